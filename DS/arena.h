@@ -25,7 +25,7 @@
            -D_ARENA_DEBUG \
            -D ARENA_TEST \
            -D ARENA_IMPLEMENTATION \
-           -o test.out arena.h
+           -o test.out arena.h -lpthread
   
       to include in other files:
       ```c
@@ -55,7 +55,20 @@
        the alignment facro by defining `ALIGNMENT_FACTOR`
        before including the library
   
+    Thread-safety:
+      `TArena` is a thread-local arena, over a shared `RegionPool`
+      `region_alloc_atomic` allocates in a region shared among threads
+      `arena_save` and `arena_restore` are the scoped save and restore
+
+    Slab allocator:
+      `Slab` is a size-class pool allocator over regions, it
+      supports freeing individual objects (see slab_alloc)
+
     Options:
+      define `ARENA_STATS`
+        to record allocation statistics (see arena_stats_dump)
+      define `ARENA_NO_THREADS`
+        to disable the thread-safe parts (and pthread)
       define `ARENA_NO_LIBC_ALLOC`
         to disable using malloc
       define `ARENA_NO_MMAP`
@@ -67,16 +80,18 @@
 #define ARENA_H__
 #include <string.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <assert.h>
 
 #ifdef _ARENA_DEBUG
 #  include <stdio.h>
-#  define fprintd(file, format, ...) \
+#  define arena_fprintd(file, format, ...) \
   fprintf (file, "[debug %s:%d] "format, __func__, __LINE__, ##__VA_ARGS__)
-#  define fprintdln(file, format, ...) fprintd (file, format"\n", ##__VA_ARGS__)
+#  define arena_fprintdln(file, format, ...) \
+  arena_fprintd (file, format"\n", ##__VA_ARGS__)
 #else
-#  define fprintd(file, format, ...)
-#  define fprintdln(file, format, ...)
+#  define arena_fprintd(file, format, ...) (void) 0
+#  define arena_fprintdln(file, format, ...) (void) 0
 #endif
 
 #ifndef ARENA_NO_LIBC_ALLOC
@@ -180,9 +195,37 @@ struct region_t {
 #define region_leftof(r) ((r)->cap - (r)->len)
 typedef struct region_t Region;
 
+/**
+ *  Allocation statistics, only when `ARENA_STATS` is defined
+ *  see arena_stats_dump
+ */
+#ifdef ARENA_STATS
+#  include <stdio.h>
+enum arena_rtype_t {
+  ARENA_R_MALLOC = 0,
+  ARENA_R_ALIGNED,
+  ARENA_R_MMAP,
+  ARENA_R_HUGE,
+};
+struct arena_stats_t {
+  size_t requested; /* bytes requested */
+  size_t reserved; /* capacity of regions */
+  size_t used, peak; /* bytes in use, and the high-water mark */
+  size_t wasted; /* free tail of the last region, when arena_alloc spills */
+  uint spills;
+  uint regions[4]; /* count of regions, by arena_rtype_t */
+};
+#  define __ARENA_STAT(...) __VA_ARGS__
+#else
+#  define __ARENA_STAT(...)
+#endif
+
 struct Arena_t {
   Region *head; /* head of the regions linked list */
   Region *end;
+#ifdef ARENA_STATS
+  struct arena_stats_t stats;
+#endif
 };
 typedef struct Arena_t Arena;
 #define new_arena() (Arena){0}
@@ -244,6 +287,140 @@ ARENADEF void arena_reset (Arena *A);
  */
 ARENADEF void arena_free (Arena *A);
 
+#ifdef ARENA_STATS
+/* prints statistics of the arena @A, and it's regions */
+ARENADEF void arena_stats_dump (Arena *A, FILE *f);
+#endif
+
+/**
+ *  Scoped save/restore
+ *  arena_save gives a mark of the end of the arena @A, and
+ *  arena_restore frees everything allocated after the mark
+ *  it takes O(1) unless new regions were allocated after the mark
+ *  (these regions are kept, to be reused)
+ *  allocations in the free space of older regions (arena_alloc
+ *  fills them when it can) are only freed by arena_reset
+ */
+struct arena_mark_t {
+  Region *end;
+  uint len;
+};
+typedef struct arena_mark_t ArenaMark;
+
+ARENADEF ArenaMark arena_save (Arena *A);
+ARENADEF void arena_restore (Arena *A, ArenaMark m);
+
+#ifndef ARENA_NO_THREADS
+#include <pthread.h>
+/**
+ *  Shared region pool
+ *  a thread-safe stack of free regions of capacity @cap,
+ *  new regions are mapped (huge regions, when @cap > HUGE_MEM)
+ */
+struct region_pool_t {
+  Region *free;
+  uint cap;
+  pthread_mutex_t lock;
+};
+typedef struct region_pool_t RegionPool;
+#define new_region_pool(region_cap)                                     \
+  (RegionPool){.cap=(region_cap), .lock=PTHREAD_MUTEX_INITIALIZER}
+
+/* gives a region of the pool @P, with zero length */
+ARENADEF Region *pool_get (RegionPool *P);
+/* gives back the region @r to the pool */
+ARENADEF void pool_put (RegionPool *P, Region *r);
+/* frees the free regions of the pool */
+ARENADEF void pool_free (RegionPool *P);
+
+/**
+ *  Thread-local arena
+ *  a bump allocator that takes regions from a shared pool,
+ *  each thread must have its own TArena, for example:
+ *  ```c
+ *    RegionPool pool = new_region_pool (1 << 20);
+ *    // in each thread
+ *    static __thread TArena T;
+ *    T = new_tarena (&pool);
+ *    ArenaMark m = tarena_save (&T);
+ *    char *scratch = tarena_alloc (&T, 1024);
+ *    tarena_restore (&T, m); // gives back regions to the pool
+ *  ```
+ *  allocations larger than the capacity of regions of the pool
+ *  get a dedicated region, which is freed instead of pooled
+ *  returned pointers are aligned to TARENA_ALIGN (a power of 2)
+ */
+#ifndef TARENA_ALIGN
+#  define TARENA_ALIGN _Alignof (max_align_t)
+#endif
+struct tarena_t {
+  Region *head; /* the current region, the others are linked after it */
+  RegionPool *pool;
+};
+typedef struct tarena_t TArena;
+#define new_tarena(pool_ptr) (TArena){.head=NULL, .pool=(pool_ptr)}
+
+ARENADEF char *tarena_alloc (TArena *T, uint size);
+ARENADEF ArenaMark tarena_save (TArena *T);
+/* O(1), plus giving back the regions allocated after the mark */
+ARENADEF void tarena_restore (TArena *T, ArenaMark m);
+/* gives back all regions of @T to the pool */
+ARENADEF void tarena_release (TArena *T);
+#endif /* ARENA_NO_THREADS */
+
+/**
+ *  Atomic bump allocation, in a single region shared among threads
+ *  (lock-free); returned pointers are aligned to ARENA_ATOMIC_ALIGN
+ *  (a power of 2), and sizes are rounded up to it
+ *  returns NULL when @r has not enough space left
+ */
+#ifndef ARENA_ATOMIC_ALIGN
+#  define ARENA_ATOMIC_ALIGN 8
+#endif
+ARENADEF char *region_alloc_atomic (Region *r, uint size);
+
+/**
+ *  Size-class pool allocator (slab)
+ *  objects are carved from regions, and freed objects are kept in
+ *  per-class free lists, alloc and free are O(1)
+ *  classes are powers of 2, from 2^SLAB_MIN_SHIFT to 2^SLAB_MAX_SHIFT
+ *  larger objects get a dedicated region (freed by slab_free)
+ *  all objects are aligned to 2^SLAB_MIN_SHIFT (16) bytes
+ *  @flags: AUSE flags of regions, or SLAB_HUGE for huge pages
+ *  it's not thread-safe, use one slab per thread
+ *  ```c
+ *    Slab S = new_slab (AUSE_MALLOC);
+ *    Token *tk = slab_alloc (&S, sizeof (Token));
+ *    slab_free (&S, tk, sizeof (Token));
+ *    slab_destroy (&S);
+ *  ```
+ */
+#define SLAB_MIN_SHIFT 4 /* 16 bytes, objects hold a free list link */
+#ifndef SLAB_MAX_SHIFT
+#  define SLAB_MAX_SHIFT 12 /* 4K */
+#endif
+#define SLAB_NCLASS (SLAB_MAX_SHIFT - SLAB_MIN_SHIFT + 1)
+#define SLAB_MAX_SIZE (1u << SLAB_MAX_SHIFT)
+/* capacity of regions, 2*HUGE_MEM for huge pages */
+#ifndef SLAB_REGION_CAP
+#  define SLAB_REGION_CAP (1 << 20)
+#endif
+#define SLAB_HUGE EXP2 (9)
+
+struct slab_t {
+  Region *head; /* the current region, the others are linked after it */
+  void *free[SLAB_NCLASS]; /* free lists */
+  uint flags;
+};
+typedef struct slab_t Slab;
+#define new_slab(region_flags) (Slab){.flags=(region_flags)}
+
+/* @size is needed by slab_free, to find the class in O(1) */
+ARENADEF void *slab_alloc (Slab *S, uint size);
+ARENADEF void slab_free (Slab *S, void *ptr, uint size);
+/* frees all regions of @S, except dedicated ones (not freed yet) */
+ARENADEF void slab_destroy (Slab *S);
+
 #endif /* ARENA_H__ */
 #ifdef ARENA_IMPLEMENTATION
 
@@ -317,7 +494,8 @@ Region *
 __new_region_mmap (uint cap)
 {
   Region *r = __arena_mmap (size_of_region (cap));
-  assert (r && "end of memory");
+  if (MAP_FAILED == (void *) r)
+    return NULL;
   r->flag = AFLAG_MAPPED | AUSE_MMAP;
   r->cap = cap;
   r->next = NULL;
@@ -357,11 +535,26 @@ __region_unmap (Region *r)
 #endif
 
 
+/* internal - frees or unmaps @r */
+static inline int
+__region_release (Region *r)
+{
+  if (FL2 (AFLAG_MAPPED, r->flag))
+    return __region_unmap (r);
+  return __region_free (r);
+}
+
 Region *
 __new_huge_region (uint cap)
 {
 #if defined (AHAS_MMAP)
-  return __new_region_mmap (cap);
+  Region *r = __new_region_mmap (cap);
+#  ifdef MADV_HUGEPAGE
+  /* ask for transparent huge pages */
+  if (NULL != r)
+    madvise (r, size_of_region (cap), MADV_HUGEPAGE);
+#  endif
+  return r;
 #else
   return NULL; /* prevent allocating huge memory with malloc */
 #endif
@@ -389,6 +582,61 @@ __new_region_H (uint cap, uint flags)
     }
 }
 
+#ifdef ARENA_STATS
+/* internal - the same order as __new_region_H */
+static inline enum arena_rtype_t
+__arena_rtypeof (Region *r, uint flags)
+{
+  if (r->cap > HUGE_MEM)
+    return ARENA_R_HUGE;
+  if (FL2 (flags, AUSE_ALIGNEDALLOC))
+    return ARENA_R_ALIGNED;
+  if (FL2 (flags, AUSE_MALLOC))
+    return ARENA_R_MALLOC;
+  return ARENA_R_MMAP;
+}
+
+static inline void
+__arena_stat_region (Arena *A, Region *r, uint flags)
+{
+  A->stats.reserved += r->cap;
+  A->stats.regions[__arena_rtypeof (r, flags)]++;
+}
+
+static inline void
+__arena_stat_alloc (Arena *A, uint size)
+{
+  A->stats.requested += size;
+  A->stats.used += size;
+  if (A->stats.used > A->stats.peak)
+    A->stats.peak = A->stats.used;
+}
+
+ARENADEF void
+arena_stats_dump (Arena *A, FILE *f)
+{
+  const struct arena_stats_t *s = &A->stats;
+  int i = 0;
+  fprintf (f, "arena @%p:\n"
+           "  requested:  %zu bytes\n"
+           "  reserved:   %zu bytes (%.1f%% used)\n"
+           "  in use:     %zu bytes, peak %zu bytes\n"
+           "  wasted:     %zu bytes in %u spills\n"
+           "  regions:    %u malloc, %u aligned, %u mmap, %u huge\n",
+           (void *) A, s->requested, s->reserved,
+           s->reserved ? 100.0 * s->requested / s->reserved : 0.0,
+           s->used, s->peak, s->wasted, s->spills,
+           s->regions[ARENA_R_MALLOC], s->regions[ARENA_R_ALIGNED],
+           s->regions[ARENA_R_MMAP], s->regions[ARENA_R_HUGE]);
+  for_regions2 (A)
+    {
+      fprintf (f, "  region #%d:  cap %u, len %u, left %u, %s\n",
+               i++, r->cap, r->len, region_leftof (r),
+               FL2 (AFLAG_MAPPED, r->flag) ? "mapped" : "malloced");
+    }
+}
+#endif /* ARENA_STATS */
+
 ARENADEF char *
 arena_alloc2 (Arena *A, uint size, uint flags)
 {
@@ -397,14 +645,16 @@ arena_alloc2 (Arena *A, uint size, uint flags)
       /* initialize the linked list */
       if (NULL != A->end)
         {
-          fprintdln (stderr, "Arena expected to be NULL, but it's not");
+          arena_fprintdln (stderr, "Arena expected to be NULL, but it's not");
           assert (0 && "Broken linked list");
         }
-      A->head->next = __new_region_H (size, flags);
+      A->head = __new_region_H (size, flags);
       if (NULL == A->head)
         return NULL;
       A->head->len = size;
       A->end = A->head;
+      __ARENA_STAT (__arena_stat_region (A, A->head, flags));
+      __ARENA_STAT (__arena_stat_alloc (A, size));
       return A->head->mem;
     }
 
@@ -416,13 +666,14 @@ arena_alloc2 (Arena *A, uint size, uint flags)
         {
           __len = r->len;
           r->len += size;
-          fprintdln (stdout, "region allocated %u, left %u bytes",
-                     size, region_leftof (r));
+          arena_fprintdln (stdout, "region allocated %u, left %u bytes",
+                           size, region_leftof (r));
+          __ARENA_STAT (__arena_stat_alloc (A, size));
           return r->mem + __len;
         }
       else
-        fprintdln (stderr, "region has cap: %u but wanted: %u",
-                   region_leftof (r), size);
+        arena_fprintdln (stderr, "region has cap: %u but wanted: %u",
+                         region_leftof (r), size);
       r = r->next;
     }
 
@@ -432,8 +683,12 @@ arena_alloc2 (Arena *A, uint size, uint flags)
   A->end->next = __new_region_H (size, flags);
   if (NULL == A->end->next)
     return NULL;
+  __ARENA_STAT (A->stats.wasted += region_leftof (A->end));
+  __ARENA_STAT (A->stats.spills++);
   A->end = A->end->next;
   A->end->len = size;
+  __ARENA_STAT (__arena_stat_region (A, A->end, flags));
+  __ARENA_STAT (__arena_stat_alloc (A, size));
   return A->end->mem;
 }
 
@@ -447,7 +702,7 @@ arena_alloc (Arena *A, uint size, uint flags)
       /* initialize the linked list */
       if (NULL != A->end)
         {
-          fprintdln (stderr, "Arena expected to be NULL, but it's not");
+          arena_fprintdln (stderr, "Arena expected to be NULL, but it's not");
           assert (0 && "Broken linked list");
         }
       A->head = __new_region_H (size, flags);
@@ -455,6 +710,8 @@ arena_alloc (Arena *A, uint size, uint flags)
         return NULL;
       A->head->len = size;
       A->end = A->head;
+      __ARENA_STAT (__arena_stat_region (A, A->head, flags));
+      __ARENA_STAT (__arena_stat_alloc (A, size));
       return A->head->mem;
     }
 
@@ -468,18 +725,19 @@ arena_alloc (Arena *A, uint size, uint flags)
             {
               __len = r->len;
               r->len += size;
-              fprintdln (stdout, "region allocated %u, left %u bytes",
-                         size, region_leftof (r));
+              arena_fprintdln (stdout, "region allocated %u, left %u bytes",
+                               size, region_leftof (r));
+              __ARENA_STAT (__arena_stat_alloc (A, size));
               return r->mem + __len;
             } else
             {
-              fprintdln (stderr, "region has flag: %u but wanted: %u",
-                         memtypeof (r->flag), flags);
+              arena_fprintdln (stderr, "region has flag: %u but wanted: %u",
+                               memtypeof (r->flag), flags);
             }
         }
       else
-        fprintdln (stderr, "region has cap: %u but wanted: %u",
-                   region_leftof (r), size);
+        arena_fprintdln (stderr, "region has cap: %u but wanted: %u",
+                         region_leftof (r), size);
       r = r->next;
     }
 
@@ -489,8 +747,12 @@ arena_alloc (Arena *A, uint size, uint flags)
   A->end->next = __new_region_H (size, flags);
   if (NULL == A->end->next)
     return NULL;
+  __ARENA_STAT (A->stats.wasted += region_leftof (A->end));
+  __ARENA_STAT (A->stats.spills++);
   A->end = A->end->next;
   A->end->len = size;
+  __ARENA_STAT (__arena_stat_region (A, A->end, flags));
+  __ARENA_STAT (__arena_stat_alloc (A, size));
   return A->end->mem;
 }
 
@@ -526,19 +788,275 @@ arena_reset (Arena *A)
     {
       r->len = 0;
     }
+  __ARENA_STAT (A->stats.used = 0);
 }
 
 ARENADEF void
 arena_free (Arena *A)
 {
-  Region *tmp;
-  for_regions2 (A)
+  Region *r = A->head, *next;
+  while (NULL != r)
     {
-      tmp = r;
-      __region_free (tmp);
+      next = r->next;
+      __region_release (r);
+      r = next;
     }
   A->head = NULL;
   A->end = NULL;
+  __ARENA_STAT (A->stats = (struct arena_stats_t){0});
+}
+
+ARENADEF ArenaMark
+arena_save (Arena *A)
+{
+  return (ArenaMark){
+    .end = A->end,
+    .len = (A->end) ? A->end->len : 0
+  };
+}
+
+ARENADEF void
+arena_restore (Arena *A, ArenaMark m)
+{
+  if (NULL == m.end)
+    {
+      arena_reset (A);
+      return;
+    }
+  m.end->len = m.len;
+  for (Region *r = m.end->next; NULL != r; r = r->next)
+    r->len = 0;
+#ifdef ARENA_STATS
+  A->stats.used = 0;
+  for_regions2 (A)
+    A->stats.used += r->len;
+#endif
+}
+
+#ifndef ARENA_NO_THREADS
+ARENADEF Region *
+pool_get (RegionPool *P)
+{
+  Region *r;
+  pthread_mutex_lock (&P->lock);
+  if (NULL != (r = P->free))
+    P->free = r->next;
+  pthread_mutex_unlock (&P->lock);
+
+  if (NULL == r)
+    {
+      if (P->cap > HUGE_MEM)
+        r = __new_huge_region (P->cap);
+      else
+        r = __new_region_mmap (P->cap);
+      if (NULL == r)
+        r = __new_region_malloc (P->cap);
+      if (NULL == r)
+        return NULL;
+    }
+  r->next = NULL;
+  r->len = 0;
+  return r;
+}
+
+ARENADEF void
+pool_put (RegionPool *P, Region *r)
+{
+  if (r->cap != P->cap)
+    {
+      /* dedicated region of a large allocation */
+      __region_release (r);
+      return;
+    }
+  pthread_mutex_lock (&P->lock);
+  r->next = P->free;
+  P->free = r;
+  pthread_mutex_unlock (&P->lock);
+}
+
+ARENADEF void
+pool_free (RegionPool *P)
+{
+  pthread_mutex_lock (&P->lock);
+  Region *r = P->free, *next;
+  P->free = NULL;
+  pthread_mutex_unlock (&P->lock);
+  for (; NULL != r; r = next)
+    {
+      next = r->next;
+      __region_release (r);
+    }
+}
+
+ARENADEF char *
+tarena_alloc (TArena *T, uint size)
+{
+  Region *r = T->head;
+  uint start = 0;
+  /* region_t::mem is not aligned, the offset is padded */
+  if (NULL != r)
+    start = r->len + (-(uintptr_t)(r->mem + r->len) & (TARENA_ALIGN - 1));
+  if (NULL == r || start > r->cap || size > r->cap - start)
+    {
+      if (size + TARENA_ALIGN > T->pool->cap)
+        r = __new_region_H (size + TARENA_ALIGN, AUSE_MMAP);
+      else
+        r = pool_get (T->pool);
+      if (NULL == r)
+        return NULL;
+      r->len = 0;
+      r->next = T->head;
+      T->head = r;
+      start = -(uintptr_t) r->mem & (TARENA_ALIGN - 1);
+    }
+  r->len = start + size;
+  return r->mem + start;
+}
+
+ARENADEF ArenaMark
+tarena_save (TArena *T)
+{
+  return (ArenaMark){
+    .end = T->head,
+    .len = (T->head) ? T->head->len : 0
+  };
+}
+
+ARENADEF void
+tarena_restore (TArena *T, ArenaMark m)
+{
+  Region *next;
+  while (T->head != m.end && NULL != T->head)
+    {
+      next = T->head->next;
+      pool_put (T->pool, T->head);
+      T->head = next;
+    }
+  if (NULL != T->head)
+    T->head->len = m.len;
+}
+
+ARENADEF void
+tarena_release (TArena *T)
+{
+  tarena_restore (T, (ArenaMark){0});
+}
+#endif /* ARENA_NO_THREADS */
+
+ARENADEF char *
+region_alloc_atomic (Region *r, uint size)
+{
+  uint old = __atomic_load_n (&r->len, __ATOMIC_RELAXED), start, new;
+  size = (size + ARENA_ATOMIC_ALIGN - 1) & ~(ARENA_ATOMIC_ALIGN - 1);
+  do
+    {
+      /* region_t::mem is not aligned, only the first one pads */
+      start = old + (-(uintptr_t)(r->mem + old) & (ARENA_ATOMIC_ALIGN - 1));
+      if (start > r->cap || size > r->cap - start)
+        return NULL;
+      new = start + size;
+    }
+  while (!__atomic_compare_exchange_n (&r->len, &old, new, 1,
+                                       __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+  return r->mem + start;
+}
+/* internal - class of objects of size @size */
+static inline int
+__slab_class (uint size)
+{
+  if (size <= (1u << SLAB_MIN_SHIFT))
+    return 0;
+  return 32 - __builtin_clz (size - 1) - SLAB_MIN_SHIFT;
+}
+
+/* internal - new region for @S */
+static inline Region *
+__slab_region (Slab *S, uint cap)
+{
+  Region *r;
+  if (FL2 (SLAB_HUGE, S->flags))
+    r = __new_huge_region (cap);
+  else
+    r = __new_region_H (cap, S->flags);
+  if (NULL != r)
+    r->len = 0;
+  return r;
+}
+
+ARENADEF void *
+slab_alloc (Slab *S, uint size)
+{
+  Region *r;
+  if (size > SLAB_MAX_SIZE)
+    {
+      /**
+       *  region_t::mem is not aligned, the padding (1 to 16 bytes)
+       *  is stored in the byte before the object, for slab_free
+       */
+      const uint align = 1u << SLAB_MIN_SHIFT;
+      if (NULL == (r = __slab_region (S, size + align)))
+        return NULL;
+      uint pad = align - ((uintptr_t) r->mem & (align - 1));
+      r->len = pad + size;
+      r->mem[pad - 1] = pad;
+      return r->mem + pad;
+    }
+
+  int c = __slab_class (size);
+  void **p = S->free[c];
+  if (NULL != p)
+    {
+      S->free[c] = *p;
+      return p;
+    }
+
+  size = 1u << (c + SLAB_MIN_SHIFT);
+  r = S->head;
+  if (NULL == r || r->len + size > r->cap)
+    {
+      uint cap = SLAB_REGION_CAP;
+      if (FL2 (SLAB_HUGE, S->flags) && cap < 2 * HUGE_MEM)
+        cap = 2 * HUGE_MEM;
+      if (NULL == (r = __slab_region (S, cap)))
+        return NULL;
+      r->next = S->head;
+      S->head = r;
+      /* region_t::mem is not aligned, classes are multiples of 16 */
+      r->len = -(uintptr_t) r->mem & ((1u << SLAB_MIN_SHIFT) - 1);
+    }
+  p = (void **)(r->mem + r->len);
+  r->len += size;
+  return p;
+}
+
+ARENADEF void
+slab_free (Slab *S, void *ptr, uint size)
+{
+  if (NULL == ptr)
+    return;
+  if (size > SLAB_MAX_SIZE)
+    {
+      /* the padding of slab_alloc, see there */
+      uint pad = ((unsigned char *) ptr)[-1];
+      __region_release ((Region *)((char *) ptr - pad
+                                   - offsetof (Region, mem)));
+      return;
+    }
+  int c = __slab_class (size);
+  *(void **) ptr = S->free[c];
+  S->free[c] = ptr;
+}
+
+ARENADEF void
+slab_destroy (Slab *S)
+{
+  Region *r = S->head, *next;
+  for (; NULL != r; r = next)
+    {
+      next = r->next;
+      __region_release (r);
+    }
+  *S = new_slab (S->flags);
 }
 #endif /* ARENA_IMPLEMENTATION */
 
@@ -556,6 +1074,47 @@ arenabak (Arena *A)
   };
 }
 
+#ifndef ARENA_NO_THREADS
+#define TEST_THREADS 4
+static void *
+tarena_worker (void *arg)
+{
+  TArena T = new_tarena ((RegionPool *) arg);
+  for (int req = 0; req < 100; ++req)
+    {
+      /* per-request scratch memory */
+      ArenaMark m = tarena_save (&T);
+      for (int i = 0; i < 50; ++i)
+        {
+          char *p = tarena_alloc (&T, 20 + i);
+          assert (NULL != p);
+          assert (0 == ((uintptr_t) p & (TARENA_ALIGN - 1)));
+          memset (p, req, 20 + i);
+        }
+      /* dedicated region */
+      assert (NULL != tarena_alloc (&T, 2 * ARENA_MIN_CAP));
+      tarena_restore (&T, m);
+    }
+  tarena_release (&T);
+  assert (NULL == T.head);
+  return NULL;
+}
+
+static void *
+atomic_worker (void *arg)
+{
+  Region *shared = arg;
+  for (int i = 0; i < 1000; ++i)
+    {
+      uint *p = (uint *) region_alloc_atomic (shared, 13); /* 16 bytes */
+      assert (NULL != p);
+      assert (0 == ((uintptr_t) p & (ARENA_ATOMIC_ALIGN - 1)));
+      p[1] = (char *) p - shared->mem;
+    }
+  return NULL;
+}
+#endif /* ARENA_NO_THREADS */
+
 int
 main (void)
 {
@@ -670,8 +1229,132 @@ main (void)
 
   printf ("freeing... ");
   arena_free (&A);
-  printf ("passed\n");
-  
+  printf ("passed\n\n");
+
+  /* test 4  --  save and restore */
+  printf ("testing save and restore... ");
+  {
+    char *q1 = arena_alloc (&A, 100, AUSE_MALLOC);
+    ArenaMark m = arena_save (&A);
+    char *q2 = arena_alloc (&A, 200, AUSE_MALLOC);
+    assert (q2 == q1 + 100);
+    /* spills to a new region */
+    assert (NULL != arena_alloc (&A, 2 * ARENA_MIN_CAP, AUSE_MALLOC));
+    arena_restore (&A, m);
+    assert (A.head->len == 100 && A.head->next->len == 0);
+    assert (q2 == arena_alloc (&A, 200, AUSE_MALLOC));
+    arena_free (&A);
+  }
+  printf ("pass\n");
+
+  /* test 5  --  slab */
+  printf ("testing slab allocator... ");
+  {
+    static void *objs[3000];
+    uint sizes[] = {1, 16, 17, 100, 1000, SLAB_MAX_SIZE};
+    Slab S = new_slab (AUSE_MALLOC);
+    for (int i = 0; i < 3000; ++i)
+      {
+        uint size = sizes[i % 6];
+        objs[i] = slab_alloc (&S, size);
+        assert (NULL != objs[i]);
+        assert (0 == ((uintptr_t) objs[i] & ((1u << SLAB_MIN_SHIFT) - 1)));
+        memset (objs[i], i, size);
+      }
+    /* more than one region */
+    assert (NULL != S.head->next);
+    /* freed objects are reused, by their class */
+    slab_free (&S, objs[3], 100);
+    slab_free (&S, objs[9], 100);
+    assert (objs[9] == slab_alloc (&S, 128));
+    assert (objs[3] == slab_alloc (&S, 65));
+    assert (objs[1] != slab_alloc (&S, 16));
+    /* dedicated region */
+    char *big = slab_alloc (&S, 3 * SLAB_MAX_SIZE);
+    assert (NULL != big);
+    assert (0 == ((uintptr_t) big & ((1u << SLAB_MIN_SHIFT) - 1)));
+    memset (big, 0, 3 * SLAB_MAX_SIZE);
+    slab_free (&S, big, 3 * SLAB_MAX_SIZE);
+    slab_destroy (&S);
+    assert (NULL == S.head && NULL == S.free[0]);
+
+    S = new_slab (SLAB_HUGE);
+    char *h = slab_alloc (&S, 64);
+    assert (NULL != h);
+    assert (S.head->cap >= 2 * HUGE_MEM && FL2 (AFLAG_MAPPED, S.head->flag));
+    slab_destroy (&S);
+  }
+  printf ("pass\n");
+
+#ifdef ARENA_STATS
+  /* test 6  --  statistics */
+  printf ("testing arena statistics... ");
+  {
+    Arena A = new_arena ();
+    assert (NULL != arena_alloc (&A, 500, AUSE_MALLOC));
+    assert (NULL != arena_alloc (&A, 400, AUSE_MALLOC));
+    /* spills, 124 bytes left in the first region */
+    assert (NULL != arena_alloc (&A, 300, AUSE_MALLOC));
+    /* spills, no mmap region */
+    assert (NULL != arena_alloc (&A, 600, AUSE_MMAP));
+    /* fits in the first region */
+    assert (NULL != arena_alloc2 (&A, 100, AUSE_MALLOC));
+    assert (A.stats.requested == 1900);
+    assert (A.stats.reserved == 3 * ARENA_MIN_CAP);
+    assert (A.stats.spills == 2);
+    assert (A.stats.wasted == (ARENA_MIN_CAP - 900) + (ARENA_MIN_CAP - 300));
+    assert (A.stats.regions[ARENA_R_MALLOC] == 2);
+    assert (A.stats.regions[ARENA_R_MMAP] == 1);
+    assert (A.stats.peak == 1900 && A.stats.used == 1900);
+    arena_reset (&A);
+    assert (0 == A.stats.used && A.stats.peak == 1900);
+    arena_free (&A);
+    assert (0 == A.stats.requested);
+  }
+  printf ("pass\n");
+#endif /* ARENA_STATS */
+
+#ifndef ARENA_NO_THREADS
+  printf ("testing thread-local arenas... ");
+  {
+    RegionPool pool = new_region_pool (ARENA_MIN_CAP);
+    pthread_t th[TEST_THREADS];
+    for (int i = 0; i < TEST_THREADS; ++i)
+      pthread_create (&th[i], NULL, tarena_worker, &pool);
+    for (int i = 0; i < TEST_THREADS; ++i)
+      pthread_join (th[i], NULL);
+    /* all regions must be back in the pool */
+    int n = 0;
+    for (Region *r = pool.free; r; r = r->next)
+      ++n;
+    assert (n > 0 && n <= TEST_THREADS * 3);
+    pool_free (&pool);
+    assert (NULL == pool.free);
+  }
+  printf ("pass\n");
+
+  printf ("testing atomic allocation... ");
+  {
+    /* plus the padding of the first allocation */
+    Region *shared = __new_region_mmap (TEST_THREADS * 1000 * 16
+                                        + ARENA_ATOMIC_ALIGN);
+    shared->len = 0;
+    uint pad = -(uintptr_t) shared->mem & (ARENA_ATOMIC_ALIGN - 1);
+    pthread_t th[TEST_THREADS];
+    for (int i = 0; i < TEST_THREADS; ++i)
+      pthread_create (&th[i], NULL, atomic_worker, shared);
+    for (int i = 0; i < TEST_THREADS; ++i)
+      pthread_join (th[i], NULL);
+    /* every allocation must be disjoint */
+    for (uint i = pad; i < shared->len; i += 16)
+      assert (((uint *)(shared->mem + i))[1] == i);
+    assert (shared->len == pad + TEST_THREADS * 1000 * 16);
+    assert (NULL == region_alloc_atomic (shared, ARENA_ATOMIC_ALIGN + 1));
+    __region_release (shared);
+  }
+  printf ("pass\n");
+#endif /* ARENA_NO_THREADS */
+
   return 0;
 }
 
@@ -23,13 +23,25 @@
     insert and lookup keys, by index, in O(1) time and memory
     or make a hash table of an arbitrary struct, then
     access their indices via key (see the example program)
+    GHashTable (ght_xxx functions) is the growable variant,
+    it supports deletion and uses SSE2 to probe slots, when available
+    ht_insert_mt and ht_idxof_mt are the thread-safe (lock-free)
+    variants of ht_insert and ht_idxof
   
     Compilation:
       to compile the test program:
       cc -x c -ggdb -Wall -Wextra -Werror \
          -D HASHTAB_IMPLEMENTATION \
-         -D HASHTAB_TEST hashtab.h -o test.out
+         -D HASHTAB_TEST hashtab.h -o test.out -lpthread
   
+      to compile the benchmark program, of hash functions:
+      (define HT_HASHER to benchmark the inlined version of a hasher)
+      cc -x c -O3 -msse4.2 -D HASHTAB_IMPLEMENTATION \
+         -D HASHTAB_BENCH hashtab.h -o bench.out
+      it reads keys from stdin, one per line, for example:
+        key_extractor dedup:  kextractor < files | ./bench.out
+        permugen word seeds:  cat wordlists | ./bench.out
+
       to compile the example program:
       cc -x c -ggdb -Wall -Wextra -Werror \
          -D HASHTAB_IMPLEMENTATION \
@@ -115,6 +127,29 @@ HASHTABDEFF const char *ht_strerr (enum ht_error_t err);
  *  used as the default hasher
  */
 HASHTABDEFF hash_t hash_FNV_1a (const char *data, idx_t len);
+/**
+ *  wyhash-like hash function, reads 8 bytes per iteration
+ *  much faster than FNV-1a on long keys (URLs, paths, ...)
+ */
+HASHTABDEFF hash_t hash_wy (const char *data, idx_t len);
+#ifdef __SSE4_2__
+/* CRC32C, using the crc32 instruction (compile with -msse4.2) */
+HASHTABDEFF hash_t hash_crc32c (const char *data, idx_t len);
+#endif
+
+/**
+ *  To select the hash function at compile time, define `HT_HASHER`
+ *  as hash_FNV_1a, hash_wy or hash_crc32c (or your own function)
+ *  it's called directly, so it can be inlined, and the hasher
+ *  given to ht_set_funs is ignored
+ */
+#ifdef HT_HASHER
+#  define __HT_HASH(ht, key, len) HT_HASHER (key, len)
+#  define __HT_DEFAULT_HASHER HT_HASHER
+#else
+#  define __HT_HASH(ht, key, len) (ht)->Hasher (key, len)
+#  define __HT_DEFAULT_HASHER hash_FNV_1a
+#endif
 
 struct keytab_t {
   DATA_T *key; /* does not have to be string */
@@ -175,6 +210,22 @@ ht_idxof (HashTable *ht, char *key, size_t key_len, idx_t *result);
 #define ht_idxofs(ht, key, result) \
   ht_idxof (ht, key, strlen (key), result)
 
+/**
+ *  Thread-safe variants of ht_insert and ht_idxof
+ *  Slots only go from empty to full: lookups read them atomically
+ *  (lock-free), and insertions claim empty slots by compare-and-swap,
+ *  so readers never block and writers never wait for each other
+ *  The data at @head[data_idx] must be written before calling
+ *  ht_insert_mt, it is published to readers by the slot, and
+ *  @head must not be reallocated meanwhile
+ *  The capacity is fixed, on HT_NO_EMPTYSLOT, the other threads
+ *  must be stopped before rehashing the table
+ */
+HASHTABDEFF int ht_insert_mt (HashTable *ht, idx_t data_idx);
+
+HASHTABDEFF int
+ht_idxof_mt (HashTable *ht, const char *key, size_t key_len, idx_t *result);
+
 
 #define ht_free(ht, free_fun) do {                \
   size_t cap_bytes = ht_sizeof (ht);              \
@@ -183,6 +234,93 @@ ht_idxof (HashTable *ht, char *key, size_t key_len, idx_t *result);
     free_fun;                                     \
   }} while (0)
 
+/**
+ *  Growable hash table
+ *  It has the same design as HashTable (slots are indices of
+ *  @head), but it grows by doubling its capacity, and keys can
+ *  be deleted
+ *
+ *  Growing is incremental: after allocating the new slots, each
+ *  insertion moves GHT_MIGRATE_STEP slots of the old ones
+ *  Slots are probed linearly in groups of GHT_GROUP control bytes,
+ *  each one is either GHT_EMPTY or the 7-bit tag of the hash of
+ *  the slot; the tags of a group are matched at once (using SSE2
+ *  if available), then the full hash is compared before isEqual
+ *  Deletion shifts the following slots backward (no tombstones)
+ */
+#define GHT_GROUP 16
+#ifndef GHT_MIGRATE_STEP
+#  define GHT_MIGRATE_STEP 16
+#endif
+
+struct ght_slots_t {
+  struct {
+    hash_t hash;
+    idx_t idx; /* index of data */
+  } *slot;
+  uint8_t *ctrl; /* control bytes, @cap + GHT_GROUP */
+  idx_t cap; /* power of 2 */
+};
+
+struct ghashtab_t {
+  struct ght_slots_t s;
+  struct ght_slots_t old; /* the old slots, while growing */
+  idx_t mig; /* slots of @old before this index are moved */
+  idx_t len; /* count of keys */
+
+  DATA_T *head; /* pointer to data */
+  int __data_size; /* length of pointers in head */
+  int __key_offset; /* offset of keytab_t in each head[index] */
+
+  ht_isequal isEqual;
+  ht_hasher Hasher;
+};
+typedef struct ghashtab_t GHashTable;
+
+/* the same as new_hashtab, ht_set_funs also works on GHashTable */
+#define new_ghashtab(table_len, data_ptr)                               \
+  (GHashTable){.s.cap=(idx_t)(table_len),                               \
+      .head=(DATA_T*)data_ptr,                                          \
+      .__data_size=sizeof (data_ptr[0]),                                \
+      .__key_offset=0                                                   \
+    }
+#define new_ghashtab_t(table_len, data_ptr, T, memb)                    \
+  (GHashTable){.s.cap=(idx_t)(table_len),                               \
+      .head=(DATA_T*)data_ptr,                                          \
+      .__data_size=sizeof (data_ptr[0]),                                \
+      .__key_offset=offsetof (T, memb)                                  \
+    }
+
+#define ght_lenof(ht) ((ht)->len)
+
+/**
+ *  Allocates the slots, at least of the initial capacity
+ *  returns -1 on failure (or when head is NULL)
+ */
+HASHTABDEFF int ght_init (GHashTable *ht);
+
+/**
+ *  Returns HT_FOUND on success, HT_DUPLICATED when
+ *  the key already exists, and -1 on allocation failure
+ */
+HASHTABDEFF int ght_insert (GHashTable *ht, idx_t data_idx);
+
+HASHTABDEFF int
+ght_idxof (GHashTable *ht, const char *key, size_t key_len, idx_t *result);
+
+#define ght_idxofs(ht, key, result) \
+  ght_idxof (ht, key, strlen (key), result)
+
+/**
+ *  Deletes the key, and gives it's index (if @result is not NULL)
+ *  returns HT_FOUND or HT_NOT_FOUND
+ *  the data at @head is untouched
+ */
+HASHTABDEFF int
+ght_delete (GHashTable *ht, const char *key, size_t key_len, idx_t *result);
+
+HASHTABDEFF void ght_free (GHashTable *ht);
+
 #endif /* HAHSTAB__H__ */
 
 /* hash table implementation */
@@ -228,6 +366,96 @@ hash_FNV_1a (const char *data, idx_t len)
   return hash;
 }
 
+/* internal - unaligned reads of wyhash */
+static inline uint64_t
+__ht_r8 (const char *p)
+{
+  uint64_t v;
+  memcpy (&v, p, 8);
+  return v;
+}
+
+static inline uint64_t
+__ht_r4 (const char *p)
+{
+  uint32_t v;
+  memcpy (&v, p, 4);
+  return v;
+}
+
+/* internal - 64x64 -> 128 bit multiplication, folded */
+static inline uint64_t
+__ht_mum (uint64_t a, uint64_t b)
+{
+#ifdef __SIZEOF_INT128__
+  __uint128_t r = (__uint128_t) a * b;
+  return (uint64_t) r ^ (uint64_t)(r >> 64);
+#else
+  uint64_t ha = a >> 32, hb = b >> 32, la = (uint32_t) a, lb = (uint32_t) b;
+  uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+  uint64_t t = rl + (rm0 << 32), c = t < rl, lo;
+  lo = t + (rm1 << 32);
+  c += lo < t;
+  return lo ^ (rh + (rm0 >> 32) + (rm1 >> 32) + c);
+#endif
+}
+
+HASHTABDEFF hash_t
+hash_wy (const char *data, idx_t len)
+{
+  const uint64_t s0 = 0xa0761d6478bd642fULL;
+  const uint64_t s1 = 0xe7037ed1a0b428dbULL;
+  const unsigned char *u = (const unsigned char *) data;
+  uint64_t seed = s0 ^ len, a, b;
+
+  if (len <= 16)
+    {
+      if (len >= 4)
+        {
+          idx_t m = (len >> 3) << 2;
+          a = (__ht_r4 (data) << 32) | __ht_r4 (data + m);
+          b = (__ht_r4 (data + len - 4) << 32) | __ht_r4 (data + len - 4 - m);
+        }
+      else if (len > 0)
+        {
+          a = ((uint64_t) u[0] << 16) | ((uint64_t) u[len >> 1] << 8)
+            | u[len - 1];
+          b = 0;
+        }
+      else
+        a = b = 0;
+    }
+  else
+    {
+      idx_t i = len;
+      for (; i > 16; i -= 16, data += 16)
+        seed = __ht_mum (__ht_r8 (data) ^ s1, __ht_r8 (data + 8) ^ seed);
+      a = __ht_r8 (data + i - 16);
+      b = __ht_r8 (data + i - 8);
+    }
+  return (hash_t) __ht_mum (s1 ^ len, __ht_mum (a ^ s1, b ^ seed));
+}
+
+#ifdef __SSE4_2__
+#  include <nmmintrin.h>
+HASHTABDEFF hash_t
+hash_crc32c (const char *data, idx_t len)
+{
+  uint32_t crc = 0xFFFFFFFF;
+#  ifdef __x86_64__
+  uint64_t c = crc;
+  for (; len >= 8; len -= 8, data += 8)
+    c = _mm_crc32_u64 (c, __ht_r8 (data));
+  crc = (uint32_t) c;
+#  endif
+  for (; len >= 4; len -= 4, data += 4)
+    crc = _mm_crc32_u32 (crc, (uint32_t) __ht_r4 (data));
+  for (; len > 0; --len, ++data)
+    crc = _mm_crc32_u8 (crc, *data);
+  return ~crc;
+}
+#endif /* __SSE4_2__ */
+
 /* internal - default isequal function */
 static inline int
 __default_isequal(const DATA_T *restrict k1, idx_t l1,
@@ -249,7 +477,7 @@ ht_init (HashTable *ht, hash_t *buf)
   ht->table = buf;
 
   if (NULL == ht->Hasher)
-    ht->Hasher = &hash_FNV_1a;
+    ht->Hasher = &__HT_DEFAULT_HASHER;
   if (NULL == ht->isEqual)
     ht->isEqual = &__default_isequal;
   if (ht->dl > ht->cap)
@@ -264,7 +492,7 @@ __do_hash (HashTable *t, idx_t i)
 {
   if ((idx_t)-1 == i)
     return -1;
-  return t->Hasher (__GET_K(t, i), __LEN_K(t, i)) % t->cap;
+  return __HT_HASH (t, __GET_K(t, i), __LEN_K(t, i)) % t->cap;
 }
 
 HASHTABDEFF int
@@ -318,7 +546,7 @@ ht_insert (HashTable *ht, idx_t data_idx)
 HASHTABDEFF int
 ht_idxof (HashTable *ht, char *key, size_t key_len, idx_t *result)
 {
-  hash_t hash = ht->Hasher (key, key_len) % ht->cap;
+  hash_t hash = __HT_HASH (ht, key, key_len) % ht->cap;
   idx_t *ptr = ht->table + hash;
 
   if ((idx_t)-1 == *ptr)
@@ -349,6 +577,335 @@ ht_idxof (HashTable *ht, char *key, size_t key_len, idx_t *result)
   return HT_NOT_FOUND;
 }
 
+/* internal - thread-safe mode */
+#define __HT_LOAD(slot) __atomic_load_n (slot, __ATOMIC_ACQUIRE)
+
+/**
+ *  internal - claims @slot for @data_idx, returns HT_FOUND on success
+ *  HT_DUPLICATED when it has the same key, otherwise HT_NOT_FOUND
+ */
+static inline int
+__ht_claim (HashTable *ht, idx_t *slot, idx_t data_idx)
+{
+  idx_t cur = __HT_LOAD (slot);
+  if ((idx_t)-1 == cur &&
+      __atomic_compare_exchange_n (slot, &cur, data_idx, false,
+                                   __ATOMIC_RELEASE, __ATOMIC_ACQUIRE))
+    return HT_FOUND;
+  /* @cur is the index that took the slot */
+  if (ht->isEqual (__GET_K(ht, data_idx), __LEN_K(ht, data_idx),
+                   __GET_K(ht, cur),  __LEN_K(ht, cur)))
+    return HT_DUPLICATED;
+  return HT_NOT_FOUND;
+}
+
+HASHTABDEFF int
+ht_insert_mt (HashTable *ht, idx_t data_idx)
+{
+  /* the same probe sequence as ht_insert */
+  hash_t hash = __do_hash (ht, data_idx);
+  int ret = __ht_claim (ht, ht->table + hash, data_idx);
+  if (HT_NOT_FOUND != ret)
+    return ret;
+
+  for (int i = -1 * ht->dl; i <= (int)ht->dl; ++i)
+    {
+      idx_t *ptr = ht->table + ((hash + i + ht->cap) % ht->cap);
+      if (HT_NOT_FOUND != (ret = __ht_claim (ht, ptr, data_idx)))
+        return ret;
+    }
+  return HT_NO_EMPTYSLOT;
+}
+
+HASHTABDEFF int
+ht_idxof_mt (HashTable *ht, const char *key, size_t key_len, idx_t *result)
+{
+  hash_t hash = __HT_HASH (ht, key, key_len) % ht->cap;
+  idx_t cur = __HT_LOAD (ht->table + hash);
+
+  if ((idx_t)-1 == cur)
+    return HT_NOT_FOUND;
+  if (ht->isEqual (__GET_K(ht, cur), __LEN_K(ht, cur), key, key_len))
+    {
+      *result = cur;
+      return HT_FOUND;
+    }
+  for (int i = -1 * ht->dl; i <= (int)ht->dl; ++i)
+    {
+      cur = __HT_LOAD (ht->table + ((hash + i + ht->cap) % ht->cap));
+      if ((idx_t)-1 != cur &&
+          ht->isEqual (__GET_K(ht, cur), __LEN_K(ht, cur), key, key_len))
+        {
+          *result = cur;
+          return HT_FOUND;
+        }
+    }
+  return HT_NOT_FOUND;
+}
+
+/* growable hash table implementation */
+#include <stdlib.h>
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
+#define GHT_EMPTY 0x80
+#define GHT_MOVED 0xFE /* migrated or deleted, only in the old slots */
+#define __GHT_TAG(h) ((uint8_t)((h) >> 25))
+#define __GHT_ISFULL(c) ((c) < GHT_EMPTY)
+
+/**
+ *  internal - mixes bits of hashes (murmur3 finalizer)
+ *  home slots are taken from the low bits, FNV-1a
+ *  is not good enough for power of 2 capacities
+ */
+static inline hash_t
+__ght_mix (hash_t h)
+{
+  h ^= h >> 16;
+  h *= 0x85ebca6b;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35;
+  h ^= h >> 16;
+  return h;
+}
+
+/* internal - bit mask of control bytes of group @g equal to @c */
+static inline uint32_t
+__ght_match (const uint8_t *g, uint8_t c)
+{
+#ifdef __SSE2__
+  __m128i v = _mm_loadu_si128 ((const __m128i *) g);
+  return _mm_movemask_epi8 (_mm_cmpeq_epi8 (v, _mm_set1_epi8 ((char) c)));
+#else
+  uint32_t m = 0;
+  for (int i = 0; i < GHT_GROUP; ++i)
+    m |= (uint32_t)(g[i] == c) << i;
+  return m;
+#endif
+}
+
+/**
+ *  internal - sets control byte of slot @i
+ *  the first group is mirrored after the last slot,
+ *  so groups can be loaded at any slot
+ */
+static inline void
+__ght_set_ctrl (struct ght_slots_t *s, idx_t i, uint8_t c)
+{
+  s->ctrl[i] = c;
+  if (i < GHT_GROUP - 1)
+    s->ctrl[s->cap + i] = c;
+}
+
+static int
+__ght_alloc (struct ght_slots_t *s, idx_t cap)
+{
+  size_t n = cap * sizeof (s->slot[0]);
+  if (NULL == (s->slot = malloc (n + cap + GHT_GROUP)))
+    return -1;
+  s->ctrl = (uint8_t *)(s->slot + cap);
+  s->cap = cap;
+  memset (s->ctrl, GHT_EMPTY, cap + GHT_GROUP);
+  return 0;
+}
+
+/* internal - position of the key in @s, or -1 */
+static inline long
+__ght_find (GHashTable *ht, struct ght_slots_t *s,
+            hash_t h, const char *key, size_t key_len)
+{
+  idx_t mask = s->cap - 1, pos = h & mask;
+  uint8_t tag = __GHT_TAG (h);
+
+  for (idx_t n = 0; n < s->cap; n += GHT_GROUP)
+    {
+      const uint8_t *g = s->ctrl + pos;
+      for (uint32_t m = __ght_match (g, tag); m; m &= m - 1)
+        {
+          idx_t i = (pos + __builtin_ctz (m)) & mask;
+          idx_t idx = s->slot[i].idx;
+          if (s->slot[i].hash == h &&
+              ht->isEqual (__GET_K(ht, idx), __LEN_K(ht, idx), key, key_len))
+            return i;
+        }
+      if (__ght_match (g, GHT_EMPTY))
+        break;
+      pos = (pos + GHT_GROUP) & mask;
+    }
+  return -1;
+}
+
+/* internal - puts a new key in the first empty slot */
+static inline void
+__ght_put (struct ght_slots_t *s, hash_t h, idx_t data_idx)
+{
+  idx_t mask = s->cap - 1, pos = h & mask;
+  uint32_t m;
+
+  while (0 == (m = __ght_match (s->ctrl + pos, GHT_EMPTY)))
+    pos = (pos + GHT_GROUP) & mask;
+  pos = (pos + __builtin_ctz (m)) & mask;
+  __ght_set_ctrl (s, pos, __GHT_TAG (h));
+  s->slot[pos].hash = h;
+  s->slot[pos].idx = data_idx;
+}
+
+/**
+ *  internal - empties slot @i, the following slots are shifted
+ *  backward, unless they would go before their home slot
+ */
+static inline void
+__ght_erase (struct ght_slots_t *s, idx_t i)
+{
+  idx_t mask = s->cap - 1, j = i;
+  for (;;)
+    {
+      j = (j + 1) & mask;
+      if (GHT_EMPTY == s->ctrl[j])
+        break;
+      idx_t home = s->slot[j].hash & mask;
+      if (((j - home) & mask) >= ((j - i) & mask))
+        {
+          __ght_set_ctrl (s, i, s->ctrl[j]);
+          s->slot[i] = s->slot[j];
+          i = j;
+        }
+    }
+  __ght_set_ctrl (s, i, GHT_EMPTY);
+}
+
+/* internal - moves @n slots of the old slots */
+static void
+__ght_migrate (GHashTable *ht, idx_t n)
+{
+  struct ght_slots_t *o = &ht->old;
+  for (; n > 0 && ht->mig < o->cap; --n, ++ht->mig)
+    {
+      if (__GHT_ISFULL (o->ctrl[ht->mig]))
+        {
+          __ght_put (&ht->s, o->slot[ht->mig].hash, o->slot[ht->mig].idx);
+          /* keep the probe sequences of the old slots */
+          __ght_set_ctrl (o, ht->mig, GHT_MOVED);
+        }
+    }
+  if (ht->mig == o->cap)
+    {
+      free (o->slot);
+      *o = (struct ght_slots_t){0};
+    }
+}
+
+HASHTABDEFF int
+ght_init (GHashTable *ht)
+{
+  idx_t cap = GHT_GROUP;
+  if (NULL == ht || NULL == ht->head)
+    return -1;
+  while (cap < ht->s.cap)
+    cap <<= 1;
+  if (0 != __ght_alloc (&ht->s, cap))
+    return -1;
+  ht->old = (struct ght_slots_t){0};
+  ht->mig = 0;
+  ht->len = 0;
+
+  if (NULL == ht->Hasher)
+    ht->Hasher = &__HT_DEFAULT_HASHER;
+  if (NULL == ht->isEqual)
+    ht->isEqual = &__default_isequal;
+  return 0;
+}
+
+HASHTABDEFF int
+ght_insert (GHashTable *ht, idx_t data_idx)
+{
+  const char *key = __GET_K(ht, data_idx);
+  idx_t key_len = __LEN_K(ht, data_idx);
+  hash_t h = __ght_mix (__HT_HASH (ht, key, key_len));
+
+  if (-1 != __ght_find (ht, &ht->s, h, key, key_len) ||
+      (ht->old.cap && -1 != __ght_find (ht, &ht->old, h, key, key_len)))
+    return HT_DUPLICATED;
+
+  if (ht->old.cap)
+    __ght_migrate (ht, GHT_MIGRATE_STEP);
+  /* Keep the load factor below 7/8 */
+  if (8 * (ht->len + 1) > 7 * ht->s.cap)
+    {
+      if (ht->old.cap)
+        __ght_migrate (ht, ht->old.cap);
+      ht->old = ht->s;
+      ht->mig = 0;
+      if (0 != __ght_alloc (&ht->s, 2 * ht->old.cap))
+        {
+          ht->s = ht->old;
+          ht->old = (struct ght_slots_t){0};
+          return -1;
+        }
+    }
+
+  __ght_put (&ht->s, h, data_idx);
+  ht->len++;
+  return HT_FOUND;
+}
+
+HASHTABDEFF int
+ght_idxof (GHashTable *ht, const char *key, size_t key_len, idx_t *result)
+{
+  hash_t h = __ght_mix (__HT_HASH (ht, key, key_len));
+  long i;
+
+  if (-1 != (i = __ght_find (ht, &ht->s, h, key, key_len)))
+    {
+      *result = ht->s.slot[i].idx;
+      return HT_FOUND;
+    }
+  if (ht->old.cap && -1 != (i = __ght_find (ht, &ht->old, h, key, key_len)))
+    {
+      *result = ht->old.slot[i].idx;
+      return HT_FOUND;
+    }
+  return HT_NOT_FOUND;
+}
+
+HASHTABDEFF int
+ght_delete (GHashTable *ht, const char *key, size_t key_len, idx_t *result)
+{
+  hash_t h = __ght_mix (__HT_HASH (ht, key, key_len));
+  long i;
+
+  if (-1 != (i = __ght_find (ht, &ht->s, h, key, key_len)))
+    {
+      if (result)
+        *result = ht->s.slot[i].idx;
+      __ght_erase (&ht->s, i);
+    }
+  else if (ht->old.cap &&
+           -1 != (i = __ght_find (ht, &ht->old, h, key, key_len)))
+    {
+      if (result)
+        *result = ht->old.slot[i].idx;
+      __ght_set_ctrl (&ht->old, i, GHT_MOVED);
+    }
+  else
+    return HT_NOT_FOUND;
+
+  ht->len--;
+  return HT_FOUND;
+}
+
+HASHTABDEFF void
+ght_free (GHashTable *ht)
+{
+  if (ht->s.slot)
+    free (ht->s.slot);
+  if (ht->old.slot)
+    free (ht->old.slot);
+  ht->s = ht->old = (struct ght_slots_t){0};
+  ht->len = 0;
+}
+
 #endif /* HASHTAB_IMPLEMENTATION */
 
 
@@ -357,6 +914,7 @@ ht_idxof (HashTable *ht, char *key, size_t key_len, idx_t *result)
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <pthread.h>
 
 hash_t
 simple_hash (const char *data, idx_t len)
@@ -370,6 +928,35 @@ simple_hash (const char *data, idx_t len)
   return 0;
 }
 
+/* thread-safe mode test, each thread inserts all the keys */
+#define MT_TEST_N 20000
+#define MT_TEST_THREADS 4
+struct mt_test_t {
+  HashTable *ht;
+  struct keytab_t *keys;
+  int id, inserted, found;
+};
+
+static void *
+mt_test_worker (void *arg)
+{
+  struct mt_test_t *w = arg;
+  idx_t res;
+  for (int k = 0; k < MT_TEST_N; ++k)
+    {
+      /* each thread starts from a different key */
+      idx_t idx = (k + w->id * (MT_TEST_N / MT_TEST_THREADS)) % MT_TEST_N;
+      int ret = ht_insert_mt (w->ht, idx);
+      assert (HT_FOUND == ret || HT_DUPLICATED == ret);
+      w->inserted += (HT_FOUND == ret);
+      /* it must be visible, by whichever thread inserted it */
+      ret = ht_idxof_mt (w->ht, w->keys[idx].key, w->keys[idx].len, &res);
+      assert (HT_FOUND == ret && idx == res);
+      w->found++;
+    }
+  return NULL;
+}
+
 #define DO_ASSERT(msg, asserts) do {            \
     printf ("%s", msg);                         \
     asserts;                                    \
@@ -380,6 +967,27 @@ simple_hash (const char *data, idx_t len)
 int
 main (void)
 {
+  /* hash functions */
+  {
+    char buf[64] = "__the quick brown fox jumps over the lazy dog";
+    DO_ASSERT ("- testing hash functions... ", {
+        /* alignment must not matter */
+        for (idx_t l = 0; l < 40; ++l)
+          {
+            char tmp[64];
+            memcpy (tmp + 1, buf + 2, l);
+            assert (hash_wy (buf + 2, l) == hash_wy (tmp + 1, l));
+          }
+        assert (hash_wy (buf, 2) != hash_wy (buf, 3));
+        assert (hash_wy ("abcd", 4) != hash_wy ("abce", 4));
+#ifdef __SSE4_2__
+        assert (0xE3069283 == hash_crc32c ("123456789", 9));
+#endif
+      });
+  }
+
+  /* these tests depend on simple_hash */
+#ifndef HT_HASHER
   struct keytab_t data[] = {
     KEYS ("Hello"), KEYS ("hello"), KEYS ("World"),
     KEYS ("world"), KEYS ("test"),  KEYS ("Hi"),
@@ -442,6 +1050,124 @@ main (void)
   }
   
   ht_free (&t, free (mem));
+#endif /* HT_HASHER */
+
+  /* growable hash table */
+  {
+#define GHT_TEST_N 5000
+    static char buf[GHT_TEST_N][8];
+    static struct keytab_t keys[GHT_TEST_N];
+    idx_t i;
+    for (int k = 0; k < GHT_TEST_N; ++k)
+      {
+        int n = snprintf (buf[k], sizeof (buf[k]), "k%d", k);
+        keys[k] = NEW_KEY (buf[k], n);
+      }
+
+    GHashTable g = new_ghashtab (1, keys);
+    ht_set_funs (&g, NULL, NULL);
+    assert (0 == ght_init (&g));
+    assert (GHT_GROUP == g.s.cap);
+
+    DO_ASSERT ("- testing growable insertion... ", {
+        for (idx_t k = 0; k < GHT_TEST_N; ++k)
+          {
+            assert (HT_FOUND == ght_insert (&g, k));
+            /* while growing, old keys are in both slots */
+            assert (HT_FOUND == ght_idxofs (&g, "k0", &i) && 0 == i);
+          }
+        assert (GHT_TEST_N == ght_lenof (&g));
+        assert (g.s.cap >= GHT_TEST_N);
+      });
+
+    DO_ASSERT ("- testing growable duplicate key insertion... ", {
+        for (idx_t k = 0; k < GHT_TEST_N; k += 7)
+          assert (HT_DUPLICATED == ght_insert (&g, k));
+        assert (GHT_TEST_N == ght_lenof (&g));
+      });
+
+    DO_ASSERT ("- testing deletion... ", {
+        for (idx_t k = 0; k < GHT_TEST_N; k += 2)
+          {
+            assert (HT_FOUND == ght_delete (&g, keys[k].key,
+                                            keys[k].len, &i));
+            assert (k == i);
+          }
+        assert (HT_NOT_FOUND == ght_delete (&g, "k0", 2, NULL));
+        for (idx_t k = 0; k < GHT_TEST_N; ++k)
+          {
+            int ret = ght_idxof (&g, keys[k].key, keys[k].len, &i);
+            assert ((k % 2) ? (HT_FOUND == ret && k == i)
+                            : (HT_NOT_FOUND == ret));
+          }
+        assert (GHT_TEST_N / 2 == ght_lenof (&g));
+      });
+    ght_free (&g);
+
+#ifndef HT_HASHER
+    DO_ASSERT ("- testing deletion with collisions... ", {
+        /* simple_hash maps most of these keys to the same slot */
+        g = new_ghashtab (1, keys);
+        ht_set_funs (&g, simple_hash, NULL);
+        assert (0 == ght_init (&g));
+        for (idx_t k = 0; k < 64; ++k)
+          assert (HT_FOUND == ght_insert (&g, k));
+        for (idx_t k = 0; k < 64; k += 3)
+          assert (HT_FOUND == ght_delete (&g, keys[k].key,
+                                          keys[k].len, NULL));
+        for (idx_t k = 0; k < 64; ++k)
+          {
+            int ret = ght_idxof (&g, keys[k].key, keys[k].len, &i);
+            assert ((k % 3) ? (HT_FOUND == ret && k == i)
+                            : (HT_NOT_FOUND == ret));
+          }
+        for (idx_t k = 0; k < 64; k += 3)
+          assert (HT_FOUND == ght_insert (&g, k));
+        for (idx_t k = 0; k < 64; ++k)
+          assert (HT_FOUND == ght_idxof (&g, keys[k].key, keys[k].len, &i));
+        ght_free (&g);
+      });
+#endif /* HT_HASHER */
+  }
+
+  /* thread-safe mode */
+  {
+    static char buf[MT_TEST_N][8];
+    static struct keytab_t keys[MT_TEST_N];
+    struct mt_test_t w[MT_TEST_THREADS];
+    pthread_t th[MT_TEST_THREADS];
+    for (int k = 0; k < MT_TEST_N; ++k)
+      {
+        int n = snprintf (buf[k], sizeof (buf[k]), "m%d", k);
+        keys[k] = NEW_KEY (buf[k], n);
+      }
+
+    HashTable mt = new_hashtab (2 * MT_TEST_N, keys, 16);
+    ht_set_funs (&mt, NULL, NULL);
+    idx_t *mt_mem = malloc (ht_sizeof (&mt));
+    assert (0 == ht_init (&mt, mt_mem));
+
+    DO_ASSERT ("- testing concurrent insertion... ", {
+        int inserted = 0;
+        for (int i = 0; i < MT_TEST_THREADS; ++i)
+          {
+            memset (&w[i], 0, sizeof (w[i]));
+            w[i].ht = &mt;
+            w[i].keys = keys;
+            w[i].id = i;
+            pthread_create (&th[i], NULL, mt_test_worker, &w[i]);
+          }
+        for (int i = 0; i < MT_TEST_THREADS; ++i)
+          {
+            pthread_join (th[i], NULL);
+            inserted += w[i].inserted;
+            assert (MT_TEST_N == w[i].found);
+          }
+        /* every key was inserted exactly once */
+        assert (MT_TEST_N == inserted);
+      });
+    ht_free (&mt, free (mt_mem));
+  }
   return 0;
 }
 
@@ -596,3 +1322,102 @@ main (void)
 }
 
 #endif /* HASHTAB_EXAMPLE */
+
+/* the benchmark program */
+#ifdef HASHTAB_BENCH
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define __HT_STR(x) #x
+#define __HT_XSTR(x) __HT_STR(x)
+
+static double
+bench_now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int
+bench_isequal (const DATA_T *restrict k1, idx_t l1,
+               const DATA_T *restrict k2, idx_t l2)
+{
+  return l1 == l2 && 0 == memcmp (k1, k2, l1);
+}
+
+int
+main (void)
+{
+  struct {
+    const char *name;
+    ht_hasher fun;
+  } hashers[] = {
+#ifdef HT_HASHER
+    {__HT_XSTR (HT_HASHER) " (inlined)", HT_HASHER},
+#else
+    {"FNV-1a", hash_FNV_1a},
+    {"wyhash", hash_wy},
+#  ifdef __SSE4_2__
+    {"crc32c", hash_crc32c},
+#  endif
+#endif
+  };
+  char *buf = NULL;
+  size_t len = 0, cap = 0, n = 0, keys_cap = 0, total = 0;
+  struct keytab_t *keys = NULL;
+
+  /* read keys, one per line */
+  for (size_t r; ; len += r)
+    {
+      if (len == cap)
+        buf = realloc (buf, (cap = cap ? 2 * cap : 1 << 20));
+      if (0 == (r = fread (buf + len, 1, cap - len, stdin)))
+        break;
+    }
+  for (char *p = buf, *end = buf + len, *nl; p < end; p = nl + 1)
+    {
+      if (!(nl = memchr (p, '\n', end - p)))
+        nl = end;
+      if (n == keys_cap)
+        keys = realloc (keys, (keys_cap = keys_cap ? 2 * keys_cap : 4096)
+                        * sizeof (struct keytab_t));
+      keys[n++] = NEW_KEY (p, nl - p);
+      total += nl - p;
+    }
+  if (0 == n)
+    {
+      puts ("provide keys on stdin, one per line");
+      return 1;
+    }
+  printf ("%zu keys, average length %.1f\n", n, (double) total / n);
+  printf ("%-22s %12s %12s %10s\n", "hasher", "hash ns/key",
+          "dedup ns/key", "distinct");
+
+  for (size_t h = 0; h < sizeof (hashers) / sizeof (hashers[0]); ++h)
+    {
+      GHashTable g = new_ghashtab (16, keys);
+      ht_set_funs (&g, hashers[h].fun, bench_isequal);
+      if (0 != ght_init (&g))
+        return 1;
+
+      volatile hash_t sink = 0;
+      double t0 = bench_now ();
+      for (size_t i = 0; i < n; ++i)
+        sink ^= __HT_HASH (&g, keys[i].key, keys[i].len);
+      double t1 = bench_now ();
+      for (size_t i = 0; i < n; ++i)
+        ght_insert (&g, i);
+      double t2 = bench_now ();
+
+      printf ("%-22s %12.2f %12.2f %10u\n", hashers[h].name,
+              (t1 - t0) * 1e9 / n, (t2 - t1) * 1e9 / n, ght_lenof (&g));
+      ght_free (&g);
+    }
+  free (keys);
+  free (buf);
+  return 0;
+}
+
+#endif /* HASHTAB_BENCH */
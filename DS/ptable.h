@@ -33,6 +33,17 @@
     memory protection and get full table size
     In other platforms, there is no memory protection,
     and double free can happen with undefined behavior
+
+    Bitmap mode:
+      when the table has a bitmap (see pt_bm_alloc), free slots are
+      tracked in a 3-level occupancy bitmap instead of the in-slot
+      free list; finding the first free and the last occupied slot
+      is then O(1) (a few ctz/clz), no matter how fragmented the
+      table is, and pt_append always fills the lowest free slot
+      the bitmap also is user allocated, and it's realloc safe:
+        pt.cap = new_cap;
+        pt_realloc (&pt, realloc (mem, cap));
+        pt_bm_realloc (&pt, realloc (mem, cap));
   
     Compilation:
       to compile the CLI program:
@@ -77,6 +88,7 @@
 #include <string.h>
 #include <sys/types.h>
 #include <assert.h>
+#include <stdint.h>
 
 #ifndef PTDEFF
 #  define PTDEFF static inline
@@ -148,6 +160,9 @@ struct ptable_t {
   /* internal fields */
   idx_t __freeidx; /* first free to write index */
   idx_t __lastocc; /* last occupied index */
+  /* optional occupancy bitmap, see pt_bm_alloc */
+  uint64_t *__bm;
+  idx_t __bmcap; /* capacity that __bm is laid out for */
 };
 typedef struct ptable_t PTable;
 #define pt_last_idx(pt) ((pt)->__lastocc) /* last occupied index */
@@ -158,9 +173,25 @@ typedef struct ptable_t PTable;
 #define pt_sizeof(pt) ptmem_sizeof ((pt)->cap)
 #define new_ptable(c) (PTable){.cap = c,                \
       .__freeidx = 0, .__lastocc = 0,                   \
-      .mem = NULL                                       \
+      .mem = NULL, .__bm = NULL, .__bmcap = 0           \
       }
 
+/**
+ *  bitmap layout, in 64-bit words:
+ *    [occ: W0]  bit i is set when slot i is occupied
+ *    [sum_occ: W1] [sum_free: W1]  bit j is set when occ[j]
+ *                                  is not zero / not full
+ *    [top_occ: W2] [top_free: W2]  bit k is set when the
+ *                                  sum word k is not zero
+ */
+#define __PTBM_W(n) (((n) + 63) / 64)
+#define __PTBM_W0(cap) __PTBM_W (cap)
+#define __PTBM_W1(cap) __PTBM_W (__PTBM_W0 (cap))
+#define __PTBM_W2(cap) __PTBM_W (__PTBM_W1 (cap))
+/* sizeof bitmap of capacity @cap (in bytes) */
+#define ptbm_sizeof(cap) ((__PTBM_W0 (cap) + 2 * __PTBM_W1 (cap)      \
+                           + 2 * __PTBM_W2 (cap)) * sizeof (uint64_t))
+
 /**
  *  alloc, realloc, free macros
  *  within @funcall of these macros, you have access
@@ -191,12 +222,36 @@ typedef struct ptable_t PTable;
     (ptable)->mem = NULL;                       \
   } while (0)
 
+/**
+ *  bitmap alloc and realloc macros, like pt_alloc and pt_realloc
+ *  they must be used after allocating the table itself
+ *    pt_bm_alloc (&pt, malloc (cap));
+ *    pt_bm_free (&pt, free (mem));
+ */
+#define pt_bm_alloc(ptable, funcall) do {               \
+    idx_t cap = ptbm_sizeof ((ptable)->cap);            \
+    (ptable)->__bm = funcall;                           \
+    if ((ptable)->__bm) {__pt_bm_init (ptable);}        \
+  } while (0)
+#define pt_bm_realloc(ptable, funcall) do {             \
+    idx_t cap = ptbm_sizeof ((ptable)->cap);            \
+    void *mem = (ptable)->__bm;                         \
+    if (mem) {(ptable)->__bm = funcall;}                \
+    if ((ptable)->__bm) {__pt_bm_grow (ptable);}        \
+  } while (0)
+#define pt_bm_free(ptable, funcall) do {                \
+    idx_t cap = ptbm_sizeof ((ptable)->cap);            \
+    void *mem = (ptable)->__bm;                         \
+    if (mem && cap > 0) {funcall;}                      \
+    (ptable)->__bm = NULL;                              \
+  } while (0)
+
 #define pt_addrof(ptable, index) ((ptable)->mem + index)
 #define pt_GET(pt, idx, T) ((T *)pt_addrof (pt, idx))
 
 /**
  *  find the previous freed index, starting from @idx
- *  not necessarily < @idx
+ *  not necessarily < @idx (in bitmap mode, always the next one)
  *  @return: on success    -> previous index
  *           on error/end  -> max value of idx_t (-1)
  */
@@ -204,6 +259,8 @@ PTDEFF idx_t pt_prev_free_idx (PTable *pt, idx_t idx);
 
 /**
  *  append to the table
+ *  in bitmap mode, it does not write anything
+ *  and returns PT_OVERFLOW when the table is full
  *  @return: on success   -> 0
  *           on failure   -> error codes in pt_errornum_t
  */
@@ -216,6 +273,10 @@ PTDEFF int pt_append (PTable *pt, void *value);
  */
 PTDEFF int pt_delete_byidx (PTable *pt, idx_t idx);
 
+/* internal, used by pt_bm_alloc and pt_bm_realloc */
+PTDEFF void __pt_bm_init (PTable *pt);
+PTDEFF void __pt_bm_grow (PTable *pt);
+
 /* @return: error message */
 PTDEFF const char *pt_strerr (int errnum);
 
@@ -237,6 +298,189 @@ PTDEFF void *pt_pop (PTable *pt);
 
 #ifdef PTABLE_IMPLEMENTATION
 
+/* bitmap internals */
+#define __PTBM_BIT(i) ((uint64_t)1 << ((i) & 63))
+#define __ptbm_occ(pt) ((pt)->__bm)
+#define __ptbm_sum_occ(pt) ((pt)->__bm + __PTBM_W0 ((pt)->__bmcap))
+#define __ptbm_sum_free(pt) (__ptbm_sum_occ (pt) + __PTBM_W1 ((pt)->__bmcap))
+#define __ptbm_top_occ(pt) (__ptbm_sum_free (pt) + __PTBM_W1 ((pt)->__bmcap))
+#define __ptbm_top_free(pt) (__ptbm_top_occ (pt) + __PTBM_W2 ((pt)->__bmcap))
+
+/* rebuilds the summary levels from the occ words */
+static inline void
+__pt_bm_sum (PTable *pt)
+{
+  idx_t cap = pt->__bmcap;
+  uint64_t *occ = __ptbm_occ (pt);
+  uint64_t *s_occ = __ptbm_sum_occ (pt), *s_free = __ptbm_sum_free (pt);
+  uint64_t *t_occ = __ptbm_top_occ (pt), *t_free = __ptbm_top_free (pt);
+
+  memset (s_occ, 0, (2 * __PTBM_W1 (cap) + 2 * __PTBM_W2 (cap))
+          * sizeof (uint64_t));
+  for (idx_t w = 0; w < __PTBM_W0 (cap); ++w)
+    {
+      if (occ[w] != 0)
+        s_occ[w / 64] |= __PTBM_BIT (w);
+      if (occ[w] != ~(uint64_t)0)
+        s_free[w / 64] |= __PTBM_BIT (w);
+    }
+  for (idx_t w = 0; w < __PTBM_W1 (cap); ++w)
+    {
+      if (s_occ[w] != 0)
+        t_occ[w / 64] |= __PTBM_BIT (w);
+      if (s_free[w] != 0)
+        t_free[w / 64] |= __PTBM_BIT (w);
+    }
+}
+
+/* the first set bit >= @from in the @n words of @v, or -1 */
+static inline idx_t
+__ptbm_scan (const uint64_t *v, idx_t n, idx_t from)
+{
+  idx_t w = from / 64;
+  uint64_t x;
+
+  if (w >= n)
+    return -1;
+  x = v[w] & (~(uint64_t)0 << (from & 63));
+  while (0 == x)
+    {
+      if (++w >= n)
+        return -1;
+      x = v[w];
+    }
+  return w * 64 + __builtin_ctzll (x);
+}
+
+/**
+ *  the first free slot >= @from
+ *  bits of the last occ word after cap are always free,
+ *  so it returns >= cap when there is no free slot
+ */
+static inline idx_t
+__pt_bm_next_free (PTable *pt, idx_t from)
+{
+  idx_t cap = pt->__bmcap;
+  uint64_t *occ = __ptbm_occ (pt), *s_free = __ptbm_sum_free (pt);
+  idx_t w = from / 64, k;
+  uint64_t x;
+
+  if (w >= __PTBM_W0 (cap))
+    return cap;
+  /* in the word of @from */
+  if ((x = ~occ[w] & (~(uint64_t)0 << (from & 63))))
+    return w * 64 + __builtin_ctzll (x);
+  /* in the next words of the same summary word */
+  if (++w >= __PTBM_W0 (cap))
+    return cap;
+  if ((x = s_free[w / 64] & (~(uint64_t)0 << (w & 63))))
+    w = (w / 64) * 64 + __builtin_ctzll (x);
+  else
+    {
+      /* through the top level */
+      k = __ptbm_scan (__ptbm_top_free (pt), __PTBM_W2 (cap), w / 64 + 1);
+      if (k == (idx_t)-1)
+        return cap;
+      w = k * 64 + __builtin_ctzll (s_free[k]);
+    }
+  return w * 64 + __builtin_ctzll (~occ[w]);
+}
+
+/* the last occupied slot, or -1 when the table is empty */
+static inline idx_t
+__pt_bm_last_occ (PTable *pt)
+{
+  idx_t cap = pt->__bmcap;
+  uint64_t *t_occ = __ptbm_top_occ (pt);
+  idx_t k = __PTBM_W2 (cap);
+
+  while (0 == t_occ[--k])
+    if (0 == k)
+      return -1;
+  k = k * 64 + 63 - __builtin_clzll (t_occ[k]);
+  k = k * 64 + 63 - __builtin_clzll (__ptbm_sum_occ (pt)[k]);
+  return k * 64 + 63 - __builtin_clzll (__ptbm_occ (pt)[k]);
+}
+
+static inline void
+__pt_bm_set (PTable *pt, idx_t i)
+{
+  uint64_t *occ = __ptbm_occ (pt);
+  idx_t w = i / 64;
+
+  occ[w] |= __PTBM_BIT (i);
+  __ptbm_sum_occ (pt)[w / 64] |= __PTBM_BIT (w);
+  __ptbm_top_occ (pt)[w / 4096] |= __PTBM_BIT (w / 64);
+  if (occ[w] == ~(uint64_t)0)
+    {
+      uint64_t *s_free = __ptbm_sum_free (pt);
+      s_free[w / 64] &= ~__PTBM_BIT (w);
+      if (0 == s_free[w / 64])
+        __ptbm_top_free (pt)[w / 4096] &= ~__PTBM_BIT (w / 64);
+    }
+}
+
+static inline void
+__pt_bm_clear (PTable *pt, idx_t i)
+{
+  uint64_t *occ = __ptbm_occ (pt);
+  idx_t w = i / 64;
+
+  occ[w] &= ~__PTBM_BIT (i);
+  __ptbm_sum_free (pt)[w / 64] |= __PTBM_BIT (w);
+  __ptbm_top_free (pt)[w / 4096] |= __PTBM_BIT (w / 64);
+  if (0 == occ[w])
+    {
+      uint64_t *s_occ = __ptbm_sum_occ (pt);
+      s_occ[w / 64] &= ~__PTBM_BIT (w);
+      if (0 == s_occ[w / 64])
+        __ptbm_top_occ (pt)[w / 4096] &= ~__PTBM_BIT (w / 64);
+    }
+}
+
+/* updates __freeidx and __lastocc from the bitmap */
+static inline void
+__pt_bm_sync (PTable *pt)
+{
+  idx_t last = __pt_bm_last_occ (pt);
+  pt->__lastocc = (last == (idx_t)-1) ? 0 : last;
+  pt->__freeidx = __pt_bm_next_free (pt, 0);
+}
+
+PTDEFF void
+__pt_bm_init (PTable *pt)
+{
+  uint64_t *bm = pt->__bm;
+
+  pt->__bmcap = pt->cap;
+  memset (bm, 0, ptbm_sizeof (pt->cap));
+  /* slots that are already in use, walking the in-slot free list */
+  pt->__bm = NULL;
+  if (pt->__lastocc > 0 || pt->__freeidx > 0)
+    for (idx_t i = 0; i <= pt->__lastocc && i < pt->cap; ++i)
+      bm[i / 64] |= __PTBM_BIT (i);
+  for (idx_t i = pt_ffree_idx (pt);
+       i != (idx_t)-1 && i < pt->__lastocc;
+       i = pt_prev_free_idx (pt, i))
+    bm[i / 64] &= ~__PTBM_BIT (i);
+  pt->__bm = bm;
+  __pt_bm_sum (pt);
+  __pt_bm_sync (pt);
+}
+
+PTDEFF void
+__pt_bm_grow (PTable *pt)
+{
+  idx_t old = __PTBM_W0 (pt->__bmcap);
+  /* the occ words are at the beginning, only summaries move */
+  pt->__bmcap = pt->cap;
+  if (__PTBM_W0 (pt->cap) > old)
+    memset (pt->__bm + old, 0, (__PTBM_W0 (pt->cap) - old)
+            * sizeof (uint64_t));
+  __pt_bm_sum (pt);
+  __pt_bm_sync (pt);
+}
+
 PTDEFF const char *
 pt_strerr (int errnum)
 {
@@ -282,6 +526,20 @@ pt_append (PTable *pt, void *value)
     return PT_NULLPTR;
   assert (pt->__lastocc <= pt->cap && pt->__freeidx <= pt->cap);
 
+  if (pt->__bm)
+    {
+      /* bitmap mode, __freeidx is the lowest free slot */
+      idx_t idx = pt->__freeidx;
+      if (idx >= pt->cap)
+        return PT_OVERFLOW;
+      pt->mem[idx] = value;
+      __pt_bm_set (pt, idx);
+      if (idx > pt->__lastocc)
+        pt->__lastocc = idx;
+      pt->__freeidx = __pt_bm_next_free (pt, idx + 1);
+      return 0;
+    }
+
   if (pt->__freeidx >= pt->__lastocc)
     {
       if (pt->__lastocc > 0 && pt->__lastocc > pt->__freeidx)
@@ -338,6 +596,21 @@ pt_delete_byidx (PTable *pt, idx_t idx)
   if (idx > pt->__lastocc)
     return PT_IDX_OUTOF_BOUND;
 
+  if (pt->__bm)
+    {
+      if (!(__ptbm_occ (pt)[idx / 64] & __PTBM_BIT (idx)))
+        return PT_ALREADY_FREED;
+      __pt_bm_clear (pt, idx);
+      if (idx < pt->__freeidx)
+        pt->__freeidx = idx;
+      if (idx == pt->__lastocc)
+        {
+          idx_t last = __pt_bm_last_occ (pt);
+          pt->__lastocc = (last == (idx_t)-1) ? 0 : last;
+        }
+      return 0;
+    }
+
 #ifdef HAVE_DFREE_PROTECTION
   /**
    *  we cannot detect doable free or memory corruption here
@@ -372,6 +645,12 @@ pt_prev_free_idx (PTable *pt, idx_t idx)
     return -1;
   if (pt->__freeidx >= pt->__lastocc)
     return -1;
+  if (pt->__bm)
+    {
+      /* bitmap mode, the next free index after @idx */
+      idx = __pt_bm_next_free (pt, idx + 1);
+      return (idx > pt->__lastocc) ? (idx_t)-1 : idx;
+    }
 
   off_t _offset = (off_t)pt->mem[idx];
 
@@ -704,6 +983,67 @@ run_tests (PTable *pt)
 #endif /* __SIZEOF_POINTER__ >= 4 */
 }
 
+/* random churn on a bitmap table, checked against a flat array */
+void
+run_bm_tests (void)
+{
+  /* more than 64^3 slots, to have more than one top word */
+  const idx_t N = 300000;
+  PTable pt = new_ptable (1000);
+  char *used = calloc (N, 1);
+  int fail = 0;
+
+  puts (" * test 3  --  bitmap mode");
+  pt_alloc (&pt, malloc (cap));
+  pt_bm_alloc (&pt, malloc (cap));
+  srand (42);
+  for (int round = 0; round < 1000000 && !fail; ++round)
+    {
+      if (rand () % 4)
+        {
+          idx_t idx = pt_ffree_idx (&pt);
+          if (PT_OVERFLOW == pt_append (&pt, (void *)(ptr_t)(idx + 1)))
+            {
+              fail |= idx != pt.cap;
+              if (pt.cap == N)
+                continue;
+              /* grow the table and the bitmap in place */
+              pt.cap = (pt.cap * 2 < N) ? pt.cap * 2 : N;
+              pt_realloc (&pt, realloc (mem, cap));
+              pt_bm_realloc (&pt, realloc (mem, cap));
+              continue;
+            }
+          fail |= used[idx];
+          used[idx] = 1;
+        }
+      else
+        {
+          idx_t idx = rand () % (pt_last_idx (&pt) + 1);
+          int ret = pt_delete_byidx (&pt, idx);
+          fail |= used[idx] ? (0 != ret) : (PT_ALREADY_FREED != ret);
+          used[idx] = 0;
+        }
+      if (0 == round % 4096 || fail)
+        {
+          idx_t ffree = 0, last = 0;
+          while (ffree < pt.cap && used[ffree])
+            ffree++;
+          for (idx_t i = 0; i < pt.cap; ++i)
+            if (used[i])
+              last = i;
+          fail |= ffree != pt_ffree_idx (&pt) || last != pt_last_idx (&pt);
+        }
+    }
+  if (fail || pt.cap != N)
+    puts ("fail");
+  else
+    puts ("pass\n");
+
+  pt_bm_free (&pt, free (mem));
+  pt_free (&pt, free (mem));
+  free (used);
+}
+
 #endif /* PTABLE_TEST */
 
 
@@ -726,6 +1066,7 @@ main (void)
 #else
   /* normal test */
   run_tests (&pt);
+  run_bm_tests ();
 #endif
   
   pt_free (&pt, free (mem));
@@ -8,6 +8,24 @@
     remapping the memory is safe
     It's possible to use mapped files as memory, see the test program
   
+    Concurrent rings:
+      `RBufferSPSC` (single producer and consumer) and
+      `RBufferMPMC` (many producers and consumers) are byte queues
+      for handing data from a thread to another; unlike RBuffer
+      they never overwrite unread data
+      capacity of them must be a power of 2, and all functions
+      are non-blocking (returning 0 when full or empty)
+
+    Mirrored memory:
+      `rb_mirror_new` maps the same pages twice back-to-back, so
+      mem[i] and mem[i + cap] are the same byte, and any region of
+      the ring (of at most cap bytes) is contiguous in memory
+      then rb_fdwrite and rb_fdread can pass the ring memory
+      directly to read(2) and write(2) without splitting at the
+      wrap point, and `rb_view` is a plain pointer to the content
+      capacity of mirrored rings is rounded up to the page size
+      define `RB_NO_FDIO` to disable them
+
     time and memory complexity:
       readc, writec, reset:
         time O(1), mem O(1)
@@ -20,7 +38,7 @@
         cc -x c -ggdb -Wall -Wextra -Werror \
           -D RB_IMPLEMENTATION \
           -D RB_TEST \
-          -o test.out ring_buffer.h
+          -o test.out ring_buffer.h -lpthread
   
       to compile the example program:
         cc -x c -ggdb -Wall -Wextra -Werror \
@@ -34,12 +52,21 @@
 #define RIBG_BUFFER__H__
 #include <stdbool.h>
 #include <string.h>
+#include <sched.h>
 
 #ifndef RB_NO_STDIO
 #  define HAVE_FILEIO
 #  include <stdio.h>
 #endif
 
+#ifndef RB_NO_FDIO
+#  define HAVE_FDIO
+#  include <unistd.h>
+#  include <sys/mman.h>
+#  include <sys/uio.h>
+#  include <sys/syscall.h>
+#endif
+
 #ifndef RINGDEF
 #  define RINGDEF static inline
 #endif
@@ -60,15 +87,26 @@ struct ring_buffer {
   size_t cap;
   size_t head, idx;
   bool full;
+  bool mirror; /* mem is mapped twice, see rb_mirror_new */
 };
 typedef struct ring_buffer RBuffer;
 
 #define rb_new(buf, len) (RBuffer) {                            \
       .mem = buf,                                               \
       .cap = len,                                               \
-      .head = 0, .idx = 0, .full = false                        \
+      .head = 0, .idx = 0, .full = false,                       \
+      .mirror = false                                           \
    }
 
+/* number of readable bytes of the ring */
+#define rb_lenof(r) ((r)->full ? (r)->cap : (r)->idx)
+/**
+ *  pointer to the oldest byte of the ring
+ *  only on mirrored rings, all the rb_lenof(r) bytes
+ *  after it are contiguous
+ */
+#define rb_view(r) ((r)->mem + ((r)->full ? (r)->head : 0))
+
 /* reset the ring */
 #define rb_reset(r) do {                        \
     (r)->head = 0;                              \
@@ -104,6 +142,97 @@ RINGDEF void rb_writen (RBuffer *r, const char *src, size_t len);
 RINGDEF void rb_fwrite (RBuffer *r, FILE *f, size_t len);
 #endif
 
+#ifdef HAVE_FDIO
+/**
+ *  makes @r a ring of at least @cap bytes on mirrored memory
+ *  returns 0 on success and -1 on failure (errno is set)
+ *  use rb_mirror_free to release it
+ */
+RINGDEF int rb_mirror_new (RBuffer *r, size_t cap);
+RINGDEF void rb_mirror_free (RBuffer *r);
+
+/**
+ *  like rb_fwrite, but reads at most @len bytes from @fd
+ *  by read(2) directly into the ring memory
+ *  returns number of read bytes, or -1 on error
+ *  a short count means end of file (or EAGAIN on non-blocking @fd)
+ */
+RINGDEF ssize_t rb_fdwrite (RBuffer *r, int fd, size_t len);
+/**
+ *  writes the oldest @n bytes of @r to @fd by write(2)
+ *  directly from the ring memory (one call on mirrored rings)
+ *  returns number of written bytes, or -1 on error
+ */
+RINGDEF ssize_t rb_fdread (RBuffer *r, int fd, size_t n);
+#endif
+
+/**
+ *  Single-producer single-consumer ring
+ *  @head is only written by the consumer and @tail by the producer
+ *  both are free-running counters (never wrapped), each one on its
+ *  own cache line, along with a cached copy of the other one
+ */
+#ifndef RB_CACHELINE
+#  define RB_CACHELINE 64
+#endif
+#define __RB_ALIGNED __attribute__((aligned (RB_CACHELINE)))
+
+struct ring_spsc_t {
+  char *mem;
+  size_t cap; /* must be a power of 2 */
+  size_t tail __RB_ALIGNED; /* producer */
+  size_t head_cache;
+  size_t head __RB_ALIGNED; /* consumer */
+  size_t tail_cache;
+};
+typedef struct ring_spsc_t RBufferSPSC;
+
+/**
+ *  Multi-producer multi-consumer ring
+ *  writers and readers first claim a range by a CAS on the reserve
+ *  counter, then copy, then publish it on the commit counter in
+ *  the order they claimed (like the DPDK rte_ring)
+ */
+struct ring_mpmc_t {
+  char *mem;
+  size_t cap; /* must be a power of 2 */
+  size_t tail_reserve __RB_ALIGNED;
+  size_t tail_commit;
+  size_t head_reserve __RB_ALIGNED;
+  size_t head_commit;
+};
+typedef struct ring_mpmc_t RBufferMPMC;
+
+#define rb_spsc_new(buf, len) (RBufferSPSC) {.mem = buf, .cap = len}
+#define rb_mpmc_new(buf, len) (RBufferMPMC) {.mem = buf, .cap = len}
+
+/**
+ *  writes at most @len bytes of @src to the ring @r
+ *  returns number of written bytes (0 when @r is full)
+ *  only the producer thread may call it
+ */
+RINGDEF size_t rb_spsc_writen (RBufferSPSC *r, const char *src, size_t len);
+/**
+ *  reads at most @n bytes from @r to @dest
+ *  returns number of read bytes (0 when @r is empty)
+ *  only the consumer thread may call it
+ */
+RINGDEF size_t rb_spsc_readn (RBufferSPSC *r, size_t n, char *dest);
+/* number of readable bytes, approximate when the other side is running */
+RINGDEF size_t rb_spsc_lenof (RBufferSPSC *r);
+
+/**
+ *  writes all the @len bytes of @src, or nothing
+ *  so writes of different producers never interleave
+ *  returns @len, or 0 when there is not enough space
+ */
+RINGDEF size_t rb_mpmc_writen (RBufferMPMC *r, const char *src, size_t len);
+/**
+ *  reads at most @n bytes from @r to @dest
+ *  returns number of read bytes (0 when @r is empty)
+ */
+RINGDEF size_t rb_mpmc_readn (RBufferMPMC *r, size_t n, char *dest);
+
 /* function definitions */
 
 /* read one byte from the ring @r */
@@ -119,6 +248,20 @@ RINGDEF void rb_readn (RBuffer *r, size_t n, char dest[n]);
 
 
 #ifdef RB_IMPLEMENTATION
+/* internal, moves @r forward after writing @n <= cap bytes at idx */
+static inline void
+__rb_advance (RBuffer *r, size_t n)
+{
+  if (r->full)
+    r->head = (r->head + n) % r->cap;
+  else if (r->idx + n >= r->cap)
+    {
+      r->full = true;
+      r->head = (r->idx + n) % r->cap;
+    }
+  r->idx = (r->idx + n) % r->cap;
+}
+
 RINGDEF void
 rb_writec (RBuffer *r, char c)
 {
@@ -138,6 +281,13 @@ rb_writen (RBuffer *r, const char *src, size_t len)
 {
   size_t __rest;
 
+  if (r->mirror && len <= r->cap)
+    {
+      /* the whole region after idx is contiguous */
+      memcpy (r->mem + r->idx, src, len);
+      __rb_advance (r, len);
+      return;
+    }
   if (len <= r->cap)
     {
       __rest = MIN (len, r->cap - r->idx);
@@ -189,6 +339,11 @@ rb_readn (RBuffer *r, size_t n, char dest[n])
       memcpy (dest, r->mem, __rest);
       return;
     }
+  if (r->mirror && n <= r->cap)
+    {
+      memcpy (dest, r->mem + r->head, n);
+      return;
+    }
 
   __rest = MIN (n, r->cap - r->idx);
   memcpy (dest, r->mem + r->head, __rest);
@@ -204,6 +359,131 @@ rb_readn (RBuffer *r, size_t n, char dest[n])
     }
 }
 
+#if defined (__x86_64__) || defined (__i386__)
+#  define __RB_RELAX() __builtin_ia32_pause ()
+#else
+#  define __RB_RELAX() (void) 0
+#endif
+
+#ifndef RB_SPINS
+#  define RB_SPINS 1024
+#endif
+
+#define __RB_LOAD(p) __atomic_load_n (p, __ATOMIC_ACQUIRE)
+#define __RB_STORE(p, v) __atomic_store_n (p, v, __ATOMIC_RELEASE)
+
+/**
+ *  internal, waits until the commit counter @p reaches @pos
+ *  spins for RB_SPINS rounds, then yields the CPU, as the thread
+ *  we are waiting for might have been preempted
+ */
+static inline void
+__rb_wait_commit (size_t *p, size_t pos)
+{
+  for (int i = 0; __RB_LOAD (p) != pos; ++i)
+    {
+      if (i < RB_SPINS)
+        __RB_RELAX ();
+      else
+        sched_yield ();
+    }
+}
+
+/* internal, copies @len bytes to/from the ring at the counter @pos */
+static inline void
+__rb_copy_to (char *mem, size_t cap, size_t pos, const char *src, size_t len)
+{
+  size_t off = pos & (cap - 1);
+  size_t __rest = MIN (len, cap - off);
+  memcpy (mem + off, src, __rest);
+  memcpy (mem, src + __rest, len - __rest);
+}
+
+static inline void
+__rb_copy_from (const char *mem, size_t cap, size_t pos, char *dest, size_t len)
+{
+  size_t off = pos & (cap - 1);
+  size_t __rest = MIN (len, cap - off);
+  memcpy (dest, mem + off, __rest);
+  memcpy (dest + __rest, mem, len - __rest);
+}
+
+RINGDEF size_t
+rb_spsc_writen (RBufferSPSC *r, const char *src, size_t len)
+{
+  size_t tail = r->tail; /* only we write it */
+  if (r->cap - (tail - r->head_cache) < len)
+    r->head_cache = __RB_LOAD (&r->head);
+  len = MIN (len, r->cap - (tail - r->head_cache));
+  if (0 == len)
+    return 0;
+  __rb_copy_to (r->mem, r->cap, tail, src, len);
+  __RB_STORE (&r->tail, tail + len);
+  return len;
+}
+
+RINGDEF size_t
+rb_spsc_readn (RBufferSPSC *r, size_t n, char *dest)
+{
+  size_t head = r->head; /* only we write it */
+  if (r->tail_cache - head < n)
+    r->tail_cache = __RB_LOAD (&r->tail);
+  n = MIN (n, r->tail_cache - head);
+  if (0 == n)
+    return 0;
+  __rb_copy_from (r->mem, r->cap, head, dest, n);
+  __RB_STORE (&r->head, head + n);
+  return n;
+}
+
+RINGDEF size_t
+rb_spsc_lenof (RBufferSPSC *r)
+{
+  return __RB_LOAD (&r->tail) - __RB_LOAD (&r->head);
+}
+
+RINGDEF size_t
+rb_mpmc_writen (RBufferMPMC *r, const char *src, size_t len)
+{
+  size_t tail = __RB_LOAD (&r->tail_reserve);
+  do
+    {
+      if (r->cap - (tail - __RB_LOAD (&r->head_commit)) < len)
+        return 0;
+    }
+  while (!__atomic_compare_exchange_n (&r->tail_reserve, &tail, tail + len,
+                                       1, __ATOMIC_ACQ_REL,
+                                       __ATOMIC_ACQUIRE));
+  if (0 == len)
+    return 0;
+  __rb_copy_to (r->mem, r->cap, tail, src, len);
+  /* wait for the previous writers */
+  __rb_wait_commit (&r->tail_commit, tail);
+  __RB_STORE (&r->tail_commit, tail + len);
+  return len;
+}
+
+RINGDEF size_t
+rb_mpmc_readn (RBufferMPMC *r, size_t n, char *dest)
+{
+  size_t len, tail, head = __RB_LOAD (&r->head_reserve);
+  do
+    {
+      tail = __RB_LOAD (&r->tail_commit);
+      len = MIN (n, tail - head);
+      if (0 == len)
+        return 0;
+    }
+  while (!__atomic_compare_exchange_n (&r->head_reserve, &head, head + len,
+                                       1, __ATOMIC_ACQ_REL,
+                                       __ATOMIC_ACQUIRE));
+  __rb_copy_from (r->mem, r->cap, head, dest, len);
+  /* wait for the previous readers */
+  __rb_wait_commit (&r->head_commit, head);
+  __RB_STORE (&r->head_commit, head + len);
+  return len;
+}
+
 #ifdef HAVE_FILEIO
 RINGDEF void
 rb_fwrite (RBuffer *r, FILE *f, size_t len)
@@ -258,6 +538,100 @@ rb_fwrite (RBuffer *r, FILE *f, size_t len)
 }
 #endif /* HAVE_FILEIO */
 
+#ifdef HAVE_FDIO
+RINGDEF int
+rb_mirror_new (RBuffer *r, size_t cap)
+{
+  long pg = sysconf (_SC_PAGESIZE);
+  char *mem;
+  int fd;
+
+  cap = (cap + pg - 1) / pg * pg;
+  if (0 == cap)
+    cap = pg;
+  if (0 > (fd = syscall (SYS_memfd_create, "ring_buffer", 0)))
+    return -1;
+  if (0 != ftruncate (fd, cap))
+    goto fail;
+  /* reserve 2*cap of address space, then map the file on both halves */
+  mem = mmap (NULL, 2 * cap, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (MAP_FAILED == mem)
+    goto fail;
+  if (MAP_FAILED == mmap (mem, cap, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_FIXED, fd, 0)
+      || MAP_FAILED == mmap (mem + cap, cap, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_FIXED, fd, 0))
+    {
+      munmap (mem, 2 * cap);
+      goto fail;
+    }
+  close (fd);
+
+  *r = rb_new (mem, cap);
+  r->mirror = true;
+  return 0;
+
+ fail:
+  close (fd);
+  return -1;
+}
+
+RINGDEF void
+rb_mirror_free (RBuffer *r)
+{
+  if (r->mirror && NULL != r->mem)
+    munmap (r->mem, 2 * r->cap);
+  r->mem = NULL;
+}
+
+RINGDEF ssize_t
+rb_fdwrite (RBuffer *r, int fd, size_t len)
+{
+  size_t total = 0;
+  while (total < len)
+    {
+      size_t __rest = r->mirror ? r->cap : r->cap - r->idx;
+      ssize_t n = read (fd, r->mem + r->idx, MIN (__rest, len - total));
+      if (n < 0)
+        return (0 == total) ? -1 : (ssize_t) total;
+      if (0 == n)
+        break;
+      __rb_advance (r, n);
+      total += n;
+    }
+  return total;
+}
+
+RINGDEF ssize_t
+rb_fdread (RBuffer *r, int fd, size_t n)
+{
+  size_t off = r->full ? r->head : 0;
+  size_t total = 0;
+  ssize_t w;
+
+  n = MIN (n, rb_lenof (r));
+  while (total < n)
+    {
+      size_t pos = (off + total) % r->cap;
+      if (r->mirror || pos + (n - total) <= r->cap)
+        w = write (fd, r->mem + pos, n - total);
+      else
+        {
+          /* the region wraps, write both parts at once */
+          struct iovec iov[2] = {
+            {.iov_base = r->mem + pos, .iov_len = r->cap - pos},
+            {.iov_base = r->mem, .iov_len = n - total - (r->cap - pos)},
+          };
+          w = writev (fd, iov, 2);
+        }
+      if (w <= 0)
+        return (0 == total) ? -1 : (ssize_t) total;
+      total += w;
+    }
+  return total;
+}
+#endif /* HAVE_FDIO */
+
 #endif /* RB_IMPLEMENTATION */
 
 
@@ -467,6 +841,162 @@ TEST_3 (RBuffer *r)
   RETPASS ();
 }
 
+#include <pthread.h>
+#include <stdint.h>
+
+#define TEST_BYTES (1024 * 1024)
+#define TEST_THREADS 4
+#define TEST_RECORDS 20000
+
+static void *
+spsc_producer (void *arg)
+{
+  RBufferSPSC *r = arg;
+  char buf[97];
+  size_t sent = 0;
+  while (sent < TEST_BYTES)
+    {
+      size_t n = MIN (sizeof (buf), TEST_BYTES - sent);
+      for (size_t i = 0; i < n; ++i)
+        buf[i] = (char)((sent + i) % 251);
+      for (size_t w = 0, k; w < n; w += k)
+        if (0 == (k = rb_spsc_writen (r, buf + w, n - w)))
+          sched_yield ();
+      sent += n;
+    }
+  return NULL;
+}
+
+int
+TEST_SPSC (void)
+{
+  static char mem[4096];
+  RBufferSPSC r = rb_spsc_new (mem, sizeof (mem));
+  pthread_t th;
+  char buf[333];
+  size_t got = 0, bad = 0;
+
+  pthread_create (&th, NULL, spsc_producer, &r);
+  while (got < TEST_BYTES)
+    {
+      size_t n = rb_spsc_readn (&r, sizeof (buf), buf);
+      if (0 == n)
+        sched_yield ();
+      for (size_t i = 0; i < n; ++i)
+        bad += buf[i] != (char)((got + i) % 251);
+      got += n;
+    }
+  pthread_join (th, NULL);
+  rbassert (0 == bad, "SPSC data", true);
+  rbassert (0 == rb_spsc_lenof (&r), "SPSC empty", true);
+  RETPASS ();
+}
+
+struct mpmc_arg {
+  RBufferMPMC *r;
+  uint32_t id;
+  uint64_t sum; /* of the received sequences */
+  size_t *count; /* shared between consumers */
+};
+
+static void *
+mpmc_producer (void *arg)
+{
+  struct mpmc_arg *a = arg;
+  for (uint32_t seq = 0; seq < TEST_RECORDS; ++seq)
+    {
+      uint32_t rec[2] = {a->id, seq};
+      while (0 == rb_mpmc_writen (a->r, (char *) rec, sizeof (rec)))
+        sched_yield ();
+    }
+  return NULL;
+}
+
+static void *
+mpmc_consumer (void *arg)
+{
+  struct mpmc_arg *a = arg;
+  uint32_t recs[2 * 16];
+  while (__RB_LOAD (a->count) < TEST_THREADS * TEST_RECORDS)
+    {
+      size_t n = rb_mpmc_readn (a->r, sizeof (recs), (char *) recs) / 8;
+      if (0 == n)
+        sched_yield ();
+      for (size_t i = 0; i < n; ++i)
+        a->sum += recs[2 * i + 1];
+      __atomic_add_fetch (a->count, n, __ATOMIC_RELEASE);
+    }
+  return NULL;
+}
+
+int
+TEST_MPMC (void)
+{
+  static char mem[1024];
+  RBufferMPMC r = rb_mpmc_new (mem, sizeof (mem));
+  pthread_t th[2 * TEST_THREADS];
+  struct mpmc_arg args[2 * TEST_THREADS];
+  uint64_t sum = 0;
+  size_t count = 0;
+
+  rbassert (0 == rb_mpmc_writen (&r, mem, 2048), "MPMC too long", true);
+  for (int i = 0; i < 2 * TEST_THREADS; ++i)
+    {
+      args[i] = (struct mpmc_arg){.r = &r, .id = i, .count = &count};
+      pthread_create (&th[i], NULL,
+                      (i < TEST_THREADS) ? mpmc_producer : mpmc_consumer,
+                      &args[i]);
+    }
+  for (int i = 0; i < 2 * TEST_THREADS; ++i)
+    pthread_join (th[i], NULL);
+  for (int i = TEST_THREADS; i < 2 * TEST_THREADS; ++i)
+    sum += args[i].sum;
+  /* each producer writes sequences 0..N-1 */
+  rbassert (sum == (uint64_t) TEST_THREADS * TEST_RECORDS
+            * (TEST_RECORDS - 1) / 2, "MPMC data", true);
+  rbassert (r.head_commit == r.tail_commit, "MPMC empty", true);
+  RETPASS ();
+}
+
+int
+TEST_MIRROR (void)
+{
+  RBuffer r;
+  int pfd[2];
+  char buf[64];
+
+  rbassert (0 == rb_mirror_new (&r, 100), "rb_mirror_new", true);
+  rbassert (r.cap >= 100 && r.mirror, "mirror capacity", true);
+  r.mem[r.cap + 3] = 'X';
+  rbassert (r.mem[3] == 'X', "mirrored mapping", true);
+
+  /* write across the wrap point and read it back contiguously */
+  r.idx = r.cap - 4;
+  rb_writen (&r, "0123456789", 10);
+  rbassert (r.idx == 6 && r.full, "mirror writen", true);
+  strnassert (r.mem, "456789", 6, "mirror writen wraps", true);
+  strnassert (rb_view (&r) + r.cap - 10, "0123456789", 10,
+              "rb_view is contiguous", true);
+
+  /* fd I/O through a pipe, across the wrap point */
+  rbassert (0 == pipe (pfd), "pipe", true);
+  rb_reset (&r);
+  r.idx = r.cap - 4;
+  write (pfd[1], "abcdefghij", 10);
+  rbassert (10 == rb_fdwrite (&r, pfd[0], 10), "rb_fdwrite", true);
+  strnassert (r.mem, "efghij", 6, "rb_fdwrite wraps", true);
+  rb_reset (&r);
+  rb_writen (&r, "ABCDEF", 6);
+  rbassert (6 == rb_fdread (&r, pfd[1], 100), "rb_fdread", true);
+  rbassert (6 == read (pfd[0], buf, sizeof (buf)), "rb_fdread len", true);
+  strnassert (buf, "ABCDEF", 6, "rb_fdread data", true);
+
+  close (pfd[0]);
+  close (pfd[1]);
+  rb_mirror_free (&r);
+  RETPASS ();
+}
+
 int
 main (void)
 {
@@ -485,6 +1015,9 @@ main (void)
   TESTFUN (TEST_1, &ring);
   TESTFUN (TEST_2, &ring);
   TESTFUN (TEST_3, &ring);
+  TESTFUN (TEST_SPSC);
+  TESTFUN (TEST_MPMC);
+  TESTFUN (TEST_MIRROR);
   
   rbassert (0 == munmap (ring.mem, ring.cap),
              "munmap failed, broken ring logic!", true);
@@ -9,12 +9,25 @@
     Reallocating that memory is possible but it most likely makes
     all your pointers invalid, instead you may allocate a large amount
     of memory, and let your operation system handle it
+
+    Index:
+      tape_get walks the tape, entry by entry; to make it faster,
+      give the tape a sparse index by `tape_index`, which keeps
+      offset of every TAPE_IDX_STEP'th entry, then tape_get walks
+      at most TAPE_IDX_STEP-1 entries
+      the index memory is also up to users, see tape_idx_sizeof
+
+    File-backed tapes:
+      with TAPE_MEM_MMAP defined, `tape_map` maps a file as
+      the tape, including its index, so the tape can be
+      reopened later without reading or parsing anything
+      file layout:  [header][index][data]
   
     Compilation:
       to compile the test program:
         cc -x c -ggdb -Wall -Wextra -Werror \
            -D TAPE_MEM_IMPLEMENTATION  \
-           -D TAPE_MEM_TEST \
+           -D TAPE_MEM_TEST -D TAPE_MEM_MMAP \
            -o test.out tape_mem.h
   
       to include in other files:
@@ -71,14 +84,34 @@ typedef struct buff_t DBuffer; /* data buffer */
 #define bufferof(data_ptr) \
   (DBuffer*)(data_ptr - offsetof (DBuffer, data))
 
+/* the index keeps offset of every TAPE_IDX_STEP'th entry */
+#ifndef TAPE_IDX_STEP
+#  define TAPE_IDX_STEP 16
+#endif
+
+struct tape_file_t; /* header of file-backed tapes */
+
 struct tape_t {
   size_t len, cap;
   char *data; /* array of buff_t structs */
+  size_t count; /* number of entries */
+  /* optional sparse index, see tape_index */
+  size_t *idx;
+  size_t idx_cap; /* number of index slots */
+  /* only for file-backed tapes, see tape_map */
+  struct tape_file_t *__file;
 };
 typedef struct tape_t Tape;
 #define new_tape(capacity)                      \
   (Tape){.len=0, .cap=capacity, .data=NULL,}
 
+/**
+ *  number of index slots that are enough for a tape
+ *  of capacity @cap, in the worst case (1-byte entries)
+ */
+#define tape_idx_sizeof(cap) \
+  ((cap) / (TAPE_IDX_STEP * buffer_of_size (1)) + 1)
+
 #ifndef TAPEMEMDEF
 #  define TAPEMEMDEF static inline
 #endif
@@ -99,10 +132,50 @@ TAPEMEMDEF char *tape_append (Tape *tape, const DBuffer *buf);
  */
 TAPEMEMDEF char *tape_get (const Tape *tape, size_t index);
 
+/**
+ *  attaches the index memory @idx of @n slots to @tape
+ *  and indexes the current entries of it
+ *  if @n is less than tape_idx_sizeof, entries after the
+ *  last slot are reached by walking the tape from there
+ *  @n = 0 detaches the index of @tape (@idx is ignored)
+ */
+TAPEMEMDEF void tape_index (Tape *tape, size_t *idx, size_t n);
+
+#ifdef TAPE_MEM_MMAP
+/**
+ *  maps the file @path as @tape, with its index
+ *  when @path does not exist, creates it with capacity @cap
+ *  otherwise @cap is ignored and the file is used as is
+ *  @return:  0 on success, -1 on failure (errno is set)
+ */
+TAPEMEMDEF int tape_map (Tape *tape, const char *path, size_t cap);
+/* flushes @tape to its file */
+TAPEMEMDEF int tape_sync (Tape *tape);
+/* syncs and unmaps @tape */
+TAPEMEMDEF int tape_unmap (Tape *tape);
+#endif /* TAPE_MEM_MMAP */
+
 #endif /* TAPE_MEM__H__ */
 
 
 #ifdef TAPE_MEM_IMPLEMENTATION
+#ifdef TAPE_MEM_MMAP
+#  include <errno.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+
+#define TAPE_MAGIC "TAPEMEM1"
+struct tape_file_t {
+  char magic[8];
+  size_t cap, len, count, idx_cap;
+};
+/* data offset of the file, after the header and the index */
+#define __tape_file_sizeof(cap) \
+  (sizeof (struct tape_file_t) + tape_idx_sizeof (cap) * sizeof (size_t))
+#endif /* TAPE_MEM_MMAP */
+
 TAPEMEMDEF char *
 tape_append (Tape *tape, const DBuffer *buf)
 {
@@ -117,10 +190,38 @@ tape_append (Tape *tape, const DBuffer *buf)
 
   char *p = memcpy (tape->data + tape->len, buf, offsetof (DBuffer, data));
   memcpy (p + offsetof (DBuffer, data), buf->data, buf->len);
+  if (tape->idx && 0 == tape->count % TAPE_IDX_STEP
+      && tape->count / TAPE_IDX_STEP < tape->idx_cap)
+    tape->idx[tape->count / TAPE_IDX_STEP] = tape->len;
   tape->len += __buf_size;
+  tape->count++;
+#ifdef TAPE_MEM_MMAP
+  if (tape->__file)
+    {
+      tape->__file->len = tape->len;
+      tape->__file->count = tape->count;
+    }
+#endif
   return p + offsetof (DBuffer, data);
 }
 
+TAPEMEMDEF void
+tape_index (Tape *tape, size_t *idx, size_t n)
+{
+  size_t off = 0;
+
+  if (0 == n)
+    idx = NULL;
+  tape->idx = idx;
+  tape->idx_cap = n;
+  for (size_t i = 0; i < tape->count && i / TAPE_IDX_STEP < n; ++i)
+    {
+      if (0 == i % TAPE_IDX_STEP)
+        idx[i / TAPE_IDX_STEP] = off;
+      off += sizeof_buffer ((DBuffer *)(tape->data + off));
+    }
+}
+
 TAPEMEMDEF char *
 tape_get (const Tape *tape, size_t index)
 {
@@ -130,6 +231,20 @@ tape_get (const Tape *tape, size_t index)
   if (NULL == tape->data)
     return NULL;
 
+  if (tape->idx && 0 != tape->idx_cap && 0 != index)
+    {
+      if (index > tape->count)
+        return NULL;
+      /* start from the nearest indexed entry before @index */
+      size_t slot = (index - 1) / TAPE_IDX_STEP;
+      if (slot >= tape->idx_cap)
+        slot = tape->idx_cap - 1;
+      p += tape->idx[slot];
+      for (index -= slot * TAPE_IDX_STEP + 1; 0 != index; --index)
+        p += sizeof_buffer ((DBuffer *)p);
+      return p + offsetof (DBuffer, data);
+    }
+
   DBuffer *buf = (DBuffer *)p;
   while (0 != index && 0 != p_len)
     {
@@ -148,6 +263,89 @@ tape_get (const Tape *tape, size_t index)
     return NULL;
 }
 
+#ifdef TAPE_MEM_MMAP
+TAPEMEMDEF int
+tape_map (Tape *tape, const char *path, size_t cap)
+{
+  struct tape_file_t *f;
+  struct stat st;
+  size_t size;
+  int fd;
+
+  if (0 > (fd = open (path, O_RDWR | O_CREAT, 0644)))
+    return -1;
+  if (0 != fstat (fd, &st))
+    goto fail;
+  if (0 == st.st_size)
+    {
+      /* new file */
+      size = __tape_file_sizeof (cap) + cap;
+      if (0 != ftruncate (fd, size))
+        goto fail;
+    }
+  else if ((size_t) st.st_size < sizeof (struct tape_file_t))
+    goto fail_inval;
+  else
+    size = st.st_size;
+
+  f = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (MAP_FAILED == f)
+    goto fail;
+  close (fd);
+
+  if (0 == st.st_size)
+    {
+      memcpy (f->magic, TAPE_MAGIC, sizeof (f->magic));
+      f->cap = cap;
+      f->len = f->count = 0;
+      f->idx_cap = tape_idx_sizeof (cap);
+    }
+  else if (0 != memcmp (f->magic, TAPE_MAGIC, sizeof (f->magic))
+           || size != __tape_file_sizeof (f->cap) + f->cap)
+    {
+      munmap (f, size);
+      errno = EINVAL;
+      return -1;
+    }
+
+  *tape = new_tape (f->cap);
+  tape->__file = f;
+  tape->data = (char *)f + __tape_file_sizeof (f->cap);
+  tape->len = f->len;
+  tape->count = f->count;
+  tape->idx = (size_t *)(f + 1);
+  tape->idx_cap = f->idx_cap;
+  return 0;
+
+ fail_inval:
+  errno = EINVAL;
+ fail:
+  close (fd);
+  return -1;
+}
+
+TAPEMEMDEF int
+tape_sync (Tape *tape)
+{
+  if (NULL == tape->__file)
+    return -1;
+  return msync (tape->__file, __tape_file_sizeof (tape->cap) + tape->cap,
+                MS_SYNC);
+}
+
+TAPEMEMDEF int
+tape_unmap (Tape *tape)
+{
+  int ret;
+  if (NULL == tape->__file)
+    return -1;
+  ret = tape_sync (tape);
+  munmap (tape->__file, __tape_file_sizeof (tape->cap) + tape->cap);
+  *tape = new_tape (0);
+  return ret;
+}
+#endif /* TAPE_MEM_MMAP */
+
 #endif /* TAPE_MEM_IMPLEMENTATION */
 
 
@@ -218,6 +416,71 @@ main (void)
   printf ("done\n");
  
   free (mem.data);
+
+  /* many entries, with and without index */
+  char word[32];
+  size_t N = 5000;
+  Tape big = new_tape (N * buffer_of_size (sizeof (word)));
+  big.data = malloc (big.cap);
+  printf ("testing tape_index... ");
+  for (size_t i = 1; i <= N; ++i)
+    {
+      tmp.len = snprintf (word, sizeof (word), "word-%lu", i) + 1;
+      tmp.data = word;
+      assert (NULL != tape_append (&big, &tmp));
+      /* attach the index in the middle of the way */
+      if (i == N / 3)
+        tape_index (&big, malloc (tape_idx_sizeof (big.cap)
+                                  * sizeof (size_t)),
+                    tape_idx_sizeof (big.cap));
+    }
+  for (size_t i = 1; i <= N; ++i)
+    {
+      snprintf (word, sizeof (word), "word-%lu", i);
+      data_at = tape_get (&big, i);
+      assert (NULL != data_at && 0 == strcmp (data_at, word));
+    }
+  assert (NULL == tape_get (&big, N + 1));
+  /* without index slots, tape_get walks the whole tape */
+  free (big.idx);
+  tape_index (&big, big.idx, 0);
+  assert (NULL == big.idx);
+  data_at = tape_get (&big, N);
+  snprintf (word, sizeof (word), "word-%lu", N);
+  assert (NULL != data_at && 0 == strcmp (data_at, word));
+  printf ("done\n");
+
+#ifdef TAPE_MEM_MMAP
+  char path[] = "/tmp/tape_mem_XXXXXX";
+  Tape ft;
+  close (mkstemp (path));
+  printf ("testing tape_map... ");
+  assert (0 == tape_map (&ft, path, big.cap));
+  for (size_t i = 1; i <= N; ++i)
+    {
+      data_at = tape_get (&big, i);
+      btmp = bufferof (data_at);
+      tmp.len = btmp->len;
+      tmp.data = data_at;
+      assert (NULL != tape_append (&ft, &tmp));
+    }
+  assert (0 == tape_unmap (&ft));
+  /* reopen it, @cap is ignored */
+  assert (0 == tape_map (&ft, path, 0));
+  assert (N == ft.count);
+  for (size_t i = 1; i <= N; ++i)
+    {
+      snprintf (word, sizeof (word), "word-%lu", i);
+      data_at = tape_get (&ft, i);
+      assert (NULL != data_at && 0 == strcmp (data_at, word));
+    }
+  assert (0 == tape_unmap (&ft));
+  unlink (path);
+  printf ("done\n");
+#endif /* TAPE_MEM_MMAP */
+
+  free (big.idx);
+  free (big.data);
   return 0;
 }
 #endif /* TAPE_MEM_TEST */
@@ -0,0 +1,880 @@
+/* This file is part of my-small-c-projects <https://gitlab.com/SI.AMO/>
+
+  This program is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/** file: bench.c
+    created on: 15 Oct 2026
+
+    Benchmark suite of the libraries (DS and libs)
+    Runs reproducible workloads (fixed seed) and prints one
+    tab-separated line per benchmark, see bench.sh to also run
+    the utilities and to compare two runs
+
+    Usage:
+      bench [OPTIONS] [NAME_PREFIX]...
+      only benchmarks starting with one of NAME_PREFIX are run
+      -l:        list benchmarks
+      -r N:      repeat each benchmark N times (default 3), the
+                 fastest run is reported
+      -s SCALE:  multiply the workload sizes by SCALE (default 1)
+      -f FILE:   corpus of the lexer benchmark (javascript), by
+                 default a synthetic one is generated
+      -c FILE:   corpus of the key_extractor lexer benchmark (C),
+                 by default a synthetic one is generated
+    Results of the workloads are also checked (hashtab lookups,
+    base64 round trip, same results of leven and lexer variants),
+    the exit status is 1 when a check fails
+
+    Output columns:
+      name, ops, ns/op, cycles/op, allocs/op, MB/s
+      cycles are TSC (reference) cycles on x86, otherwise 0
+      allocs are malloc/calloc/realloc/aligned_alloc calls made by
+      the libraries, counted by wrapping them (mmap is not counted)
+      MB/s is 0 when the benchmark does not process a byte stream
+
+    Compilation:
+      cc -O3 -march=native -Wall -Wextra -I../libs -I../DS \
+         -o bench bench.c -lpthread
+ **/
+#ifndef _GNU_SOURCE
+#  define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#if defined (__x86_64__) || defined (__i386__)
+#  include <x86intrin.h>
+#  define bench_cycles() __rdtsc ()
+#else
+#  define bench_cycles() 0ULL
+#endif
+
+/**
+ *  allocation counters
+ *  the libraries below are included after these macros, so
+ *  their allocations go through the counting wrappers; only
+ *  the allocations between bench_start and bench_stop count
+ */
+static size_t bench_allocs = 0;
+
+static void *
+bench_malloc (size_t n)
+{
+  ++bench_allocs;
+  return malloc (n);
+}
+
+static void *
+bench_calloc (size_t n, size_t size)
+{
+  ++bench_allocs;
+  return calloc (n, size);
+}
+
+static void *
+bench_realloc (void *p, size_t n)
+{
+  ++bench_allocs;
+  return realloc (p, n);
+}
+
+static void *
+bench_aligned_alloc (size_t al, size_t n)
+{
+  ++bench_allocs;
+  return aligned_alloc (al, n);
+}
+
+#define malloc(n) bench_malloc (n)
+#define calloc(n, size) bench_calloc (n, size)
+#define realloc(p, n) bench_realloc (p, n)
+#define aligned_alloc(al, n) bench_aligned_alloc (al, n)
+
+#define HASHTAB_IMPLEMENTATION
+#ifndef HT_HASHER
+#  define HT_HASHER hash_wy
+#endif
+#include "hashtab.h"
+
+#define ARENA_IMPLEMENTATION
+#include "arena.h"
+
+#define LEVEN_IMPLEMENTATION
+#include "leven.h"
+
+#define B64_IMPLEMENTATION
+#include "libbase64.h"
+
+#define ML_IMPLEMENTATION
+#include "mini-lexer.h"
+
+
+/* reproducible workloads */
+#define BENCH_SEED 0x9E3779B97F4A7C15ULL
+
+static uint64_t rng_state;
+
+static inline uint64_t
+rng (void)
+{
+  /* splitmix64 */
+  uint64_t z = (rng_state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+static double
+bench_now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* to keep results alive */
+static volatile uint64_t bench_sink;
+
+/**
+ *  regression checks, results of the workloads are checked
+ *  (and cross-checked between implementations), on failure
+ *  the program exits with 1, after running all benchmarks
+ */
+static int bench_failed = 0;
+
+#define bench_check(cond, name) do {                            \
+    if (!(cond))                                                \
+      {                                                         \
+        fprintf (stderr, "bench: %s: regression check failed "  \
+                 "(%s)\n", name, #cond);                        \
+        bench_failed = 1;                                       \
+      }                                                         \
+  } while (0)
+
+/**
+ *  measurement of one run
+ *  benchmarks call bench_start before the measured part
+ *  and return the number of ops (and bytes, if any)
+ */
+struct bench_run_t {
+  double t;
+  uint64_t cycles;
+  size_t allocs;
+  size_t ops;
+  size_t bytes;
+};
+
+static struct bench_run_t __run;
+
+#define bench_start() do {                      \
+    __run.allocs = bench_allocs;                \
+    __run.cycles = bench_cycles ();             \
+    __run.t = bench_now ();                     \
+  } while (0)
+
+#define bench_stop(n_ops, n_bytes) do {                 \
+    __run.t = bench_now () - __run.t;                   \
+    __run.cycles = bench_cycles () - __run.cycles;      \
+    __run.allocs = bench_allocs - __run.allocs;         \
+    __run.ops = (n_ops);                                \
+    __run.bytes = (n_bytes);                            \
+  } while (0)
+
+static size_t scale = 1;
+static const char *corpus_path = NULL;
+static const char *c_corpus_path = NULL;
+
+
+/**
+ *  hashtab
+ *  keys like "k1f2e3d4c5", inserted to a growable table,
+ *  then looked up (all hits), and the same count of misses
+ */
+#define HT_N (1 << 20)
+
+static struct keytab_t *ht_keys;
+static char *ht_mem;
+
+static void
+ht_mkkeys (size_t n)
+{
+  rng_state = BENCH_SEED;
+  ht_keys = malloc (2 * n * sizeof (*ht_keys));
+  ht_mem = malloc (2 * n * 24);
+  for (size_t i = 0; i < 2 * n; ++i)
+    {
+      char *k = ht_mem + i * 24;
+      int len = snprintf (k, 24, "k%llx", (unsigned long long) rng ());
+      ht_keys[i] = NEW_KEY (k, len);
+    }
+}
+
+static int
+bench_isequal (const DATA_T *restrict k1, idx_t l1,
+               const DATA_T *restrict k2, idx_t l2)
+{
+  return l1 == l2 && 0 == memcmp (k1, k2, l1);
+}
+
+static void
+b_hashtab_insert (void)
+{
+  size_t n = HT_N * scale;
+  if (!ht_keys)
+    ht_mkkeys (n);
+  GHashTable g = new_ghashtab (16, ht_keys);
+  ht_set_funs (&g, HT_HASHER, bench_isequal);
+
+  bench_start ();
+  ght_init (&g);
+  for (size_t i = 0; i < n; ++i)
+    ght_insert (&g, i);
+  bench_stop (n, 0);
+
+  bench_check (ght_lenof (&g) == n, "hashtab.insert");
+  bench_sink += ght_lenof (&g);
+  ght_free (&g);
+}
+
+static void
+b_hashtab_lookup (void)
+{
+  size_t n = HT_N * scale;
+  if (!ht_keys)
+    ht_mkkeys (n);
+  GHashTable g = new_ghashtab (16, ht_keys);
+  ht_set_funs (&g, HT_HASHER, bench_isequal);
+  ght_init (&g);
+  for (size_t i = 0; i < n; ++i)
+    ght_insert (&g, i);
+
+  idx_t res;
+  size_t found = 0;
+  bench_start ();
+  /* hits, then misses (keys n..2n are not inserted) */
+  for (size_t i = 0; i < 2 * n; ++i)
+    found += (0 == ght_idxof (&g, ht_keys[i].key, ht_keys[i].len, &res));
+  bench_stop (2 * n, 0);
+
+  bench_check (found == n, "hashtab.lookup");
+  bench_sink += found;
+  ght_free (&g);
+}
+
+
+/**
+ *  arena vs malloc
+ *  many small objects (16 to 256 bytes) of one lifetime
+ *  arena_alloc looks for free space in all regions (first fit),
+ *  so it runs on ALLOC_N / 16 objects to stay within seconds,
+ *  tarena and slab are the O(1) allocators (regions of tarena's
+ *  pool are mapped, and not counted as allocations)
+ */
+#define ALLOC_N (1 << 20)
+
+static uint16_t *alloc_sizes;
+
+static void
+alloc_mksizes (size_t n)
+{
+  rng_state = BENCH_SEED;
+  alloc_sizes = malloc (n * sizeof (*alloc_sizes));
+  for (size_t i = 0; i < n; ++i)
+    alloc_sizes[i] = 16 + rng () % 241;
+}
+
+static void
+b_alloc_arena (void)
+{
+  size_t n = ALLOC_N / 16 * scale;
+  if (!alloc_sizes)
+    alloc_mksizes (ALLOC_N * scale);
+  Arena A = new_arena ();
+
+  bench_start ();
+  for (size_t i = 0; i < n; ++i)
+    {
+      char *p = arena_alloc (&A, alloc_sizes[i], AUSE_MALLOC);
+      *p = (char) i;
+    }
+  arena_free (&A);
+  bench_stop (n, 0);
+}
+
+static void
+b_alloc_tarena (void)
+{
+  size_t n = ALLOC_N * scale;
+  if (!alloc_sizes)
+    alloc_mksizes (n);
+  RegionPool pool = new_region_pool (1 << 20);
+  TArena T = new_tarena (&pool);
+
+  bench_start ();
+  for (size_t i = 0; i < n; ++i)
+    {
+      char *p = tarena_alloc (&T, alloc_sizes[i]);
+      *p = (char) i;
+    }
+  tarena_release (&T);
+  bench_stop (n, 0);
+
+  pool_free (&pool);
+}
+
+static void
+b_alloc_slab (void)
+{
+  size_t n = ALLOC_N * scale;
+  if (!alloc_sizes)
+    alloc_mksizes (n);
+  char **ptrs = malloc (n * sizeof (char *));
+  Slab S = new_slab (AUSE_MALLOC);
+
+  bench_start ();
+  for (size_t i = 0; i < n; ++i)
+    {
+      ptrs[i] = slab_alloc (&S, alloc_sizes[i]);
+      *ptrs[i] = (char) i;
+    }
+  for (size_t i = 0; i < n; ++i)
+    slab_free (&S, ptrs[i], alloc_sizes[i]);
+  slab_destroy (&S);
+  bench_stop (n, 0);
+
+  free (ptrs);
+}
+
+static void
+b_alloc_malloc (void)
+{
+  size_t n = ALLOC_N * scale;
+  if (!alloc_sizes)
+    alloc_mksizes (n);
+  char **ptrs = malloc (n * sizeof (char *));
+
+  bench_start ();
+  for (size_t i = 0; i < n; ++i)
+    {
+      ptrs[i] = malloc (alloc_sizes[i]);
+      *ptrs[i] = (char) i;
+    }
+  for (size_t i = 0; i < n; ++i)
+    free (ptrs[i]);
+  bench_stop (n, 0);
+
+  free (ptrs);
+}
+
+
+/**
+ *  leven
+ *  pairs of random words (5 to 20 letters of a small alphabet)
+ */
+#define LEVEN_N (1 << 17)
+#define LEVEN_WLEN 24
+
+static char *leven_words;
+
+static void
+leven_mkwords (size_t n)
+{
+  rng_state = BENCH_SEED;
+  leven_words = malloc (2 * n * LEVEN_WLEN);
+  for (size_t i = 0; i < 2 * n; ++i)
+    {
+      char *w = leven_words + i * LEVEN_WLEN;
+      int len = 5 + rng () % 16;
+      for (int j = 0; j < len; ++j)
+        w[j] = "abcdefgh"[rng () % 8];
+      w[len] = '\0';
+    }
+}
+
+/* sum of distances, the same for all implementations */
+static size_t leven_sum = 0;
+
+#define LEVEN_BENCH(fun) do {                                   \
+    size_t n = LEVEN_N * scale, sum = 0;                        \
+    if (!leven_words)                                           \
+      leven_mkwords (n);                                        \
+    bench_start ();                                             \
+    for (size_t i = 0; i < n; ++i)                              \
+      sum += fun (leven_words + 2 * i * LEVEN_WLEN,             \
+                  leven_words + (2 * i + 1) * LEVEN_WLEN);      \
+    bench_stop (n, 0);                                          \
+    if (leven_sum == 0)                                         \
+      leven_sum = sum;                                          \
+    bench_check (sum == leven_sum, "leven." #fun);              \
+  } while (0)
+
+static void
+b_leven_imm (void)
+{
+  LEVEN_BENCH (leven_imm);
+}
+
+static void
+b_leven_myers (void)
+{
+  LEVEN_BENCH (leven_myers);
+}
+
+
+/**
+ *  base64
+ *  encode and decode of a random buffer
+ */
+#define B64_N (16 << 20)
+
+static unsigned char *b64_raw, *b64_enc, *b64_dec;
+static size_t b64_enclen;
+
+static void
+b64_mkbuf (size_t n)
+{
+  rng_state = BENCH_SEED;
+  b64_raw = malloc (n);
+  b64_enc = malloc (n / 3 * 4 + 8);
+  b64_dec = malloc (n + 8);
+  for (size_t i = 0; i < n; i += 8)
+    {
+      uint64_t r = rng ();
+      memcpy (b64_raw + i, &r, n - i < 8 ? n - i : 8);
+    }
+  int err = 0;
+  b64_enclen = b64_encode (b64_raw, n, b64_enc, n / 3 * 4 + 8, &err);
+}
+
+static void
+b_base64_encode (void)
+{
+  size_t n = B64_N * scale;
+  int err = 0;
+  if (!b64_raw)
+    b64_mkbuf (n);
+
+  bench_start ();
+  size_t w = b64_encode (b64_raw, n, b64_enc, n / 3 * 4 + 8, &err);
+  bench_stop (n, n);
+
+  bench_check (w == b64_enclen, "base64.encode");
+}
+
+static void
+b_base64_decode (void)
+{
+  size_t n = B64_N * scale;
+  int err = 0;
+  if (!b64_raw)
+    b64_mkbuf (n);
+
+  bench_start ();
+  size_t w = b64_decode (b64_enc, b64_enclen, b64_dec, n + 8, &err);
+  bench_stop (b64_enclen, b64_enclen);
+
+  bench_check (w == n && 0 == memcmp (b64_raw, b64_dec, n),
+               "base64.decode");
+}
+
+
+/**
+ *  mini-lexer
+ *  tokens of a javascript corpus, by default a synthetic one
+ *  tokens are counted by NEXT_MATCH (and NEXT_ZTERM) results
+ */
+#define LEX_N (8 << 20)
+
+enum JS_LANG
+  {
+    /* keywords */
+    JS_FUNCTION = 0, JS_RETURN, JS_VAR, JS_LET, JS_CONST,
+    JS_IF, JS_ELSE, JS_FOR, JS_WHILE, JS_NEW, JS_THIS,
+    /* punctuations */
+    JS_ASSIGN = 0, JS_DOT, JS_COMMA, JS_SEMI, JS_PLUS, JS_MINUS,
+    JS_STAR, JS_LT, JS_GT, JS_NOT, JS_COLON, JS_LPAREN, JS_RPAREN,
+    JS_LCURLY, JS_RCURLY, JS_LBRACKET, JS_RBRACKET,
+    /* expressions */
+    JS_STR = 0, JS_STR2, JS_TMPL,
+    /* comments */
+    JS_COMM_SL = 0,
+    JS_COMM_ML = 0,
+  };
+
+static const char *JS_Keywords[] = {
+  [JS_FUNCTION] = "function", [JS_RETURN] = "return",
+  [JS_VAR] = "var", [JS_LET] = "let", [JS_CONST] = "const",
+  [JS_IF] = "if", [JS_ELSE] = "else", [JS_FOR] = "for",
+  [JS_WHILE] = "while", [JS_NEW] = "new", [JS_THIS] = "this",
+};
+static struct Milexer_exp_ JS_Puncs[] = {
+  [JS_ASSIGN] = {"="}, [JS_DOT] = {"."}, [JS_COMMA] = {","},
+  [JS_SEMI] = {";"}, [JS_PLUS] = {"+"}, [JS_MINUS] = {"-"},
+  [JS_STAR] = {"*"}, [JS_LT] = {"<"}, [JS_GT] = {">"},
+  [JS_NOT] = {"!"}, [JS_COLON] = {":"},
+  [JS_LPAREN] = {"("}, [JS_RPAREN] = {")"},
+  [JS_LCURLY] = {"{"}, [JS_RCURLY] = {"}"},
+  [JS_LBRACKET] = {"["}, [JS_RBRACKET] = {"]"},
+};
+/* like key_extractor, only strings are expressions */
+static struct Milexer_exp_ JS_Expressions[] = {
+  [JS_STR] = {"\"", "\""}, [JS_STR2] = {"'", "'"},
+  [JS_TMPL] = {"`", "`"},
+};
+static const char *JS_SL_Comments[] = {
+  [JS_COMM_SL] = "//",
+};
+static struct Milexer_exp_ JS_ML_Comments[] = {
+  [JS_COMM_ML] = {"/*", "*/"},
+};
+static Milexer js_ml = {
+  .puncs       = GEN_MLCFG (JS_Puncs),
+  .keywords    = GEN_MLCFG (JS_Keywords),
+  .expression  = GEN_MLCFG (JS_Expressions),
+  .b_comment   = GEN_MLCFG (JS_SL_Comments),
+  .a_comment   = GEN_MLCFG (JS_ML_Comments),
+};
+
+static char *lex_src;
+static size_t lex_len;
+/* token count, the same with and without PFLAG_VIEW */
+static size_t lex_tokens = 0;
+
+/* reads the whole @path into @buf, @len */
+static void
+lex_readfile (const char *path, char **buf, size_t *len)
+{
+  FILE *f = fopen (path, "r");
+  if (!f)
+    {
+      perror (path);
+      exit (1);
+    }
+  size_t cap = 1 << 20, r;
+  *buf = malloc (cap);
+  while ((r = fread (*buf + *len, 1, cap - *len, f)) > 0)
+    if ((*len += r) == cap)
+      *buf = realloc (*buf, cap *= 2);
+  fclose (f);
+}
+
+static void
+lex_mkcorpus (size_t n)
+{
+  if (corpus_path)
+    {
+      lex_readfile (corpus_path, &lex_src, &lex_len);
+      return;
+    }
+
+  static const char *idents[] = {
+    "value", "index", "result", "node", "options", "callback",
+    "element", "data", "i", "x", "self", "length", "push", "map",
+  };
+#define IDENT() idents[rng () % (sizeof (idents) / sizeof (*idents))]
+  rng_state = BENCH_SEED;
+  lex_src = malloc (n + 512);
+  while (lex_len < n)
+    {
+      char *p = lex_src + lex_len;
+      switch (rng () % 6)
+        {
+        case 0:
+          p += sprintf (p, "function %s(%s, %s) {\n", IDENT (),
+                        IDENT (), IDENT ());
+          break;
+        case 1:
+          p += sprintf (p, "  const %s = %s.%s(%s, %u);\n", IDENT (),
+                        IDENT (), IDENT (), IDENT (),
+                        (unsigned) (rng () % 1000));
+          break;
+        case 2:
+          p += sprintf (p, "  if (%s < %s.length) { return \"%s\"; }\n",
+                        IDENT (), IDENT (), IDENT ());
+          break;
+        case 3:
+          p += sprintf (p, "  // %s %s %s\n", IDENT (), IDENT (), IDENT ());
+          break;
+        case 4:
+          p += sprintf (p, "  for (let %s = 0; %s < %s; %s++) "
+                        "%s[%s] = '%s';\n", IDENT (), IDENT (), IDENT (),
+                        IDENT (), IDENT (), IDENT (), IDENT ());
+          break;
+        default:
+          p += sprintf (p, "}\n/* %s */\n", IDENT ());
+          break;
+        }
+      lex_len = p - lex_src;
+    }
+#undef IDENT
+}
+
+static void
+lexer_bench (int flags)
+{
+  size_t tokens = 0;
+  if (!lex_src)
+    lex_mkcorpus (LEX_N * scale);
+
+  Milexer_Slice src = {.lazy = true};
+  Milexer_Token tk = TK_ALLOC (64);
+  bench_start ();
+  SET_ML_SLICE (&src, lex_src, lex_len);
+  for (int ret = 0; !NEXT_SHOULD_END (ret); )
+    {
+      ret = ml_next (&js_ml, &src, &tk, flags);
+      if (ret == NEXT_NEED_LOAD)
+        END_ML_SLICE (&src);
+      else if (ret == NEXT_MATCH || ret == NEXT_ZTERM)
+        ++tokens;
+    }
+  bench_stop (tokens, lex_len);
+
+  if (lex_tokens == 0)
+    lex_tokens = tokens;
+  bench_check (tokens > 0 && tokens == lex_tokens, "lexer");
+  TK_FREE (&tk);
+}
+
+static void
+b_lexer_tokens (void)
+{
+  lexer_bench (PFLAG_DEFAULT);
+}
+
+/* zero-copy tokens */
+static void
+b_lexer_view (void)
+{
+  lexer_bench (PFLAG_VIEW);
+}
+
+/**
+ *  The language of key_extractor (utils/key_extractor.c), only
+ *  strings and nearly all non-alphanumeric bytes as delimiters
+ *  The input is given in small slices, like key_extractor does
+ *  this is its throughput, most of the time is spent in ml_next
+ */
+#define KX_SLICE 512
+
+enum KX_LANG
+  {
+    KX_STR = 0, KX_STR2, KX_STR3,
+  };
+
+static struct Milexer_exp_ KX_Expressions[] = {
+  [KX_STR] = {"\"", "\""}, [KX_STR2] = {"'", "'"},
+  [KX_STR3] = {"`", "`"},
+};
+static const char *KX_Delimiters[] = {
+  "\x00\x21", "\x23\x2F", "\x3A\x40", "\x5B",
+  "\x5D", "\x5E", "\x60", "\x7B\xFF",
+};
+static Milexer kx_ml = {
+  .expression   = GEN_MLCFG (KX_Expressions),
+  .delim_ranges = GEN_MLCFG (KX_Delimiters),
+};
+
+static char *kx_src;
+static size_t kx_len;
+static size_t kx_tokens = 0;
+
+static void
+kx_mkcorpus (size_t n)
+{
+  if (c_corpus_path)
+    {
+      lex_readfile (c_corpus_path, &kx_src, &kx_len);
+      return;
+    }
+
+  static const char *idents[] = {
+    "buf", "len", "idx", "ptr", "ctx", "size_t", "next", "out",
+    "state", "flags", "tk", "src", "cap", "res", "i", "n",
+  };
+#define IDENT() idents[rng () % (sizeof (idents) / sizeof (*idents))]
+  rng_state = BENCH_SEED;
+  kx_src = malloc (n + 512);
+  while (kx_len < n)
+    {
+      char *p = kx_src + kx_len;
+      switch (rng () % 6)
+        {
+        case 0:
+          p += sprintf (p, "static int\n%s_%s (const char *%s, "
+                        "size_t %s)\n{\n", IDENT (), IDENT (),
+                        IDENT (), IDENT ());
+          break;
+        case 1:
+          p += sprintf (p, "  if (%s->%s == NULL || %s >= %u)\n"
+                        "    return -1;\n", IDENT (), IDENT (),
+                        IDENT (), (unsigned) (rng () % 4096));
+          break;
+        case 2:
+          p += sprintf (p, "  fprintf (stderr, \"%s: %%s\\n\", %s);\n",
+                        IDENT (), IDENT ());
+          break;
+        case 3:
+          p += sprintf (p, "  /* %s of the %s, see %s */\n",
+                        IDENT (), IDENT (), IDENT ());
+          break;
+        case 4:
+          p += sprintf (p, "  %s[%s++] = '%c';\n", IDENT (), IDENT (),
+                        (int) ('a' + rng () % 26));
+          break;
+        default:
+          p += sprintf (p, "  return %s;\n}\n\n", IDENT ());
+          break;
+        }
+      kx_len = p - kx_src;
+    }
+#undef IDENT
+}
+
+static void
+b_lexer_kextractor (void)
+{
+  size_t tokens = 0, off = 0;
+  if (!kx_src)
+    kx_mkcorpus (LEX_N * scale);
+
+  Milexer_Slice src = {.lazy = true};
+  Milexer_Token tk = TK_ALLOC (KX_SLICE);
+  bench_start ();
+  for (int ret = 0; !NEXT_SHOULD_END (ret); )
+    {
+      ret = ml_next (&kx_ml, &src, &tk, PFLAG_INEXP);
+      if (ret == NEXT_NEED_LOAD)
+        {
+          if (off < kx_len)
+            {
+              size_t n = kx_len - off;
+              SET_ML_SLICE (&src, kx_src + off,
+                            (n < KX_SLICE) ? n : KX_SLICE);
+              off += src.cap;
+            }
+          else
+            END_ML_SLICE (&src);
+        }
+      else if (ret == NEXT_MATCH || ret == NEXT_ZTERM)
+        ++tokens;
+    }
+  bench_stop (tokens, kx_len);
+
+  if (kx_tokens == 0)
+    kx_tokens = tokens;
+  bench_check (tokens > 0 && tokens == kx_tokens, "lexer.kextractor");
+  TK_FREE (&tk);
+}
+
+
+static const struct {
+  const char *name;
+  void (*fun)(void);
+} benchmarks[] = {
+  {"hashtab.insert", b_hashtab_insert},
+  {"hashtab.lookup", b_hashtab_lookup},
+  {"alloc.arena", b_alloc_arena},
+  {"alloc.tarena", b_alloc_tarena},
+  {"alloc.slab", b_alloc_slab},
+  {"alloc.malloc", b_alloc_malloc},
+  {"leven.imm", b_leven_imm},
+  {"leven.myers", b_leven_myers},
+  {"base64.encode", b_base64_encode},
+  {"base64.decode", b_base64_decode},
+  {"lexer.tokens", b_lexer_tokens},
+  {"lexer.view", b_lexer_view},
+  {"lexer.kextractor", b_lexer_kextractor},
+};
+#define BENCH_COUNT (sizeof (benchmarks) / sizeof (benchmarks[0]))
+
+static void
+bench_print (const char *name, const struct bench_run_t *r)
+{
+  double ops = r->ops ? r->ops : 1;
+  printf ("%s\t%zu\t%.2f\t%.2f\t%.4f\t%.1f\n", name, r->ops,
+          r->t * 1e9 / ops, r->cycles / ops, r->allocs / ops,
+          r->bytes ? r->bytes / r->t / 1e6 : 0.0);
+  fflush (stdout);
+}
+
+static int
+selected (const char *name, int argc, char **argv)
+{
+  if (argc == 0)
+    return 1;
+  for (int i = 0; i < argc; ++i)
+    if (0 == strncmp (name, argv[i], strlen (argv[i])))
+      return 1;
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  int opt, reps = 3;
+  while ((opt = getopt (argc, argv, "lr:s:f:c:h")) != -1)
+    {
+      switch (opt)
+        {
+        case 'l':
+          for (size_t i = 0; i < BENCH_COUNT; ++i)
+            puts (benchmarks[i].name);
+          return 0;
+        case 'r':
+          reps = atoi (optarg);
+          break;
+        case 's':
+          scale = strtoul (optarg, NULL, 0);
+          break;
+        case 'f':
+          corpus_path = optarg;
+          break;
+        case 'c':
+          c_corpus_path = optarg;
+          break;
+        default:
+          fprintf (stderr, "usage: %s [-l] [-r REPS] [-s SCALE] "
+                   "[-f JS_CORPUS] [-c C_CORPUS] [NAME_PREFIX]...\n",
+                   *argv);
+          return opt != 'h';
+        }
+    }
+  if (reps < 1)
+    reps = 1;
+  if (scale < 1)
+    scale = 1;
+  argc -= optind;
+  argv += optind;
+
+  puts ("# name\tops\tns/op\tcycles/op\tallocs/op\tMB/s");
+  for (size_t i = 0; i < BENCH_COUNT; ++i)
+    {
+      if (!selected (benchmarks[i].name, argc, argv))
+        continue;
+      struct bench_run_t best = {0};
+      for (int r = 0; r < reps; ++r)
+        {
+          benchmarks[i].fun ();
+          if (r == 0 || __run.t < best.t)
+            best = __run;
+        }
+      bench_print (benchmarks[i].name, &best);
+    }
+  return bench_failed;
+}
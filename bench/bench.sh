@@ -0,0 +1,237 @@
+#!/bin/sh
+# This file is part of my-small-c-projects <https://gitlab.com/SI.AMO/>
+# (GPL-3.0-or-later, see bench.c)
+#
+# file: bench.sh
+# created on: 15 Oct 2026
+#
+# Builds and runs the benchmark suite, the library benchmarks
+# of bench.c plus the utilities (permugen, key_extractor, ffuc),
+# and prints the results as tab-separated lines (the same columns
+# as bench.c); tr_ng only has regression checks (no rows), and
+# kextractor also checks that -j 4 prints the same as -j 1
+#
+# Usage:
+#   ./bench.sh [run] [BENCH_ARGS]...  > results.tsv
+#   ./bench.sh compare OLD.tsv NEW.tsv
+#
+# BENCH_ARGS are passed to the bench program (see bench.c), name
+# prefixes also select the utility benchmarks (permugen, ffuc,
+# kextractor, tr_ng); kextractor runs on the C sources of this repository
+# (repeated to KX_MB megabytes)
+#
+# Environment:
+#   CC, CFLAGS:  compiler and flags (default: cc, -O3 -march=native)
+#   BUILD:       build directory (default: $TMPDIR/msc-bench)
+#   FFUC_WORDS:  word count of the ffuc benchmark (default: 20000)
+#   KX_MB:       corpus size of the kextractor benchmark (default: 16)
+#   PORT:        port of the loopback server (default: 18080)
+#
+# Utilities are skipped (with a note on stderr) when they fail to
+# build, ffuc needs libcurl; allocs/op of them is not known (-)
+# The exit status is 1 when a regression check fails (see bench.c,
+# and unsuccessful ffuc requests), all benchmarks are still run
+# compare exits with 1 when a benchmark is more than 5% slower
+
+set -u
+HERE=$(cd "$(dirname "$0")" && pwd)
+ROOT=$(dirname "$HERE")
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:--O3 -march=native}
+BUILD=${BUILD:-${TMPDIR:-/tmp}/msc-bench}
+FFUC_WORDS=${FFUC_WORDS:-20000}
+KX_MB=${KX_MB:-16}
+PORT=${PORT:-18080}
+
+note () { echo "bench: $*" >&2; }
+
+now_ns () { date +%s%N; }
+
+# prints a row of a command, that its output is measured
+# usage: row NAME COMMAND...
+row ()
+{
+  name=$1; shift
+  t0=$(now_ns)
+  set -- $("$@" | wc -lc)
+  t1=$(now_ns)
+  awk -v n="$name" -v l="$1" -v b="$2" -v t="$((t1 - t0))" 'BEGIN {
+    if (l == 0) l = 1;
+    printf "%s\t%d\t%.2f\t0\t-\t%.1f\n", n, l, t / l, b * 1000 / t
+  }'
+}
+
+# prints a row of a command, that its input FILE is measured
+# usage: row_in NAME FILE COMMAND...
+row_in ()
+{
+  name=$1 file=$2; shift 2
+  t0=$(now_ns)
+  l=$("$@" < "$file" | wc -l)
+  t1=$(now_ns)
+  awk -v n="$name" -v l="$l" -v b="$(wc -c < "$file")" \
+      -v t="$((t1 - t0))" 'BEGIN {
+    if (l == 0) l = 1;
+    printf "%s\t%d\t%.2f\t0\t-\t%.1f\n", n, l, t / l, b * 1000 / t
+  }'
+}
+
+# checks the output of tr_ng, on failure sets rc to 1
+# usage: tr_check HEX_OUTPUT PRINTF_INPUT TR_ARGS...
+tr_check ()
+{
+  want=$1 in=$2; shift 2
+  got=$(printf "$in" | "$BUILD/tr_ng" "$@" | od -An -tx1 | tr -d ' \n')
+  [ "$got" = "$want" ] || {
+    note "tr_ng $*: output $got, expected $want"
+    rc=1
+  }
+}
+
+build ()
+{
+  mkdir -p "$BUILD" || exit 1
+  $CC $CFLAGS -I"$ROOT/libs" -I"$ROOT/DS" \
+      -o "$BUILD/bench" "$HERE/bench.c" -lpthread || exit 1
+  $CC $CFLAGS -I"$ROOT/libs" -I"$ROOT/DS" \
+      -o "$BUILD/permugen" "$ROOT/utils/permugen.c" -lpthread 2>/dev/null \
+    || note "permugen: build failed, skipped"
+  $CC $CFLAGS -I"$ROOT/libs" -I"$ROOT/DS" -o "$BUILD/kextractor" \
+      "$ROOT/utils/key_extractor.c" -lpthread 2>/dev/null \
+    || note "kextractor: build failed, skipped"
+  $CC $CFLAGS -o "$BUILD/tr_ng" "$ROOT/gnu_recreation/tr_ng.c" 2>/dev/null \
+    || note "tr_ng: build failed, skipped"
+  if $CC $CFLAGS -I"$ROOT/libs" -o "$BUILD/ffuc" "$ROOT/utils/ffuc.c" \
+         -lcurl -lpthread 2>/dev/null; then
+    $CC -O2 -o "$BUILD/httpd" "$HERE/httpd.c" || rm -f "$BUILD/ffuc"
+  else
+    note "ffuc: build failed (libcurl?), skipped"
+  fi
+}
+
+# is utility benchmark $1 selected by the name prefixes
+selected ()
+{
+  has_prefix=0 skip=0
+  for a in $BENCH_ARGS; do
+    # options and their arguments
+    [ $skip -eq 1 ] && { skip=0; continue; }
+    case $a in
+      -[rsf]) skip=1; continue ;;
+      -*) continue ;;
+    esac
+    has_prefix=1
+    case $1 in
+      "$a"*) return 0 ;;
+    esac
+  done
+  return $has_prefix
+}
+
+run ()
+{
+  BENCH_ARGS="$*"
+  build
+  rc=0
+  "$BUILD/bench" "$@" || rc=1
+
+  if [ -x "$BUILD/permugen" ]; then
+    # lines/sec at several depths, alphanumeric seeds
+    for d in 3 4 5; do
+      selected "permugen.d$d" && \
+        row "permugen.d$d" "$BUILD/permugen" -s '\l \d' -d "$d"
+    done
+  fi
+
+  if [ -x "$BUILD/kextractor" ] && selected "kextractor.c"; then
+    # input MB/s, tokens of C sources (the default language)
+    find "$ROOT" -name '*.[ch]' -exec cat {} + > "$BUILD/csrc.1"
+    : > "$BUILD/csrc"
+    while [ -s "$BUILD/csrc.1" ] &&
+            [ "$(wc -c < "$BUILD/csrc")" -lt $((KX_MB << 20)) ]; do
+      cat "$BUILD/csrc.1" >> "$BUILD/csrc"
+    done
+    row_in "kextractor.c" "$BUILD/csrc" "$BUILD/kextractor"
+    # the parallel mode must print the same keys as the serial mode
+    s1=$("$BUILD/kextractor" --if "$BUILD/csrc" -j 1 | cksum)
+    s4=$("$BUILD/kextractor" --if "$BUILD/csrc" -j 4 | cksum)
+    [ "$s1" = "$s4" ] || {
+      note "kextractor: output of -j 4 differs from -j 1"
+      rc=1
+    }
+  fi
+
+  if [ -x "$BUILD/tr_ng" ] && selected "tr_ng."; then
+    # squeeze within 16-byte blocks (the SIMD path), and of bytes
+    # above 0x7F, which the ASCII nibble lookup used to miss
+    a32=aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa
+    ff20='\377\377\377\377\377\377\377\377\377\377'
+    ff20=$ff20$ff20
+    h16='\200\200\200\200\200\200\200\200'
+    h16=$h16$h16
+    e16='\351\351\351\351\351\351\351\351'
+    e16=$e16$e16
+    tr_check 61 "$a32" -s c a
+    tr_check 61ff62 "a${ff20}b" -s c '\xff'
+    tr_check 788079e9 "x${h16}y${e16}" -s c '\x80' d '\xe9'
+  fi
+
+  if [ -x "$BUILD/ffuc" ] && selected "ffuc."; then
+    "$BUILD/httpd" "$PORT" &
+    srv=$!
+    sleep 0.2
+    seq "$FFUC_WORDS" > "$BUILD/words"
+    # requests/sec, new connections and keep-alive (-k)
+    for mode in loopback keepalive; do
+      selected "ffuc.$mode" || continue
+      [ $mode = keepalive ] && opt=-k || opt=
+      t0=$(now_ns)
+      ok=$("$BUILD/ffuc" $opt -u "http://127.0.0.1:$PORT/FUZZ" \
+                              -w "$BUILD/words" 2>/dev/null | grep -c 'Status: 200')
+      t1=$(now_ns)
+      [ "$ok" -eq "$FFUC_WORDS" ] || {
+        note "ffuc.$mode: $ok of $FFUC_WORDS requests succeeded"
+        rc=1
+      }
+      awk -v n="ffuc.$mode" -v r="$FFUC_WORDS" -v t="$((t1 - t0))" 'BEGIN {
+        printf "%s\t%d\t%.2f\t0\t-\t0.0\n", n, r, t / r
+      }'
+    done
+    kill "$srv" 2>/dev/null
+  fi
+  return $rc
+}
+
+# ns/op of two results side by side, new/old ratio
+# and a mark on more than 5% slower benchmarks (exit status 1)
+compare ()
+{
+  awk -F '\t' '
+    /^#/ { next }
+    FNR == NR { old[$1] = $3; next }
+    {
+      if (!($1 in old)) { printf "%-20s %12s %12.2f\n", $1, "-", $3; next }
+      r = old[$1] > 0 ? $3 / old[$1] : 0
+      mark = (r > 1.05) ? "  (slower)" : ((r < 0.95) ? "  (faster)" : "")
+      if (r > 1.05) slower = 1
+      printf "%-20s %12.2f %12.2f %8.3f%s\n", $1, old[$1], $3, r, mark
+    }
+    BEGIN { printf "%-20s %12s %12s %8s\n", "# name", "old ns/op",
+            "new ns/op", "ratio" }
+    END { exit slower }
+  ' "$1" "$2"
+}
+
+case ${1:-run} in
+  compare)
+    [ $# -eq 3 ] || { echo "usage: $0 compare OLD.tsv NEW.tsv" >&2; exit 1; }
+    compare "$2" "$3"
+    ;;
+  run)
+    [ $# -gt 0 ] && shift
+    run "$@"
+    ;;
+  *)
+    run "$@"
+    ;;
+esac
@@ -0,0 +1,135 @@
+/* This file is part of my-small-c-projects <https://gitlab.com/SI.AMO/>
+
+  This program is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/** file: httpd.c
+    created on: 15 Oct 2026
+
+    Loopback HTTP server of the ffuc benchmark (see bench.sh)
+    Answers every request with a fixed `200 OK`, keep-alive,
+    single-threaded (poll), so the client is the bottleneck
+    Requests must not have a body (GET / HEAD)
+
+    Usage:
+      httpd PORT
+
+    Compilation:
+      cc -O2 -Wall -Wextra -o httpd httpd.c
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define MAX_CONN 1024
+
+static const char response[] =
+  "HTTP/1.1 200 OK\r\n"
+  "Content-Type: text/plain\r\n"
+  "Content-Length: 3\r\n"
+  "\r\n"
+  "ok\n";
+
+static struct pollfd fds[MAX_CONN + 1];
+/* matched length of "\r\n\r\n", per connection */
+static int state[MAX_CONN + 1];
+
+/* returns the number of complete requests in @buf */
+static int
+requests (const char *buf, ssize_t n, int *st)
+{
+  int count = 0;
+  for (ssize_t i = 0; i < n; ++i)
+    {
+      char c = buf[i];
+      if (c == ((*st % 2) ? '\n' : '\r'))
+        ++*st;
+      else
+        *st = (c == '\r');
+      if (*st == 4)
+        {
+          ++count;
+          *st = 0;
+        }
+    }
+  return count;
+}
+
+int
+main (int argc, char **argv)
+{
+  if (argc < 2)
+    {
+      fprintf (stderr, "usage: %s PORT\n", *argv);
+      return 1;
+    }
+  signal (SIGPIPE, SIG_IGN);
+
+  int srv = socket (AF_INET, SOCK_STREAM, 0), one = 1;
+  struct sockaddr_in addr = {
+    .sin_family = AF_INET,
+    .sin_port = htons (atoi (argv[1])),
+    .sin_addr.s_addr = htonl (INADDR_LOOPBACK),
+  };
+  setsockopt (srv, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one));
+  if (bind (srv, (struct sockaddr *) &addr, sizeof (addr)) < 0
+      || listen (srv, 512) < 0)
+    {
+      perror ("httpd");
+      return 1;
+    }
+
+  int n = 1;
+  fds[0] = (struct pollfd){.fd = srv, .events = POLLIN};
+  char buf[16384];
+  while (poll (fds, n, -1) >= 0)
+    {
+      if ((fds[0].revents & POLLIN) && n <= MAX_CONN)
+        {
+          int c = accept (srv, NULL, NULL);
+          if (c >= 0)
+            {
+              state[n] = 0;
+              fds[n++] = (struct pollfd){.fd = c, .events = POLLIN};
+            }
+        }
+      for (int i = 1; i < n; ++i)
+        {
+          if (!fds[i].revents)
+            continue;
+          ssize_t r = read (fds[i].fd, buf, sizeof (buf));
+          int dead = (r <= 0);
+          for (int k = dead ? 0 : requests (buf, r, &state[i]); k > 0; --k)
+            if (write (fds[i].fd, response, sizeof (response) - 1) < 0)
+              {
+                dead = 1;
+                break;
+              }
+          if (dead)
+            {
+              /* closed or failed, move the last one here */
+              close (fds[i].fd);
+              fds[i] = fds[--n];
+              state[i] = state[n];
+              --i;
+            }
+        }
+    }
+  return 0;
+}
@@ -50,6 +50,8 @@
  *       `-D CODEM_FUZZY_SEARCH_CITYNAME`:
  *          to enable fuzzy search, you need to provide
  *          the `leven.h` file (available in the same repository)
+ *       `-D CODEM_NO_SIMD`:
+ *          to not use the SSE2 kernel of codem_isvalid_batch
  *
  *     to include in c files:
  *       ```c
@@ -79,6 +81,12 @@
 #define codeM__H__
 #include <ctype.h>
 #include <string.h>
+#include <stdint.h>
+
+#if defined (__SSE2__) && !defined (CODEM_NO_SIMD)
+#  define CODEM_SSE2
+#  include <emmintrin.h>
+#endif
 
 /* city_name and city_code data */
 #include "codeM_data.h"
@@ -99,6 +107,17 @@ RandFunction codem_srand = NULL;
 /* macro to initialize codem_srand */
 #define codem_rand_init(randfun) codem_srand = &(randfun)
 
+/**
+ *  pseudo-random number generator of the batch functions
+ *  (splitmix64), it is not shared: each thread should
+ *  have its own state, any seed is fine
+ */
+typedef struct
+{
+  uint64_t s;
+} CodemRng;
+#define codem_rng_seed(rng, seed) ((rng)->s = (uint64_t)(seed))
+
 #ifndef CODEMDEF
 #  define CODEMDEF static inline
 #endif
@@ -265,6 +284,31 @@ CODEMDEF int codem_rands (char *codem, int len);
 /* write a valid random city code on @dest */
 CODEMDEF void codem_rand_ccode (char *dest);
 
+/* next random number of @rng */
+CODEMDEF uint64_t codem_rng_next (CodemRng *rng);
+
+/**
+ *  batch validation of @n normalized codems
+ *  the i'th codem is @buf[i*@stride : i*@stride + 10]
+ *  (@stride >= 10, e.g. 10 when they are packed, or 11 when
+ *  they are separated by a newline or a null-byte)
+ *  writes 1 on @res[i] when it's valid, otherwise 0
+ *  city codes are not checked (see codem_isvalidn)
+ *  @return:  number of valid codems
+ */
+CODEMDEF size_t
+codem_isvalid_batch (const char *buf, size_t n, size_t stride,
+                     unsigned char *res);
+
+/**
+ *  makes @n random valid codems on @buf, with the same layout
+ *  as codem_isvalid_batch, bytes between them are not touched
+ *  @ccode:  to also make valid city codes (like codem_rand2)
+ */
+CODEMDEF void
+codem_rand_batch (char *buf, size_t n, size_t stride, int ccode,
+                  CodemRng *rng);
+
 /**
  *  @return: the index of @codem[0:3] in city_code
  *  only use the `codem_cname_byidx` function
@@ -408,14 +452,17 @@ codem_rand_gen (char *res, int len)
     }
 }
 
-CODEMDEF void
-codem_rand_ccode (char *dest)
+/**
+ *  internal function
+ *  writes a valid city code on @dest (not null-terminated)
+ *  @r1, @r2:  two random numbers
+ */
+static inline void
+__codem_ccode (char *dest, size_t r1, size_t r2)
 {
 #ifndef CODEM_NO_CITY_DATA
   int code_count = CC_LEN;
-  int idx = city_rand_idx__H ();
-  size_t rand = codem_srand ();
-  const char *p = city_code[idx];
+  const char *p = city_code[r1 % CITY_COUNT];
   const char *q = p;
 
   /* make a random choice between code at idx */
@@ -425,18 +472,29 @@ codem_rand_ccode (char *dest)
       q += CC_LEN;
       code_count += CC_LEN;
       /* randomly break the loop -- code_count >= 6 */
-      if (0 == rand % code_count)
+      if (0 == r2 % code_count)
         break;
     }
-  strncpy (dest, p, CC_LEN);
+  memcpy (dest, p, CC_LEN);
 #else
-  size_t rand = codem_srand ();
+  UNUSED (r1);
   for (int idx = CC_LEN-1; idx >= 0; --idx)
     {
-      dest[idx] = (rand%10) + '0';
-      rand /= 10;
+      dest[idx] = (r2%10) + '0';
+      r2 /= 10;
     }
 #endif
+}
+
+CODEMDEF void
+codem_rand_ccode (char *dest)
+{
+#ifndef CODEM_NO_CITY_DATA
+  size_t r1 = codem_srand ();
+#else
+  size_t r1 = 0;
+#endif
+  __codem_ccode (dest, r1, codem_srand ());
   dest[CC_LEN] = '\0';
 }
 
@@ -557,6 +615,134 @@ codem_ccode_idx (const char *codem)
 #endif
 }
 
+CODEMDEF uint64_t
+codem_rng_next (CodemRng *rng)
+{
+  uint64_t z = (rng->s += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+#ifdef CODEM_SSE2
+/**
+ *  internal function
+ *  weighted digit sum (see ctrl_digit__H) of a codem at @p
+ *  as four 32-bit partial sums, loads 16 bytes
+ *  sets @*numeric to 1 when @p[0:10] is numeric
+ */
+static inline __m128i
+__codem_sum_sse2 (const char *p, int *numeric)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i nine = _mm_set1_epi8 (9);
+  __m128i d = _mm_sub_epi8 (_mm_loadu_si128 ((const __m128i *) p),
+                            _mm_set1_epi8 ('0'));
+  int m = _mm_movemask_epi8 (_mm_cmpeq_epi8 (_mm_max_epu8 (d, nine), nine));
+  *numeric = ((m & 0x3FF) == 0x3FF);
+
+  __m128i lo = _mm_madd_epi16 (_mm_unpacklo_epi8 (d, zero),
+                               _mm_setr_epi16 (10, 9, 8, 7, 6, 5, 4, 3));
+  __m128i hi = _mm_madd_epi16 (_mm_unpackhi_epi8 (d, zero),
+                               _mm_setr_epi16 (2, 0, 0, 0, 0, 0, 0, 0));
+  return _mm_add_epi32 (lo, hi);
+}
+
+/**
+ *  internal function
+ *  validates 4 codems at @p (each one of them loads 16 bytes)
+ *  sums are reduced and taken modulo 11 in parallel
+ */
+static inline int
+__codem_isvalid4_sse2 (const char *p, size_t stride, unsigned char *res)
+{
+  int num[4];
+  __m128i s0 = __codem_sum_sse2 (p, num);
+  __m128i s1 = __codem_sum_sse2 (p + stride, num + 1);
+  __m128i s2 = __codem_sum_sse2 (p + 2 * stride, num + 2);
+  __m128i s3 = __codem_sum_sse2 (p + 3 * stride, num + 3);
+
+  /* transpose and add, sum[i] is the sum of the i'th codem */
+  __m128i u0 = _mm_add_epi32 (_mm_unpacklo_epi32 (s0, s1),
+                              _mm_unpackhi_epi32 (s0, s1));
+  __m128i u1 = _mm_add_epi32 (_mm_unpacklo_epi32 (s2, s3),
+                              _mm_unpackhi_epi32 (s2, s3));
+  __m128i sum = _mm_add_epi32 (_mm_unpacklo_epi64 (u0, u1),
+                               _mm_unpackhi_epi64 (u0, u1));
+
+  /* sum <= 9*54, so: sum / 11 == (sum * 5958) >> 16 */
+  sum = _mm_packs_epi32 (sum, sum);
+  __m128i q = _mm_mulhi_epu16 (sum, _mm_set1_epi16 (5958));
+  __m128i r = _mm_sub_epi16 (sum, _mm_mullo_epi16 (q, _mm_set1_epi16 (11)));
+
+  int16_t rem[8];
+  _mm_storeu_si128 ((__m128i *) rem, r);
+  int count = 0;
+  for (int i = 0; i < 4; ++i)
+    {
+      int c = (rem[i] >= 2) ? 11 - rem[i] : rem[i];
+      res[i] = num[i] && char2num (p[i * stride + CTRL_DIGIT_IDX]) == c;
+      count += res[i];
+    }
+  return count;
+}
+#endif /* CODEM_SSE2 */
+
+CODEMDEF size_t
+codem_isvalid_batch (const char *buf, size_t n, size_t stride,
+                     unsigned char *res)
+{
+  size_t i = 0, count = 0;
+
+#ifdef CODEM_SSE2
+  /* the kernel reads 16 bytes of each codem, the tail is scalar */
+  if (n > 0 && stride >= CODEM_LEN)
+    {
+      size_t end = (n - 1) * stride + CODEM_LEN;
+      for (; i + 4 <= n && (i + 3) * stride + 16 <= end; i += 4)
+        count += __codem_isvalid4_sse2 (buf + i * stride, stride, res + i);
+    }
+#endif
+
+  for (; i < n; ++i)
+    {
+      res[i] = codem_isvalidn (buf + i * stride);
+      count += res[i];
+    }
+  return count;
+}
+
+CODEMDEF void
+codem_rand_batch (char *buf, size_t n, size_t stride, int ccode,
+                  CodemRng *rng)
+{
+  for (size_t i = 0; i < n; ++i, buf += stride)
+    {
+      int len = CODEM_LEN - 1;
+      char *p = buf;
+      uint64_t r = codem_rng_next (rng);
+
+      if (ccode)
+        {
+          uint64_t r2 = codem_rng_next (rng);
+          __codem_ccode (p, r2 & 0xFFFFFFFF, r2 >> 32);
+          p += CC_LEN;
+          len -= CC_LEN;
+        }
+      /* r % 10^9 is uniform enough, r is 64 bits */
+      r %= 1000000000;
+      while (0 != len--)
+        {
+          *(p++) = num2char (r % 10);
+          r /= 10;
+        }
+
+      int res;
+      ctrl_digit__H (res, buf);
+      buf[CTRL_DIGIT_IDX] = num2char (res);
+    }
+}
+
 /**
  *  internal functions
  *  `__cname_fuzzy_search` and `__cname_normal_search`
@@ -573,17 +759,20 @@ static inline int
 __cname_fuzzy_search (const char *search)
 {
   const char *p;
-  char *tmp = malloc (MAX_TMP);
+  char *tmp = malloc (MAX_TMP + 1);
   size_t n = SAFE_LEN(strlen (search));
-  size_t min_dist = -1; // size_t MAX value
+  /* distances more than this are not accepted */
+  size_t min_dist = leven_strlen (search) / 2 + 1;
   size_t min_dist_idx = CC_NOT_FOUND; // -1
 
-  for (size_t idx = 0; idx < CITY_COUNT; ++idx)
+  for (size_t idx = 0; idx < CITY_COUNT && 0 != min_dist; ++idx)
     {
       p = city_name[idx];
       strncpy (tmp, p, n);
+      tmp[n] = '\0';
 
-      size_t LD = leven_imm (tmp, search);
+      /* only distances less than the current best matter */
+      size_t LD = leven_within (tmp, search, min_dist - 1);
       if (LD < min_dist)
         {
           min_dist = LD;
@@ -592,8 +781,6 @@ __cname_fuzzy_search (const char *search)
     }
 
   free (tmp);
-  if (min_dist > leven_strlen (search) / 2)
-    return CC_NOT_FOUND;
   return min_dist_idx;
 }
 #  else /* ! CODEM_FUZZY_SEARCH_CITYNAME */
@@ -785,6 +972,76 @@ test_2_3 ()
   assert (codem_isvalid2 (code));
 }
 
+/**
+ *    Test Type 3
+ *
+ *    tests:  codem_isvalid_batch,
+ *            codem_rand_batch
+ **/
+#define BATCH_N 1003
+
+static void
+test_3_1 ()
+{
+  /* packed codems, and separated by newline */
+  static char buf[BATCH_N * (CODEM_LEN + 1)];
+  static unsigned char res[BATCH_N];
+  CodemRng rng;
+  codem_rng_seed (&rng, 42);
+
+  for (size_t stride = CODEM_LEN; stride <= CODEM_LEN + 1; ++stride)
+    {
+      memset (buf, '\n', sizeof (buf));
+      codem_rand_batch (buf, BATCH_N, stride, 0, &rng);
+      if (stride > CODEM_LEN)
+        assert (buf[CODEM_LEN] == '\n');
+
+      /* all of them must be valid */
+      assert (BATCH_N == codem_isvalid_batch (buf, BATCH_N, stride, res));
+
+      /* make some of them invalid, compare with codem_isvalidn */
+      for (size_t i = 0; i < BATCH_N; i += 3)
+        {
+          char *p = buf + i * stride;
+          if (i % 2)
+            p[i % CODEM_LEN] = (i % 4 == 1) ? 'x' : '0' + ('9' - p[i % CODEM_LEN]);
+          else
+            p[CTRL_DIGIT_IDX] = num2char ((char2num (p[CTRL_DIGIT_IDX]) + 1) % 10);
+        }
+      size_t count = codem_isvalid_batch (buf, BATCH_N, stride, res);
+      size_t exp = 0;
+      for (size_t i = 0; i < BATCH_N; ++i)
+        {
+          char tmp[CODEM_BUF_LEN] = {0};
+          memcpy (tmp, buf + i * stride, CODEM_LEN);
+          assert (res[i] == codem_isvalidn (tmp));
+          exp += res[i];
+        }
+      assert (count == exp);
+      assert (count < BATCH_N);
+      DEBUG ("stride %zu: %zu of %d are valid\n", stride, count, BATCH_N);
+    }
+}
+
+static void
+test_3_2 ()
+{
+  static char buf[BATCH_N * CODEM_LEN];
+  static unsigned char res[BATCH_N];
+  CodemRng rng;
+  codem_rng_seed (&rng, 0);
+
+  /* valid city codes */
+  codem_rand_batch (buf, BATCH_N, CODEM_LEN, 1, &rng);
+  assert (BATCH_N == codem_isvalid_batch (buf, BATCH_N, CODEM_LEN, res));
+  for (size_t i = 0; i < BATCH_N; ++i)
+    assert (codem_ccode_idx (buf + i * CODEM_LEN) != CC_NOT_FOUND);
+
+  /* all digits must appear */
+  for (char c = '0'; c <= '9'; ++c)
+    assert (memchr (buf, c, sizeof (buf)));
+}
+
 /* pseudo random number generator function */
 /* which always returns const 4242424242UL */
 static inline size_t 
@@ -808,6 +1065,11 @@ main (void)
   FUN_TEST (test_2_1, "random code generator\n");
   FUN_TEST (test_2_2, "random code with prefix\n");
   FUN_TEST (test_2_3, "random code with city code\n");
+
+  /**   test type 3  **/
+  puts ("\n/* Running test type 3 *******************/");
+  FUN_TEST (test_3_1, "batch validation\n");
+  FUN_TEST (test_3_2, "batch generation with city code\n");
   
   return 0;
 }
@@ -124,6 +124,8 @@ PyDECLARE (py_cname_by_code);
 PyDECLARE (py_ccode_by_cname);
 PyDECLARE (py_search_cname);
 PyDECLARE (py_set_srand);
+PyDECLARE (py_validate_batch);
+PyDECLARE (py_rand_batch);
 
 static struct PyMethodDef funs[] = {
   {
@@ -186,6 +188,22 @@ static struct PyMethodDef funs[] = {
     "set the random number generator function\n"
     "pass it None to use the default function\n"
     "expected signature:  def rand()->int: ..."
+  },{
+    "validate_batch", py_validate_batch,
+    METH_VARARGS,
+    "validate_batch(buffer, stride=10)\n"
+    "validate 10-digit codems of a bytes-like object\n"
+    "the i'th codem is buffer[i*stride : i*stride+10]\n"
+    "returns bytes, 1 for valid and 0 for invalid codems\n"
+    "this wont check the city codes"
+  },{
+    "rand_batch", py_rand_batch,
+    METH_VARARGS,
+    "rand_batch(n, ccode=True, stride=10)\n"
+    "make n random valid codems, as a bytes object of\n"
+    "length n*stride, extra bytes are newline\n"
+    "ccode: to make valid city codes too\n"
+    "it does not use the set_srand function"
   },
   {NULL, NULL, 0, NULL}
 };
@@ -564,6 +582,94 @@ py_set_srand (PyObject *self, PyObject *arg)
     }
 }
 
+/**
+ *  random number generator of the batch functions
+ *  each thread has its own state, seeded on the first use
+ */
+static __thread CodemRng batch_rng;
+static __thread int batch_rng_init = 0;
+
+static inline CodemRng *
+get_batch_rng ()
+{
+  if (!batch_rng_init)
+    {
+      codem_rng_seed (&batch_rng, time (NULL) ^ (size_t)&batch_rng
+                      ^ ((uint64_t)clock () << 32));
+      batch_rng_init = 1;
+    }
+  return &batch_rng;
+}
+
+/**
+ *  @return:
+ *    on error   -> None
+ *    otherwise  -> bytes object
+ **/
+PYCODEMDEF
+py_validate_batch (PyObject *self, PyObject *args)
+{
+  UNUSED (self);
+
+  Py_buffer buf;
+  Py_ssize_t stride = CODEM_LEN, n = 0;
+  PyObject *result;
+
+  if (!PyArg_ParseTuple (args, "y*|n", &buf, &stride))
+    Py_RETURN_NONE;
+  if (stride < CODEM_LEN)
+    {
+      PyBuffer_Release (&buf);
+      Py_RETURN_NONE;
+    }
+
+  /* the last codem might not have the extra bytes */
+  if (buf.len >= CODEM_LEN)
+    n = (buf.len - CODEM_LEN) / stride + 1;
+  if (!(result = PyBytes_FromStringAndSize (NULL, n)))
+    {
+      PyBuffer_Release (&buf);
+      return NULL;
+    }
+
+  unsigned char *res = (unsigned char *) PyBytes_AS_STRING (result);
+  Py_BEGIN_ALLOW_THREADS
+  codem_isvalid_batch (buf.buf, n, stride, res);
+  Py_END_ALLOW_THREADS
+
+  PyBuffer_Release (&buf);
+  return result;
+}
+
+// @return:  same as py_validate_batch
+PYCODEMDEF
+py_rand_batch (PyObject *self, PyObject *args)
+{
+  UNUSED (self);
+
+  Py_ssize_t n, stride = CODEM_LEN;
+  int ccode = 1;
+  PyObject *result;
+
+  if (!PyArg_ParseTuple (args, "n|pn", &n, &ccode, &stride))
+    Py_RETURN_NONE;
+  if (n < 0 || stride < CODEM_LEN || n > PY_SSIZE_T_MAX / stride)
+    Py_RETURN_NONE;
+
+  if (!(result = PyBytes_FromStringAndSize (NULL, n * stride)))
+    return NULL;
+
+  char *buf = PyBytes_AS_STRING (result);
+  CodemRng *rng = get_batch_rng ();
+  Py_BEGIN_ALLOW_THREADS
+  if (stride > CODEM_LEN)
+    memset (buf, '\n', n * stride);
+  codem_rand_batch (buf, n, stride, ccode, rng);
+  Py_END_ALLOW_THREADS
+
+  return result;
+}
+
 /**
  *  @return:
  *    on error    -> max size_t value
@@ -9,6 +9,8 @@
       -d, --decode       to decode
       -l, --line         to read line by line, and
                          possess each line separately
+      -w, --wrap COLS    wrap encoded lines after COLS
+                         characters (default 0: no wrapping)
           --version      print the version
   
     Compilation:
@@ -16,6 +18,7 @@
          -I../libs -o base64 base64.c
  **/
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 
@@ -40,6 +43,7 @@ enum IO_Mode
 
 static enum Mode mode = ENCODE_MODE;
 static enum IO_Mode ioMode = CIN_COUT;
+static int wrap = 0;
 
 FILE *inf, *outf;
 
@@ -68,6 +72,8 @@ main (int argc, char **argv)
                 mode = DECODE_MODE;
               else if (OPTCMP (*argv, "--line"))
                 ioMode = LIN_LOUT;
+              else if (OPTCMP (*argv, "--wrap"))
+                goto WRAP_OPT;
               else if (OPTCMP (*argv, "--version"))
                 goto VERSION_OPT;
               else
@@ -80,6 +86,16 @@ main (int argc, char **argv)
             case 'l':
               ioMode = LIN_LOUT;
               break;
+            case 'w':
+            WRAP_OPT:
+              if (argc < 2)
+                {
+                  warnln ("option '%s' requires an argument", *argv);
+                  break;
+                }
+              --argc, ++argv;
+              wrap = atoi (*argv);
+              break;
 
             case 'v':
             VERSION_OPT:
@@ -118,8 +134,10 @@ main (int argc, char **argv)
       case ENCODE_MODE:
         if (CIN_COUT == ioMode)
           {
-            b64_stream_encode (fileno (inf), fileno (outf), &err);
-            fprintf (outf, "\n");
+            b64_stream_encode_wrap (fileno (inf), fileno (outf),
+                                    wrap, &err);
+            if (wrap <= 0)
+              fprintf (outf, "\n");
           }
         if (LIN_LOUT == ioMode)
           {
@@ -174,6 +192,10 @@ main (int argc, char **argv)
         warnln ("invalid input");
         break;
 
+      case EIO_B64:
+        warnln ("read/write error: %s", strerror (errno));
+        break;
+
       case EOBUFFER_B64:
       default:
         warnln ("internal error");
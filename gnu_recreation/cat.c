@@ -1,11 +1,62 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h> 
 #include <fcntl.h>
+#include <errno.h>
 #include <sys/stat.h>
 
 #define BS 128*1024
 
+/* requested pipe size, for the splice path */
+#ifndef PIPE_SZ
+#define PIPE_SZ (1024 * 1024)
+#endif
+
+#if !defined (CAT_NO_SPLICE) && !defined (__linux__)
+#define CAT_NO_SPLICE
+#endif
+
+#ifndef CAT_NO_SPLICE
+/**
+ *  regular file -> pipe copy by splice(2), pages are moved
+ *  from the page cache into the pipe, no user space copy
+ *  returns -1 if splice is not applicable (nothing written)
+ */
+static int
+cat_splice (int fd, const struct stat *st)
+{
+    struct stat ost;
+
+    if (!S_ISREG (st->st_mode) ||
+        fstat (1, &ost) || !S_ISFIFO (ost.st_mode))
+        return -1;
+
+    /* best effort */
+    fcntl (1, F_SETPIPE_SZ, PIPE_SZ);
+    int psz = fcntl (1, F_GETPIPE_SZ);
+    if (psz <= 0)
+        psz = 64 * 1024;
+
+    ssize_t s;
+    size_t total = 0;
+    while ((s = splice (fd, NULL, 1, NULL, psz, SPLICE_F_MOVE)) != 0)
+    {
+        if (s < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            /* fallback is only possible before the first write */
+            return total ? 1 : -1;
+        }
+        total += s;
+    }
+    return 0;
+}
+#endif
+
 int
 main (int argc, char **argv)
 {
@@ -32,6 +83,17 @@ main (int argc, char **argv)
 #endif
     fd = open (argv[1], 0);
 
+#ifndef CAT_NO_SPLICE
+    int ret = cat_splice (fd, &st);
+    if (ret != -1)
+    {
+        free (buf);
+        return ret;
+    }
+#endif
+
+    if (block_size > BS)
+        block_size = BS;
     while ((r = read (fd, buf, block_size)) != 0)
         write (1, buf, r);
 
@@ -13,20 +13,42 @@
     Compilation:
       cc -ggdb -O3 -Wall -Wextra -Werror \
          -I../libs -o tee tee.c
+
+    Options:
+      `-D_TEE_NO_SPLICE`:
+        always use the read/write loop, by default
+        when stdin is a pipe, data is duplicated by
+        tee(2) and moved into outputs by splice(2)
+        without copying through user space
+      `-D_PIPE_SZ=n`:
+        pipe buffer size to request (F_SETPIPE_SZ)
  **/
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #define CLI_IMPLEMENTATION
 #include "clistd.h"
 
 /* max buffer length */
 #ifndef _BMAX
-# define _BMAX (sysconf (_SC_PAGESIZE) / 4) // 1kb
+# define _BMAX ((size_t)128 * 1024) // 128kb
+#endif
+
+/* requested pipe size, for the splice path */
+#ifndef _PIPE_SZ
+# define _PIPE_SZ (1024 * 1024) // 1mb
+#endif
+
+#if !defined (_TEE_NO_SPLICE) && !defined (__linux__)
+# define _TEE_NO_SPLICE
 #endif
 
 /* dynamic array for filepaths */
@@ -38,6 +60,7 @@
 #define OPT_ERR 1
 #define FOPEN_ERR 2
 #define MEM_ERR 3
+#define WRITE_ERR 4
 
 static int out_flags = O_CREAT|O_WRONLY;
 static mode_t out_mode = 0644;
@@ -72,6 +95,160 @@ out_open (const char *out_pathname)
   return 0;
 }
 
+/* write all of @buf, retries on short writes */
+static int
+write_all (int fd, const char *buf, size_t len)
+{
+  while (len > 0)
+    {
+      ssize_t w = write (fd, buf, len);
+      if (w < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          return -1;
+        }
+      buf += w;
+      len -= w;
+    }
+  return 0;
+}
+
+#ifndef _TEE_NO_SPLICE
+/**
+ *  the splice path, only when stdin is a pipe
+ *
+ *  each round, tee(2) duplicates the available input
+ *  (without consuming it) into an intermediate pipe,
+ *  which is then spliced into one output; the last
+ *  output is spliced directly from stdin, this also
+ *  consumes the round from the input
+ *  outputs that do not support splice (tty, O_APPEND
+ *  files, ...) fall back to read/write through @buffer
+ *
+ *  returns -1 when the splice path is not applicable
+ *  (nothing has been consumed), otherwise 0 or WRITE_ERR
+ */
+static int
+tee_splice (int *fds, size_t n, char *buffer)
+{
+  struct stat st;
+  if (fstat (in_fd, &st) < 0 || !S_ISFIFO (st.st_mode))
+    return -1;
+
+  int p[2];
+  if (pipe (p) < 0)
+    return -1;
+  /* best effort, keep the default sizes on failure */
+  fcntl (in_fd, F_SETPIPE_SZ, _PIPE_SZ);
+  int psz = fcntl (in_fd, F_GETPIPE_SZ);
+  if (psz <= 0 || fcntl (p[1], F_SETPIPE_SZ, psz) < psz)
+    {
+      /* tee(2) must fit a whole round into @p */
+      close (p[0]);
+      close (p[1]);
+      return -1;
+    }
+
+  /* outputs that failed to splice, see out_splice */
+  char *nosplice = calloc (n, 1);
+  if (!nosplice)
+    {
+      close (p[0]);
+      close (p[1]);
+      return -1;
+    }
+
+  int ret = 0;
+  /**
+   *  move exactly @len bytes from @src (pipe) to
+   *  output @i, by splice or by read/write
+   */
+#define out_splice(src, i, len) do {                    \
+    size_t __rem = (len);                               \
+    while (__rem > 0 && !nosplice[i])                   \
+      {                                                 \
+        ssize_t __s = splice (src, NULL, fds[i], NULL,  \
+                              __rem, SPLICE_F_MOVE);    \
+        if (__s > 0)                                    \
+          __rem -= __s;                                 \
+        else if (__s < 0 && errno == EINTR)             \
+          continue;                                     \
+        else if (__s < 0 && errno == EINVAL)            \
+          nosplice[i] = 1;                              \
+        else                                            \
+          goto Write_Error;                             \
+      }                                                 \
+    while (__rem > 0)                                   \
+      {                                                 \
+        size_t __n = __rem < _BMAX ? __rem : _BMAX;     \
+        ssize_t __r = read (src, buffer, __n);          \
+        if (__r < 0 && errno == EINTR)                  \
+          continue;                                     \
+        if (__r <= 0 || write_all (fds[i], buffer, __r)) \
+          goto Write_Error;                             \
+        __rem -= __r;                                   \
+      }                                                 \
+  } while (0)
+
+  while (1)
+    {
+      ssize_t len = 0;
+      /* duplicate the next round into @p for all but the last */
+      for (size_t i = 0; i + 1 < n; ++i)
+        {
+          ssize_t t;
+          do
+            t = tee (in_fd, p[1], i ? (size_t)len : (size_t)psz, 0);
+          while (t < 0 && errno == EINTR);
+          if (t <= 0 || (i && t != len))
+            {
+              if (t == 0 && i == 0)
+                goto End; // EOF
+              goto Write_Error;
+            }
+          len = t;
+          out_splice (p[0], i, len);
+        }
+      if (n == 1)
+        {
+          /* no duplication needed */
+          do
+            len = splice (in_fd, NULL, fds[0], NULL, psz, SPLICE_F_MOVE);
+          while (len < 0 && errno == EINTR);
+          if (len == 0)
+            goto End;
+          if (len < 0 && errno == EINVAL)
+            {
+              /* not applicable, nothing consumed */
+              ret = -1;
+              goto End;
+            }
+          if (len < 0)
+            goto Write_Error;
+        }
+      else
+        {
+          /* consume the round from the input */
+          out_splice (in_fd, n - 1, len);
+        }
+#ifdef _DEBUG
+      debugf ("spliced %ld bytes to %lu outputs\n", len, n);
+#endif
+    }
+
+ Write_Error:
+  warnln ("write error -- %s", strerror (errno));
+  ret = WRITE_ERR;
+ End:
+#undef out_splice
+  free (nosplice);
+  close (p[0]);
+  close (p[1]);
+  return ret;
+}
+#endif /* _TEE_NO_SPLICE */
+
 int
 parse_args (int argc, char **argv)
 {
@@ -138,7 +315,9 @@ int
 main (int argc, char **argv)
 {
   set_program_name (*argv);
-  out_fds = da_new (int);
+  /* usually a few files, heap allocation only if needed */
+  da_buf_t (int, 16) out_fds_buf;
+  out_fds = da_newbuf (int, out_fds_buf);
   /* parse options and open output files */
   int ret;
   if ((ret = parse_args (argc, argv)) != 0)
@@ -163,11 +342,33 @@ main (int argc, char **argv)
     }
 #endif
 
+#ifdef _DEBUG
+  size_t sys_count = 0; // syscall counter
+  size_t total_read = 0;
+#endif
+
+#ifndef _TEE_NO_SPLICE
+  {
+    /* standard output followed by the output files */
+    int *fds = malloc ((out_count + 1) * sizeof (int));
+    if (!fds)
+      {
+        free (buffer);
+        return MEM_ERR;
+      }
+    fds[0] = STDOUT_FILENO;
+    memcpy (fds + 1, out_fds, out_count * sizeof (int));
+    ret = tee_splice (fds, out_count + 1, buffer);
+    free (fds);
+    if (ret != -1)
+      goto End_of_Main;
+    ret = 0;
+  }
+#endif
+
 #ifndef _DEBUG
   while (1)
 #else
-  size_t sys_count = 0; // syscall counter
-  size_t total_read = 0;
   while (++sys_count)
 #endif
     {
@@ -180,7 +381,12 @@ main (int argc, char **argv)
       else if (_r > 0)
         {
           /* write to standard output */
-          write (STDOUT_FILENO, buffer, _r);
+          if (write_all (STDOUT_FILENO, buffer, _r))
+            {
+              warnln ("write error -- %s", strerror (errno));
+              ret = WRITE_ERR;
+              goto End_of_Main;
+            }
 
 #ifdef _DEBUG
           debugf ("write syscall, %ld bytes\n", _r);
@@ -191,10 +397,10 @@ main (int argc, char **argv)
           for (size_t i=0; i < out_count; ++i)
             {
               fd = out_fds[i];
-              ssize_t _w = write (fd, buffer, _r);
-              if (_w < 0 || _w != _r)
+              if (write_all (fd, buffer, _r))
                 {
                   warnln ("write error -- %s", strerror (errno));
+                  ret = WRITE_ERR;
                   goto End_of_Main;
                 }
             }
@@ -212,5 +418,5 @@ main (int argc, char **argv)
           ,total_read, sys_count, sys_count*out_count);
 #endif
 
-  return 0;
+  return ret;
 }
@@ -5,7 +5,11 @@
     Translate or delete characters
   
     Usage:
-      ./tr char1 char2 ...
+      ./tr [-s] char1 char2 ...
+  
+      Options:
+        -s    squeeze repeated characters of the result,
+              only characters that are mapped to (char2, ...)
   
       Example:
         # to map a to b  and  A to B
@@ -18,6 +22,9 @@
         ./tr '\x42' 'C'
         ./tr '\x42' '\x43'
   
+        # to map tabs to space and squeeze spaces
+        ./tr -s '\t' ' ' ' ' ' '
+  
       Interpreted sequences:
         \a, \b, \t, \n, \v, \f, \r
                 see ASCII table for more details
@@ -32,8 +39,23 @@
            -o tr tr_ng.c
       or remove `-D_USE_BIO` to compile without buffered_io
   
+      the input is processed in blocks of `_TR_BLOCK` bytes
+      (default 128KiB), on x86 SSSE3 kernels are used when
+      the CPU supports them, define `_TR_NO_SIMD` to disable them
  **/
 #include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+#ifndef _TR_BLOCK
+#  define _TR_BLOCK (128 * 1024)
+#endif
+
+#if !defined (_TR_NO_SIMD) && defined (__GNUC__) && defined (__SSE2__)
+#  define TR_SIMD
+#  include <immintrin.h>
+#  define TR_SSSE3 __attribute__ ((target ("ssse3")))
+#endif
 
 /**
  *  using buffered_io.h for better performance
@@ -101,12 +123,24 @@ norm_scape (const char *str)
   return 0;
 }
 
+/* option -s */
+static int squeeze = 0;
+/* characters that are mapped to (char2, ...) */
+static unsigned char targets[CHAR_S];
+
 int
 parse_param (int argc, char **argv)
 {
 #define __next(n) argc -= n, argv += n
 
-  for (__next(1); argc > 0; __next(2))
+  __next (1);
+  if (argc > 0 && 0 == strcmp (argv[0], "-s"))
+    {
+      squeeze = 1;
+      __next (1);
+    }
+
+  for (; argc > 0; __next(2))
     {
       if (argc <= 1)
         break;
@@ -117,10 +151,206 @@ parse_param (int argc, char **argv)
       if (from < 0x7F)
         {
           ASCII_table[from] = to;
+          targets[(unsigned char) to] = 1;
+        }
+    }
+  return 0;
+}
+
+/**
+ *  tables made from ASCII_table by tr_init
+ *  map:   the result of each byte
+ *  del:   bytes to be deleted (mapped to 0)
+ *  sq:    bytes to be squeezed (results of the mapping)
+ *  touch: bytes that may change the output (map | del | sq)
+ */
+static unsigned char map[CHAR_S], del[CHAR_S], sq[CHAR_S], touch[CHAR_S];
+
+/* no deletes and no squeeze, only map */
+static int map_only = 0;
+
+/* pairs of the small set translation (see tr_small) */
+#define TR_SMALL 8
+static int small_n = -1;
+static unsigned char small_from[TR_SMALL], small_to[TR_SMALL];
+
+void
+tr_init (void)
+{
+  int changed = 0;
+  for (int c = 0; c < CHAR_S; ++c)
+    {
+      map[c] = (c > 0x7F) ? c : (unsigned char) ASCII_table[c];
+      del[c] = (c != 0 && map[c] == 0);
+      if (map[c] != c || del[c])
+        {
+          touch[c] = 1;
+          if (!del[c] && changed < TR_SMALL)
+            {
+              small_from[changed] = c;
+              small_to[changed] = map[c];
+            }
+          changed += !del[c];
+        }
+    }
+  for (int c = 1; c < CHAR_S && squeeze; ++c)
+    sq[c] = targets[c];
+  for (int c = 0; c < CHAR_S; ++c)
+    touch[c] |= sq[c];
+
+  /* only translation, of a few characters */
+  int deletes = 0;
+  for (int c = 0; c < CHAR_S; ++c)
+    deletes += del[c];
+  map_only = (!squeeze && !deletes);
+  if (map_only && changed <= TR_SMALL)
+    small_n = changed;
+}
+
+/**
+ *  scalar translate, delete and squeeze of @in[.@n]
+ *  writes on @out (it can be the same as @in)
+ *  @last: the last byte of the output, -1 at the beginning
+ *  returns the end of @out
+ */
+static inline unsigned char *
+tr_scalar (const unsigned char *in, size_t n, unsigned char *out, int *last)
+{
+  int l = *last;
+  if (map_only)
+    {
+      for (size_t i = 0; i < n; ++i)
+        out[i] = map[in[i]];
+      return out + n;
+    }
+  for (const unsigned char *end = in + n; in < end; ++in)
+    {
+      unsigned char c = map[*in];
+      if (del[*in] || (c == l && sq[c]))
+        continue;
+      *(out++) = c;
+      l = c;
+    }
+  *last = l;
+  return out;
+}
+
+#ifdef TR_SIMD
+/**
+ *  small set translation, no deletes and squeeze
+ *  each 16 bytes are compared against each pair
+ */
+static inline size_t
+tr_small (unsigned char *buf, size_t n)
+{
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16)
+    {
+      __m128i v = _mm_loadu_si128 ((__m128i *)(buf + i));
+      for (int k = 0; k < small_n; ++k)
+        {
+          __m128i m = _mm_cmpeq_epi8 (v, _mm_set1_epi8 (small_from[k]));
+          v = _mm_or_si128 (_mm_andnot_si128 (m, v),
+                            _mm_and_si128 (m, _mm_set1_epi8 (small_to[k])));
+        }
+      _mm_storeu_si128 ((__m128i *)(buf + i), v);
+    }
+  return i;
+}
+
+/**
+ *  bitset of the touch table for the nibble lookup,
+ *  lut[hi >> 3][lo] has bit (hi & 7), when byte (hi << 4 | lo)
+ *  is touched; bytes above 0x7F are only touched by squeeze
+ */
+static unsigned char touch_lut[2][16];
+
+/**
+ *  translate, delete and squeeze via the nibble lookup
+ *  16-byte blocks without any touched byte are copied
+ *  as they are, the others go to tr_scalar
+ */
+TR_SSSE3 static unsigned char *
+tr_ssse3 (const unsigned char *in, size_t n, unsigned char *out, int *last)
+{
+  const __m128i lut0 = _mm_loadu_si128 ((const __m128i *) touch_lut[0]);
+  const __m128i lut1 = _mm_loadu_si128 ((const __m128i *) touch_lut[1]);
+  const __m128i bits0 = _mm_setr_epi8 (1, 2, 4, 8, 16, 32, 64, -128,
+                                       0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i bits1 = _mm_setr_epi8 (0, 0, 0, 0, 0, 0, 0, 0,
+                                       1, 2, 4, 8, 16, 32, 64, -128);
+  const __m128i m0f = _mm_set1_epi8 (0x0F);
+  const unsigned char *end = in + n;
+
+  for (; in + 16 <= end; in += 16)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) in);
+      __m128i lo = _mm_and_si128 (v, m0f);
+      __m128i hi = _mm_and_si128 (_mm_srli_epi16 (v, 4), m0f);
+      __m128i t0 = _mm_and_si128 (_mm_shuffle_epi8 (lut0, lo),
+                                  _mm_shuffle_epi8 (bits0, hi));
+      __m128i t1 = _mm_and_si128 (_mm_shuffle_epi8 (lut1, lo),
+                                  _mm_shuffle_epi8 (bits1, hi));
+      __m128i t = _mm_or_si128 (t0, t1);
+      if (_mm_movemask_epi8 (_mm_cmpeq_epi8 (t, _mm_setzero_si128 ()))
+          == 0xFFFF)
+        {
+          _mm_storeu_si128 ((__m128i *) out, v);
+          out += 16;
+          *last = in[15];
+        }
+      else
+        out = tr_scalar (in, 16, out, last);
+    }
+  return tr_scalar (in, end - in, out, last);
+}
+#endif /* TR_SIMD */
+
+/* returns length of the result, written on @buf */
+static size_t
+tr_block (unsigned char *buf, size_t n, int *last)
+{
+#ifdef TR_SIMD
+  static int ssse3 = -1;
+  if (ssse3 < 0)
+    {
+      __builtin_cpu_init ();
+      ssse3 = __builtin_cpu_supports ("ssse3");
+      for (int c = 0; c < CHAR_S; ++c)
+        if (touch[c])
+          touch_lut[c >> 7][c & 0x0F] |= 1 << ((c >> 4) & 7);
+    }
+
+  if (small_n >= 0)
+    {
+      size_t i = tr_small (buf, n);
+      return i + (tr_scalar (buf + i, n - i, buf + i, last) - (buf + i));
+    }
+  if (ssse3)
+    return tr_ssse3 (buf, n, buf, last) - buf;
+#endif
+  return tr_scalar (buf, n, buf, last) - buf;
+}
+
+#ifndef _USE_BIO
+static int
+write_all (int fd, const unsigned char *p, size_t n)
+{
+  while (n > 0)
+    {
+      ssize_t w = write (fd, p, n);
+      if (w < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          return -1;
         }
+      p += w;
+      n -= w;
     }
   return 0;
 }
+#endif /* _USE_BIO */
 
 int
 main (int argc, char **argv)
@@ -128,38 +358,39 @@ main (int argc, char **argv)
 #ifdef _USE_BIO
   int cap = _BMAX;
   BIO_t bio = bio_new (cap, malloc (cap), 1);
-#  define putc_H(c) bio_putc (&bio, c)
+#  define write_H(p, n) bio_put (&bio, (const char *)(p), n)
 #else
-#  define putc_H(c) write (1, &c, 1)
+#  define write_H(p, n) write_all (1, p, n)
 #endif
 
-#define tr_putc(c) if (c > 0x7F) {              \
-    putc_H (c);                                 \
-  } else {                                      \
-    char to_write = ASCII_table[c];             \
-    if (c != 0 && to_write == 0) continue;      \
-    putc_H (to_write);                          \
-  }
+  static unsigned char buf[_TR_BLOCK];
+  ssize_t r;
+  int last = -1, tty = isatty (0);
 
-  int c = 1;
   /* updates the ASCII_table */
   parse_param (argc, argv);
+  tr_init ();
 
-  if (!isatty (0))
-    {
-      while (read (0, &c, 1) > 0)
-        {
-          tr_putc (c);
-        }
-    }
-  else
+  while ((r = read (0, buf, _TR_BLOCK)) != 0)
     {
-      while (c != 0 && read (0, &c, 1) == 1)
+      if (r < 0)
         {
-          tr_putc (c);
+          if (errno == EINTR)
+            continue;
+          break;
         }
-    }
 
+      /* on terminal, the input ends with a null-byte */
+      unsigned char *nul = tty ? memchr (buf, 0, r) : NULL;
+      if (nul)
+        r = nul - buf + 1;
+
+      size_t n = tr_block (buf, r, &last);
+      if (write_H (buf, n) != 0)
+        break;
+      if (nul)
+        break;
+    }
 
 #ifdef _USE_BIO
   bio_flush (&bio);
@@ -347,6 +347,9 @@ OLIVECDEF void olivec_sprite_blend(Olivec_Canvas oc, int x, int y, int w, int h,
 OLIVECDEF void olivec_sprite_copy(Olivec_Canvas oc, int x, int y, int w, int h, Olivec_Canvas sprite);
 OLIVECDEF void olivec_sprite_copy_bilinear(Olivec_Canvas oc, int x, int y, int w, int h, Olivec_Canvas sprite);
 OLIVECDEF uint32_t olivec_pixel_bilinear(Olivec_Canvas sprite, int nx, int ny, int w, int h);
+// Span primitives of the inner loops, n pixels starting at p (SIMD when available)
+OLIVECDEF void olivec_span_fill(uint32_t *p, size_t n, uint32_t color);
+OLIVECDEF void olivec_span_blend(uint32_t *p, size_t n, uint32_t color);
 
 typedef struct {
     // Safe ranges to iterate over.
@@ -374,10 +377,91 @@ OLIVECDEF bool olivec_normalize_rect(int x, int y, int w, int h,
                                      size_t canvas_width, size_t canvas_height,
                                      Olivec_Normalized_Rect *nr);
 
+#ifdef OLIVEC_BATCH
+// Tile-binned rendering mode, define OLIVEC_BATCH and link with -lpthread.
+//
+// Draw commands are recorded between olivec_batch_begin() and olivec_batch_end(),
+// then binned into OLIVEC_TILE x OLIVEC_TILE tiles and rasterized tile by tile on
+// a pool of threads. Every tile replays its commands in the recorded order with the
+// regular olivec_* functions on a subcanvas of the tile, so the result is exactly
+// the same as drawing the commands directly on the canvas.
+//
+// Olivec_Batch b;
+// olivec_batch_init(&b, 4);
+// for (;;) {
+//     olivec_batch_begin(&b, oc);
+//     olivec_batch_fill(&b, BACKGROUND_COLOR);
+//     olivec_batch_circle(&b, x, y, r, color);
+//     olivec_batch_end(&b);
+// }
+// olivec_batch_free(&b);
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#ifndef OLIVEC_TILE
+#define OLIVEC_TILE 64 // 16KiB of pixels per tile
+#endif
+
+typedef enum {
+    OLIVEC_CMD_FILL = 0,
+    OLIVEC_CMD_RECT,
+    OLIVEC_CMD_CIRCLE,
+    OLIVEC_CMD_TRIANGLE,
+    OLIVEC_CMD_LINE,
+} Olivec_Cmd_Kind;
+
+typedef struct {
+    Olivec_Cmd_Kind kind;
+    // rect: x, y, w, h; circle: cx, cy, r; line: x1, y1, x2, y2
+    int a[6];
+    uint32_t color;
+    // Safe bounding box on the canvas, computed when binning
+    int x1, y1, x2, y2;
+} Olivec_Cmd;
+
+typedef struct {
+    Olivec_Canvas oc;
+    Olivec_Cmd *cmds;
+    size_t count, capacity;
+
+    // Commands of tile t are bins[bin_start[t]..bin_start[t + 1]]
+    size_t *bins, bins_capacity;
+    size_t *bin_start, tiles_capacity;
+    size_t tiles_x, tiles_y;
+    size_t next_tile;
+
+    // Worker pool, the caller of olivec_batch_end() is also a worker
+    pthread_t *threads;
+    size_t threads_count;
+    pthread_mutex_t mu;
+    pthread_cond_t cv, done;
+    size_t generation, busy;
+    bool stop;
+} Olivec_Batch;
+
+// threads is the total number of rendering threads including the caller
+OLIVECDEF bool olivec_batch_init(Olivec_Batch *b, size_t threads);
+OLIVECDEF void olivec_batch_free(Olivec_Batch *b);
+OLIVECDEF void olivec_batch_begin(Olivec_Batch *b, Olivec_Canvas oc);
+OLIVECDEF void olivec_batch_end(Olivec_Batch *b);
+OLIVECDEF void olivec_batch_fill(Olivec_Batch *b, uint32_t color);
+OLIVECDEF void olivec_batch_rect(Olivec_Batch *b, int x, int y, int w, int h, uint32_t color);
+OLIVECDEF void olivec_batch_frame(Olivec_Batch *b, int x, int y, int w, int h, size_t thiccness, uint32_t color);
+OLIVECDEF void olivec_batch_circle(Olivec_Batch *b, int cx, int cy, int r, uint32_t color);
+OLIVECDEF void olivec_batch_triangle(Olivec_Batch *b, int x1, int y1, int x2, int y2, int x3, int y3, uint32_t color);
+OLIVECDEF void olivec_batch_line(Olivec_Batch *b, int x1, int y1, int x2, int y2, uint32_t color);
+#endif // OLIVEC_BATCH
+
 #endif // OLIVE_C_
 
 #ifdef OLIVEC_IMPLEMENTATION
 
+#if defined(__SSE2__) && !defined(OLIVEC_NO_SIMD)
+#define OLIVEC_SSE2
+#include <emmintrin.h>
+#endif
+
 OLIVECDEF Olivec_Canvas olivec_canvas(uint32_t *pixels, size_t width, size_t height, size_t stride)
 {
     Olivec_Canvas oc = {
@@ -463,12 +547,72 @@ OLIVECDEF void olivec_blend_color(uint32_t *c1, uint32_t c2)
     *c1 = OLIVEC_RGBA(r1, g1, b1, a1);
 }
 
+OLIVECDEF void olivec_span_fill(uint32_t *p, size_t n, uint32_t color)
+{
+    size_t i = 0;
+#ifdef OLIVEC_SSE2
+    __m128i c = _mm_set1_epi32((int) color);
+    for (; i + 8 <= n; i += 8) {
+        _mm_storeu_si128((__m128i*) (p + i), c);
+        _mm_storeu_si128((__m128i*) (p + i + 4), c);
+    }
+#endif
+    for (; i < n; ++i) p[i] = color;
+}
+
+// Same as olivec_blend_color() on every pixel of the span
+OLIVECDEF void olivec_span_blend(uint32_t *p, size_t n, uint32_t color)
+{
+    uint32_t a2 = OLIVEC_ALPHA(color);
+    size_t i = 0;
+
+    // Fully transparent, x*255/255 == x
+    if (a2 == 0) return;
+
+    // Opaque, color channels are replaced and the destination alpha is kept
+    if (a2 == 255) {
+        uint32_t rgb = color&0x00FFFFFF;
+#ifdef OLIVEC_SSE2
+        __m128i amask = _mm_set1_epi32((int) 0xFF000000);
+        __m128i c = _mm_set1_epi32((int) rgb);
+        for (; i + 4 <= n; i += 4) {
+            __m128i d = _mm_loadu_si128((__m128i*) (p + i));
+            _mm_storeu_si128((__m128i*) (p + i), _mm_or_si128(_mm_and_si128(d, amask), c));
+        }
+#endif
+        for (; i < n; ++i) p[i] = (p[i]&0xFF000000) | rgb;
+        return;
+    }
+
+#ifdef OLIVEC_SSE2
+    // 16-bit lanes: c1*(255 - a2) + c2*a2 <= 255*255, and for such x
+    // x/255 == (x + 1 + (x>>8))>>8, the exact result of the scalar version
+    __m128i zero = _mm_setzero_si128();
+    __m128i one = _mm_set1_epi16(1);
+    __m128i ia = _mm_set1_epi16((short) (255 - a2));
+    short r2 = (short) (OLIVEC_RED(color)*a2);
+    short g2 = (short) (OLIVEC_GREEN(color)*a2);
+    short b2 = (short) (OLIVEC_BLUE(color)*a2);
+    __m128i c2 = _mm_setr_epi16(r2, g2, b2, 0, r2, g2, b2, 0);
+    __m128i amask = _mm_set1_epi32((int) 0xFF000000);
+    for (; i + 4 <= n; i += 4) {
+        __m128i d = _mm_loadu_si128((__m128i*) (p + i));
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), ia), c2);
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), ia), c2);
+        lo = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(lo, one), _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(hi, one), _mm_srli_epi16(hi, 8)), 8);
+        __m128i r = _mm_packus_epi16(lo, hi);
+        r = _mm_or_si128(_mm_andnot_si128(amask, r), _mm_and_si128(amask, d));
+        _mm_storeu_si128((__m128i*) (p + i), r);
+    }
+#endif
+    for (; i < n; ++i) olivec_blend_color(&p[i], color);
+}
+
 OLIVECDEF void olivec_fill(Olivec_Canvas oc, uint32_t color)
 {
     for (size_t y = 0; y < oc.height; ++y) {
-        for (size_t x = 0; x < oc.width; ++x) {
-            OLIVEC_PIXEL(oc, x, y) = color;
-        }
+        olivec_span_fill(&OLIVEC_PIXEL(oc, 0, y), oc.width, color);
     }
 }
 
@@ -476,10 +620,8 @@ OLIVECDEF void olivec_rect(Olivec_Canvas oc, int x, int y, int w, int h, uint32_
 {
     Olivec_Normalized_Rect nr = {0};
     if (!olivec_normalize_rect(x, y, w, h, oc.width, oc.height, &nr)) return;
-    for (int x = nr.x1; x <= nr.x2; ++x) {
-        for (int y = nr.y1; y <= nr.y2; ++y) {
-            olivec_blend_color(&OLIVEC_PIXEL(oc, x, y), color);
-        }
+    for (int y = nr.y1; y <= nr.y2; ++y) {
+        olivec_span_blend(&OLIVEC_PIXEL(oc, nr.x1, y), nr.x2 - nr.x1 + 1, color);
     }
 }
 
@@ -521,29 +663,51 @@ OLIVECDEF void olivec_ellipse(Olivec_Canvas oc, int cx, int cy, int rx, int ry,
     }
 }
 
+// Number of the AA subsamples of the pixel (x, y) inside of the circle
+OLIVECDEF int olivec__circle_coverage(int x, int y, int cx, int cy, int r)
+{
+    int count = 0;
+    for (int sox = 0; sox < OLIVEC_AA_RES; ++sox) {
+        for (int soy = 0; soy < OLIVEC_AA_RES; ++soy) {
+            // TODO: switch to 64 bits to make the overflow less likely
+            // Also research the probability of overflow
+            int res1 = (OLIVEC_AA_RES + 1);
+            int dx = (x*res1*2 + 2 + sox*2 - res1*cx*2 - res1);
+            int dy = (y*res1*2 + 2 + soy*2 - res1*cy*2 - res1);
+            if (dx*dx + dy*dy <= res1*res1*r*r*2*2) count += 1;
+        }
+    }
+    return count;
+}
+
+OLIVECDEF void olivec__blend_coverage(uint32_t *pixel, uint32_t color, int count)
+{
+    uint32_t alpha = ((color&0xFF000000)>>(3*8))*count/OLIVEC_AA_RES/OLIVEC_AA_RES;
+    uint32_t updated_color = (color&0x00FFFFFF)|(alpha<<(3*8));
+    olivec_blend_color(pixel, updated_color);
+}
+
 OLIVECDEF void olivec_circle(Olivec_Canvas oc, int cx, int cy, int r, uint32_t color)
 {
     Olivec_Normalized_Rect nr = {0};
     int r1 = r + OLIVEC_SIGN(int, r);
     if (!olivec_normalize_rect(cx - r1, cy - r1, 2*r1, 2*r1, oc.width, oc.height, &nr)) return;
 
+    // Pixels with all the subsamples inside form one span per row (the coverage
+    // test is convex in x), only the edges go through the AA loop
     for (int y = nr.y1; y <= nr.y2; ++y) {
-        for (int x = nr.x1; x <= nr.x2; ++x) {
-            int count = 0;
-            for (int sox = 0; sox < OLIVEC_AA_RES; ++sox) {
-                for (int soy = 0; soy < OLIVEC_AA_RES; ++soy) {
-                    // TODO: switch to 64 bits to make the overflow less likely
-                    // Also research the probability of overflow
-                    int res1 = (OLIVEC_AA_RES + 1);
-                    int dx = (x*res1*2 + 2 + sox*2 - res1*cx*2 - res1);
-                    int dy = (y*res1*2 + 2 + soy*2 - res1*cy*2 - res1);
-                    if (dx*dx + dy*dy <= res1*res1*r*r*2*2) count += 1;
-                }
-            }
-            uint32_t alpha = ((color&0xFF000000)>>(3*8))*count/OLIVEC_AA_RES/OLIVEC_AA_RES;
-            uint32_t updated_color = (color&0x00FFFFFF)|(alpha<<(3*8));
-            olivec_blend_color(&OLIVEC_PIXEL(oc, x, y), updated_color);
+        int x = nr.x1, xr = nr.x2;
+        for (; x <= xr; ++x) {
+            int count = olivec__circle_coverage(x, y, cx, cy, r);
+            if (count == OLIVEC_AA_RES*OLIVEC_AA_RES) break;
+            olivec__blend_coverage(&OLIVEC_PIXEL(oc, x, y), color, count);
         }
+        for (; xr > x; --xr) {
+            int count = olivec__circle_coverage(xr, y, cx, cy, r);
+            if (count == OLIVEC_AA_RES*OLIVEC_AA_RES) break;
+            olivec__blend_coverage(&OLIVEC_PIXEL(oc, xr, y), color, count);
+        }
+        if (x <= xr) olivec_span_blend(&OLIVEC_PIXEL(oc, x, y), xr - x + 1, color);
     }
 }
 
@@ -789,13 +953,13 @@ OLIVECDEF void olivec_triangle(Olivec_Canvas oc, int x1, int y1, int x2, int y2,
 {
     int lx, hx, ly, hy;
     if (olivec_normalize_triangle(oc.width, oc.height, x1, y1, x2, y2, x3, y3, &lx, &hx, &ly, &hy)) {
+        // The inside test is linear in x, so each row is one span
         for (int y = ly; y <= hy; ++y) {
-            for (int x = lx; x <= hx; ++x) {
-                int u1, u2, det;
-                if (olivec_barycentric(x1, y1, x2, y2, x3, y3, x, y, &u1, &u2, &det)) {
-                    olivec_blend_color(&OLIVEC_PIXEL(oc, x, y), color);
-                }
-            }
+            int u1, u2, det;
+            int l = lx, r = hx;
+            while (l <= r && !olivec_barycentric(x1, y1, x2, y2, x3, y3, l, y, &u1, &u2, &det)) ++l;
+            while (r > l && !olivec_barycentric(x1, y1, x2, y2, x3, y3, r, y, &u1, &u2, &det)) --r;
+            if (l <= r) olivec_span_blend(&OLIVEC_PIXEL(oc, l, y), r - l + 1, color);
         }
     }
 }
@@ -924,10 +1088,343 @@ OLIVECDEF void olivec_sprite_copy_bilinear(Olivec_Canvas oc, int x, int y, int w
     }
 }
 
+#ifdef OLIVEC_BATCH
+OLIVECDEF void olivec__batch_draw(Olivec_Canvas oc, const Olivec_Cmd *cmd, int tx, int ty)
+{
+    const int *a = cmd->a;
+    switch (cmd->kind) {
+    case OLIVEC_CMD_FILL:
+        olivec_fill(oc, cmd->color);
+        break;
+    case OLIVEC_CMD_RECT:
+        olivec_rect(oc, a[0] - tx, a[1] - ty, a[2], a[3], cmd->color);
+        break;
+    case OLIVEC_CMD_CIRCLE:
+        olivec_circle(oc, a[0] - tx, a[1] - ty, a[2], cmd->color);
+        break;
+    case OLIVEC_CMD_TRIANGLE:
+        olivec_triangle(oc, a[0] - tx, a[1] - ty, a[2] - tx, a[3] - ty, a[4] - tx, a[5] - ty, cmd->color);
+        break;
+    case OLIVEC_CMD_LINE:
+        olivec_line(oc, a[0] - tx, a[1] - ty, a[2] - tx, a[3] - ty, cmd->color);
+        break;
+    }
+}
+
+// Computes the safe bounding box of the command, false if it's invisible
+OLIVECDEF bool olivec__batch_bounds(Olivec_Canvas oc, Olivec_Cmd *cmd)
+{
+    const int *a = cmd->a;
+    Olivec_Normalized_Rect nr = {0};
+    switch (cmd->kind) {
+    case OLIVEC_CMD_FILL:
+        if (oc.width == 0 || oc.height == 0) return false;
+        cmd->x1 = 0;
+        cmd->y1 = 0;
+        cmd->x2 = oc.width - 1;
+        cmd->y2 = oc.height - 1;
+        return true;
+    case OLIVEC_CMD_RECT:
+        if (!olivec_normalize_rect(a[0], a[1], a[2], a[3], oc.width, oc.height, &nr)) return false;
+        break;
+    case OLIVEC_CMD_CIRCLE: {
+        int r1 = a[2] + OLIVEC_SIGN(int, a[2]);
+        if (!olivec_normalize_rect(a[0] - r1, a[1] - r1, 2*r1, 2*r1, oc.width, oc.height, &nr)) return false;
+    } break;
+    case OLIVEC_CMD_TRIANGLE:
+        return olivec_normalize_triangle(oc.width, oc.height, a[0], a[1], a[2], a[3], a[4], a[5],
+                                         &cmd->x1, &cmd->x2, &cmd->y1, &cmd->y2);
+    case OLIVEC_CMD_LINE: {
+        int x1 = a[0], x2 = a[2], y1 = a[1], y2 = a[3];
+        if (x1 > x2) OLIVEC_SWAP(int, x1, x2);
+        if (y1 > y2) OLIVEC_SWAP(int, y1, y2);
+        if (!olivec_normalize_rect(x1, y1, x2 - x1 + 1, y2 - y1 + 1, oc.width, oc.height, &nr)) return false;
+    } break;
+    }
+    cmd->x1 = nr.x1;
+    cmd->y1 = nr.y1;
+    cmd->x2 = nr.x2;
+    cmd->y2 = nr.y2;
+    return true;
+}
+
+OLIVECDEF void olivec__batch_tiles(Olivec_Batch *b)
+{
+    size_t tiles = b->tiles_x*b->tiles_y;
+    for (;;) {
+        size_t t = __atomic_fetch_add(&b->next_tile, 1, __ATOMIC_RELAXED);
+        if (t >= tiles) break;
+        int tx = (t%b->tiles_x)*OLIVEC_TILE;
+        int ty = (t/b->tiles_x)*OLIVEC_TILE;
+        Olivec_Canvas sub = olivec_subcanvas(b->oc, tx, ty, OLIVEC_TILE, OLIVEC_TILE);
+        for (size_t i = b->bin_start[t]; i < b->bin_start[t + 1]; ++i) {
+            olivec__batch_draw(sub, &b->cmds[b->bins[i]], tx, ty);
+        }
+    }
+}
+
+OLIVECDEF void *olivec__batch_worker(void *arg)
+{
+    Olivec_Batch *b = arg;
+    size_t seen = 0;
+    pthread_mutex_lock(&b->mu);
+    for (;;) {
+        while (b->generation == seen && !b->stop) pthread_cond_wait(&b->cv, &b->mu);
+        if (b->stop) break;
+        seen = b->generation;
+        pthread_mutex_unlock(&b->mu);
+
+        olivec__batch_tiles(b);
+
+        pthread_mutex_lock(&b->mu);
+        if (--b->busy == 0) pthread_cond_signal(&b->done);
+    }
+    pthread_mutex_unlock(&b->mu);
+    return NULL;
+}
+
+OLIVECDEF bool olivec_batch_init(Olivec_Batch *b, size_t threads)
+{
+    *b = (Olivec_Batch) {0};
+    pthread_mutex_init(&b->mu, NULL);
+    pthread_cond_init(&b->cv, NULL);
+    pthread_cond_init(&b->done, NULL);
+    if (threads <= 1) return true;
+
+    b->threads = malloc((threads - 1)*sizeof(*b->threads));
+    if (b->threads == NULL) return false;
+    for (; b->threads_count < threads - 1; ++b->threads_count) {
+        if (pthread_create(&b->threads[b->threads_count], NULL, olivec__batch_worker, b) != 0) {
+            // Render with the threads we've got
+            break;
+        }
+    }
+    return true;
+}
+
+OLIVECDEF void olivec_batch_free(Olivec_Batch *b)
+{
+    pthread_mutex_lock(&b->mu);
+    b->stop = true;
+    pthread_cond_broadcast(&b->cv);
+    pthread_mutex_unlock(&b->mu);
+    for (size_t i = 0; i < b->threads_count; ++i) pthread_join(b->threads[i], NULL);
+
+    pthread_mutex_destroy(&b->mu);
+    pthread_cond_destroy(&b->cv);
+    pthread_cond_destroy(&b->done);
+    free(b->threads);
+    free(b->cmds);
+    free(b->bins);
+    free(b->bin_start);
+    *b = (Olivec_Batch) {0};
+}
+
+OLIVECDEF void olivec_batch_begin(Olivec_Batch *b, Olivec_Canvas oc)
+{
+    b->oc = oc;
+    b->count = 0;
+}
+
+// Draws the recorded commands directly, when binning is not possible
+OLIVECDEF void olivec__batch_direct(Olivec_Batch *b)
+{
+    for (size_t i = 0; i < b->count; ++i) {
+        olivec__batch_draw(b->oc, &b->cmds[i], 0, 0);
+    }
+    b->count = 0;
+}
+
+OLIVECDEF void olivec_batch_end(Olivec_Batch *b)
+{
+    size_t tiles_x = (b->oc.width + OLIVEC_TILE - 1)/OLIVEC_TILE;
+    size_t tiles_y = (b->oc.height + OLIVEC_TILE - 1)/OLIVEC_TILE;
+    size_t tiles = tiles_x*tiles_y;
+
+    if (b->count == 0 || tiles == 0) {
+        b->count = 0;
+        return;
+    }
+    if (b->tiles_capacity < tiles + 1) {
+        size_t *bin_start = realloc(b->bin_start, (tiles + 1)*sizeof(*bin_start));
+        if (bin_start == NULL) {
+            olivec__batch_direct(b);
+            return;
+        }
+        b->bin_start = bin_start;
+        b->tiles_capacity = tiles + 1;
+    }
+
+    // Count the commands of each tile, then turn the counts into offsets
+    memset(b->bin_start, 0, (tiles + 1)*sizeof(*b->bin_start));
+    size_t total = 0;
+    for (size_t i = 0; i < b->count; ++i) {
+        Olivec_Cmd *cmd = &b->cmds[i];
+        if (!olivec__batch_bounds(b->oc, cmd)) {
+            cmd->x1 = 1;
+            cmd->x2 = 0;
+            continue;
+        }
+        for (size_t ty = cmd->y1/OLIVEC_TILE; ty <= (size_t) cmd->y2/OLIVEC_TILE; ++ty) {
+            for (size_t tx = cmd->x1/OLIVEC_TILE; tx <= (size_t) cmd->x2/OLIVEC_TILE; ++tx) {
+                b->bin_start[ty*tiles_x + tx + 1] += 1;
+                total += 1;
+            }
+        }
+    }
+    if (b->bins_capacity < total) {
+        size_t *bins = realloc(b->bins, total*sizeof(*bins));
+        if (bins == NULL) {
+            olivec__batch_direct(b);
+            return;
+        }
+        b->bins = bins;
+        b->bins_capacity = total;
+    }
+    for (size_t t = 0; t < tiles; ++t) b->bin_start[t + 1] += b->bin_start[t];
+
+    // Fill the bins in the recorded order, bin_start[t] is used as the cursor
+    // of tile t and ends up at the start of tile t + 1, then gets shifted back
+    for (size_t i = 0; i < b->count; ++i) {
+        Olivec_Cmd *cmd = &b->cmds[i];
+        if (cmd->x1 > cmd->x2) continue;
+        for (size_t ty = cmd->y1/OLIVEC_TILE; ty <= (size_t) cmd->y2/OLIVEC_TILE; ++ty) {
+            for (size_t tx = cmd->x1/OLIVEC_TILE; tx <= (size_t) cmd->x2/OLIVEC_TILE; ++tx) {
+                b->bins[b->bin_start[ty*tiles_x + tx]++] = i;
+            }
+        }
+    }
+    for (size_t t = tiles; t > 0; --t) b->bin_start[t] = b->bin_start[t - 1];
+    b->bin_start[0] = 0;
+
+    b->tiles_x = tiles_x;
+    b->tiles_y = tiles_y;
+    b->next_tile = 0;
+    if (b->threads_count > 0) {
+        pthread_mutex_lock(&b->mu);
+        b->busy = b->threads_count;
+        b->generation += 1;
+        pthread_cond_broadcast(&b->cv);
+        pthread_mutex_unlock(&b->mu);
+    }
+
+    olivec__batch_tiles(b);
+
+    if (b->threads_count > 0) {
+        pthread_mutex_lock(&b->mu);
+        while (b->busy > 0) pthread_cond_wait(&b->done, &b->mu);
+        pthread_mutex_unlock(&b->mu);
+    }
+    b->count = 0;
+}
+
+OLIVECDEF Olivec_Cmd *olivec__batch_push(Olivec_Batch *b, Olivec_Cmd_Kind kind, uint32_t color)
+{
+    if (b->count >= b->capacity) {
+        size_t capacity = b->capacity == 0 ? 256 : b->capacity*2;
+        Olivec_Cmd *cmds = realloc(b->cmds, capacity*sizeof(*cmds));
+        if (cmds == NULL) {
+            // Out of memory, render what we have and start over
+            olivec_batch_end(b);
+            if (b->capacity == 0) return NULL;
+        } else {
+            b->cmds = cmds;
+            b->capacity = capacity;
+        }
+    }
+    Olivec_Cmd *cmd = &b->cmds[b->count++];
+    cmd->kind = kind;
+    cmd->color = color;
+    return cmd;
+}
+
+OLIVECDEF void olivec_batch_fill(Olivec_Batch *b, uint32_t color)
+{
+    Olivec_Cmd *cmd = olivec__batch_push(b, OLIVEC_CMD_FILL, color);
+    if (cmd == NULL) {
+        olivec_fill(b->oc, color);
+        return;
+    }
+    // Everything recorded before is covered
+    b->cmds[0] = *cmd;
+    b->count = 1;
+}
+
+OLIVECDEF void olivec_batch_rect(Olivec_Batch *b, int x, int y, int w, int h, uint32_t color)
+{
+    Olivec_Cmd *cmd = olivec__batch_push(b, OLIVEC_CMD_RECT, color);
+    if (cmd == NULL) {
+        olivec_rect(b->oc, x, y, w, h, color);
+        return;
+    }
+    cmd->a[0] = x;
+    cmd->a[1] = y;
+    cmd->a[2] = w;
+    cmd->a[3] = h;
+}
+
+OLIVECDEF void olivec_batch_frame(Olivec_Batch *b, int x, int y, int w, int h, size_t t, uint32_t color)
+{
+    if (t == 0) return; // Nothing to render
+
+    // Same as olivec_frame
+    int x1 = x;
+    int y1 = y;
+    int x2 = x1 + OLIVEC_SIGN(int, w)*(OLIVEC_ABS(int, w) - 1);
+    if (x1 > x2) OLIVEC_SWAP(int, x1, x2);
+    int y2 = y1 + OLIVEC_SIGN(int, h)*(OLIVEC_ABS(int, h) - 1);
+    if (y1 > y2) OLIVEC_SWAP(int, y1, y2);
+
+    olivec_batch_rect(b, x1 - t/2, y1 - t/2, (x2 - x1 + 1) + t/2*2, t, color);  // Top
+    olivec_batch_rect(b, x1 - t/2, y1 - t/2, t, (y2 - y1 + 1) + t/2*2, color);  // Left
+    olivec_batch_rect(b, x1 - t/2, y2 + t/2, (x2 - x1 + 1) + t/2*2, -t, color); // Bottom
+    olivec_batch_rect(b, x2 + t/2, y1 - t/2, -t, (y2 - y1 + 1) + t/2*2, color); // Right
+}
+
+OLIVECDEF void olivec_batch_circle(Olivec_Batch *b, int cx, int cy, int r, uint32_t color)
+{
+    Olivec_Cmd *cmd = olivec__batch_push(b, OLIVEC_CMD_CIRCLE, color);
+    if (cmd == NULL) {
+        olivec_circle(b->oc, cx, cy, r, color);
+        return;
+    }
+    cmd->a[0] = cx;
+    cmd->a[1] = cy;
+    cmd->a[2] = r;
+}
+
+OLIVECDEF void olivec_batch_triangle(Olivec_Batch *b, int x1, int y1, int x2, int y2, int x3, int y3, uint32_t color)
+{
+    Olivec_Cmd *cmd = olivec__batch_push(b, OLIVEC_CMD_TRIANGLE, color);
+    if (cmd == NULL) {
+        olivec_triangle(b->oc, x1, y1, x2, y2, x3, y3, color);
+        return;
+    }
+    cmd->a[0] = x1;
+    cmd->a[1] = y1;
+    cmd->a[2] = x2;
+    cmd->a[3] = y2;
+    cmd->a[4] = x3;
+    cmd->a[5] = y3;
+}
+
+OLIVECDEF void olivec_batch_line(Olivec_Batch *b, int x1, int y1, int x2, int y2, uint32_t color)
+{
+    Olivec_Cmd *cmd = olivec__batch_push(b, OLIVEC_CMD_LINE, color);
+    if (cmd == NULL) {
+        olivec_line(b->oc, x1, y1, x2, y2, color);
+        return;
+    }
+    cmd->a[0] = x1;
+    cmd->a[1] = y1;
+    cmd->a[2] = x2;
+    cmd->a[3] = y2;
+}
+#endif // OLIVEC_BATCH
+
 #endif // OLIVEC_IMPLEMENTATION
 
 // TODO: Benchmarking
-// TODO: SIMD implementations
 // TODO: bezier curves
 // TODO: olivec_ring
 // TODO: fuzzer
@@ -5,7 +5,11 @@
       first provide olive.c file,
       ref: https://github.com/tsoding/olive.c.git
       then:
-          cc -o ttyART ttyART.c -lm
+          cc -O2 -o ttyART ttyART.c -lm -lpthread
+
+      rendering is tile-binned and multi-threaded
+      (olive.c OLIVEC_BATCH mode), use -D TTYART_THREADS=n
+      to set the number of threads (default: number of CPUs)
 
       run it on tty (display server must be detached)  
  **/
@@ -19,8 +23,15 @@
 #include <math.h>
 
 #define OLIVEC_IMPLEMENTATION
+#define OLIVEC_BATCH
 #include "olive.c"
 
+#ifndef TTYART_THREADS
+#define TTYART_THREADS sysconf(_SC_NPROCESSORS_ONLN)
+#endif
+
+static Olivec_Batch batch;
+
 #define RENDER vc_render1
 Olivec_Canvas vc_render1(float dt, int WIDTH, int HEIGHT, Olivec_Canvas oc);
 
@@ -64,12 +75,14 @@ int main() {
     Olivec_Canvas oc = olivec_canvas(fbp, vinfo.xres, vinfo.yres, vinfo.xres);
     oc = olivec_subcanvas(oc, 1190, 550, 800, 500);
 
+    olivec_batch_init(&batch, TTYART_THREADS);
     for(;;){
             RENDER (0.05f, 800, 500, oc);
             usleep(1000*1000/10);
     }
 
 
+    olivec_batch_free(&batch);
     munmap(fbp, screensize);
     close(fb_fd);
 
@@ -98,7 +111,8 @@ Olivec_Canvas vc_render1(float dt, int WIDTH, int HEIGHT, Olivec_Canvas oc)
 {
     angle += 0.25*PI*dt;
 
-    olivec_fill(oc, BACKGROUND_COLOR);
+    olivec_batch_begin(&batch, oc);
+    olivec_batch_fill(&batch, BACKGROUND_COLOR);
     for (int ix = 0; ix < GRID_COUNT; ++ix) {
         for (int iy = 0; iy < GRID_COUNT; ++iy) {
             for (int iz = 0; iz < GRID_COUNT; ++iz) {
@@ -128,10 +142,11 @@ Olivec_Canvas vc_render1(float dt, int WIDTH, int HEIGHT, Olivec_Canvas oc)
                 uint32_t g = iy*255/GRID_COUNT;
                 uint32_t b = iz*255/GRID_COUNT;
                 uint32_t color = 0xFF000000 | (r<<(0*8)) | (g<<(1*8)) | (b<<(2*8));
-                olivec_circle(oc, (x + 1)/2*WIDTH, (y + 1)/2*HEIGHT, CIRCLE_RADIUS, color);
+                olivec_batch_circle(&batch, (x + 1)/2*WIDTH, (y + 1)/2*HEIGHT, CIRCLE_RADIUS, color);
             }
         }
     }
+    olivec_batch_end(&batch);
 
     size_t size = 8;
 
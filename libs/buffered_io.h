@@ -30,12 +30,64 @@
       return 0;
     }
     ```
+
+    Vectored output:
+      large buffers (>= BIO_REF_MIN bytes) can be queued by
+      reference (without copying) via `bio_putv`, they are written
+      by a single writev(2) call on the next flush, so they MUST
+      remain valid and unchanged until then
+      to enable it, give the bio an iovec array:
+        struct iovec iov[16];
+        bio_iov (&bio, 16, iov);
+      otherwise `bio_putv` is the same as `bio_put`
+
+      when the output is a pipe, `bio_vmsplice (&bio, 1)` makes
+      the queued references go through vmsplice(2) (zero-copy),
+      then the pages are shared with the pipe, and must remain
+      unchanged until the reader consumes them (e.g. mmap'ed or
+      read-only data); `bio_splice` moves data from a file
+      descriptor to the output by splice(2)
+
+    Asynchronous mode (define `BIO_ASYNC`, link with -lpthread):
+      a background thread writes one buffer while the other
+      one is being filled, so flush does not block on write(2)
+      (unless the previous buffer is still being written)
+        bio_async_init (&bio, malloc (BMAX));
+        // bio_putxx ...
+        bio_sync (&bio); // waits for the pending write
+        bio_async_free (&bio); // flushes and stops the thread
+      write errors of the background thread are reported by the
+      next flush or `bio_sync`, via bio_err and bio_errno
+
+    Options:
+      define `BIO_REF_MIN` to change the `bio_putv` threshold
+      define `BIO_NO_SPLICE` to disable vmsplice and splice
  **/
 #ifndef BUFFERED_IO__H
 #define BUFFERED_IO__H
 #include <unistd.h>
 #include <errno.h>
 #include <string.h>
+#include <limits.h>
+#include <sys/uio.h>
+
+#if !defined (BIO_NO_SPLICE) && defined (__linux__)
+#  define BIO_SPLICE
+#  include <sys/syscall.h>
+#endif
+
+#ifndef BIO_REF_MIN
+#  define BIO_REF_MIN 4096
+#endif
+
+#ifndef IOV_MAX
+#  define IOV_MAX 1024
+#endif
+
+#ifdef BIO_ASYNC
+#  include <stdlib.h>
+#  include <pthread.h>
+#endif
 
 #ifndef uchar
 #  define uchar unsigned char
@@ -49,6 +101,16 @@ struct BIO {
 
   /* output file */
   int outfd;
+
+  /* queued buffers (optional, see bio_putv) */
+  struct iovec *iov;
+  int iovcap; /* @iov capacity */
+  int __iovcnt; /* number of queued buffers */
+  int __iovoff; /* @buffer[0:__iovoff] is already queued */
+  int flags;
+
+  /* the background writer (see bio_async_init) */
+  void *__async;
 };
 typedef struct BIO BIO_t;
 
@@ -68,26 +130,65 @@ typedef struct BIO BIO_t;
 #define bio_newf(cap, mem, out_f) \
   bio_new(cap, mem, fileno (out_f)) 
 
-#define bio_has_more(bio) ((bio)->__len > 0)
+// @mem: iovec array of length @cap (>= 3) for bio_putv
+#define bio_iov(bio, cap, mem) \
+  ((bio)->iov = mem, (bio)->iovcap = cap, (bio)->__iovcnt = 0)
+
+#define BIO_VMSPLICE 1
+// to use vmsplice for buffers queued by bio_putv
+#define bio_vmsplice(bio, on) \
+  ((on) ? ((bio)->flags |= BIO_VMSPLICE) : ((bio)->flags &= ~BIO_VMSPLICE))
+
+#define bio_has_more(bio) ((bio)->__len > 0 || (bio)->__iovcnt > 0)
 #define bio_is_empty(bio) ((bio)->__len == 0)
 
 // to flush the buffer and zero out __len
 #define bio_flush(bio) do {                             \
-    if (write ((bio)->outfd,                            \
-               (bio)->buffer, (bio)->__len) < 0)        \
+    if ((bio)->__async) {                               \
+      bio_flusha (bio);                                 \
+    } else if ((bio)->__iovcnt > 0) {                   \
+      bio_flushv (bio);                                 \
+      (bio)->__iovcnt = (bio)->__iovoff = 0;            \
+    } else if (write ((bio)->outfd,                     \
+                      (bio)->buffer, (bio)->__len) < 0) \
       { (bio)->__errno = errno; }                       \
     (bio)->__len = 0;                                   \
   } while (0)
 
 // safe flush, only sets __len=0 on successful write syscall
 #define bio_sflush(bio) do {                            \
-    if (write ((bio)->outfd,                            \
+    if ((bio)->__async) {                               \
+      bio_flusha (bio);                                 \
+    } else if ((bio)->__iovcnt > 0) {                   \
+      bio_flushv (bio);                                 \
+    } else if (write ((bio)->outfd,                     \
                (bio)->buffer, (bio)->__len) < 0) {      \
       (bio)->__errno = errno;                           \
     } else {                                            \
       (bio)->__len = 0;                                 \
     }} while (0)
 
+// writes the queued buffers and @buffer (via writev)
+// on failure, the unwritten part remains queued
+// returns errno on failure and 0 on success
+BIODEFF int bio_flushv (BIO_t *bio);
+
+#ifdef BIO_ASYNC
+// starts the background writer, @mem: the second buffer
+// (of length bio->len), returns 0 or errno on failure
+BIODEFF int bio_async_init (BIO_t *bio, uchar *mem);
+// flushes, stops the writer and gives bio its first buffer back
+// then @mem of bio_async_init can be freed
+BIODEFF int bio_async_free (BIO_t *bio);
+// hands the buffer to the writer and switches buffers
+BIODEFF int bio_flusha (BIO_t *bio);
+// waits for the pending write, returns errno or 0
+BIODEFF int bio_sync (BIO_t *bio);
+#else
+#  define bio_flusha(bio) bio_flushv (bio)
+#  define bio_sync(bio) ((bio)->__errno)
+#endif
+
 // flush & print newline
 BIODEFF int bio_flushln(BIO_t *bio);
 
@@ -112,6 +213,17 @@ BIODEFF int bio_put (BIO_t *bio, const char *ptr, int ptr_len);
 // with an extra newline
 BIODEFF int bio_putln (BIO_t *bio, const char *ptr, int ptr_len);
 
+// queues @ptr[@ptr_len] by reference (not copied)
+// when @ptr_len >= BIO_REF_MIN, see bio_iov
+BIODEFF int bio_putv (BIO_t *bio, const void *ptr, int ptr_len);
+
+#ifdef BIO_SPLICE
+// flushes the buffer, then moves at most @len bytes
+// from @infd to the output, using splice when possible
+// returns number of bytes moved, or -1 on failure
+BIODEFF ssize_t bio_splice (BIO_t *bio, int infd, size_t len);
+#endif
+
 // puts string
 #define bio_puts(bio, str) bio_putln (bio, str, strlen (str))
 // puts without \n
@@ -135,6 +247,31 @@ bio_fputc (BIO_t *bio, uchar c)
   }
   
 
+#ifdef BIO_ASYNC
+/**
+ *  internal function, puts @ptr in async mode
+ *  the buffer is flushed whenever it gets full, to keep
+ *  the order with the background writer
+ */
+static inline int
+__bio_puta (BIO_t *bio, const char *ptr, int ptr_len)
+{
+  while (ptr_len > 0)
+    {
+      int n = bio->len - bio->__len;
+      if (n > ptr_len)
+        n = ptr_len;
+      memcpy (bio->buffer + bio->__len, ptr, n);
+      bio->__len += n;
+      ptr += n;
+      ptr_len -= n;
+      if (bio->__len >= bio->len)
+        bio_flush (bio);
+    }
+  return bio->__errno;
+}
+#endif /* BIO_ASYNC */
+
 BIODEFF int
 bio_put (BIO_t *bio, const char *ptr, int ptr_len)
 {
@@ -144,6 +281,10 @@ bio_put (BIO_t *bio, const char *ptr, int ptr_len)
       bio->__len += ptr_len;
       return 0;
     }
+#ifdef BIO_ASYNC
+  else if (bio->__async)
+    return __bio_puta (bio, ptr, ptr_len);
+#endif
   else
     {
       bio_flush (bio);
@@ -167,6 +308,14 @@ bio_putln (BIO_t *bio, const char *ptr, int ptr_len)
       bio->buffer[bio->__len++] = '\n';
       return 0;
     }
+#ifdef BIO_ASYNC
+  else if (bio->__async)
+    {
+      __bio_puta (bio, ptr, ptr_len);
+      bio_putc (bio, '\n');
+      return bio->__errno;
+    }
+#endif
   else
     {
       bio_flush (bio);
@@ -186,6 +335,14 @@ bio_putln (BIO_t *bio, const char *ptr, int ptr_len)
 BIODEFF int
 bio_flushln(BIO_t *bio)
 {
+#ifdef BIO_ASYNC
+  if (bio->__async)
+    {
+      bio_putc (bio, '\n');
+      bio_flush (bio);
+      return bio->__errno;
+    }
+#endif
   bio_flush (bio);
   if (bio->__errno != 0)
     return bio->__errno;
@@ -195,5 +352,316 @@ bio_flushln(BIO_t *bio)
     });
   return 0;
 }
+
+// internal helper, is @v a part of @buffer
+#define __bio_own(bio, v) \
+  ((uchar *)(v)->iov_base >= (bio)->buffer && \
+   (uchar *)(v)->iov_base < (bio)->buffer + (bio)->len)
+
+BIODEFF int
+bio_flushv (BIO_t *bio)
+{
+  struct iovec *v;
+  int n;
+
+  do {
+    /* queue the rest of the buffer, if there is room */
+    if (bio->__len > bio->__iovoff && bio->__iovcnt < bio->iovcap)
+      {
+        v = bio->iov + bio->__iovcnt;
+        v->iov_base = bio->buffer + bio->__iovoff;
+        v->iov_len = bio->__len - bio->__iovoff;
+        bio->__iovcnt++;
+        bio->__iovoff = bio->__len;
+      }
+
+    for (v = bio->iov, n = bio->__iovcnt; n > 0; )
+      {
+        ssize_t w;
+        /* group buffers of the same kind */
+        int k = 1, own = __bio_own (bio, v);
+        for (; k < n && k < IOV_MAX; ++k)
+          if (__bio_own (bio, v + k) != own)
+            break;
+
+#ifdef BIO_SPLICE
+        if (!own && (bio->flags & BIO_VMSPLICE))
+          {
+            w = syscall (SYS_vmsplice, bio->outfd, v, k, 0);
+            if (w < 0 && errno != EINTR)
+              {
+                /* not a pipe, never try again */
+                bio->flags &= ~BIO_VMSPLICE;
+                continue;
+              }
+          }
+        else
+#endif
+          w = writev (bio->outfd, v, k);
+
+        if (w < 0)
+          {
+            if (errno == EINTR)
+              continue;
+            bio->__errno = errno;
+            /* keep the unwritten part */
+            memmove (bio->iov, v, n * sizeof (struct iovec));
+            bio->__iovcnt = n;
+            return bio->__errno;
+          }
+
+        for (; n > 0 && (size_t) w >= v->iov_len; --n, ++v)
+          w -= v->iov_len;
+        if (n > 0)
+          {
+            v->iov_base = (uchar *) v->iov_base + w;
+            v->iov_len -= w;
+          }
+      }
+    bio->__iovcnt = 0;
+  } while (bio->__len > bio->__iovoff);
+
+  bio->__iovoff = bio->__len = 0;
+  return 0;
+}
+
+BIODEFF int
+bio_putv (BIO_t *bio, const void *ptr, int ptr_len)
+{
+  /* the async writer copies anyway */
+  if (!bio->iov || ptr_len < BIO_REF_MIN || bio->__async)
+    return bio_put (bio, ptr, ptr_len);
+
+  /* the rest of the buffer, @ptr and one more */
+  if (bio->__iovcnt + 3 > bio->iovcap)
+    {
+      if (bio_flushv (bio) != 0)
+        return bio->__errno;
+    }
+
+  struct iovec *v = bio->iov + bio->__iovcnt;
+  if (bio->__len > bio->__iovoff)
+    {
+      v->iov_base = bio->buffer + bio->__iovoff;
+      v->iov_len = bio->__len - bio->__iovoff;
+      bio->__iovoff = bio->__len;
+      v++;
+    }
+  v->iov_base = (void *) ptr;
+  v->iov_len = ptr_len;
+  bio->__iovcnt = v - bio->iov + 1;
+  return 0;
+}
+
+#ifdef BIO_SPLICE
+BIODEFF ssize_t
+bio_splice (BIO_t *bio, int infd, size_t len)
+{
+  size_t total = 0;
+  int use_splice = 1;
+
+  bio_sflush (bio);
+  if (bio_sync (bio) != 0)
+    return -1;
+
+  while (total < len)
+    {
+      ssize_t r, w = 0;
+      size_t n = len - total;
+
+      if (use_splice)
+        {
+          r = syscall (SYS_splice, infd, NULL, bio->outfd, NULL,
+                       n, 1 /* SPLICE_F_MOVE */);
+          if (r < 0 && (errno == EINVAL || errno == ESPIPE))
+            {
+              /* neither end is a pipe */
+              use_splice = 0;
+              continue;
+            }
+          w = r;
+        }
+      else
+        {
+          if (n > (size_t) bio->len)
+            n = bio->len;
+          r = read (infd, bio->buffer, n);
+          for (ssize_t t; w < r; w += t)
+            if ((t = write (bio->outfd, bio->buffer + w, r - w)) < 0)
+              {
+                if (errno == EINTR)
+                  t = 0;
+                else
+                  {
+                    bio->__errno = errno;
+                    return -1;
+                  }
+              }
+        }
+
+      if (r < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          bio->__errno = errno;
+          return -1;
+        }
+      if (r == 0)
+        break;
+      total += w;
+    }
+  return total;
+}
+#endif /* BIO_SPLICE */
+
+#ifdef BIO_ASYNC
+struct bio_async
+{
+  pthread_t th;
+  pthread_mutex_t mu;
+  pthread_cond_t cv;
+  uchar *pending; /* being written, NULL when idle */
+  uchar *spare; /* the buffer not in use */
+  uchar *first; /* the first buffer of bio */
+  int len, outfd;
+  int err, stop;
+};
+
+static void *
+__bio_writer (void *arg)
+{
+  struct bio_async *a = arg;
+
+  pthread_mutex_lock (&a->mu);
+  for (;;)
+    {
+      while (!a->pending && !a->stop)
+        pthread_cond_wait (&a->cv, &a->mu);
+      if (!a->pending)
+        break;
+
+      uchar *p = a->pending;
+      int n = a->len, fd = a->outfd, err = 0;
+      pthread_mutex_unlock (&a->mu);
+      while (n > 0)
+        {
+          ssize_t w = write (fd, p, n);
+          if (w < 0)
+            {
+              if (errno == EINTR)
+                continue;
+              err = errno;
+              break;
+            }
+          p += w;
+          n -= w;
+        }
+      pthread_mutex_lock (&a->mu);
+      if (err && !a->err)
+        a->err = err;
+      a->pending = NULL;
+      pthread_cond_broadcast (&a->cv);
+    }
+  pthread_mutex_unlock (&a->mu);
+  return NULL;
+}
+
+/* waits for the writer to be idle, @a->mu must be locked */
+static inline void
+__bio_wait (BIO_t *bio, struct bio_async *a)
+{
+  while (a->pending)
+    pthread_cond_wait (&a->cv, &a->mu);
+  if (a->err)
+    {
+      bio->__errno = a->err;
+      a->err = 0;
+    }
+}
+
+BIODEFF int
+bio_async_init (BIO_t *bio, uchar *mem)
+{
+  struct bio_async *a;
+  int ret;
+
+  if (bio->__async)
+    return 0;
+  if (!mem || !(a = malloc (sizeof (struct bio_async))))
+    return (bio->__errno = ENOMEM);
+  bio_flush (bio);
+
+  *a = (struct bio_async){.spare = mem, .first = bio->buffer};
+  pthread_mutex_init (&a->mu, NULL);
+  pthread_cond_init (&a->cv, NULL);
+  if ((ret = pthread_create (&a->th, NULL, __bio_writer, a)) != 0)
+    {
+      pthread_cond_destroy (&a->cv);
+      pthread_mutex_destroy (&a->mu);
+      free (a);
+      return (bio->__errno = ret);
+    }
+  bio->__async = a;
+  return 0;
+}
+
+BIODEFF int
+bio_flusha (BIO_t *bio)
+{
+  struct bio_async *a = bio->__async;
+
+  pthread_mutex_lock (&a->mu);
+  __bio_wait (bio, a);
+  if (bio->__len > 0)
+    {
+      a->pending = bio->buffer;
+      a->len = bio->__len;
+      a->outfd = bio->outfd;
+      bio->buffer = a->spare;
+      a->spare = a->pending;
+      pthread_cond_signal (&a->cv);
+    }
+  pthread_mutex_unlock (&a->mu);
+  bio->__len = 0;
+  return bio->__errno;
+}
+
+BIODEFF int
+bio_sync (BIO_t *bio)
+{
+  struct bio_async *a = bio->__async;
+  if (a)
+    {
+      pthread_mutex_lock (&a->mu);
+      __bio_wait (bio, a);
+      pthread_mutex_unlock (&a->mu);
+    }
+  return bio->__errno;
+}
+
+BIODEFF int
+bio_async_free (BIO_t *bio)
+{
+  struct bio_async *a = bio->__async;
+  if (!a)
+    return bio->__errno;
+
+  bio_flusha (bio);
+  pthread_mutex_lock (&a->mu);
+  __bio_wait (bio, a);
+  a->stop = 1;
+  pthread_cond_signal (&a->cv);
+  pthread_mutex_unlock (&a->mu);
+  pthread_join (a->th, NULL);
+
+  /* both buffers are empty */
+  bio->buffer = a->first;
+  pthread_cond_destroy (&a->cv);
+  pthread_mutex_destroy (&a->mu);
+  free (a);
+  bio->__async = NULL;
+  return bio->__errno;
+}
+#endif /* BIO_ASYNC */
 #endif /* BIO_IMPLEMENTATION */
 #endif /* BUFFERED_IO__H */
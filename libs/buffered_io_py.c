@@ -51,10 +51,12 @@
  **/
 #include <stdlib.h>
 #include <fcntl.h>
+#include <pthread.h>
 
 #define PY_SSIZE_T_CLEAN
 #include <Python.h>
 
+#define BIO_ASYNC
 #define BIO_IMPLEMENTATION
 #include "buffered_io.h"
 
@@ -63,6 +65,11 @@
 #  define BMAX 1024 // 1k
 #endif
 
+/* number of items of putall/putlines per GIL release */
+#ifndef PUT_BATCH
+#  define PUT_BATCH 256
+#endif
+
 #ifndef PYBIODEFF
 #  define PYBIODEFF static PyObject *
 #endif
@@ -87,9 +94,27 @@
 typedef struct {
   PyObject_HEAD
   uchar *mem;
+  uchar *mem2; /* second buffer of the async mode */
   BIO_t *bio;
+  pthread_mutex_t lock; /* of @bio, see PYBIO_LOCK */
 } BIO_Object;
 
+/**
+ *  All methods take the lock of the object, as the GIL is released
+ *  while writing; the GIL is never held while waiting for the lock
+ *  (it is released first), otherwise the owner of the lock could
+ *  wait for the GIL forever
+ */
+#define PYBIO_LOCK(self) do {                           \
+    if (0 != pthread_mutex_trylock (&(self)->lock))     \
+      {                                                 \
+        Py_BEGIN_ALLOW_THREADS                          \
+        pthread_mutex_lock (&(self)->lock);             \
+        Py_END_ALLOW_THREADS                            \
+      }                                                 \
+  } while (0)
+#define PYBIO_UNLOCK(self) pthread_mutex_unlock (&(self)->lock)
+
 
 /* external PyMethod definitions */
 #define PyDECLARE(name) \
@@ -111,6 +136,13 @@ PyBIO_DECLARE (pybio_putln);
 /* put str */
 PyBIO_DECLARE (pybio_fputs);
 PyBIO_DECLARE (pybio_puts);
+/* bulk write */
+PyBIO_DECLARE (pybio_write);
+PyBIO_DECLARE (pybio_putall);
+PyBIO_DECLARE (pybio_putlines);
+/* async mode */
+PyBIO_DECLARE (pybio_setasync);
+PyBIO_DECLARE (pybio_sync);
 
 /* BIO_Object allocator and destructor */
 PYBIODEFF BIO_Object_alloc (PyTypeObject *type, PyObject *args, PyObject *kwds);
@@ -166,12 +198,42 @@ static PyMethodDef bio_funs[] =
       "like put function, also puts a newline\n"
       "\nParameters:\n"
       "  b (bytes): input bytes"
+    },{
+      "write", (PyCFunction)pybio_write, METH_VARARGS,
+      "write(buffer b)\n"
+      "to put a bytes-like object (bytes, bytearray, memoryview...)\n"
+      "\nParameters:\n"
+      "  b (buffer): input buffer"
+    },{
+      "putall", (PyCFunction)pybio_putall, METH_VARARGS,
+      "putall(iterable it)\n"
+      "to put all items of @it in one call\n"
+      "\nParameters:\n"
+      "  it (iterable): of str, bytes or bytes-like objects"
+    },{
+      "putlines", (PyCFunction)pybio_putlines, METH_VARARGS,
+      "putlines(iterable it)\n"
+      "like putall, also puts a newline after each item\n"
+      "\nParameters:\n"
+      "  it (iterable): of str, bytes or bytes-like objects"
     },{
       "flush", (PyCFunction)pybio_flush, METH_NOARGS,
       "flush the buffer"
     },{
       "flushln", (PyCFunction)pybio_flushln, METH_NOARGS,
       "like flush, also puts a newline"
+    },{
+      "set_async", (PyCFunction)pybio_setasync, METH_VARARGS,
+      "set_async(bool on)\n"
+      "to enable or disable the async mode, where a background\n"
+      "thread writes one buffer while the other one is filled\n"
+      "\nParameters:\n"
+      "  on (bool): enable or disable\n"
+    },{
+      "sync", (PyCFunction)pybio_sync, METH_NOARGS,
+      "sync()\n"
+      "waits for the pending background write (async mode)\n"
+      "returns errno of the last failed write, or 0"
     },
     {NULL}
 };
@@ -204,7 +266,9 @@ PYBIODEFF
 pybio_flush (BIO_Object *self, PyObject *args)
 {
   UNUSED (args);
+  PYBIO_LOCK (self);
   bio_flush (self->bio);
+  PYBIO_UNLOCK (self);
   printd ("bio flush\n");
   Py_RETURN_NONE;
 }
@@ -213,7 +277,9 @@ PYBIODEFF
 pybio_flushln (BIO_Object *self, PyObject *args)
 {
   UNUSED (args);
+  PYBIO_LOCK (self);
   bio_flushln (self->bio);
+  PYBIO_UNLOCK (self);
   printd ("bio flush with newline\n");
   Py_RETURN_NONE;
 }
@@ -227,7 +293,9 @@ pybio_putc (BIO_Object *self, PyObject *args)
       if (!PyArg_ParseTuple (args, "s", &str))
         Py_RETURN_NONE;
 
+      PYBIO_LOCK (self);
       bio_putc (self->bio, *str);
+      PYBIO_UNLOCK (self);
     }
   Py_RETURN_NONE;
 }
@@ -241,7 +309,9 @@ pybio_fputs (BIO_Object *self, PyObject *args)
       if (!PyArg_ParseTuple (args, "s", &str))
         Py_RETURN_NONE;
 
+      PYBIO_LOCK (self);
       bio_fputs (self->bio, str);
+      PYBIO_UNLOCK (self);
     }
   Py_RETURN_NONE;
 }
@@ -255,7 +325,9 @@ pybio_puts (BIO_Object *self, PyObject *args)
       if (!PyArg_ParseTuple (args, "s", &str))
         Py_RETURN_NONE;
 
+      PYBIO_LOCK (self);
       bio_puts (self->bio, str);
+      PYBIO_UNLOCK (self);
     }
   Py_RETURN_NONE;
 }
@@ -275,7 +347,9 @@ pybio_put (BIO_Object *self, PyObject *args)
         Py_RETURN_NONE;
       bytes_len = PyBytes_Size (bytes_obj);
 
+      PYBIO_LOCK (self);
       bio_put (self->bio, bytes_ptr, bytes_len);
+      PYBIO_UNLOCK (self);
     }
   Py_RETURN_NONE;
 }
@@ -295,11 +369,207 @@ pybio_putln (BIO_Object *self, PyObject *args)
         Py_RETURN_NONE;
       bytes_len = PyBytes_Size (bytes_obj);
 
+      PYBIO_LOCK (self);
       bio_putln (self->bio, bytes_ptr, bytes_len);
+      PYBIO_UNLOCK (self);
+    }
+  Py_RETURN_NONE;
+}
+
+/* bio_put for lengths beyond int */
+static void
+__pybio_put (BIO_t *bio, const char *ptr, Py_ssize_t len, int newline)
+{
+  for (; len > INT_MAX / 2; len -= INT_MAX / 2, ptr += INT_MAX / 2)
+    bio_put (bio, ptr, INT_MAX / 2);
+  if (newline)
+    bio_putln (bio, ptr, len);
+  else
+    bio_put (bio, ptr, len);
+}
+
+PYBIODEFF
+pybio_write (BIO_Object *self, PyObject *args)
+{
+  if (self && self->bio)
+    {
+      Py_buffer view;
+      if (!PyArg_ParseTuple (args, "y*", &view))
+        return NULL;
+
+      Py_BEGIN_ALLOW_THREADS
+      pthread_mutex_lock (&self->lock);
+      __pybio_put (self->bio, view.buf, view.len, 0);
+      pthread_mutex_unlock (&self->lock);
+      Py_END_ALLOW_THREADS
+      PyBuffer_Release (&view);
+    }
+  Py_RETURN_NONE;
+}
+
+/**
+ *  internal function, gets pointer and length of @item
+ *  @view is only used (and must be released) when
+ *  @item is neither str nor bytes
+ *  returns -1 on failure (the Python error is set)
+ */
+static int
+__pybio_item (PyObject *item, const char **ptr, Py_ssize_t *len,
+              Py_buffer *view)
+{
+  view->obj = NULL;
+  if (PyUnicode_Check (item))
+    {
+      *ptr = PyUnicode_AsUTF8AndSize (item, len);
+      return (*ptr) ? 0 : -1;
+    }
+  if (PyBytes_Check (item))
+    {
+      char *p;
+      if (PyBytes_AsStringAndSize (item, &p, len) < 0)
+        return -1;
+      *ptr = p;
+      return 0;
+    }
+  if (PyObject_GetBuffer (item, view, PyBUF_SIMPLE) < 0)
+    return -1;
+  *ptr = view->buf;
+  *len = view->len;
+  return 0;
+}
+
+/**
+ *  puts items of the iterable @args[0]
+ *  items are collected in batches of PUT_BATCH (holding
+ *  references), then written while the GIL is released
+ */
+static PyObject *
+__pybio_putiter (BIO_Object *self, PyObject *args, int newline)
+{
+  PyObject *iterable, *it, *item;
+  PyObject *items[PUT_BATCH];
+  const char *ptrs[PUT_BATCH];
+  Py_ssize_t lens[PUT_BATCH];
+  Py_buffer views[PUT_BATCH];
+  int n = 0, failed = 0;
+
+  if (!self || !self->bio)
+    Py_RETURN_NONE;
+  if (!PyArg_ParseTuple (args, "O", &iterable))
+    return NULL;
+  if (!(it = PyObject_GetIter (iterable)))
+    return NULL;
+
+  do {
+    if ((item = PyIter_Next (it)))
+      {
+        if (__pybio_item (item, ptrs + n, lens + n, views + n) < 0)
+          {
+            Py_DECREF (item);
+            failed = 1;
+          }
+        else
+          items[n++] = item;
+      }
+    else if (PyErr_Occurred ())
+      failed = 1;
+
+    if (n == PUT_BATCH || (n > 0 && (!item || failed)))
+      {
+        BIO_t *bio = self->bio;
+        Py_BEGIN_ALLOW_THREADS
+        pthread_mutex_lock (&self->lock);
+        for (int i = 0; i < n; ++i)
+          __pybio_put (bio, ptrs[i], lens[i], newline);
+        pthread_mutex_unlock (&self->lock);
+        Py_END_ALLOW_THREADS
+
+        for (int i = 0; i < n; ++i)
+          {
+            if (views[i].obj)
+              PyBuffer_Release (views + i);
+            Py_DECREF (items[i]);
+          }
+        printd ("bio bulk write of %d items\n", n);
+        n = 0;
+      }
+  } while (item && !failed);
+
+  Py_DECREF (it);
+  if (failed)
+    return NULL;
+  Py_RETURN_NONE;
+}
+
+PYBIODEFF
+pybio_putall (BIO_Object *self, PyObject *args)
+{
+  return __pybio_putiter (self, args, 0);
+}
+
+PYBIODEFF
+pybio_putlines (BIO_Object *self, PyObject *args)
+{
+  return __pybio_putiter (self, args, 1);
+}
+
+PYBIODEFF
+pybio_setasync (BIO_Object *self, PyObject *args)
+{
+  if (self && self->bio)
+    {
+      int on, ret;
+      if (!PyArg_ParseTuple (args, "p", &on))
+        return NULL;
+
+      PYBIO_LOCK (self);
+      if (on && !self->mem2)
+        {
+          if (!(self->mem2 = malloc (self->bio->len)))
+            {
+              PYBIO_UNLOCK (self);
+              return PyErr_NoMemory ();
+            }
+          if ((ret = bio_async_init (self->bio, self->mem2)) != 0)
+            {
+              free (self->mem2);
+              self->mem2 = NULL;
+              PYBIO_UNLOCK (self);
+              errno = ret;
+              return PyErr_SetFromErrno (PyExc_OSError);
+            }
+          printd ("bio async mode, mem2 @%p\n", self->mem2);
+        }
+      else if (!on && self->mem2)
+        {
+          Py_BEGIN_ALLOW_THREADS
+          bio_async_free (self->bio);
+          Py_END_ALLOW_THREADS
+          free (self->mem2);
+          self->mem2 = NULL;
+          printd ("bio async mode was disabled\n");
+        }
+      PYBIO_UNLOCK (self);
     }
   Py_RETURN_NONE;
 }
 
+PYBIODEFF
+pybio_sync (BIO_Object *self, PyObject *args)
+{
+  int ret = 0;
+  UNUSED (args);
+  if (self && self->bio)
+    {
+      Py_BEGIN_ALLOW_THREADS
+      pthread_mutex_lock (&self->lock);
+      ret = bio_sync (self->bio);
+      pthread_mutex_unlock (&self->lock);
+      Py_END_ALLOW_THREADS
+    }
+  return PyLong_FromLong (ret);
+}
+
 PYBIODEFF
 BIO_Object_alloc (PyTypeObject *type, PyObject *args, PyObject *kwds)
 {
@@ -315,6 +585,7 @@ BIO_Object_alloc (PyTypeObject *type, PyObject *args, PyObject *kwds)
 
   if ((self = (BIO_Object *)type->tp_alloc (type, 0)))
     {
+      pthread_mutex_init (&self->lock, NULL);
       self->bio = malloc (sizeof (BIO_t));
       self->mem = malloc (cap);
       if (!self->bio || !self->mem)
@@ -352,7 +623,9 @@ pybio_setofd (BIO_Object *self, PyObject *args)
           Py_RETURN_NONE;
         }
 
+      PYBIO_LOCK (self);
       bio_out (self->bio, fd);
+      PYBIO_UNLOCK (self);
       printd ("bip output fd was changed to %d\n", fd);
     }
   Py_RETURN_NONE;
@@ -366,8 +639,14 @@ BIO_Object_free (BIO_Object *self)
       printd ("bio flush before destroying\n");
       bio_flush (self->bio);
     }
+  if (self->mem2)
+    {
+      bio_async_free (self->bio);
+      free (self->mem2);
+    }
   printd ("bio @%p was destroyed\n", self->bio);
   free (self->bio);
+  pthread_mutex_destroy (&self->lock);
   (Py_TYPE (self))->tp_free ((PyObject *) self);
 }
 
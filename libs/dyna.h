@@ -104,10 +104,27 @@
     }
     ```
   
+    Allocators:
+      By default arrays live on the heap (see dyna_alloc)
+      To use an inline stack buffer, that only moves to the
+      heap when it overflows its initial capacity:
+      ```c
+      da_buf_t (int, 16) buf;
+      int *arr = da_newbuf (int, buf);
+      ```
+      To use some other allocator (see da_allocator):
+      ```c
+      #include "arena.h"  // before dyna.h
+      da_allocator al = da_arena_allocator (&A);
+      char **arr = da_newa (char *, 8, &al);
+      ```
+      The @al must remain valid as long as the array is used
+
     Options:
       `_DA_DEBUG`:  to print some debugging information
       `DA_INICAP`:  the default initial capacity of arrays
-      `DA_DO_GRO`:  to define how arrays grow
+      `DA_DO_GROW`: to define how arrays grow (the default
+                    growth policy, see da_allocator::grow)
       `DA_GFACT`:   growth factor (see the source code)
       `DA_FORCE_MEMCPY`:
                     to force using memcpy for assignments
@@ -177,6 +194,25 @@
 #define _Nullable
 #endif
 
+/**
+ *  Allocator hook of dynamic arrays
+ *  @alloc:  must return memory aligned to 8
+ *  @free:   optional, NULL means the memory is never freed
+ *  @grow:   optional growth policy, returns the new capacity
+ *           which must be at least @needed (default: DA_DO_GROW)
+ *  @ctx:    passed to @alloc and @free (e.g. an arena)
+ */
+typedef struct
+{
+  void *(*alloc) (void *ctx, size_t size);
+  void (*free) (void *ctx, void *ptr);
+  da_idx (*grow) (da_idx cap, da_idx needed);
+  void *ctx;
+} da_allocator;
+
+/* dyna_t flags */
+#define DA_F_INLINE 1 /* lives in a user buffer, see da_newbuf */
+
 /**
  *  Internal struct
  *  Users do not need to interact with it directly
@@ -186,6 +222,8 @@ typedef struct
   da_idx cap; /* capacity of array */
   da_idx size; /* length of array */
   da_idx cell_bytes; /* size of each cell */
+  da_idx flags;
+  const da_allocator *allocator; /* NULL means heap (dyna_alloc) */
 
   /* Actual bytes of array */
 #if defined(__GNUC__) || defined(__clang__)
@@ -255,9 +293,16 @@ typedef struct
  *  generic type purposes and safety
  */
 DYNADEF dyna_t * __mk_da (int n, int cell_bytes);
+DYNADEF dyna_t * __mk_da2 (int n, int cell_bytes, const da_allocator *);
+DYNADEF dyna_t * __mk_dabuf (void *buf, size_t size, int cell_bytes);
+DYNADEF void __da_release (dyna_t *);
 DYNADEF void * __da_dup (void *);
 DYNADEF int __da_popn (void *, int n);
 DYNADEF da_sidx __da_allocate (void *, int n, int cell_bytes);
+DYNADEF int __da_reserve (void *, int n, int cell_bytes);
+DYNADEF da_sidx __da_appendn (void *, const void *src, int n, int cell_bytes);
+DYNADEF da_sidx __da_bsearch (const void *arr, const void *key, int cell_bytes,
+                              int (*cmp) (const void *, const void *));
 #define __da_allocate1(ptr, cell_bytes) \
   __da_allocate (ptr, 1, cell_bytes)
 
@@ -286,7 +331,7 @@ DYNADEF da_sidx __da_allocate (void *, int n, int cell_bytes);
     if (NULL != arr) {                              \
       dyna_t *__da__ = DA_CONTAINEROF (arr);        \
       da_dprintf ("Destroying dyna @%p\n", __da__); \
-      dyna_free (__da__);                           \
+      __da_release (__da__);                        \
     }} while (0)
 
 // To get length and capacity of @arr
@@ -311,6 +356,42 @@ DYNADEF da_sidx __da_allocate (void *, int n, int cell_bytes);
 #define da_newn(T, n) \
   ((T *)( ( (dyna_t *) __mk_da (n, sizeof (T)) )->arr ))
 
+/**
+ *  Create a new dynamic array, using the allocator @al
+ *  (da_allocator *) which must outlive the array
+ */
+#define da_newa(T, n, al) \
+  ((T *)( ( (dyna_t *) __mk_da2 (n, sizeof (T), al) )->arr ))
+
+/**
+ *  Create a new dynamic array inside the buffer @buf
+ *  The buffer must be declared via `da_buf_t (T, n) buf;`
+ *  When the array needs more than @n cells, it moves to the heap
+ *  so @buf must outlive the array only until then, and
+ *  da_free must be called as usual
+ */
+#define da_buf_t(T, n)                                    \
+  union {                                                 \
+    dyna_t __hdr;                                         \
+    char __buf[sizeof (dyna_t) + (n) * sizeof (T)];       \
+  }
+#define da_newbuf(T, buf) \
+  ((T *)( __mk_dabuf (&(buf), sizeof (buf), sizeof (T))->arr ))
+
+/**
+ *  Allocator of the arena @A (Arena *)
+ *  Only when arena.h is included before dyna.h
+ *  The arrays do not need to be freed, see arena_free
+ */
+#ifdef ARENA_H__
+# ifndef DA_ARENA_FLAGS
+#  define DA_ARENA_FLAGS AUSE_MALLOC
+# endif
+# define da_arena_allocator(A) \
+  (da_allocator){.alloc = __da_arena_alloc, .ctx = (A)}
+DYNADEF void *__da_arena_alloc (void *A, size_t size);
+#endif
+
 /**
  *  Duplicate a dynamic array
  *  returns a pointer to a new dynamic array
@@ -387,6 +468,172 @@ DYNADEF da_sidx __da_allocate (void *, int n, int cell_bytes);
 #define da_allocate(arr, n) __da_allocate (&arr, n, sizeof (*(arr)))
 #define da_allocate1(arr) __da_allocate1 (&arr, sizeof (*(arr)))
 
+/**
+ *  Reserve space for @n more cells in @arr
+ *  Does not change the size of @arr, so the next @n
+ *  appends will not reallocate
+ *  returns 0 on success and -1 on failure
+ */
+#define da_reserve(arr, n) __da_reserve (&(arr), n, sizeof (*(arr)))
+
+/**
+ *  Appends @n cells from @src (a C array) to @arr
+ *  with a single allocation and memcpy
+ *  @src may point inside @arr itself
+ *  returns index of the first appended cell or -1
+ */
+#define da_appendn(arr, src, n) \
+  __da_appendn (&(arr), src, n, sizeof (*(arr)))
+
+/**
+ *  Sort and search, with qsort and bsearch
+ *  @cmp is the usual comparison function of qsort
+ *  da_bsearch returns index of @key (a pointer) in @arr or -1
+ *  @arr must be sorted
+ */
+#define da_sort(arr, cmp) do {                                  \
+    if (NULL != arr)                                            \
+      qsort (arr, da_sizeof (arr), sizeof (*(arr)), cmp);       \
+  } while (0)
+#define da_bsearch(arr, key, cmp) \
+  __da_bsearch (arr, key, sizeof (*(arr)), cmp)
+
+/**
+ *  Typed sort and search functions
+ *  The faster alternative of da_sort, for the cell type @T
+ *  `DA_DEF_SORT (suffix, T, LESS)` defines:
+ *
+ *    void da_sort_suffix (T *arr):
+ *      in-place introsort of the dynamic array @arr
+ *    da_idx da_lbound_suffix (const T *arr, T key):
+ *      index of the first cell not less than @key
+ *    da_sidx da_find_suffix (const T *arr, T key):
+ *      index of @key in the sorted @arr, or -1
+ *
+ *  @LESS (a, b) must be a strict weak ordering
+ *  These are defined for: int, uint, long, size (size_t)
+ *  and str (const char *, by strcmp)
+ */
+#define DA_LESS(a, b) ((a) < (b))
+#define DA_STRLESS(a, b) (strcmp ((a), (b)) < 0)
+#define DA_SORT_ISORT 16 /* insertion sort threshold */
+
+#define DA_DEF_SORT(suffix, T, LESS)                                    \
+  static inline void                                                    \
+  __da_isort_##suffix (T *a, da_idx lo, da_idx hi)                      \
+  {                                                                     \
+    for (da_idx i = lo + 1; i < hi; ++i)                                \
+      {                                                                 \
+        T x = a[i];                                                     \
+        da_idx j = i;                                                   \
+        for (; j > lo && LESS (x, a[j - 1]); --j)                       \
+          a[j] = a[j - 1];                                              \
+        a[j] = x;                                                       \
+      }                                                                 \
+  }                                                                     \
+  static inline void                                                    \
+  __da_sift_##suffix (T *a, da_idx i, da_idx n)                         \
+  {                                                                     \
+    T x = a[i];                                                         \
+    for (da_idx c; (c = 2 * i + 1) < n; i = c)                          \
+      {                                                                 \
+        if (c + 1 < n && LESS (a[c], a[c + 1]))                         \
+          ++c;                                                          \
+        if (! LESS (x, a[c]))                                           \
+          break;                                                        \
+        a[i] = a[c];                                                    \
+      }                                                                 \
+    a[i] = x;                                                           \
+  }                                                                     \
+  static inline void                                                    \
+  __da_hsort_##suffix (T *a, da_idx n)                                  \
+  {                                                                     \
+    for (da_idx i = n / 2; i-- > 0; )                                   \
+      __da_sift_##suffix (a, i, n);                                     \
+    for (da_idx end = n - 1; end > 0; --end)                            \
+      {                                                                 \
+        T x = a[0]; a[0] = a[end]; a[end] = x;                          \
+        __da_sift_##suffix (a, 0, end);                                 \
+      }                                                                 \
+  }                                                                     \
+  static void                                                           \
+  __da_introsort_##suffix (T *a, da_idx lo, da_idx hi, int depth)       \
+  {                                                                     \
+    T x;                                                                \
+    while (hi - lo > DA_SORT_ISORT)                                     \
+      {                                                                 \
+        if (depth-- == 0)                                               \
+          {                                                             \
+            __da_hsort_##suffix (a + lo, hi - lo);                      \
+            return;                                                     \
+          }                                                             \
+        /* median of three, a[lo] <= a[m] <= a[hi - 1] */              \
+        da_idx m = lo + (hi - lo) / 2, i = lo - 1, j = hi;              \
+        if (LESS (a[m], a[lo]))                                         \
+          { x = a[m]; a[m] = a[lo]; a[lo] = x; }                        \
+        if (LESS (a[hi - 1], a[m]))                                     \
+          {                                                             \
+            x = a[m]; a[m] = a[hi - 1]; a[hi - 1] = x;                  \
+            if (LESS (a[m], a[lo]))                                     \
+              { x = a[m]; a[m] = a[lo]; a[lo] = x; }                    \
+          }                                                             \
+        T p = a[m];                                                     \
+        /* Hoare partition, [lo, j] <= p <= [j + 1, hi) */             \
+        for (;;)                                                        \
+          {                                                             \
+            do ++i; while (LESS (a[i], p));                             \
+            do --j; while (LESS (p, a[j]));                             \
+            if (i >= j)                                                 \
+              break;                                                    \
+            x = a[i]; a[i] = a[j]; a[j] = x;                            \
+          }                                                             \
+        /* recurse into the smaller part */                             \
+        if (j + 1 - lo < hi - j - 1)                                    \
+          {                                                             \
+            __da_introsort_##suffix (a, lo, j + 1, depth);              \
+            lo = j + 1;                                                 \
+          }                                                             \
+        else                                                            \
+          {                                                             \
+            __da_introsort_##suffix (a, j + 1, hi, depth);              \
+            hi = j + 1;                                                 \
+          }                                                             \
+      }                                                                 \
+    __da_isort_##suffix (a, lo, hi);                                    \
+  }                                                                     \
+  DYNADEF void                                                          \
+  da_sort_##suffix (T *arr)                                             \
+  {                                                                     \
+    da_idx n = da_sizeof (arr);                                         \
+    int depth = 0;                                                      \
+    for (da_idx k = n; k > 1; k >>= 1)                                  \
+      depth += 2;                                                       \
+    if (n > 1)                                                          \
+      __da_introsort_##suffix (arr, 0, n, depth);                       \
+  }                                                                     \
+  DYNADEF da_idx                                                        \
+  da_lbound_##suffix (const T *arr, T key)                              \
+  {                                                                     \
+    da_idx lo = 0, hi = da_sizeof (arr);                                \
+    while (lo < hi)                                                     \
+      {                                                                 \
+        da_idx m = lo + (hi - lo) / 2;                                  \
+        if (LESS (arr[m], key))                                         \
+          lo = m + 1;                                                   \
+        else                                                            \
+          hi = m;                                                       \
+      }                                                                 \
+    return lo;                                                          \
+  }                                                                     \
+  DYNADEF da_sidx                                                       \
+  da_find_##suffix (const T *arr, T key)                                \
+  {                                                                     \
+    da_idx i = da_lbound_##suffix (arr, key);                           \
+    if (i < (da_idx) da_sizeof (arr) && ! LESS (key, arr[i]))           \
+      return i;                                                         \
+    return -1;                                                          \
+  }
+
 /**
  *  Drops contents of a dynamic array
  *  It only sets the size of @arr to zero,
@@ -441,14 +688,33 @@ DYNADEF da_sidx __da_allocate (void *, int n, int cell_bytes);
 
 dyna_t *
 __mk_da (int n, int cell_size)
+{
+  return __mk_da2 (n, cell_size, NULL);
+}
+
+/* internal, allocates @size bytes, for the array of @al */
+static inline void *
+__da_alloc (const da_allocator *al, size_t size)
+{
+  if (NULL == al)
+    return dyna_alloc (size);
+  return al->alloc (al->ctx, size);
+}
+
+dyna_t *
+__mk_da2 (int n, int cell_size, const da_allocator *al)
 {
   if (0 == n)
     n = 1; /* prevent 0 capacity initialization */
   size_t ptrlen = sizeof (dyna_t) + cell_size * n;
-  dyna_t *da = (dyna_t *) dyna_alloc (ptrlen);
+  dyna_t *da = (dyna_t *) __da_alloc (al, ptrlen);
+  if (NULL == da)
+    return NULL;
   da->cap = n;
   da->size = 0;
   da->cell_bytes = cell_size;
+  da->flags = 0;
+  da->allocator = al;
 
   da_dprintf ("Allocated dyna, cell_size: %luB, capacity: %lu, "
               "size: %luB (%luB metadata + %luB array)  @%p\n",
@@ -464,43 +730,179 @@ __mk_da (int n, int cell_size)
   return da;
 }
 
+dyna_t *
+__mk_dabuf (void *buf, size_t size, int cell_size)
+{
+  dyna_t *da = (dyna_t *) buf;
+  da->cap = (size - sizeof (dyna_t)) / cell_size;
+  da->size = 0;
+  da->cell_bytes = cell_size;
+  da->flags = DA_F_INLINE;
+  da->allocator = NULL;
+  da_dprintf ("Inline dyna, cell_size: %luB, capacity: %lu  @%p\n",
+              (size_t) cell_size, (size_t) da->cap, da);
+  return da;
+}
+
+DYNADEF void
+__da_release (dyna_t *da)
+{
+  if (da->flags & DA_F_INLINE)
+    return;
+  if (NULL == da->allocator)
+    dyna_free (da);
+  else if (NULL != da->allocator->free)
+    da->allocator->free (da->allocator->ctx, da);
+}
+
+#ifdef ARENA_H__
+DYNADEF void *
+__da_arena_alloc (void *A, size_t size)
+{
+  /* arena allocations are not aligned */
+  char *p = arena_alloc ((Arena *) A, size + 7, DA_ARENA_FLAGS);
+  if (NULL == p)
+    return NULL;
+  return p + (-(uintptr_t) p & 7);
+}
+#endif
+
+/**
+ *  internal, moves @da to a new memory of @new_size bytes
+ *  only the first @old_size bytes are preserved
+ */
+static inline dyna_t *
+__da_move (dyna_t *da, size_t old_size, size_t new_size)
+{
+  dyna_t *new_da;
+  if (NULL == da->allocator && !(da->flags & DA_F_INLINE))
+    return dyna_realloc (da, new_size);
+
+  if (NULL == (new_da = __da_alloc (da->allocator, new_size)))
+    return NULL;
+  memcpy (new_da, da, old_size);
+  __da_release (da);
+  new_da->flags &= ~DA_F_INLINE;
+  return new_da;
+}
+
+/**
+ *  internal, moves @da to a memory of @cap cells
+ *  the @arr pointer is updated, returns NULL on failure
+ */
+static inline dyna_t *
+__da_resize (void **arr, dyna_t *da, da_idx cap)
+{
+  dyna_t *new_da;
+  new_da = __da_move (da, sizeof (dyna_t) + da->size * da->cell_bytes,
+                      sizeof (dyna_t) + cap * da->cell_bytes);
+  if (!new_da)
+    return NULL;
+  new_da->cap = cap;
+  *arr = new_da->arr;
+  return new_da;
+}
+
 DYNADEF da_sidx
 __da_allocate (void *__arr, int n, int cell_bytes)
 {
   dyna_t *da;
   void **arr = (void **)__arr;
-  size_t old_size, new_size;
+  da_idx old_size, needed;
 
   if (! *arr)
     {
-      da = __mk_da (n, cell_bytes);
+      if (NULL == (da = __mk_da (n, cell_bytes)))
+        return -1;
       *arr = da->arr;
     }
   else if (!(da = DA_CONTAINEROF (*arr)))
     return -1;
 
   old_size = da->size;
-  da->size += n;
-  if (da->size > da->cap)
+  needed = old_size + n;
+  if (needed > da->cap)
     {
       da_dprintf ("Not enough space, size: %lu, needed: %lu\n",
-                  (size_t) da->size,
-                  (size_t) da->size + (size_t) n);
-      {
-        da->cap = da->size;
-        new_size = sizeof (dyna_t) + da->cap * da->cell_bytes;
-        da = dyna_realloc (da, new_size);
-        if (!da)
-          return -1;
-        *arr = da->arr;
-      }
+                  (size_t) da->size, (size_t) needed);
+      da_idx cap = da->cap;
+      if (NULL != da->allocator && NULL != da->allocator->grow)
+        cap = da->allocator->grow (cap, needed);
+      else
+        while (cap < needed)
+          DA_DO_GROW (cap);
+      if (cap < needed)
+        cap = needed;
+      if (NULL == (da = __da_resize (arr, da, cap)))
+        return -1;
       da_dprintf ("Reallocated, new capacity: %lu\n",
                   (size_t) da->cap);
     }
 
-  return old_size++;
+  da->size = needed;
+  return old_size;
+}
+
+DYNADEF int
+__da_reserve (void *__arr, int n, int cell_bytes)
+{
+  dyna_t *da;
+  void **arr = (void **)__arr;
+
+  if (! *arr)
+    {
+      if (NULL == (da = __mk_da (n, cell_bytes)))
+        return -1;
+      *arr = da->arr;
+      return 0;
+    }
+  da = DA_CONTAINEROF (*arr);
+  if (da->size + n <= da->cap)
+    return 0;
+  if (NULL == __da_resize (arr, da, da->size + n))
+    return -1;
+  return 0;
+}
+
+DYNADEF da_sidx
+__da_appendn (void *__arr, const void *src, int n, int cell_bytes)
+{
+  da_sidx idx;
+  char **arr = (char **)__arr;
+  /* @src might be inside the array itself (e.g. da_appd_da) */
+  const char *old = *arr;
+  if (n <= 0)
+    return -1;
+  if (-1 == (idx = __da_allocate (__arr, n, cell_bytes)))
+    return -1;
+  if (NULL != old && (const char *) src >= old &&
+      (const char *) src < old + idx * cell_bytes)
+    src = *arr + ((const char *) src - old);
+  memcpy (*arr + idx * cell_bytes, src, (size_t) n * cell_bytes);
+  return idx;
+}
+
+/* internal, for da_bsearch */
+DYNADEF da_sidx
+__da_bsearch (const void *arr, const void *key, int cell_bytes,
+              int (*cmp) (const void *, const void *))
+{
+  const char *p;
+  if (NULL == arr)
+    return -1;
+  p = bsearch (key, arr, da_sizeof (arr), cell_bytes, cmp);
+  if (NULL == p)
+    return -1;
+  return (p - (const char *) arr) / cell_bytes;
 }
 
+/* typed sort and search functions */
+DA_DEF_SORT (int, int, DA_LESS)
+DA_DEF_SORT (uint, unsigned int, DA_LESS)
+DA_DEF_SORT (long, long, DA_LESS)
+DA_DEF_SORT (size, size_t, DA_LESS)
+DA_DEF_SORT (str, const char *, DA_STRLESS)
+
 /** DEPRECATED CODE SECTION **
  ** Do not use these functions, use __da_allocate instead
  **
@@ -550,9 +952,16 @@ __da_dup (void *__arr)
 {
   void **arr = (void **)__arr;
   dyna_t *da = DA_CONTAINEROF (*arr);
+  da_idx cap = (da->size > 0) ? da->size : 1;
   size_t lenof_da = da->size * da->cell_bytes + sizeof (dyna_t);
-  dyna_t *new_da = malloc (lenof_da);
+  dyna_t *new_da = dyna_alloc (sizeof (dyna_t) + cap * da->cell_bytes);
+  if (NULL == new_da)
+    return NULL;
   memcpy (new_da, da, lenof_da);
+  /* duplicates always live on the heap */
+  new_da->cap = cap;
+  new_da->flags = 0;
+  new_da->allocator = NULL;
   return &new_da->arr;
 }
 
@@ -576,6 +985,7 @@ __da_popn (void *_Nullable __arr, int n)
 #ifdef DYNA_TEST
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
 
 #define LOG(fmt, ...) fprintf (stderr, fmt, ##__VA_ARGS__)
 #define STRCOLOR(code, cstr) "\033[" #code "m" cstr "\033[0m"
@@ -596,6 +1006,31 @@ __da_popn (void *_Nullable __arr, int n)
     (exp_v == true);  /* return value */                 \
   })
 
+/* bump allocator, for the allocator test */
+static char test_pool[4096];
+static size_t test_pool_len;
+static void *
+test_alloc (void *ctx, size_t size)
+{
+  (void) ctx;
+  void *p = test_pool + test_pool_len;
+  test_pool_len += (size + 7) & ~7;
+  return p;
+}
+
+static int
+test_intcmp (const void *a, const void *b)
+{
+  return *(const int *) a - *(const int *) b;
+}
+
+static da_idx
+test_grow (da_idx cap, da_idx needed)
+{
+  while (cap < needed)
+    cap += 3;
+  return cap;
+}
 
 int
 main (void)
@@ -713,7 +1148,7 @@ main (void)
     tassert (da_sizeof (carr) == 6,
              "sizeof array after popN 6 elements");
 
-    da_pop(carr);  da_pop(carr);
+    da_pop1 (carr);  da_pop1 (carr);
     tassert (da_sizeof (carr) == 4,
              "sizeof array after 2 other pops");
     tassert (strncmp (carr, "0123", 4) == 0,
@@ -732,9 +1167,9 @@ main (void)
     tassert (da_sizeof (carr) == 0, "popN all elements");
 
     da_appd (carr, '*');
-    da_pop (carr);
+    da_pop1 (carr);
     tassert (da_sizeof (carr) == 0, "pop latest elements");
-    da_pop (carr);  da_pop (carr);
+    da_pop1 (carr);  da_pop1 (carr);
     tassert (da_sizeof (carr) == 0, "pop empty array");
 
     da_appd (carr, '*');
@@ -744,6 +1179,91 @@ main (void)
     tassert (da_sizeof (carr) == 0, "delete from empty array");
   }
 
+  puts ("\n * Inline buffer and allocator test *");
+  {
+    da_buf_t (int, 4) buf;
+    int *numbers = da_newbuf (int, buf);
+    int v;
+    for (v = 0; v < 4; ++v)
+      da_appd (numbers, v);
+    tassert ((void *) numbers == (void *) buf.__hdr.arr &&
+             da_capof (numbers) == 4,
+             "inline buffer before overflow");
+    da_appd (numbers, v);
+    tassert ((void *) numbers != (void *) buf.__hdr.arr &&
+             da_sizeof (numbers) == 5 &&
+             numbers[0] == 0 && numbers[4] == 4,
+             "inline buffer moves to heap at overflow");
+    da_free (numbers);
+
+    da_allocator al = {.alloc = test_alloc, .grow = test_grow};
+    char *carr = da_newa (char, 2, &al);
+    da_appd_arr (carr, "0123", 4);
+    tassert (da_capof (carr) == 5 && test_pool_len > 0,
+             "custom allocator and growth policy");
+    da_appd_arr (carr, "4567", 4);
+    tassert (da_capof (carr) == 8 && strncmp (carr, "01234567", 8) == 0,
+             "contents after growth");
+    char *dup = da_dup (carr);
+    tassert (DA_CONTAINEROF (dup)->allocator == NULL &&
+             strncmp (dup, carr, 8) == 0, "duplicate lives on the heap");
+    da_free (dup);
+    da_free (carr);
+  }
+
+  puts ("\n * Reserve, bulk append, sort and search test *");
+  {
+    long *arr = NULL;
+    tassert (0 == da_reserve (arr, 1000) && da_capof (arr) == 1000 &&
+             da_sizeof (arr) == 0, "reserve on NULL array");
+    for (long i = 0; i < 1000; ++i)
+      da_appd (arr, (i * 7919) % 1000);
+    tassert (da_capof (arr) == 1000, "no reallocation after reserve");
+    tassert (1000 == da_appendn (arr, arr, 1000) && da_sizeof (arr) == 2000
+             && arr[1000] == 0 && arr[1999] == arr[999],
+             "bulk append of the array itself");
+
+    da_sort_long (arr);
+    int sorted = 1;
+    for (da_idx i = 0; i < 2000; ++i)
+      sorted &= (arr[i] == (long) i / 2);
+    tassert (sorted, "introsort of long array");
+    tassert (da_lbound_long (arr, 500) == 1000 &&
+             da_find_long (arr, 999) == 1998 &&
+             da_find_long (arr, 1000) == -1, "binary search");
+    da_free (arr);
+
+    /* many duplicates and the heapsort fallback */
+    unsigned int *u = NULL;
+    for (unsigned int i = 0; i < 5000; ++i)
+      da_appd (u, (i & 1) ? i % 3 : 5000 - i);
+    da_sort_uint (u);
+    sorted = 1;
+    for (da_idx i = 1; i < 5000; ++i)
+      sorted &= (u[i - 1] <= u[i]);
+    tassert (sorted, "introsort with duplicates");
+    da_free (u);
+
+    const char *words[] = {"delta", "alpha", "echo", "charlie", "bravo"};
+    const char **strs = NULL;
+    da_appendn (strs, words, 5);
+    da_sort_str (strs);
+    tassert (0 == strcmp (strs[0], "alpha") &&
+             0 == strcmp (strs[4], "echo") &&
+             2 == da_find_str (strs, "charlie") &&
+             -1 == da_find_str (strs, "foxtrot"), "string sort and search");
+
+    int *ints = NULL;
+    int ivals[] = {5, 3, 9, 1};
+    da_appendn (ints, ivals, 4);
+    da_sort (ints, test_intcmp);
+    int key = 9;
+    tassert (ints[0] == 1 && 3 == da_bsearch (ints, &key, test_intcmp),
+             "qsort and bsearch");
+    da_free (ints);
+    da_free (strs);
+  }
+
   puts ("\n * "   STRGREEN("All tests passed")   " *");
   return EXIT_SUCCESS;
 }
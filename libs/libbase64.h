@@ -32,7 +32,17 @@
     Options:
       define `B64_NO_STREAM`: to not include stream
         encoder and decoder functions
-      `EOBUFFER_B64` and `INVALID_B64`: to check errors
+      define `B64_NO_SIMD`: to disable SIMD kernels
+        by default, on x86 SSSE3 / AVX2 kernels are chosen
+        at runtime (based on the CPU) and NEON on aarch64
+        they only handle the bulk of the input, tails and
+        invalid input are always handled by the scalar code
+      define `B64_STREAM_BUF`: buffer size of the stream
+        functions (default: 64KiB)
+      define `B64_NO_MMAP`: stream functions will not
+        mmap regular files and only use read(2)
+      `EOBUFFER_B64`, `INVALID_B64` and `EIO_B64`:
+        to check errors
   
     Compilation (self test program):
       cc -x c -ggdb -Wall -Wextra -Werror \
@@ -45,6 +55,13 @@
 
 #ifndef B64_NO_STREAM
 # include <unistd.h>
+# include <errno.h>
+# include <stdlib.h>
+# include <string.h>
+# include <sys/stat.h>
+# ifndef B64_NO_MMAP
+#  include <sys/mman.h>
+# endif
 #endif
 
 #ifndef B64DEFF
@@ -53,6 +70,7 @@
 
 #define EOBUFFER_B64 -1 // end of buffer
 #define INVALID_B64 -2 // invalid base64
+#define EIO_B64 -3 // read/write failure
 
 /* Bse64 decode/encode block */
 #define B64_DECODE_B 3
@@ -96,16 +114,409 @@ B64DEFF int b64_decode (const void *restrict src_v, int srclen,
 /**
  *  stream decoder and encoder
  *  @ifd, @ofd: input and output file descriptors
- *  returns number of bytes written on @ofd
+ *  returns number of bytes written on @ofd, on invalid
+ *  input, the data decoded before the invalid quantum is
+ *  written and INVALID_B64 is set on @error
+ *
+ *  they work on B64_STREAM_BUF blocks, regular files
+ *  are mapped (unless B64_NO_MMAP) and other files are read
+ *  the decoder skips white spaces (so wrapped input is fine),
+ *  and b64_stream_encode_wrap breaks lines after @wrap
+ *  characters (0: no wrapping)
  */
 #ifndef B64_NO_STREAM
-B64DEFF int b64_stream_decode (int ifd, int ofd, int *error);
-B64DEFF int b64_stream_encode (int ifd, int ofd, int *error);
+B64DEFF size_t b64_stream_decode (int ifd, int ofd, int *error);
+B64DEFF size_t b64_stream_encode (int ifd, int ofd, int *error);
+B64DEFF size_t b64_stream_encode_wrap (int ifd, int ofd, int wrap,
+                                       int *error);
 #endif
 
 
 #ifdef B64_IMPLEMENTATION
 
+/**
+ *  SIMD kernels
+ *  They encode/decode as many full blocks of @src as
+ *  they can, and advance @src and @dst; the rest is left
+ *  to the scalar code (tails, `=` and invalid characters)
+ *  returns number of bytes consumed from @src
+ */
+#ifndef B64_NO_SIMD
+# if (defined (__x86_64__) || defined (__i386__)) && defined (__GNUC__)
+#  include <immintrin.h>
+#  define B64_SIMD
+#  define B64_SIMD_X86
+# elif defined (__aarch64__) && defined (__ARM_NEON)
+#  include <arm_neon.h>
+#  define B64_SIMD
+#  define B64_SIMD_NEON
+# endif
+#endif
+
+#ifdef B64_SIMD
+#include <stddef.h>
+
+typedef size_t (*b64_kernel_t) (const unsigned char **src, size_t srclen,
+                                unsigned char **dst, size_t dstlen);
+
+static size_t
+__b64_none (const unsigned char **src, size_t srclen,
+            unsigned char **dst, size_t dstlen)
+{
+  (void) src, (void) srclen, (void) dst, (void) dstlen;
+  return 0;
+}
+
+#ifdef B64_SIMD_X86
+# define B64_SSSE3 __attribute__ ((target ("ssse3")))
+# define B64_AVX2 __attribute__ ((target ("avx2")))
+
+/**
+ *  @idx: 6-bit indexes -> base64 characters
+ *  idx 0..25 -> 'A', 26..51 -> 'a', 52..61 -> '0',
+ *  62 -> '+', 63 -> '/'; reduce @idx to a class number
+ *  and use pshufb to get the offset of that class
+ */
+B64_SSSE3 static inline __m128i
+__b64_enc_lookup_ssse3 (__m128i idx)
+{
+  const __m128i shift = _mm_setr_epi8 (
+    'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+    '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+    '/' - 63, 'A', 0, 0);
+  __m128i r = _mm_subs_epu8 (idx, _mm_set1_epi8 (51));
+  __m128i lt = _mm_cmpgt_epi8 (_mm_set1_epi8 (26), idx);
+  r = _mm_or_si128 (r, _mm_and_si128 (lt, _mm_set1_epi8 (13)));
+  return _mm_add_epi8 (_mm_shuffle_epi8 (shift, r), idx);
+}
+
+B64_AVX2 static inline __m256i
+__b64_enc_lookup_avx2 (__m256i idx)
+{
+  const __m256i shift = _mm256_setr_epi8 (
+    'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+    '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+    '/' - 63, 'A', 0, 0,
+    'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+    '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+    '/' - 63, 'A', 0, 0);
+  __m256i r = _mm256_subs_epu8 (idx, _mm256_set1_epi8 (51));
+  __m256i lt = _mm256_cmpgt_epi8 (_mm256_set1_epi8 (26), idx);
+  r = _mm256_or_si256 (r, _mm256_and_si256 (lt, _mm256_set1_epi8 (13)));
+  return _mm256_add_epi8 (_mm256_shuffle_epi8 (shift, r), idx);
+}
+
+/* 12 bytes -> 16 characters, loads 16 bytes */
+B64_SSSE3 static size_t
+__b64_enc_ssse3 (const unsigned char **src, size_t srclen,
+                 unsigned char **dst, size_t dstlen)
+{
+  const unsigned char *s = *src;
+  unsigned char *d = *dst;
+  const __m128i shuf = _mm_setr_epi8 (1, 0, 2, 1, 4, 3, 5, 4,
+                                      7, 6, 8, 7, 10, 9, 11, 10);
+
+  for (; srclen >= 16 && dstlen >= 16; srclen -= 12, dstlen -= 16)
+    {
+      __m128i in = _mm_loadu_si128 ((const __m128i *) s);
+      in = _mm_shuffle_epi8 (in, shuf);
+      /* move each 6-bit field to its own byte */
+      __m128i t0 = _mm_and_si128 (in, _mm_set1_epi32 (0x0fc0fc00));
+      __m128i t1 = _mm_mulhi_epu16 (t0, _mm_set1_epi32 (0x04000040));
+      __m128i t2 = _mm_and_si128 (in, _mm_set1_epi32 (0x003f03f0));
+      __m128i t3 = _mm_mullo_epi16 (t2, _mm_set1_epi32 (0x01000010));
+      __m128i out = __b64_enc_lookup_ssse3 (_mm_or_si128 (t1, t3));
+      _mm_storeu_si128 ((__m128i *) d, out);
+      s += 12;
+      d += 16;
+    }
+
+  size_t n = s - *src;
+  *src = s;
+  *dst = d;
+  return n;
+}
+
+/* 24 bytes -> 32 characters, loads 28 bytes */
+B64_AVX2 static size_t
+__b64_enc_avx2 (const unsigned char **src, size_t srclen,
+                unsigned char **dst, size_t dstlen)
+{
+  const unsigned char *s = *src;
+  unsigned char *d = *dst;
+  const __m256i shuf = _mm256_setr_epi8 (1, 0, 2, 1, 4, 3, 5, 4,
+                                         7, 6, 8, 7, 10, 9, 11, 10,
+                                         1, 0, 2, 1, 4, 3, 5, 4,
+                                         7, 6, 8, 7, 10, 9, 11, 10);
+
+  for (; srclen >= 28 && dstlen >= 32; srclen -= 24, dstlen -= 32)
+    {
+      __m256i in = _mm256_inserti128_si256 (
+        _mm256_castsi128_si256 (_mm_loadu_si128 ((const __m128i *) s)),
+        _mm_loadu_si128 ((const __m128i *) (s + 12)), 1);
+      in = _mm256_shuffle_epi8 (in, shuf);
+      __m256i t0 = _mm256_and_si256 (in, _mm256_set1_epi32 (0x0fc0fc00));
+      __m256i t1 = _mm256_mulhi_epu16 (t0, _mm256_set1_epi32 (0x04000040));
+      __m256i t2 = _mm256_and_si256 (in, _mm256_set1_epi32 (0x003f03f0));
+      __m256i t3 = _mm256_mullo_epi16 (t2, _mm256_set1_epi32 (0x01000010));
+      __m256i out = __b64_enc_lookup_avx2 (_mm256_or_si256 (t1, t3));
+      _mm256_storeu_si256 ((__m256i *) d, out);
+      s += 24;
+      d += 32;
+    }
+
+  size_t n = s - *src;
+  *src = s;
+  *dst = d;
+  return n + __b64_enc_ssse3 (src, srclen, dst, dstlen);
+}
+
+/**
+ *  16 characters -> 12 bytes, stores 16 bytes
+ *  characters are classified by their nibbles (lut_lo & lut_hi
+ *  must have no bit in common), any invalid character
+ *  (including `=`) stops the kernel before that block
+ */
+B64_SSSE3 static size_t
+__b64_dec_ssse3 (const unsigned char **src, size_t srclen,
+                 unsigned char **dst, size_t dstlen)
+{
+  const unsigned char *s = *src;
+  unsigned char *d = *dst;
+  const __m128i lut_lo = _mm_setr_epi8 (
+    0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+    0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+  const __m128i lut_hi = _mm_setr_epi8 (
+    0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  const __m128i lut_roll = _mm_setr_epi8 (
+    0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i m2f = _mm_set1_epi8 (0x2F);
+  const __m128i zero = _mm_setzero_si128 ();
+
+  for (; srclen >= 16 && dstlen >= 16; srclen -= 16, dstlen -= 12)
+    {
+      __m128i in = _mm_loadu_si128 ((const __m128i *) s);
+      __m128i hi = _mm_and_si128 (_mm_srli_epi32 (in, 4), m2f);
+      __m128i lo = _mm_and_si128 (in, m2f);
+      __m128i bad = _mm_and_si128 (_mm_shuffle_epi8 (lut_lo, lo),
+                                   _mm_shuffle_epi8 (lut_hi, hi));
+      if (_mm_movemask_epi8 (_mm_cmpeq_epi8 (bad, zero)) != 0xFFFF)
+        break;
+
+      __m128i eq = _mm_cmpeq_epi8 (in, m2f);
+      __m128i roll = _mm_shuffle_epi8 (lut_roll, _mm_add_epi8 (eq, hi));
+      in = _mm_add_epi8 (in, roll);
+      /* pack 4x6 bits -> 3 bytes */
+      in = _mm_maddubs_epi16 (in, _mm_set1_epi32 (0x01400140));
+      in = _mm_madd_epi16 (in, _mm_set1_epi32 (0x00011000));
+      in = _mm_shuffle_epi8 (in, _mm_setr_epi8 (2, 1, 0, 6, 5, 4,
+                                                10, 9, 8, 14, 13, 12,
+                                                -1, -1, -1, -1));
+      _mm_storeu_si128 ((__m128i *) d, in);
+      s += 16;
+      d += 12;
+    }
+
+  size_t n = s - *src;
+  *src = s;
+  *dst = d;
+  return n;
+}
+
+/* 32 characters -> 24 bytes, stores 32 bytes */
+B64_AVX2 static size_t
+__b64_dec_avx2 (const unsigned char **src, size_t srclen,
+                unsigned char **dst, size_t dstlen)
+{
+  const unsigned char *s = *src;
+  unsigned char *d = *dst;
+  const __m256i lut_lo = _mm256_setr_epi8 (
+    0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+    0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+    0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+    0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+  const __m256i lut_hi = _mm256_setr_epi8 (
+    0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  const __m256i lut_roll = _mm256_setr_epi8 (
+    0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m256i m2f = _mm256_set1_epi8 (0x2F);
+  const __m256i zero = _mm256_setzero_si256 ();
+
+  for (; srclen >= 32 && dstlen >= 32; srclen -= 32, dstlen -= 24)
+    {
+      __m256i in = _mm256_loadu_si256 ((const __m256i *) s);
+      __m256i hi = _mm256_and_si256 (_mm256_srli_epi32 (in, 4), m2f);
+      __m256i lo = _mm256_and_si256 (in, m2f);
+      __m256i bad = _mm256_and_si256 (_mm256_shuffle_epi8 (lut_lo, lo),
+                                      _mm256_shuffle_epi8 (lut_hi, hi));
+      if ((unsigned int) _mm256_movemask_epi8 (
+            _mm256_cmpeq_epi8 (bad, zero)) != 0xFFFFFFFFu)
+        break;
+
+      __m256i eq = _mm256_cmpeq_epi8 (in, m2f);
+      __m256i roll = _mm256_shuffle_epi8 (lut_roll,
+                                          _mm256_add_epi8 (eq, hi));
+      in = _mm256_add_epi8 (in, roll);
+      in = _mm256_maddubs_epi16 (in, _mm256_set1_epi32 (0x01400140));
+      in = _mm256_madd_epi16 (in, _mm256_set1_epi32 (0x00011000));
+      in = _mm256_shuffle_epi8 (in, _mm256_setr_epi8 (
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+      /* join the two 12-byte lanes */
+      in = _mm256_permutevar8x32_epi32 (in, _mm256_setr_epi32 (
+        0, 1, 2, 4, 5, 6, -1, -1));
+      _mm256_storeu_si256 ((__m256i *) d, in);
+      s += 32;
+      d += 24;
+    }
+
+  size_t n = s - *src;
+  *src = s;
+  *dst = d;
+  return n + __b64_dec_ssse3 (src, srclen, dst, dstlen);
+}
+#endif /* B64_SIMD_X86 */
+
+#ifdef B64_SIMD_NEON
+/* ASCII -> 6-bit index, 0xFF: invalid */
+static const unsigned char __b64_dec128[128] = {
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 62, 255, 255, 255, 63,
+  52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 255, 255, 255, 255, 255, 255,
+  255, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
+  15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 255, 255, 255, 255, 255,
+  255, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+  41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 255, 255, 255, 255, 255,
+};
+
+static inline uint8x16x4_t
+__b64_neon_tbl (const unsigned char *p)
+{
+  uint8x16x4_t t;
+  t.val[0] = vld1q_u8 (p);
+  t.val[1] = vld1q_u8 (p + 16);
+  t.val[2] = vld1q_u8 (p + 32);
+  t.val[3] = vld1q_u8 (p + 48);
+  return t;
+}
+
+/* 48 bytes -> 64 characters */
+static size_t
+__b64_enc_neon (const unsigned char **src, size_t srclen,
+                unsigned char **dst, size_t dstlen)
+{
+  const unsigned char *s = *src;
+  unsigned char *d = *dst;
+  const uint8x16x4_t tbl = __b64_neon_tbl ((const unsigned char *) b64);
+  const uint8x16_t mask = vdupq_n_u8 (B64_MASK);
+
+  for (; srclen >= 48 && dstlen >= 64; srclen -= 48, dstlen -= 64)
+    {
+      uint8x16x3_t in = vld3q_u8 (s);
+      uint8x16x4_t out;
+      out.val[0] = vshrq_n_u8 (in.val[0], 2);
+      out.val[1] = vandq_u8 (vorrq_u8 (vshlq_n_u8 (in.val[0], 4),
+                                       vshrq_n_u8 (in.val[1], 4)), mask);
+      out.val[2] = vandq_u8 (vorrq_u8 (vshlq_n_u8 (in.val[1], 2),
+                                       vshrq_n_u8 (in.val[2], 6)), mask);
+      out.val[3] = vandq_u8 (in.val[2], mask);
+      for (int i = 0; i < 4; ++i)
+        out.val[i] = vqtbl4q_u8 (tbl, out.val[i]);
+      vst4q_u8 (d, out);
+      s += 48;
+      d += 64;
+    }
+
+  size_t n = s - *src;
+  *src = s;
+  *dst = d;
+  return n;
+}
+
+/* 64 characters -> 48 bytes */
+static size_t
+__b64_dec_neon (const unsigned char **src, size_t srclen,
+                unsigned char **dst, size_t dstlen)
+{
+  const unsigned char *s = *src;
+  unsigned char *d = *dst;
+  const uint8x16x4_t tlo = __b64_neon_tbl (__b64_dec128);
+  const uint8x16x4_t thi = __b64_neon_tbl (__b64_dec128 + 64);
+  const uint8x16_t c64 = vdupq_n_u8 (64);
+
+  for (; srclen >= 64 && dstlen >= 48; srclen -= 64, dstlen -= 48)
+    {
+      uint8x16x4_t in = vld4q_u8 (s);
+      uint8x16_t err = vdupq_n_u8 (0);
+      for (int i = 0; i < 4; ++i)
+        {
+          uint8x16_t c = in.val[i];
+          /* non-ASCII characters stay 0, but have the high bit */
+          in.val[i] = vqtbx4q_u8 (vqtbl4q_u8 (tlo, c), thi,
+                                  vsubq_u8 (c, c64));
+          err = vorrq_u8 (err, vorrq_u8 (in.val[i], c));
+        }
+      if (vmaxvq_u8 (err) & 0x80)
+        break;
+
+      uint8x16x3_t out;
+      out.val[0] = vorrq_u8 (vshlq_n_u8 (in.val[0], 2),
+                             vshrq_n_u8 (in.val[1], 4));
+      out.val[1] = vorrq_u8 (vshlq_n_u8 (in.val[1], 4),
+                             vshrq_n_u8 (in.val[2], 2));
+      out.val[2] = vorrq_u8 (vshlq_n_u8 (in.val[2], 6), in.val[3]);
+      vst3q_u8 (d, out);
+      s += 64;
+      d += 48;
+    }
+
+  size_t n = s - *src;
+  *src = s;
+  *dst = d;
+  return n;
+}
+#endif /* B64_SIMD_NEON */
+
+/* the selected kernels, chosen on the first call */
+static b64_kernel_t __b64_enc_k = NULL;
+static b64_kernel_t __b64_dec_k = NULL;
+
+static inline void
+__b64_simd_init (void)
+{
+  b64_kernel_t enc = __b64_none, dec = __b64_none;
+#if defined (B64_SIMD_X86)
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("avx2"))
+    enc = __b64_enc_avx2, dec = __b64_dec_avx2;
+  else if (__builtin_cpu_supports ("ssse3"))
+    enc = __b64_enc_ssse3, dec = __b64_dec_ssse3;
+#elif defined (B64_SIMD_NEON)
+  enc = __b64_enc_neon, dec = __b64_dec_neon;
+#endif
+  __atomic_store_n (&__b64_dec_k, dec, __ATOMIC_RELAXED);
+  __atomic_store_n (&__b64_enc_k, enc, __ATOMIC_RELAXED);
+}
+
+static inline b64_kernel_t
+__b64_kernel (b64_kernel_t *k)
+{
+  b64_kernel_t r = __atomic_load_n (k, __ATOMIC_RELAXED);
+  if (!r)
+    {
+      __b64_simd_init ();
+      r = __atomic_load_n (k, __ATOMIC_RELAXED);
+    }
+  return r;
+}
+#endif /* B64_SIMD */
+
 B64DEFF int
 b64_encode (const void *restrict src_v, int srclen,
                   void *restrict dst_v, int dstlen,
@@ -118,6 +529,15 @@ b64_encode (const void *restrict src_v, int srclen,
   unsigned char *dst = dst_v;
 
   *error = 0;
+#ifdef B64_SIMD
+  if (srclen > 0 && dstlen > 0)
+    {
+      size_t n = __b64_kernel (&__b64_enc_k) (&src, srclen, &dst, dstlen);
+      srclen -= n;
+      dstlen -= n / 3 * 4;
+      rw += n / 3 * 4;
+    }
+#endif
   while (srclen >= 3)
     {
       srclen -= 3;
@@ -185,6 +605,15 @@ b64_decode (const void *restrict src_v, int srclen,
   const unsigned char *src = src_v;
   unsigned char *dst = dst_v;
 
+#ifdef B64_SIMD
+  if (srclen > 0 && dstlen > 0)
+    {
+      size_t k = __b64_kernel (&__b64_dec_k) (&src, srclen, &dst, dstlen);
+      srclen -= k;
+      dstlen -= k / 4 * 3;
+      rw += k / 4 * 3;
+    }
+#endif
   for (; srclen > 0; srclen -= 4)
     {
       /* decode byte #1 */
@@ -237,45 +666,320 @@ b64_decode (const void *restrict src_v, int srclen,
 
 
 #ifndef B64_NO_STREAM
-int
-b64_stream_decode (int ifd, int ofd, int *error)
+#ifndef B64_STREAM_BUF
+# define B64_STREAM_BUF (64 * 1024)
+#endif
+
+#define B64_ISSPACE(c) \
+  ((c) == ' ' || (c) == '\n' || (c) == '\r' || \
+   (c) == '\t' || (c) == '\v' || (c) == '\f')
+
+/* called on every input chunk, returns 0 or an error */
+typedef int (*b64_chunk_fn) (void *ctx, const unsigned char *p, size_t n);
+
+static int
+__b64_writeall (int fd, const unsigned char *p, size_t n)
+{
+  while (n > 0)
+    {
+      ssize_t w = write (fd, p, n);
+      if (w < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          return EIO_B64;
+        }
+      p += w;
+      n -= w;
+    }
+  return 0;
+}
+
+/**
+ *  calls @fn on chunks of at most B64_STREAM_BUF bytes of @ifd
+ *  if @ifd is a regular file, the rest of it is mapped
+ *  (and the offset of @ifd is moved), then read(2) on @buf
+ *  is used until the end of file
+ */
+static int
+__b64_foreach_chunk (int ifd, unsigned char *buf,
+                     b64_chunk_fn fn, void *ctx)
 {
-  int r = 0, w = 0; // read and write bytes
-  char in[4], tmp[B64_DECODE_B + 1];
+  int ret;
+#ifndef B64_NO_MMAP
+  struct stat st;
+  off_t off;
 
-  while (read (ifd, in + r, 1) == 1)
+  if (fstat (ifd, &st) == 0 && S_ISREG (st.st_mode)
+      && (off = lseek (ifd, 0, SEEK_CUR)) >= 0 && st.st_size > off
+      && (off_t)(size_t) st.st_size == st.st_size)
     {
-      if (r == 3 || in[r] == '\n')
+      size_t len = st.st_size;
+      unsigned char *m = mmap (NULL, len, PROT_READ, MAP_PRIVATE, ifd, 0);
+      if (m != MAP_FAILED)
         {
-          int n = b64_decode (in, r, tmp, 3, error);
-          if (*error)
-            break;
-          w += n;
-          write (ofd, tmp, n);
-          r = 0;
-          continue;
+          madvise (m, len, MADV_SEQUENTIAL);
+          ret = 0;
+          for (size_t i = off; i < len && ret == 0; i += B64_STREAM_BUF)
+            {
+              size_t n = len - i;
+              ret = fn (ctx, m + i, n < B64_STREAM_BUF ? n : B64_STREAM_BUF);
+            }
+          munmap (m, len);
+          if (ret != 0)
+            return ret;
+          lseek (ifd, len, SEEK_SET);
+        }
+    }
+#endif /* B64_NO_MMAP */
+
+  for (;;)
+    {
+      ssize_t r = read (ifd, buf, B64_STREAM_BUF);
+      if (r < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          return EIO_B64;
+        }
+      if (r == 0)
+        return 0;
+      if ((ret = fn (ctx, buf, r)) != 0)
+        return ret;
+    }
+}
+
+typedef struct
+{
+  int ofd, wrap, col;
+  size_t written, olen;
+  int ncarry;
+  unsigned char carry[B64_DECODE_B];
+  unsigned char in[B64_STREAM_BUF];
+  unsigned char tmp[B64_STREAM_BUF + 1];
+  unsigned char obuf[B64_STREAM_BUF + 1];
+} B64Encoder;
+
+static int
+__b64_enc_flush (B64Encoder *c)
+{
+  int ret = __b64_writeall (c->ofd, c->obuf, c->olen);
+  c->written += c->olen;
+  c->olen = 0;
+  return ret;
+}
+
+/* appends @n characters to the output (wrapping lines) */
+static int
+__b64_enc_put (B64Encoder *c, const unsigned char *s, size_t n)
+{
+  int ret;
+  while (n > 0)
+    {
+      if (c->olen == B64_STREAM_BUF && (ret = __b64_enc_flush (c)))
+        return ret;
+      size_t k = B64_STREAM_BUF - c->olen;
+      if (c->wrap > 0)
+        {
+          if (c->col == c->wrap)
+            {
+              c->obuf[c->olen++] = '\n';
+              c->col = 0;
+              continue;
+            }
+          if (k > (size_t)(c->wrap - c->col))
+            k = c->wrap - c->col;
+          c->col += (k < n) ? k : n;
+        }
+      if (k > n)
+        k = n;
+      memcpy (c->obuf + c->olen, s, k);
+      c->olen += k;
+      s += k;
+      n -= k;
+    }
+  return 0;
+}
+
+static int
+__b64_enc_chunk (void *ctx, const unsigned char *p, size_t n)
+{
+  B64Encoder *c = ctx;
+  int err, ret;
+
+  if (c->ncarry > 0)
+    {
+      while (c->ncarry < B64_DECODE_B && n > 0)
+        c->carry[c->ncarry++] = *(p++), n--;
+      if (c->ncarry < B64_DECODE_B)
+        return 0;
+      b64_encode (c->carry, B64_DECODE_B, c->tmp, B64_ENCODE_B, &err);
+      if ((ret = __b64_enc_put (c, c->tmp, B64_ENCODE_B)))
+        return ret;
+      c->ncarry = 0;
+    }
+
+  while (n >= B64_DECODE_B)
+    {
+      size_t k = n / 3 * 3;
+      if (c->wrap > 0)
+        {
+          /* encode on tmp, then copy with new lines */
+          if (k > B64_STREAM_BUF / 4 * 3)
+            k = B64_STREAM_BUF / 4 * 3;
+          b64_encode (p, k, c->tmp, B64_STREAM_BUF, &err);
+          if ((ret = __b64_enc_put (c, c->tmp, k / 3 * 4)))
+            return ret;
         }
       else
-        r++;
+        {
+          /* encode directly on the output buffer */
+          size_t room = B64_STREAM_BUF - c->olen;
+          if (room < B64_ENCODE_B)
+            {
+              if ((ret = __b64_enc_flush (c)))
+                return ret;
+              room = B64_STREAM_BUF;
+            }
+          if (k > room / 4 * 3)
+            k = room / 4 * 3;
+          b64_encode (p, k, c->obuf + c->olen, room, &err);
+          c->olen += k / 3 * 4;
+        }
+      p += k;
+      n -= k;
     }
 
+  memcpy (c->carry, p, n);
+  c->ncarry = n;
+  return 0;
+}
+
+B64DEFF size_t
+b64_stream_encode_wrap (int ifd, int ofd, int wrap, int *error)
+{
+  int err;
+  B64Encoder *c = malloc (sizeof (B64Encoder));
+  if (!c)
+    {
+      *error = EOBUFFER_B64;
+      return 0;
+    }
+  c->ofd = ofd;
+  c->wrap = (wrap > 0) ? wrap : 0;
+  c->col = c->ncarry = 0;
+  c->written = c->olen = 0;
+
+  *error = __b64_foreach_chunk (ifd, c->in, __b64_enc_chunk, c);
+  if (*error == 0 && c->ncarry > 0)
+    {
+      b64_encode (c->carry, c->ncarry, c->tmp, B64_ENCODE_B, &err);
+      *error = __b64_enc_put (c, c->tmp, B64_ENCODE_B);
+    }
+  if (*error == 0 && c->col > 0)
+    *error = __b64_enc_put (c, (const unsigned char *) "\n", 1);
+  if ((err = __b64_enc_flush (c)) && *error == 0)
+    *error = err;
+
+  size_t w = c->written;
+  free (c);
   return w;
 }
 
-B64DEFF int
+B64DEFF size_t
 b64_stream_encode (int ifd, int ofd, int *error)
 {
-  int r, w = 0; // read & write bytes
-  char in[3], tmp[B64_ENCODE_B + 1];
+  return b64_stream_encode_wrap (ifd, ofd, 0, error);
+}
+
+typedef struct
+{
+  int ofd, error;
+  size_t written;
+  size_t nq; // number of pending characters in q
+  unsigned char in[B64_STREAM_BUF];
+  unsigned char q[B64_STREAM_BUF + B64_ENCODE_B];
+  unsigned char obuf[B64_STREAM_BUF / 4 * 3 + B64_ENCODE_B];
+} B64Decoder;
 
-  while ((r = read (ifd, in, 3)) > 0)
+/**
+ *  decodes complete quanta of c->q, a padded quantum
+ *  ends the input, but may be followed by another one
+ *  returns number of characters consumed from c->q
+ */
+static size_t
+__b64_dec_quanta (B64Decoder *c, size_t len)
+{
+  size_t off = 0;
+  int n, err;
+
+  while (len - off >= B64_ENCODE_B)
     {
-      int n = b64_encode (in, r, tmp, 4, error);
-      if (*error)
-        break;
-      w += n;
-      write (ofd, tmp, n);
+      size_t end = off + (len - off) / 4 * 4;
+      unsigned char *eq = memchr (c->q + off, '=', end - off);
+      if (eq)
+        end = off + (eq - c->q - off) / 4 * 4 + 4;
+
+      err = 0;
+      n = b64_decode (c->q + off, end - off,
+                      c->obuf, sizeof (c->obuf) - 1, &err);
+      /* the valid prefix is written, even on invalid input */
+      int werr = __b64_writeall (c->ofd, c->obuf, n);
+      if (werr == 0)
+        c->written += n;
+      if (err || werr)
+        {
+          c->error = err ? err : werr;
+          return off;
+        }
+      off = end;
     }
+  return off;
+}
+
+static int
+__b64_dec_chunk (void *ctx, const unsigned char *p, size_t n)
+{
+  B64Decoder *c = ctx;
+  unsigned char *q = c->q + c->nq;
+
+  /* drop white spaces */
+  for (const unsigned char *end = p + n; p < end; ++p)
+    if (!B64_ISSPACE (*p))
+      *(q++) = *p;
+
+  size_t len = q - c->q;
+  size_t done = __b64_dec_quanta (c, len);
+  c->nq = len - done;
+  memmove (c->q, c->q + done, c->nq);
+  return c->error;
+}
+
+B64DEFF size_t
+b64_stream_decode (int ifd, int ofd, int *error)
+{
+  B64Decoder *c = malloc (sizeof (B64Decoder));
+  if (!c)
+    {
+      *error = EOBUFFER_B64;
+      return 0;
+    }
+  c->ofd = ofd;
+  c->error = 0;
+  c->written = c->nq = 0;
+
+  *error = __b64_foreach_chunk (ifd, c->in, __b64_dec_chunk, c);
+  if (*error == 0 && c->nq > 0)
+    {
+      /* incomplete last quantum, without padding */
+      while (c->nq < B64_ENCODE_B)
+        c->q[c->nq++] = '=';
+      __b64_dec_quanta (c, c->nq);
+      *error = c->error;
+    }
+
+  size_t w = c->written;
+  free (c);
   return w;
 }
 #endif /* B64_NO_STREAM */
@@ -290,7 +994,11 @@ b64_stream_encode (int ifd, int ofd, int *error)
 */
 #ifdef B64_TEST
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#ifndef B64_NO_STREAM
+# include <sys/wait.h>
+#endif
 
 struct TCASE
 {
@@ -321,6 +1029,242 @@ static struct TCASE tests[] = {
             exp, got);                          \
   }
 
+#ifdef B64_SIMD
+#define SIMD_MAXLEN 1024
+/**
+ *  compares results of the SIMD kernel @enc, @dec
+ *  with the scalar code, on random inputs of all lengths
+ *  less than SIMD_MAXLEN, invalid inputs and short buffers
+ */
+static int
+simd_test (b64_kernel_t enc, b64_kernel_t dec)
+{
+  static unsigned char in[SIMD_MAXLEN], out[SIMD_MAXLEN];
+  static char exp[SIMD_MAXLEN * 2], got[SIMD_MAXLEN * 2];
+  int e1, e2, n1, n2, fails = 0;
+
+  srand (1);
+  for (int len = 0; len < SIMD_MAXLEN; ++len)
+    {
+      for (int i = 0; i < len; ++i)
+        in[i] = rand ();
+
+      __b64_enc_k = __b64_none, __b64_dec_k = __b64_none;
+      n1 = b64_encode (in, len, exp, sizeof (exp), &e1);
+      __b64_enc_k = enc, __b64_dec_k = dec;
+      n2 = b64_encode (in, len, got, sizeof (got), &e2);
+      if (n1 != n2 || e1 != e2 || memcmp (exp, got, n1 + 1) != 0)
+        {
+          printf ("  encode, length %d failed\n", len);
+          fails++;
+          continue;
+        }
+
+      e2 = 0;
+      n2 = b64_decode (got, n1, out, sizeof (out), &e2);
+      if (e2 != 0 || n2 != len || memcmp (in, out, len) != 0)
+        {
+          printf ("  decode, length %d failed\n", n1);
+          fails++;
+        }
+
+      /* short output buffer (of the encoder and decoder) */
+      int small = len / 2;
+      __b64_enc_k = __b64_none, __b64_dec_k = __b64_none;
+      n1 = b64_encode (in, len, exp, small, &e1);
+      __b64_enc_k = enc, __b64_dec_k = dec;
+      n2 = b64_encode (in, len, got, small, &e2);
+      if (n1 != n2 || e1 != e2 || memcmp (exp, got, n1) != 0)
+        {
+          printf ("  encode, length %d, dstlen %d failed\n", len, small);
+          fails++;
+        }
+
+      /* the input becomes invalid at a random position */
+      b64_encode (in, len, got, sizeof (got), &e2);
+      int n = strlen (got);
+      if (n == 0)
+        continue;
+      int c;
+      do
+        c = rand () & 0xFF;
+      while (dec64 (c) != 0xFF);
+      got[rand () % n] = c;
+      for (int i = 0; i < 2; ++i)
+        {
+          int dlen = i ? len / 2 : (int) sizeof (out) - 1;
+          e1 = e2 = 0;
+          __b64_enc_k = __b64_none, __b64_dec_k = __b64_none;
+          n1 = b64_decode (got, n, out, dlen, &e1);
+          memcpy (exp, out, n1);
+          __b64_enc_k = enc, __b64_dec_k = dec;
+          n2 = b64_decode (got, n, out, dlen, &e2);
+          if (n1 != n2 || e1 != e2 || memcmp (exp, out, n1) != 0)
+            {
+              printf ("  invalid decode, length %d, dstlen %d failed\n",
+                      n, dlen);
+              fails++;
+            }
+        }
+    }
+  return fails;
+}
+#endif /* B64_SIMD */
+
+#ifndef B64_NO_STREAM
+#define STREAM_LEN (5 * B64_STREAM_BUF + 7)
+
+/* reads content of @fd from the beginning */
+static size_t
+slurp (int fd, unsigned char *buf, size_t cap)
+{
+  size_t n = 0;
+  ssize_t r;
+  lseek (fd, 0, SEEK_SET);
+  while (n < cap && (r = read (fd, buf + n, cap - n)) > 0)
+    n += r;
+  return n;
+}
+
+static int
+tmpfd (void)
+{
+  return fileno (tmpfile ());
+}
+
+/**
+ *  encodes and decodes STREAM_LEN random bytes,
+ *  through regular files (mmap) and pipes (read)
+ */
+static int
+stream_test (void)
+{
+  int err, fails = 0;
+  size_t n, len;
+  unsigned char *data = malloc (STREAM_LEN);
+  unsigned char *enc = malloc (STREAM_LEN * 2);
+  unsigned char *got = malloc (STREAM_LEN * 2);
+
+  srand (2);
+  for (int i = 0; i < STREAM_LEN; ++i)
+    data[i] = rand ();
+  len = b64_encode (data, STREAM_LEN, enc, STREAM_LEN * 2, &err);
+
+  int in = tmpfd (), out = tmpfd (), wrapped = tmpfd ();
+  __b64_writeall (in, data, STREAM_LEN);
+
+  /* encode, no wrapping */
+  lseek (in, 0, SEEK_SET);
+  n = b64_stream_encode (in, out, &err);
+  if (err || n != len || slurp (out, got, STREAM_LEN * 2) != len
+      || memcmp (enc, got, len) != 0)
+    {
+      printf ("  stream encode failed\n");
+      fails++;
+    }
+
+  /* encode, wrap at 76 */
+  lseek (in, 0, SEEK_SET);
+  n = b64_stream_encode_wrap (in, wrapped, 76, &err);
+  size_t k = slurp (wrapped, got, STREAM_LEN * 2), j = 0, col = 0;
+  if (err || n != k || got[k - 1] != '\n')
+    fails++, printf ("  stream wrap failed\n");
+  for (size_t i = 0; i < k; ++i)
+    {
+      if (got[i] == '\n')
+        {
+          if (col != 76 && i != k - 1)
+            break;
+          col = 0;
+        }
+      else if (j >= len || got[i] != enc[j++] || ++col > 76)
+        break;
+    }
+  if (j != len)
+    fails++, printf ("  stream wrap, bad lines\n");
+
+  /* decode the wrapped file */
+  ftruncate (out, 0);
+  lseek (out, 0, SEEK_SET);
+  lseek (wrapped, 0, SEEK_SET);
+  n = b64_stream_decode (wrapped, out, &err);
+  if (err || n != STREAM_LEN || slurp (out, got, STREAM_LEN * 2) != n
+      || memcmp (data, got, n) != 0)
+    fails++, printf ("  stream decode (mmap) failed\n");
+
+  /* decode through a pipe, with short writes */
+  int fds[2];
+  pipe (fds);
+  if (fork () == 0)
+    {
+      close (fds[0]);
+      k = slurp (wrapped, got, STREAM_LEN * 2);
+      for (size_t i = 0; i < k; i += 1001)
+        __b64_writeall (fds[1], got + i, (k - i < 1001) ? k - i : 1001);
+      _exit (0);
+    }
+  close (fds[1]);
+  ftruncate (out, 0);
+  lseek (out, 0, SEEK_SET);
+  n = b64_stream_decode (fds[0], out, &err);
+  close (fds[0]);
+  wait (NULL);
+  if (err || n != STREAM_LEN || slurp (out, got, STREAM_LEN * 2) != n
+      || memcmp (data, got, n) != 0)
+    fails++, printf ("  stream decode (pipe) failed\n");
+
+  /* concatenated padded inputs and white spaces */
+  struct TCASE dec[] = {
+    Tcase ("YQ==YWE=\nYWFh", "aaaaaa"),
+    Tcase ("YW\n Jj\tZA", "abcd"),
+  };
+  /* invalid inputs, and their valid prefix to be written */
+  struct TCASE inv[] = {
+    Tcase ("!YWJj", ""),
+    Tcase ("YWJj!A==", "abc"),
+    Tcase ("QUJD====", "ABC"),
+  };
+  size_t ndec = sizeof (dec) / sizeof (*dec);
+  for (size_t i = 0; i < ndec + sizeof (inv) / sizeof (*inv); ++i)
+    {
+      struct TCASE *tc = (i < ndec) ? dec + i : inv + i - ndec;
+      int t = tmpfd ();
+      ftruncate (out, 0);
+      lseek (out, 0, SEEK_SET);
+      __b64_writeall (t, (const unsigned char *) tc->test,
+                      strlen (tc->test));
+      lseek (t, 0, SEEK_SET);
+      n = b64_stream_decode (t, out, &err);
+      k = slurp (out, got, STREAM_LEN);
+      if (err != ((i < ndec) ? 0 : INVALID_B64)
+          || n != strlen (tc->exp) || k != n
+          || memcmp (tc->exp, got, n) != 0)
+        fails++, printf ("  stream decode `%s` failed\n", tc->test);
+      close (t);
+    }
+
+  /* valid prefix longer than a block, then invalid input */
+  {
+    int t = tmpfd ();
+    ftruncate (out, 0);
+    lseek (out, 0, SEEK_SET);
+    __b64_writeall (t, enc, len); // not padded
+    __b64_writeall (t, (const unsigned char *) "!!!!", 4);
+    lseek (t, 0, SEEK_SET);
+    n = b64_stream_decode (t, out, &err);
+    k = slurp (out, got, STREAM_LEN * 2);
+    if (err != INVALID_B64 || n != STREAM_LEN || k != n
+        || memcmp (data, got, n) != 0)
+      fails++, printf ("  stream decode, valid prefix failed\n");
+    close (t);
+  }
+
+  close (in), close (out), close (wrapped);
+  free (data), free (enc), free (got);
+  return fails;
+}
+#endif /* B64_NO_STREAM */
+
 int
 main (void)
 {
@@ -348,7 +1292,48 @@ main (void)
 #undef DO_CMP
 
     }
-  
+
+#ifdef B64_SIMD
+  struct {
+    const char *name;
+    b64_kernel_t enc, dec;
+    int supported;
+  } kernels[] = {
+# if defined (B64_SIMD_X86)
+    {"ssse3", __b64_enc_ssse3, __b64_dec_ssse3,
+     (__builtin_cpu_init (), __builtin_cpu_supports ("ssse3"))},
+    {"avx2", __b64_enc_avx2, __b64_dec_avx2,
+     __builtin_cpu_supports ("avx2")},
+# elif defined (B64_SIMD_NEON)
+    {"neon", __b64_enc_neon, __b64_dec_neon, 1},
+# endif
+  };
+
+  for (size_t i = 0; i < sizeof (kernels) / sizeof (*kernels); ++i)
+    {
+      if (!kernels[i].supported)
+        {
+          printf ("testing: %s kernels... skipped\n", kernels[i].name);
+          continue;
+        }
+      printf ("testing: %s kernels... ", kernels[i].name);
+      fflush (stdout);
+      if (simd_test (kernels[i].enc, kernels[i].dec) == 0)
+        printf ("pass\n");
+      else
+        printf ("failed\n");
+    }
+#endif /* B64_SIMD */
+
+#ifndef B64_NO_STREAM
+  printf ("testing: stream encode/decode... ");
+  fflush (stdout);
+  if (stream_test () == 0)
+    printf ("pass\n");
+  else
+    printf ("failed\n");
+#endif
+
   return 0;
 }
 #endif /* B64_TEST */
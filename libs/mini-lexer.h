@@ -342,6 +342,15 @@
   
     Compilation Options:
       Debug Info:  define `-D_ML_DEBUG`
+      No SIMD:  define `-D ML_NO_SIMD` to not use SSE2 in the
+                fast path of ml_next (scanning plain bytes)
+      Trie size:  `-D ML_TRIE_NODES=n` nodes for the automaton of
+                  puncs, expressions and keywords (default 256);
+                  larger languages fall back to linear search
+      Trie usage:  `-D ML_TRIE_MIN=n` the automaton is only used
+                   for languages with at least n puncs, expressions
+                   and keywords (default 16), smaller ones are
+                   faster with linear search
  **/
 #ifndef MINI_LEXER__H
 #define MINI_LEXER__H
@@ -376,6 +385,13 @@
 #define ml_free free
 #endif
 
+#ifndef ML_NO_SIMD
+# ifdef __SSE2__
+#  include <emmintrin.h>
+#  define ML_SSE2
+# endif
+#endif
+
 #define ML_LENOF(arr) (sizeof (arr) / sizeof ((arr)[0]))
 #define ML_STRLEN(cstr) ((cstr) ? strlen (cstr) : 0)
 
@@ -534,6 +550,13 @@ enum milexer_parsing_flag_t
      *  which are ignored by default
      */
     PFLAG_INCOMMENT = 1 << 3,
+
+    /**
+     *  Zero-copy mode, to retrieve tokens as views into the source
+     *  slice (Milexer_Token->view), when they are entirely within
+     *  the slice; see Milexer_Token->view
+     */
+    PFLAG_VIEW = 1 << 4,
   };
 
 enum milexer_token_t
@@ -581,9 +604,21 @@ typedef struct
   /* line/column number of the token in the input */
   size_t line, col;
 
+  /**
+   *  With the PFLAG_VIEW parsing flag, the token is
+   *  @view of length @view_len (it's not null-terminated)
+   *  It points to the source slice, or @cstr when the token is
+   *  not entirely within the current slice; @cstr may not
+   *  have the complete token, when @view is not @cstr
+   */
+  const char *view;
+  size_t view_len;
+
   /* Internal */
   size_t __idx;
   size_t __line_idx; /* start of the current line's index */
+  const char *__src; /* source of @cstr[0], NULL if not contiguous */
+  size_t __hole, __hole_end; /* not copied bytes of @cstr */
 } Milexer_Token;
 
 /** Token macros, to work with tokens **/
@@ -695,6 +730,50 @@ typedef struct
 #define __get_last_punc(ml, src) \
   ((ml)->puncs.exp + (src)->__last_punc_idx)
 
+/**
+ *  Set of bytes, as a bitmap and (when possible) up to
+ *  ML_SPAN_RANGES ranges [lo, hi], for the SIMD scanner
+ */
+#ifndef ML_SPAN_RANGES
+# define ML_SPAN_RANGES 16
+#endif
+struct ml_span_t
+{
+  unsigned long long bits[4];
+  unsigned char lo[ML_SPAN_RANGES], hi[ML_SPAN_RANGES];
+  int len; /* count of ranges, -1 if there are more */
+  bool disabled; /* nothing could be skipped */
+};
+
+/**
+ *  Aho-Corasick automaton of the prefixes of puncs and expressions,
+ *  and the trie of keywords, in a fixed pool of ML_TRIE_NODES nodes
+ *  Node 0 is the root, its children are in the @root tables
+ */
+#ifndef ML_TRIE_NODES
+# define ML_TRIE_NODES 256
+#endif
+#ifndef ML_TRIE_MIN
+# define ML_TRIE_MIN 16
+#endif
+struct ml_trie_node_t
+{
+  unsigned char c;   /* byte of the edge from the parent */
+  short child, next; /* the first child and the next sibling */
+  short fail, dict;  /* failure link, and the next node with outputs */
+  short punc, exp;   /* outputs (in @outs) of puncs and expressions */
+  short kw;          /* id of the keyword, -1 if not a keyword */
+};
+struct ml_trie_t
+{
+  struct ml_trie_node_t node[ML_TRIE_NODES + 1];
+  struct { short id, next; } outs[ML_TRIE_NODES + 1];
+  short root[256], kw_root[256], kw_empty;
+  int len, outs_len;
+  /* false: small language or the pool was not enough, use linear search */
+  bool ok;
+};
+
 typedef struct Milexer_t
 {
   /* Configurations */
@@ -715,6 +794,30 @@ typedef struct Milexer_t
    */
   Milexer_BEXP delim_ranges;
 
+  /* Internal, see ml_compile */
+  struct
+  {
+    /* The configuration of the tables, to detect ML_SET */
+    const void *puncs, *keywords, *expression, *b_comment, *delim_ranges;
+    int puncs_len, keywords_len, expression_len;
+    int b_comment_len, delim_ranges_len;
+    bool ready;
+
+    /* ML_CLS_xxx bits of each byte */
+    unsigned char cls[256];
+    /**
+     *  Stop sets of the fast path of ml_next, bytes
+     *  that the parser has nothing to do with them are skipped
+     *  middle:  (the middle of tokens) for each delimiter flags
+     *    [PFLAG_IGSPACE | PFLAG_ALLDELIMS], see ML_MIDDLE_SET
+     *  dummy:  (between tokens) runs of delimiters, bytes which
+     *    are not delimiters, and SPECIAL bytes are stops
+     *  comm, ml_comm:  the single and multi-line comments
+     */
+    struct ml_span_t middle[4], dummy[4], comm, ml_comm;
+    /* To detect puncs, expression prefixes and keywords */
+    struct ml_trie_t trie;
+  } __tbl;
 } Milexer;
 
 /**
@@ -760,6 +863,16 @@ typedef struct Milexer_t
 MLDEF int ml_next (Milexer *ml, Milexer_Slice *src,
              Milexer_Token *tk, int flg);
 
+/**
+ *  Updates the internals of @ml, and compiles its byte class
+ *  and delimiter tables, used by the fast path of ml_next
+ *
+ *  ml_next calls it when a component is changed by ML_SET or
+ *  ML_MUTATE, but changing the keywords, delimiters or single-line
+ *  comments in place (not by ML_SET) needs calling this function
+ */
+MLDEF void ml_compile (Milexer *ml);
+
 
 #ifdef ML_FLEX
 #include <stdio.h>
@@ -990,6 +1103,350 @@ MLDEF YY_BUFFER_STATE * yy_restart (FILE *file);
           punc->end = PUNC_DOUBLE_CHECK;            \
       }} while (0)) 
 
+/** Internal
+ *  Byte classes of the language, see ml_compile
+ *  SPECIAL:  bytes of prefixes of puncs, expressions and comments,
+ *            and also backslash and null-byte
+ *  DELIM:  default delimiters (below space)
+ *  RANGE:  bytes of @delim_ranges
+ *  SCOMM, MCOMM:  the last byte of (single/multi-line) comment prefixes
+ *  MCOMM_END:  the last byte of multi-line comment suffixes
+ */
+enum ml_cls_t
+  {
+    ML_CLS_SPECIAL   = 1 << 0,
+    ML_CLS_DELIM     = 1 << 1,
+    ML_CLS_RANGE     = 1 << 2,
+    ML_CLS_SCOMM     = 1 << 3,
+    ML_CLS_MCOMM     = 1 << 4,
+    ML_CLS_MCOMM_END = 1 << 5,
+  };
+#define ML_CLS(ml, c) ((ml)->__tbl.cls[(unsigned char) (c)])
+/* Index of the middle stop set, of parsing flags @flg */
+#define ML_MIDDLE_SET(flg) \
+  ((HAS_FLAG (flg, PFLAG_IGSPACE) ? 1 : 0) |    \
+   (HAS_FLAG (flg, PFLAG_ALLDELIMS) ? 2 : 0))
+/* Does @set have @c */
+#define ML_SPAN_HAS(set, c)                                 \
+  (((set)->bits[(unsigned char) (c) >> 6] >>                \
+    ((unsigned char) (c) & 63)) & 1)
+#define ML_SPAN_ADD(set, c)                                 \
+  ((set)->bits[(unsigned char) (c) >> 6] |=                 \
+   1ULL << ((unsigned char) (c) & 63))
+/* Components of the language, that need ml_compile */
+#define ML_DIRTY(ml)                                            \
+  (!(ml)->__tbl.ready || !(ml)->puncs.clean ||                  \
+   !(ml)->expression.clean || !(ml)->a_comment.clean ||         \
+   __ML_CHANGED (ml, puncs) || __ML_CHANGED (ml, keywords) ||   \
+   __ML_CHANGED (ml, expression) || __ML_CHANGED (ml, b_comment) || \
+   __ML_CHANGED (ml, delim_ranges))
+#define __ML_CHANGED(ml, field)                         \
+  ((ml)->__tbl.field != (ml)->field.exp ||              \
+   (ml)->__tbl.field##_len != (ml)->field.len)
+#define __ML_STORE(ml, field)                           \
+  ((ml)->__tbl.field = (ml)->field.exp,                 \
+   (ml)->__tbl.field##_len = (ml)->field.len)
+
+/* Makes the ranges of @set from its bitmap */
+static void
+__ml_span_ranges (struct ml_span_t *set)
+{
+  set->len = 0;
+  for (int c = 0; c < 256; )
+    {
+      if (! ML_SPAN_HAS (set, c))
+        {
+          ++c;
+          continue;
+        }
+      int lo = c;
+      while (c < 256 && ML_SPAN_HAS (set, c))
+        ++c;
+      if (set->len == ML_SPAN_RANGES)
+        {
+          set->len = -1; /* only the bitmap */
+          return;
+        }
+      set->lo[set->len] = lo;
+      set->hi[set->len++] = c - 1;
+    }
+}
+
+/**
+ *  Makes @set of bytes of @cls which have any of the @mask bits,
+ *  and bytes of @extra
+ */
+static void
+__ml_span_build (struct ml_span_t *set, const unsigned char *cls,
+                 int mask, const char *extra)
+{
+  memset (set->bits, 0, sizeof (set->bits));
+  for (int c = 0; c < 256; ++c)
+    if (cls[c] & mask)
+      ML_SPAN_ADD (set, c);
+  for (; *extra; ++extra)
+    ML_SPAN_ADD (set, *extra);
+  __ml_span_ranges (set);
+}
+
+/**
+ *  Returns length of the run of bytes of @p (at most @n),
+ *  which are not in @set; 16 bytes at a time with SSE2
+ */
+static inline size_t
+__ml_span (const char *p, size_t n, const struct ml_span_t *set)
+{
+  size_t i = 0;
+#ifdef ML_SSE2
+  if (set->len >= 0)
+    {
+      for (; i + 16 <= n; i += 16)
+        {
+          __m128i x = _mm_loadu_si128 ((const __m128i *) (p + i));
+          __m128i m = _mm_setzero_si128 ();
+          for (int j=0; j < set->len; ++j)
+            {
+              /* x in [lo, hi]  <=>  (x - lo) <= (hi - lo), unsigned */
+              __m128i t = _mm_sub_epi8 (x, _mm_set1_epi8 (set->lo[j]));
+              __m128i d = _mm_set1_epi8 (set->hi[j] - set->lo[j]);
+              m = _mm_or_si128 (m, _mm_cmpeq_epi8 (_mm_min_epu8 (t, d), t));
+            }
+          int mask = _mm_movemask_epi8 (m);
+          if (mask)
+            return i + __builtin_ctz (mask);
+        }
+    }
+#endif /* ML_SSE2 */
+  for (; i < n; ++i)
+    if (ML_SPAN_HAS (set, p[i]))
+      break;
+  return i;
+}
+
+/* Same as __ml_span, for the set of two bytes @a and @b */
+static inline size_t
+__ml_span2 (const char *p, size_t n, char a, char b)
+{
+  size_t i = 0;
+#ifdef ML_SSE2
+  __m128i va = _mm_set1_epi8 (a), vb = _mm_set1_epi8 (b);
+  for (; i + 16 <= n; i += 16)
+    {
+      __m128i x = _mm_loadu_si128 ((const __m128i *) (p + i));
+      int mask = _mm_movemask_epi8 (_mm_or_si128 (_mm_cmpeq_epi8 (x, va),
+                                                  _mm_cmpeq_epi8 (x, vb)));
+      if (mask)
+        return i + __builtin_ctz (mask);
+    }
+#endif /* ML_SSE2 */
+  for (; i < n; ++i)
+    if (p[i] == a || p[i] == b)
+      break;
+  return i;
+}
+
+/* The child of the node @n of the @trie, by the byte @c */
+static inline int
+__ml_trie_child (const struct ml_trie_t *trie, const short *root,
+                 int n, unsigned char c)
+{
+  if (n == 0)
+    return root[c];
+  for (n = trie->node[n].child; n; n = trie->node[n].next)
+    if (trie->node[n].c == c)
+      return n;
+  return 0;
+}
+
+/* The next state of the automaton, from @n by @c */
+static inline int
+__ml_trie_step (const struct ml_trie_t *trie, int n, unsigned char c)
+{
+  int next;
+  for (;; n = trie->node[n].fail)
+    {
+      if ((next = __ml_trie_child (trie, trie->root, n, c)) || n == 0)
+        return next;
+    }
+}
+
+/**
+ *  Inserts @s into the trie of @root
+ *  Returns the node of @s, -1 if the pool is full or @s is empty
+ */
+static int
+__ml_trie_insert (struct ml_trie_t *trie, short *root, const char *s)
+{
+  int n = 0, next;
+  if (!s || !*s)
+    return -1;
+  for (const unsigned char *p = (const unsigned char *) s; *p; ++p, n = next)
+    {
+      if ((next = __ml_trie_child (trie, root, n, *p)))
+        continue;
+      if (trie->len == ML_TRIE_NODES)
+        return -1;
+      next = ++trie->len;
+      trie->node[next] = (struct ml_trie_node_t){.c = *p, .kw = -1};
+      if (n == 0)
+        root[*p] = next;
+      else
+        {
+          trie->node[next].next = trie->node[n].child;
+          trie->node[n].child = next;
+        }
+    }
+  return n;
+}
+
+/* Adds @id to the list of outputs @head, false if the pool is full */
+static bool
+__ml_trie_out (struct ml_trie_t *trie, short *head, int id)
+{
+  if (trie->outs_len == ML_TRIE_NODES)
+    return false;
+  int o = ++trie->outs_len;
+  trie->outs[o].id = id;
+  trie->outs[o].next = *head;
+  *head = o;
+  return true;
+}
+
+/**
+ *  Builds the automaton of puncs and expression prefixes,
+ *  and the trie of keywords; disabled ones are also included
+ *  For small languages (see ML_TRIE_MIN), or when they do not fit,
+ *  trie->ok will be false
+ */
+static void
+__ml_trie_build (Milexer *ml)
+{
+  struct ml_trie_t *trie = &ml->__tbl.trie;
+  short queue[ML_TRIE_NODES];
+  int n, head = 0, tail = 0;
+
+  trie->ok = false;
+  if (ml->puncs.len + ml->expression.len + ml->keywords.len < ML_TRIE_MIN)
+    return;
+  trie->len = trie->outs_len = 0;
+  trie->kw_empty = -1;
+  memset (trie->root, 0, sizeof (trie->root));
+  memset (trie->kw_root, 0, sizeof (trie->kw_root));
+  trie->node[0] = (struct ml_trie_node_t){.kw = -1};
+
+  for (int i=0; i < ml->puncs.len; ++i)
+    {
+      n = __ml_trie_insert (trie, trie->root, ml->puncs.exp[i].begin);
+      if (n < 0 || !__ml_trie_out (trie, &trie->node[n].punc, i))
+        return;
+    }
+  for (int i=0; i < ml->expression.len; ++i)
+    {
+      n = __ml_trie_insert (trie, trie->root, ml->expression.exp[i].begin);
+      if (n < 0 || !__ml_trie_out (trie, &trie->node[n].exp, i))
+        return;
+    }
+  for (int i=0; i < ml->keywords.len; ++i)
+    {
+      const char *kw = ml->keywords.exp[i];
+      if (kw && *kw == '\0')
+        {
+          if (trie->kw_empty == -1)
+            trie->kw_empty = i;
+          continue;
+        }
+      if ((n = __ml_trie_insert (trie, trie->kw_root, kw)) < 0)
+        return;
+      if (trie->node[n].kw == -1)
+        trie->node[n].kw = i; /* the first one, like strcmp loop */
+    }
+
+  /* Failure links, breadth-first */
+  for (int c = 0; c < 256; ++c)
+    if ((n = trie->root[c]))
+      queue[tail++] = n;
+  while (head < tail)
+    {
+      int u = queue[head++];
+      for (int v = trie->node[u].child; v; v = trie->node[v].next)
+        {
+          int f = __ml_trie_step (trie, trie->node[u].fail, trie->node[v].c);
+          const struct ml_trie_node_t *fn = &trie->node[f];
+          trie->node[v].fail = f;
+          trie->node[v].dict = (fn->punc || fn->exp) ? f : fn->dict;
+          queue[tail++] = v;
+        }
+    }
+  trie->ok = true;
+}
+
+/**
+ *  Finds the longest (the last one of equals) enabled punc in @cstr
+ *  Returns its index, or -1; @len will be its length
+ */
+static int
+__ml_trie_puncs (const Milexer *ml, const char *cstr, size_t *len)
+{
+  const struct ml_trie_t *trie = &ml->__tbl.trie;
+  int res = -1, n = 0;
+  for (const unsigned char *p = (const unsigned char *) cstr; *p; ++p)
+    {
+      n = __ml_trie_step (trie, n, *p);
+      for (int d = n; d; d = trie->node[d].dict)
+        for (int o = trie->node[d].punc; o; o = trie->outs[o].next)
+          {
+            int i = trie->outs[o].id;
+            const _exp_t *punc = &ml->puncs.exp[i];
+            size_t l = punc->len.begin;
+            if (punc->disabled)
+              continue;
+            if (l > *len || (l == *len && i > res))
+              res = i, *len = l;
+          }
+    }
+  return res;
+}
+
+/**
+ *  Finds the first (by index) enabled expression prefix in @cstr
+ *  Returns its index, or -1; @ptr will be its first occurrence
+ */
+static int
+__ml_trie_exp (const Milexer *ml, char *cstr, char **ptr)
+{
+  const struct ml_trie_t *trie = &ml->__tbl.trie;
+  int res = -1, n = 0;
+  for (char *p = cstr; *p; ++p)
+    {
+      n = __ml_trie_step (trie, n, *p);
+      for (int d = n; d; d = trie->node[d].dict)
+        for (int o = trie->node[d].exp; o; o = trie->outs[o].next)
+          {
+            int i = trie->outs[o].id;
+            const _exp_t *e = &ml->expression.exp[i];
+            if (e->disabled || (res != -1 && i >= res))
+              continue;
+            res = i;
+            *ptr = p - e->len.begin + 1;
+          }
+    }
+  return res;
+}
+
+/* Returns id of the keyword @cstr, or -1 */
+static inline int
+__ml_trie_keyword (const Milexer *ml, const char *cstr)
+{
+  const struct ml_trie_t *trie = &ml->__tbl.trie;
+  const unsigned char *p = (const unsigned char *) cstr;
+  int n;
+  if (*p == '\0')
+    return trie->kw_empty;
+  for (n = trie->kw_root[*p++]; n && *p; ++p)
+    n = __ml_trie_child (trie, trie->kw_root, n, *p);
+  return n ? trie->node[n].kw : -1;
+}
+
 /** Functions without MLDEF are internal functions **/
 /**
  *  To set the ID of keyword tokens
@@ -1006,26 +1463,15 @@ __detect_delim (const Milexer *ml, unsigned char p, int flags)
   if (ml->delim_ranges.len == 0 || HAS_FLAG (flags, PFLAG_ALLDELIMS))
     {
       /* default delimiters */
-      if (p < ' ' ||
+      if (ML_CLS (ml, p) & ML_CLS_DELIM ||
           (p == ' ' && !HAS_FLAG (flags, PFLAG_IGSPACE)))
         {
           return p;
         }
     }
-  if (ml->delim_ranges.len > 0 || HAS_FLAG (flags, PFLAG_ALLDELIMS))
-    {
-      for (int i=0; i < ml->delim_ranges.len; ++i)
-        {
-          const char *__p = ml->delim_ranges.exp[i];
-          if (__p[1] != '\0')
-            {
-              if (p >= (unsigned char)__p[0] && p <= (unsigned char)__p[1])
-                return p;
-            }
-          else if (p == (unsigned char)__p[0])
-            return p;
-        }
-    }
+  /* @delim_ranges, see ml_compile */
+  if (ML_CLS (ml, p) & ML_CLS_RANGE)
+    return p;
   return 0;
 }
 
@@ -1101,23 +1547,26 @@ __detect_puncs (const Milexer *ml,
   if (ml->puncs.disabled)
     return NULL;
 
-  for (int i=0; i < ml->puncs.len; ++i)
-    {
-      _exp_t *punc = &ml->puncs.exp[i];
-      if (punc->disabled)
-        continue;
-      size_t len = punc->len.begin;
-      if (res->__idx < len)
-        continue;
-      if (strstr (res->cstr, punc->begin) != NULL)
-        {
-          if (len >= l_match_len)
-            {
-              l_match_len = len;
-              l_match_idx = i;
-            }
-        }
-    }
+  if (ml->__tbl.trie.ok)
+    l_match_idx = __ml_trie_puncs (ml, res->cstr, &l_match_len);
+  else
+    for (int i=0; i < ml->puncs.len; ++i)
+      {
+        _exp_t *punc = &ml->puncs.exp[i];
+        if (punc->disabled)
+          continue;
+        size_t len = punc->len.begin;
+        if (res->__idx < len)
+          continue;
+        if (strstr (res->cstr, punc->begin) != NULL)
+          {
+            if (len >= l_match_len)
+              {
+                l_match_len = len;
+                l_match_idx = i;
+              }
+          }
+      }
 
   if (l_match_idx != -1)
     {
@@ -1256,6 +1705,14 @@ __is_expression_pref (const Milexer *ml,
         return NULL;
       __cstr = p + 2;
     }
+  if (ml->__tbl.trie.ok)
+    {
+      int i = __ml_trie_exp (ml, __cstr, &p);
+      if (i == -1)
+        return NULL;
+      src->__last_exp_idx = i;
+      return p;
+    }
   for (int i=0; i < ml->expression.len; ++i)
     {
       _exp_t *e = ml->expression.exp + i;
@@ -1270,6 +1727,18 @@ __is_expression_pref (const Milexer *ml,
   return NULL;
 }
 
+/* Zero-copy mode, copies the skipped bytes of @tk, see __ml_next */
+static inline void
+__ml_tk_fill (Milexer_Token *tk)
+{
+  if (tk->__hole_end)
+    {
+      memcpy (tk->cstr + tk->__hole, tk->__src + tk->__hole,
+              tk->__hole_end - tk->__hole);
+      tk->__hole = tk->__hole_end = 0;
+    }
+}
+
 static int
 ml_set_keyword_id (const Milexer *ml, Milexer_Token *res)
 {
@@ -1277,6 +1746,12 @@ ml_set_keyword_id (const Milexer *ml, Milexer_Token *res)
     return -1;
   if (ml->keywords.len > 0 && !ml->keywords.disabled)
     {
+      __ml_tk_fill (res);
+      if (ml->__tbl.trie.ok)
+        {
+          res->id = __ml_trie_keyword (ml, res->cstr);
+          return (res->id == -1) ? -1 : 0;
+        }
       for (int i=0; i < ml->keywords.len; ++i)
         {
           const char *p = ml->keywords.exp[i];
@@ -1305,13 +1780,231 @@ tk_set_defaults (const Milexer *ml, Milexer_Token *tk)
   return false;
 }
 
-MLDEF int
-ml_next (Milexer *ml, Milexer_Slice *src,
-         Milexer_Token *tk, int flags)
+/**
+ *  Sets the @bits of bytes of @s in @cls, and @last for
+ *  its last byte; returns false if @s is empty
+ */
+static bool
+__ml_cls_str (unsigned char *cls, const char *s, int bits, int last)
+{
+  const unsigned char *p = (const unsigned char *) s;
+  if (!p || !*p)
+    return false;
+  for (; *p; ++p)
+    cls[*p] |= bits;
+  cls[*(p - 1)] |= last;
+  return true;
+}
+
+MLDEF void
+ml_compile (Milexer *ml)
+{
+  unsigned char *cls = ml->__tbl.cls;
+  /* Empty prefixes match everywhere, nothing can be skipped */
+  bool ok = true, ok_end = true;
+
+  UPDATE_EXP (&ml->expression);
+  UPDATE_EXP (&ml->a_comment);
+  UPDATE_PUNC (&ml->puncs);
+
+  /* Disabled rules are also included, so toggling them is free */
+  memset (cls, 0, sizeof (ml->__tbl.cls));
+  for (int i=0; i < ml->puncs.len; ++i)
+    ok &= __ml_cls_str (cls, ml->puncs.exp[i].begin, ML_CLS_SPECIAL, 0);
+  for (int i=0; i < ml->expression.len; ++i)
+    ok &= __ml_cls_str (cls, ml->expression.exp[i].begin, ML_CLS_SPECIAL, 0);
+  for (int i=0; i < ml->b_comment.len; ++i)
+    ok &= __ml_cls_str (cls, ml->b_comment.exp[i],
+                        ML_CLS_SPECIAL, ML_CLS_SCOMM);
+  for (int i=0; i < ml->a_comment.len; ++i)
+    {
+      _exp_t *e = &ml->a_comment.exp[i];
+      ok &= __ml_cls_str (cls, e->begin, ML_CLS_SPECIAL, ML_CLS_MCOMM);
+      ok_end &= __ml_cls_str (cls, e->end, 0, ML_CLS_MCOMM_END);
+    }
+  cls[0] |= ML_CLS_SPECIAL;
+  cls['\\'] |= ML_CLS_SPECIAL;
+
+  for (int c = 1; c < ' '; ++c)
+    cls[c] |= ML_CLS_DELIM;
+  for (int i=0; i < ml->delim_ranges.len; ++i)
+    {
+      const unsigned char *r = (const unsigned char *) ml->delim_ranges.exp[i];
+      int hi = r[1] ? r[1] : r[0]; /* also "\x00\x12" */
+      for (int c = r[0]; c <= hi; ++c)
+        cls[c] |= ML_CLS_RANGE;
+    }
+
+  /* Stop sets, see __ml_skippable */
+  for (int f=0; f < 4; ++f)
+    {
+      struct ml_span_t *set = &ml->__tbl.middle[f];
+      int mask = ML_CLS_SPECIAL | ML_CLS_RANGE;
+      bool defaults = (ml->delim_ranges.len == 0 || (f & 2));
+      if (defaults)
+        mask |= ML_CLS_DELIM;
+      __ml_span_build (set, cls, mask,
+                       (defaults && !(f & 1)) ? " " : "");
+      set->disabled = !ok;
+
+      struct ml_span_t *dset = &ml->__tbl.dummy[f];
+      for (int i=0; i < 4; ++i)
+        dset->bits[i] = ~set->bits[i];
+      for (int c = 0; c < 256; ++c)
+        if (cls[c] & ML_CLS_SPECIAL)
+          ML_SPAN_ADD (dset, c);
+      dset->len = -1; /* only the bitmap, see __ml_skip_delims */
+      dset->disabled = !ok;
+    }
+  __ml_span_build (&ml->__tbl.comm, cls, 0, "\n\r\\");
+  __ml_span_build (&ml->__tbl.ml_comm, cls, ML_CLS_MCOMM_END, "\n\\");
+  ml->__tbl.ml_comm.disabled = !ok_end;
+
+  __ml_trie_build (ml);
+
+  __ML_STORE (ml, puncs);
+  __ML_STORE (ml, keywords);
+  __ML_STORE (ml, expression);
+  __ML_STORE (ml, b_comment);
+  __ML_STORE (ml, delim_ranges);
+  ml->__tbl.ready = true;
+}
+
+/**
+ *  The fast path of ml_next
+ *  Returns length of the run of bytes of @src, that the main loop
+ *  would only copy into @tk; @tk_plain means @tk has no SPECIAL
+ *  bytes, so no prefix could be found in the middle of it
+ *
+ *  The last byte of @src and @tk are always left to the main loop,
+ *  for handling the end of slice and chunks
+ */
+static inline size_t
+__ml_skippable (const Milexer *ml, const Milexer_Slice *src,
+                const Milexer_Token *tk, int flags, bool tk_plain)
+{
+  const struct ml_span_t *set;
+  const _exp_t *e = NULL;
+  size_t n;
+
+  switch (src->state)
+    {
+    case SYN_MIDDLE:
+      if (!tk_plain && tk->__idx > 0)
+        return 0;
+      set = &ml->__tbl.middle[ML_MIDDLE_SET (flags)];
+      break;
+
+    case SYN_COMM:
+      set = &ml->__tbl.comm;
+      break;
+
+    case SYN_ML_COMM:
+      set = &ml->__tbl.ml_comm;
+      break;
+
+    case SYN_NO_DUMMY:
+      /* Only the suffix of the expression and escapes */
+      e = __get_last_exp (ml, src);
+      if (e->len.end == 0)
+        return 0;
+      set = NULL;
+      break;
+
+    default:
+      return 0;
+    }
+  if (set && (set->disabled || ML_SPAN_HAS (set, src->buffer[src->idx])))
+    return 0;
+
+  n = src->cap - src->idx;
+  if (tk->cap - tk->__idx < n)
+    n = tk->cap - tk->__idx;
+  if (n <= 1)
+    return 0;
+  n -= 1;
+  if (set == NULL)
+    return __ml_span2 (src->buffer + src->idx, n,
+                       '\\', e->end[e->len.end - 1]);
+  return __ml_span (src->buffer + src->idx, n, set);
+}
+
+/**
+ *  The fast path of ml_next, between tokens (SYN_DUMMY)
+ *  Skips the run of delimiters of @src, but the last one, which
+ *  the main loop uses to finish @tk, like it does for all of them
+ *  These runs are short (a few spaces and puncs), so no SIMD
+ */
+static inline void
+__ml_skip_delims (const Milexer *ml, Milexer_Slice *src,
+                  Milexer_Token *tk, int flags)
+{
+  const struct ml_span_t *set = &ml->__tbl.dummy[ML_MIDDLE_SET (flags)];
+  const char *p = src->buffer + src->idx;
+  size_t n = src->cap - src->idx, i;
+
+  if (set->disabled || n <= 1 || tk->cap <= 1)
+    return;
+  for (i=0; i < n - 1 && !ML_SPAN_HAS (set, p[i]); ++i)
+    ;
+  if (i <= 1)
+    return;
+  for (size_t j=0; j < i - 1; ++j)
+    if (p[j] == '\n')
+      {
+        src->__last_newline = 0;
+        tk->line++;
+        tk->__line_idx = src->idx + j + 1;
+      }
+  src->idx += i - 1;
+}
+
+/**
+ *  Zero-copy mode (PFLAG_VIEW), tracks the source of @tk,
+ *  before copying the byte @p of the source into it
+ */
+#define ML_VIEW_TRACK(tk, p) do {                                   \
+    if ((tk)->__idx == 0)                                           \
+      (tk)->__src = (p), (tk)->__hole_end = 0;                      \
+    else if ((tk)->__src && (tk)->__src + (tk)->__idx != (p))       \
+      (tk)->__src = NULL;                                           \
+  } while (0)
+
+/* Zero-copy mode, sets the view of @tk, after returning @ret */
+static inline void
+__ml_set_view (Milexer_Token *tk, int ret)
+{
+  const char *p;
+  if ((ret == NEXT_MATCH || ret == NEXT_ZTERM) && tk->__src)
+    {
+      /* skipped bytes are never null, see __ml_skippable */
+      tk->view = tk->__src;
+      if (tk->__hole_end == 0)
+        tk->view_len = strlen (tk->cstr);
+      else if ((p = memchr (tk->cstr, 0, tk->__hole)))
+        tk->view_len = p - tk->cstr;
+      else
+        tk->view_len = tk->__hole_end + strlen (tk->cstr + tk->__hole_end);
+      tk->__hole = tk->__hole_end = 0;
+      return;
+    }
+  __ml_tk_fill (tk);
+  if (ret == NEXT_NEED_LOAD)
+    tk->__src = NULL; /* the next slice */
+  tk->view = tk->cstr;
+  tk->view_len = strlen (tk->cstr);
+}
+
+static int
+__ml_next (Milexer *ml, Milexer_Slice *src,
+           Milexer_Token *tk, int flags)
 {
   struct Milexer_exp_ *last_exp;
   if (tk->cstr == NULL || tk->cap <= 0 || tk->cstr == src->buffer)
     return NEXT_ERR;
+  /* Update language internals if necessary */
+  if (ML_DIRTY (ml))
+    ml_compile (ml);
 
   /* pre parsing */
   tk->type = TK_NOT_SET;
@@ -1327,6 +2020,7 @@ ml_next (Milexer *ml, Milexer_Slice *src,
           last_exp = __get_last_exp (ml, src);
           char *__p = mempcpy (tk->cstr, last_exp->begin, last_exp->len.begin);
           tk->__idx += __p - tk->cstr;
+          tk->__src = NULL;
           TOKEN_MARK_COL (src, tk);
           tk->col -= last_exp->len.begin;
         }
@@ -1337,6 +2031,7 @@ ml_next (Milexer *ml, Milexer_Slice *src,
       TOKEN_MARK_COL (src, tk);
       last_exp = __get_last_punc (ml, src);
       memcpy (tk->cstr, last_exp->begin, last_exp->len.begin);
+      tk->__src = NULL;
       LD_STATE (src);
       /* just to make to null-terminated */
       tk->__idx = last_exp->len.begin;
@@ -1358,6 +2053,7 @@ ml_next (Milexer *ml, Milexer_Slice *src,
           tk->type = TK_COMMENT;
           tk->__idx = strlen (src->__last_comm);
           strncpy (tk->cstr, src->__last_comm, tk->__idx);
+          tk->__src = NULL;
           src->__last_comm = NULL;
         }
       break;
@@ -1367,11 +2063,6 @@ ml_next (Milexer *ml, Milexer_Slice *src,
       TOKEN_MARK_COL (src, tk);
       if (src->__last_newline)
         TOKEN_MARK_NEWLINE (src, tk);
-
-      /* Update language internals if necessary */
-      UPDATE_EXP (&ml->expression);
-      UPDATE_EXP (&ml->a_comment);
-      UPDATE_PUNC (&ml->puncs);
       break;
 
     default:
@@ -1398,13 +2089,45 @@ ml_next (Milexer *ml, Milexer_Slice *src,
    */
   const char *p;
   char *dst = tk->cstr;
+  size_t n;
+  bool tk_plain = true;
   if (src->idx == 0)
     TOKEN_RESET_LINE (tk);
+  for (size_t i=0; i < tk->__idx && tk_plain; ++i)
+    tk_plain = !(ML_CLS (ml, tk->cstr[i]) & ML_CLS_SPECIAL);
   for (; src->idx < src->cap; )
     {
+      if (src->state == SYN_DUMMY && tk->__idx == 0)
+        __ml_skip_delims (ml, src, tk, flags);
+      else if ((n = __ml_skippable (ml, src, tk, flags, tk_plain)))
+        {
+          p = src->buffer + src->idx;
+          if (HAS_FLAG (flags, PFLAG_VIEW))
+            ML_VIEW_TRACK (tk, p);
+          if (HAS_FLAG (flags, PFLAG_VIEW) &&
+              src->state == SYN_MIDDLE && tk->__src)
+            {
+              /**
+               *  The middle of plain tokens is never read, unless they
+               *  become non-plain (or keyword), see __ml_tk_fill
+               */
+              if (tk->__hole_end == 0)
+                tk->__hole = tk->__idx;
+              tk->__hole_end = tk->__idx + n;
+            }
+          else
+            memcpy (tk->cstr + tk->__idx, p, n);
+          tk->__idx += n, src->idx += n;
+        }
       p = src->buffer + (src->idx++);
+      if (HAS_FLAG (flags, PFLAG_VIEW))
+        ML_VIEW_TRACK (tk, p);
       dst = tk->cstr + (tk->__idx++);
       *dst = *p;
+      tk_plain = (tk->__idx == 1 || tk_plain) &&
+        !(ML_CLS (ml, *p) & ML_CLS_SPECIAL);
+      if (!tk_plain && tk->__hole_end)
+        __ml_tk_fill (tk);
       
       //-- detect & reset chunks -------//
       if (tk->__idx == tk->cap)
@@ -1443,6 +2166,9 @@ ml_next (Milexer *ml, Milexer_Slice *src,
                 }
               else
                 {
+                  /* the current byte was escaped */
+                  if (src->state == SYN_ESCAPE)
+                    LD_STATE (src);
                   ST_STATE (src, SYN_CHUNK);
                   return NEXT_CHUNK;
                 }
@@ -1486,7 +2212,8 @@ ml_next (Milexer *ml, Milexer_Slice *src,
         case SYN_ML_COMM: {
           if (*p == '\n')
             TOKEN_MARK_NEWLINE (src, tk);
-          if ((__ptr = __is_mline_commented_suff (ml, src, tk)))
+          if ((ML_CLS (ml, *p) & ML_CLS_MCOMM_END) &&
+              (__ptr = __is_mline_commented_suff (ml, src, tk)))
             {
               TOKEN_MARK_COL (src, tk);
               ST_STATE (src, SYN_DUMMY);
@@ -1500,17 +2227,22 @@ ml_next (Milexer *ml, Milexer_Slice *src,
         } break;
 
         case SYN_DUMMY: {
-          if ((__ptr = __is_sline_commented_pref (ml, src, tk)))
+          /* No prefix could be found in plain tokens */
+          if (tk_plain)
+            tk->cstr[tk->__idx] = '\0';
+          if (!tk_plain && (ML_CLS (ml, *p) & ML_CLS_SCOMM) &&
+              (__ptr = __is_sline_commented_pref (ml, src, tk)))
             {
               tk->type = TK_COMMENT;
               ST_STATE (src, SYN_COMM);
             }
-          else if ((__ptr = __is_mline_commented_pref (ml, src, tk)))
+          else if (!tk_plain && (ML_CLS (ml, *p) & ML_CLS_MCOMM) &&
+                   (__ptr = __is_mline_commented_pref (ml, src, tk)))
             {
               tk->type = TK_COMMENT;
               ST_STATE (src, SYN_ML_COMM);
             }
-          else if ((__ptr = __is_expression_pref (ml, src, tk)))
+          else if (!tk_plain && (__ptr = __is_expression_pref (ml, src, tk)))
             {
               tk->type = TK_EXPRESSION;
               if (__ptr == tk->cstr)
@@ -1529,7 +2261,7 @@ ml_next (Milexer *ml, Milexer_Slice *src,
                   return NEXT_MATCH;
                 }
             }
-          else if ((__ptr = __detect_puncs (ml, src, tk)))
+          else if (!tk_plain && (__ptr = __detect_puncs (ml, src, tk)))
             {
               tk->type = TK_PUNCS;
               TOKEN_FINISH (tk);
@@ -1554,7 +2286,10 @@ ml_next (Milexer *ml, Milexer_Slice *src,
         } break;
 
         case SYN_MIDDLE: {
-          if ((__ptr = __is_sline_commented_pref (ml, src, tk)))
+          if (tk_plain)
+            tk->cstr[tk->__idx] = '\0';
+          if (!tk_plain && (ML_CLS (ml, *p) & ML_CLS_SCOMM) &&
+              (__ptr = __is_sline_commented_pref (ml, src, tk)))
             {
               ST_STATE (src, SYN_COMM);
               if (__ptr == tk->cstr)
@@ -1568,7 +2303,8 @@ ml_next (Milexer *ml, Milexer_Slice *src,
                   return NEXT_MATCH;
                 }
             }
-          else if ((__ptr = __is_mline_commented_pref (ml, src, tk)))
+          else if (!tk_plain && (ML_CLS (ml, *p) & ML_CLS_MCOMM) &&
+                   (__ptr = __is_mline_commented_pref (ml, src, tk)))
             {
               ST_STATE (src, SYN_ML_COMM);
               if (__ptr == tk->cstr)
@@ -1604,7 +2340,7 @@ ml_next (Milexer *ml, Milexer_Slice *src,
                   TOKEN_MARK_COL (src, tk);
                 }
             }
-          else if (__detect_puncs (ml, src, tk))
+          else if (!tk_plain && __detect_puncs (ml, src, tk))
             {
               const char *_punc = __get_last_punc (ml, src)->begin;
               size_t n = strlen (_punc);
@@ -1624,7 +2360,7 @@ ml_next (Milexer *ml, Milexer_Slice *src,
                   return NEXT_MATCH;
                 }
             }
-          else if ((__ptr = __is_expression_pref (ml, src, tk)))
+          else if (!tk_plain && (__ptr = __is_expression_pref (ml, src, tk)))
             {
               if (__ptr != tk->cstr)
                 {
@@ -1700,6 +2436,20 @@ ml_next (Milexer *ml, Milexer_Slice *src,
   return NEXT_NEED_LOAD;
 }
 
+MLDEF int
+ml_next (Milexer *ml, Milexer_Slice *src,
+         Milexer_Token *tk, int flags)
+{
+  int ret = __ml_next (ml, src, tk, flags);
+  if (ret == NEXT_ERR)
+    return ret;
+  if (HAS_FLAG (flags, PFLAG_VIEW))
+    __ml_set_view (tk, ret);
+  else
+    tk->__src = NULL;
+  return ret;
+}
+
 /* Milexer's flex API implementation */
 #ifdef ML_FLEX
 /**
@@ -2398,7 +3148,14 @@ do_test__H (test_t *t, Milexer_Slice *src,
         Return (counter, "unexpected NEXT_END");
       ret = ml_next (&ml, src, &tk, t->parsing_flags);
 
-      if (strcmp (tcase->cstr, tk.cstr) != 0)
+      if (HAS_FLAG (t->parsing_flags, PFLAG_VIEW))
+        {
+          if (strlen (tcase->cstr) != tk.view_len ||
+              strncmp (tcase->cstr, tk.view, tk.view_len) != 0)
+            Return (counter, "token view `%.*s` != expected `%s`",
+                    (int) tk.view_len, tk.view, tcase->cstr);
+        }
+      else if (strcmp (tcase->cstr, tk.cstr) != 0)
         {
           Return (counter, "token `%s` != expected `%s`",
                   tk.cstr, tcase->cstr);
@@ -2707,6 +3464,20 @@ main (int argc, char **argv)
         {0}
       }};
     DO_TEST (&t, "inner long expressions");
+
+    t = (test_t) {
+      .parsing_flags = PFLAG_INEXP | PFLAG_VIEW,
+      .input = "hello world+if(bar baz) file ",
+      .etk = (Milexer_Token []){
+        {.type = TK_KEYWORD,       .cstr = "hello",    .col=0},
+        {.type = TK_KEYWORD,       .cstr = "world",    .col=6},
+        {.type = TK_PUNCS,         .cstr = "+",        .col=11},
+        {.type = TK_KEYWORD,       .cstr = "if",       .col=12},
+        {.type = TK_EXPRESSION,    .cstr = "bar baz",  .col=15},
+        {.type = TK_KEYWORD,       .cstr = "file",     .col=24},
+        {0}
+      }};
+    DO_TEST (&t, "zero-copy view flag");
   }
 
   puts ("-- custom delimiters --");
@@ -2778,6 +3549,18 @@ main (int argc, char **argv)
         {0}
       }};
     DO_TEST (&t, "escape & inner expression flag");
+
+    /* the escaped byte is the last byte of the chunk */
+    t = (test_t) {
+      .parsing_flags = PFLAG_DEFAULT,
+      .input = "(aaaaaaaaaaaaa\\)b) cc ",
+      .etk = (Milexer_Token []){
+        {.type = TK_EXPRESSION,    .cstr = "(aaaaaaaaaaaaa\\)"},
+        {.type = TK_EXPRESSION,    .cstr = "b)"},
+        {.type = TK_KEYWORD,       .cstr = "cc"},
+        {0}
+      }};
+    DO_TEST (&t, "escape at the end of chunk");
   }
 
   puts ("-- single-line comment --");
@@ -49,6 +49,16 @@
       $ ffux -XPOST -u https://x.com  -d 'username=FUZZ' -w /tmp/usernames \
                                       -d 'password=FUZZ' -w /tmp/rockyou.txt
 
+    Generated word-lists:
+      Instead of a file path, `-W "permugen:ARGS"` runs `permugen ARGS`
+      and reads the words from it's output lazily (without any temporary
+      file), so the word-list can be arbitrary large:
+      $ ffuc -u https://x.com/FUZZ -W "permugen: -s '[a-z]' -d4"
+      (the count of words is taken from `permugen --estimate`)
+      Seeking to a word (workers, resume and leases) and rewinds,
+      restart permugen with `--skip`, so ARGS should not have the
+      --skip, --count and --threads (unordered) options
+
     Filter & Match:
       To filter responses (to excluding if satisfied):
           --fs (filter size),        --fc (filter status code)
@@ -74,10 +84,25 @@
         Singular:  one word-list for all FUZZ keywords
       See the usage help for more details.
 
+    Workers:
+      By default, one thread sends all the requests and handles their
+      responses; With `-j N`, N worker threads share the work, each
+      with it's own curl multi handle and a slice of the concurrent
+      requests (-t), so response handling is not limited to one core.
+      $ ffuc -j 4 -t 200 -u https://x.com/FUZZ -w /tmp/wl1
+
+    Distributed mode:
+      A coordinator splits the fuzz indexes into leases, and nodes
+      (on other hosts, with the same options and word-lists) send
+      the requests of leases and stream back passed results; leases
+      of dead nodes are given to others.
+      $ ffuc --coordinator 9090 -u https://x.com/FUZZ -w /tmp/wl1
+      $ ffuc --node host:9090 -j 4 -u https://x.com/FUZZ -w /tmp/wl1
+
     Compilation:
       cc -ggdb -O3 -Wall -Wextra -Werror \
          -I ../libs/ \
-         ffuc.c -o ffuc -lcurl
+         ffuc.c -o ffuc -lcurl -lpthread
 
     Options:
       -D_DEBUG:
@@ -88,6 +113,8 @@
         Disables handing no FUZZ keyword provided scenarios
       -D NO_DEFAULT_COLOR:
         Disables output colors by default
+      -D PERMUGEN_CMD='"/path/to/permugen"':
+        The permugen command of the generated word-lists
  **/
 #undef _GNU_SOURCE
 #define _GNU_SOURCE
@@ -100,6 +127,10 @@
 #include <errno.h>
 #include <string.h>
 #include <stdbool.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <inttypes.h>
 
 #include <fcntl.h>
 #include <sys/mman.h>
@@ -110,6 +141,10 @@
 /* Only used in interactive mode */
 #include <pthread.h>
 #include <signal.h>
+#include <sys/epoll.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
 
 #define DYNA_IMPLEMENTATION
 #include "dyna.h"
@@ -127,7 +162,7 @@
 #ifndef TMP_CAP
 #  define TMP_CAP 1024 /* bytes */
 #endif
-static char tmp[TMP_CAP];
+static __thread char tmp[TMP_CAP]; /* thread-local, used by workers */
 
 /* Default concurrent requests count */
 #ifndef DEFAULT_REQ_COUNT
@@ -156,11 +191,76 @@ static char tmp[TMP_CAP];
 # define MIN_DT_US 100
 #endif
 
+/**
+ *  Adaptive rate controller (see the `--adaptive` option)
+ *  Every AIMD_PERIOD_MS, the concurrency window grows by
+ *  AIMD_INC_WINDOW, or halves if the p99 latency of the
+ *  period exceeds the target or more than AIMD_ERR_PERC
+ *  percent of the responses were errors.
+ *  Without an explicit target, it is AIMD_AUTO_FACTOR times
+ *  the best p50 seen so far.
+ */
+#ifndef AIMD_PERIOD_MS
+# define AIMD_PERIOD_MS 500
+#endif
+#ifndef AIMD_INIT_WINDOW
+# define AIMD_INIT_WINDOW 4
+#endif
+#ifndef AIMD_INC_WINDOW
+# define AIMD_INC_WINDOW 1
+#endif
+#ifndef AIMD_ERR_PERC
+# define AIMD_ERR_PERC 5
+#endif
+#ifndef AIMD_AUTO_FACTOR
+# define AIMD_AUTO_FACTOR 4
+#endif
+#ifndef AIMD_MIN_TARGET_MS
+# define AIMD_MIN_TARGET_MS 50
+#endif
+
+/* Checkpoint interval (see the `--checkpoint` option) */
+#ifndef CKPT_PERIOD_MS
+# define CKPT_PERIOD_MS 1000
+#endif
+#define CKPT_MAGIC "FFUCCKP1"
+
+/**
+ *  Distributed mode  (see the `--coordinator` and `--node` options)
+ *  LEASE_LEN:  count of fuzz indexes of each lease
+ *  NODE_PING_MS:  nodes send PING, when idle more than this
+ *  NODE_TTL_MS:  nodes silent for this long, are considered dead
+ *  NODE_RETRY_MS:  nodes ask for leases again after WAIT
+ */
+#ifndef LEASE_LEN
+# define LEASE_LEN 4096
+#endif
+#ifndef NODE_PING_MS
+# define NODE_PING_MS 2000
+#endif
+#ifndef NODE_TTL_MS
+# define NODE_TTL_MS 15000
+#endif
+#ifndef NODE_RETRY_MS
+# define NODE_RETRY_MS 500
+#endif
+#ifndef NODES_MAX
+# define NODES_MAX 64
+#endif
+#ifndef NODE_BUF_CAP
+# define NODE_BUF_CAP (1 << 16) /* Buffer of results, of nodes */
+#endif
+
 /* Poll timeout */
 #ifndef POLL_TTL_MS
 # define POLL_TTL_MS 1000
 #endif
 
+/* Maximum count of events of each epoll_wait call */
+#ifndef EPOLL_EVENTS_MAX
+# define EPOLL_EVENTS_MAX 64
+#endif
+
 #ifndef PRINT_MARGIN
 # ifndef __ANDROID__
 #   define PRINT_MARGIN 25
@@ -173,6 +273,31 @@ static char tmp[TMP_CAP];
 #define DISCOVERY_REQ_COUNT 4
 #endif
 
+/* Count of fuzz indexes that workers take at once */
+#ifndef FUZZ_CHUNK
+# define FUZZ_CHUNK 64
+#endif
+
+/* Generated word-lists, see fw_gen */
+#ifndef PERMUGEN_CMD
+# define PERMUGEN_CMD "permugen"
+#endif
+#define FW_GEN_PREFIX "permugen:"
+
+/**
+ *  Generated word-lists, seeking more than FW_GEN_SEEK_MAX
+ *  words forward (or any backward), restarts the generator
+ *  with `--skip`, otherwise the words are read
+ */
+#ifndef FW_GEN_SEEK_MAX
+# define FW_GEN_SEEK_MAX 4096
+#endif
+
+/* Mapped word-lists, one line offset per FW_INDEX_STRIDE words */
+#ifndef FW_INDEX_STRIDE
+# define FW_INDEX_STRIDE 64
+#endif
+
 #define NOP ((void) NULL)
 #define UNUSED(x) (void)(x)
 #define MIN(a,b) ((a < b) ? (a) : (b))
@@ -189,7 +314,7 @@ static char tmp[TMP_CAP];
     fprintf (stream, element_format, (arr)[__idx]);         \
   } while (0)
 
-const char *lopt_str = "m:w:" "T:R:t:p:A" "u:H:d:X:x:" "ivhc";
+const char *lopt_str = "m:w:W:j:" "T:R:t:p:A" "u:H:d:X:x:" "ivhckE";
 const struct option lopts[] =
   {
     /* We call it `thread` (-t) for compatibility with ffuf,
@@ -247,6 +372,8 @@ const struct option lopts[] =
     {"word",                required_argument, NULL, 'w'},
     {"wordlist",            required_argument, NULL, 'w'},
     {"word-list",           required_argument, NULL, 'w'},
+    {"generator",           required_argument, NULL, 'W'},
+    {"workers",             required_argument, NULL, 'j'},
     {"rate",                required_argument, NULL, 'R'},
     {"max_rate",            required_argument, NULL, 'R'},
     {"timeout",             required_argument, NULL, 'T'},
@@ -256,6 +383,15 @@ const struct option lopts[] =
     {"color",               no_argument,       NULL, 'c'},
     {"it",                  no_argument,       NULL, 'i'},
     {"interactive",         no_argument,       NULL, 'i'},
+    {"keep-alive",          no_argument,       NULL, 'k'},
+    {"early-abort",         no_argument,       NULL, 'E'},
+    {"adaptive",            optional_argument, NULL, '%'},
+    {"checkpoint",          required_argument, NULL, '{'},
+    {"resume",              required_argument, NULL, '}'},
+    {"stats",               required_argument, NULL, '^'},
+    {"http2",               no_argument,       NULL, '@'},
+    {"coordinator",         required_argument, NULL, '<'},
+    {"node",                required_argument, NULL, '>'},
     {"proxy",               required_argument, NULL, 'x'},
     {"http-proxy",          required_argument, NULL, 'x'},
     {"help",                no_argument,       NULL, 'h'},
@@ -299,6 +435,8 @@ enum ffuc_flag_t
      */
     CTX_FREE          = 0,
     CTX_INUSE         = 1,
+    CTX_READY         = 2, /* static options are set (keep-alive mode) */
+    CTX_ABORTED       = 4, /* discarded by early abort (the `-E` option) */
 
     /* Exit codes */
     EOFUZZ            = 1,
@@ -389,6 +527,52 @@ struct req_stat_t
     .code=0,   .duration=0,       .ccode=0,              \
   })
 
+/**
+ *  Latency histogram (microseconds)
+ *  Values below 2^LAT_SUB_BITS have their own bucket, the others
+ *  are split into 2^LAT_SUB_BITS buckets per power of two, so the
+ *  relative error is below 1/2^LAT_SUB_BITS  (HDR histogram)
+ */
+#ifndef LAT_SUB_BITS
+# define LAT_SUB_BITS 3
+#endif
+#define LAT_SUB (1U << LAT_SUB_BITS)
+#define LAT_MAX_BITS 31 /* ~35 minutes */
+#define LAT_HIST_LEN ((LAT_MAX_BITS - LAT_SUB_BITS + 1) * LAT_SUB)
+
+struct lat_hist_t
+{
+  uint buckets[LAT_HIST_LEN];
+};
+
+/* Phases of requests, @lat of Progress */
+enum lat_phase_t
+  {
+    LAT_DNS = 0,
+    LAT_CONNECT,
+    LAT_TLS,
+    LAT_TTFB, /* Time to first byte */
+    LAT_TOTAL,
+    LAT_PHASES
+  };
+
+const char *lat_phase_name[] =
+  {
+    [LAT_DNS]         = "dns",
+    [LAT_CONNECT]     = "connect",
+    [LAT_TLS]         = "tls",
+    [LAT_TTFB]        = "ttfb",
+    [LAT_TOTAL]       = "total",
+  };
+
+/* Per status code counters, @status of Progress */
+#define HTTP_STATUS_MAX 600
+
+/* Interval of the JSON stats dump (see the `--stats` option) */
+#ifndef STATS_PERIOD_MS
+# define STATS_PERIOD_MS 5000
+#endif
+
 typedef struct progress_t
 {
   uint req_total;
@@ -400,18 +584,76 @@ typedef struct progress_t
   uint progbar_refrate; /* progress bar refresh rate */
   uint rate;
 
+  /**
+   *  Latency of responses (including errors) of each phase;
+   *  DNS, connect and TLS, only when they were not skipped
+   *  (reused connections)
+   */
+  struct lat_hist_t lat[LAT_PHASES];
+  /* Count of responses by status code, errors are not included */
+  uint status[HTTP_STATUS_MAX];
+  size_t start_us; /* The start time of the fuzz */
+
   /* Internals (to calculate request rate) */
   size_t dt_us; /* delta time */
   uint __req_dt; /* stabilized req_dt */
 } Progress;
 
+/**
+ *  Adaptive controller state (AIMD)
+ *  @window and @rate are the live setpoints, workers
+ *  read them; the controller and the interactive thread
+ *  write them (relaxed atomic)
+ */
+struct aimd_t
+{
+  bool enabled;
+  uint target_ms; /* p99 latency target, 0 means automatic */
+  uint window; /* Maximum requests in flight */
+  uint rate; /* Request rate setpoint (req/sec) */
+  uint p50, p99; /* Latencies of the last period */
+
+  /* Internals */
+  size_t t0_us;
+  uint best_p50;
+  uint __err_count;
+  struct lat_hist_t __prev;
+};
+
+/**
+ *  Counters and rates of progress_t are shared among the worker
+ *  threads and the main thread (tick_progress), so they are
+ *  accessed atomically
+ */
+#define PROG_LOAD(field) __atomic_load_n (&(field), __ATOMIC_RELAXED)
+#define PROG_STORE(field, val) \
+  __atomic_store_n (&(field), (val), __ATOMIC_RELAXED)
+
 /* Percentage of progress */
-#define REQ_PERC(prog) ((prog)->req_sent * 100 / (prog)->req_total)
+#define REQ_PERC(prog) (PROG_LOAD ((prog)->req_sent) * 100 / (prog)->req_total)
 /* Convert timespec to microseconds */
 #define TS2US(tv) ((tv).tv_sec * 1000000LL + (tv).tv_sec)
-/* Request rate and real time rate */
-#define REQ_RATE(prog) (((prog)->__req_dt * 1000000) / (prog)->dt_us)
-#define RT_REQ_RATE(prog) (((prog)->req_dt * 1000000) / (prog)->dt_us)
+
+/* Monotonic clock in microseconds */
+static inline size_t
+now_us (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000UL + ts.tv_nsec / 1000;
+}
+
+/* Monotonic clock in milliseconds */
+static inline long
+now_ms (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+/* Request rate of @req requests in @dt microseconds */
+#define REQ_RATE(req, dt) (((req) * 1000000) / (dt))
 
 struct res_filter_t
 {
@@ -429,15 +671,25 @@ const struct res_filter_t default_filter = {MATCH_CODE, {200, 399}};
 
 struct request_t
 {
+  /* @URL, @body and headers' data point to @arena */
   char *URL;
   char *body;
-  struct curl_slist *headers;
+  struct curl_slist *headers; /* Static array, linked in place */
+
+  char *arena; /* Request assembly buffer, see __register_context */
+  size_t arena_cap;
 };
 
+struct worker_t;
+
 typedef struct
 {
   int flag;
   CURL *easy_handle;
+  CURLM *multi_handle; /* The multi handle of @easy_handle */
+  struct worker_t *worker; /* The owner worker, NULL if not any */
+  void *next_free; /* The next free context, see lookup_free_handle */
+  size_t fuzz_index; /* The fuzz index of the request (workers only) */
 
   /* Statistics of the request */
   struct req_stat_t stat;
@@ -461,6 +713,26 @@ typedef struct
   char **wlists; /* word-list(s) file path */
 } FuzzTemplate;
 
+/**
+ *  Compiled template
+ *
+ *  Each template string of FuzzTemplate is compiled once
+ *  (see compile_template) into segments; literal spans of the
+ *  template, and slots, that refer to RequestContext->FUZZ
+ */
+struct tmpl_seg_t
+{
+  const char *str; /* Literal span, NULL for slots */
+  size_t len;
+  int slot; /* Index of RequestContext->FUZZ */
+};
+
+typedef struct
+{
+  struct tmpl_seg_t *segs; /* Dynamic array */
+  size_t lit_bytes; /* Total length of literal spans */
+} CompiledTemplate;
+
 /**
  *  FFuc word (fw)
  *
@@ -490,12 +762,106 @@ typedef struct
   /* Internal */
   uint __offset; /* Offset of the current word in @str */
   size_t __str_bytes; /* length of @str in bytes */
+
+  /**
+   *  Generated word-lists (see fw_gen), when @__gen_args is not NULL,
+   *  @str is a line buffer of @__str_bytes bytes which holds only
+   *  the current word, read from the output of @__gen
+   */
+  char *__gen_args;
+  FILE *__gen;
+
+  /**
+   *  Mapped word-lists, @__lines[i] is the offset of the word
+   *  i * FW_INDEX_STRIDE in @str (dynamic array, see fw_seek)
+   *  Copies (fw_dup) share @str and @__lines with the original,
+   *  and @__shared is set in them
+   */
+  size_t *__lines;
+  bool __shared;
 } Fword;
 
 const Fword dummy_fword = {
   .str="FUZZ\n", .len=4, .total_count=1, .__str_bytes=5
 };
 
+/**
+ *  Worker threads  (see the `-j` option)
+ *
+ *  Each worker owns a slice of opt.Rqueue.ctxs, it's own curl multi
+ *  handle and copies of the word-lists; workers take fuzz indexes in
+ *  chunks of FUZZ_CHUNK from the shared opt.fuzz_next (atomic), and
+ *  __next_fuzz_index maps each index to the words of word-lists
+ */
+typedef struct worker_t
+{
+  int id;
+  pthread_t th;
+  CURLM *multi_handle;
+  RequestContext *ctxs; /* A slice of opt.Rqueue.ctxs */
+  size_t len; /* Length of @ctxs */
+  size_t waiting; /* number of used elements */
+  RequestContext *free_ctxs; /* Free list of @ctxs */
+
+  /* Event driver, see fuzz_loop */
+  int epfd;
+  long timeout_at; /* curl timer deadline (ms), -1 if not any */
+
+  Fword **words; /* Copies of opt.words (Static array) */
+  size_t next, end; /* The current chunk of fuzz indexes */
+  bool eofuzz;
+} Worker;
+
+/**
+ *  Checkpoint file  (see the `--checkpoint` option)
+ *
+ *  The file is mmap'd and updated in place; each worker records
+ *  it's current chunk and fuzz indexes of it's requests in flight
+ *  (one slot per request context), and the main thread updates
+ *  the header every CKPT_PERIOD_MS.
+ *  Fuzz indexes below @fuzz_next, which are not in any chunk,
+ *  slot or pending range, are done.
+ *
+ *  Layout:  the header,  @workers_len chunks (ckpt_range_t),
+ *           @slots_len slots (fuzz index + 1, or 0 if free),
+ *           @pending_len ranges, left from the resumed run
+ *
+ *  @sign identifies the fuzz configuration (see fuzz_sign)
+ */
+struct ckpt_range_t
+{
+  uint64_t start, end;
+};
+
+struct ckpt_t
+{
+  char magic[8];
+  uint64_t sign;
+  uint64_t fuzz_next;
+  uint64_t req_total;
+  uint32_t req_sent, err_count;
+  uint32_t workers_len, slots_len, pending_len;
+  uint32_t __pad;
+};
+
+/**
+ *  Lease of fuzz indexes  (distributed mode)
+ *  Nodes count the finished requests of it (@done) and errors,
+ *  the coordinator keeps the @owner node of it
+ */
+struct lease_t
+{
+  size_t start, end;
+  size_t done;
+  uint errors;
+  int owner;
+};
+
+#define ckpt_size(workers_len, slots_len, pending_len)        \
+  (sizeof (struct ckpt_t) +                                   \
+   ((workers_len) + (pending_len)) * sizeof (struct ckpt_range_t) + \
+   (slots_len) * sizeof (uint64_t))
+
 /* Fword printf format and arguments */
 #define FW_FORMAT "%.*s"
 #define FW_ARG(fw) (int)((fw)->len), fw_get (fw)
@@ -504,6 +870,12 @@ const Fword dummy_fword = {
 int fw_map (Fword *dst, int fd);
 /* To initialize Fword manually */
 void fw_init (Fword *fw, char *cstr, size_t cstr_len);
+/**
+ *  To initialize Fword from a generator command, @args are
+ *  arguments of permugen (without FW_GEN_PREFIX)
+ *  Returns non-zero on failure
+ */
+int fw_gen (Fword *dst, const char *args);
 
 /**
  *  Open file @path and create Fword of it,
@@ -515,8 +887,17 @@ static inline Fword *make_fw_from_path (const char *path);
 /* Fword copy, duplicate and unmap */
 #define fw_cpy(dst, src) Memcpy (dst, src, sizeof (Fword))
 Fword *fw_dup (const Fword *src);
-#define fw_unmap(fw) \
-  if ((fw) && (fw)->str) { ffuc_munmap ((fw)->str, (fw)->__str_bytes); }
+#define fw_unmap(fw) do {                                    \
+    if ((fw) && (fw)->__gen_args)                            \
+      fw_gen_close (fw);                                    \
+    else if ((fw) && (fw)->str && !(fw)->__shared)          \
+      {                                                     \
+        ffuc_munmap ((fw)->str, (fw)->__str_bytes);         \
+        da_free ((fw)->__lines);                            \
+      }                                                     \
+  } while (0)
+/* Terminates the generator of @fw, and frees it's buffers */
+void fw_gen_close (Fword *fw);
 
 /* Fword free, Only needed if @fw is created via fw_dup */
 #define fw_free(fw) do {                        \
@@ -526,6 +907,9 @@ Fword *fw_dup (const Fword *src);
 
 /* Moves to the next word in the word-list, and returns it */
 char *fw_next (Fword *fw);
+/* Moves to the first word, or to the word at @index */
+static void fw_rewind (Fword *fw);
+static void fw_seek (Fword *fw, uint index);
 /* Returns the current word of the word-list */
 #define fw_get(fw) ((fw)->str + (fw)->__offset)
 
@@ -542,15 +926,24 @@ Fword *fw_dup (const Fword *src);
 char *fw_next (Fword *fw);
 
 /**
- *  FUZZ sprintf function
- *  substitutes the FUZZ keyword of @format
- *  with the appropriate value from the @FUZZ array.
+ *  Template compiler
+ *  splits @format into literal spans and slots of FUZZ
+ *  keywords, slots are numbered from *@slot and *@slot
+ *  gets incremented by the number of slots used.
+ *  FUZZ keywords without any word-list remain literal.
+ */
+void compile_template (CompiledTemplate *dst,
+                       const char *format, int *slot);
+
+/**
+ *  Writes @t into @dst, substituting the slots with
+ *  elements of @FUZZ, @lens are their lengths
  * Return:
- *  The number of elements consumed from @FUZZ.
- *  @FUZZ must have enough element(s).
+ *  End of the written bytes, the null-byte is NOT written
  */
-int fuzz_snprintf (char *restrict dst, size_t dst_cap,
-               const char *restrict format, char **FUZZ);
+static inline char *
+tmpl_assemble (char *restrict dst, const CompiledTemplate *t,
+               char **FUZZ, const size_t *lens);
 
 /**
  *  Strline and StrlineNull Functions
@@ -565,18 +958,19 @@ static inline char *Strline (const char *cstr);
 static inline char *StrlineNull (const char *cstr);
 
 /**
- *  Libcurl handle lookup functions
+ *  Libcurl handle lookup functions, O(1)
  *
  * lookup_handle:
- *   Finds @handle in @ctxs array, returns NULL is not found
+ *   Returns the request context of @handle (CURLOPT_PRIVATE)
  * lookup_free_handle:
- *   Finds the first free request context in @ctxs,
+ *   Takes a free request context from the free list of @w,
  *   returns null if couldn't find any
+ * release_handle:
+ *   Gives @ctx back to the free list of it's worker @w
  */
-static inline RequestContext *
-lookup_handle (CURL *handle, RequestContext *ctxs, size_t len);
-static inline RequestContext *
-lookup_free_handle (RequestContext *ctxs, size_t len);
+static inline RequestContext *lookup_handle (CURL *handle);
+static inline RequestContext *lookup_free_handle (struct worker_t *w);
+static inline void release_handle (struct worker_t *w, RequestContext *ctx);
 
 /**
  *  Progress functions
@@ -596,11 +990,64 @@ lookup_free_handle (RequestContext *ctxs, size_t len);
  *   Returns the current request rate and updates @prog->rate
  * rt_req_rate:
  *   Real time request rate
+ *
+ * lat_record:
+ *   Adds @us to the latency histogram @h (atomic)
+ * lat_quantile:
+ *   Returns the @q quantile (0 < @q <= 1) of @n samples of
+ *   the difference of histograms @h and @prev (if not NULL)
+ *
+ * dump_stats:
+ *   Prints the progress, status code counters and the
+ *   latency of each phase, as one JSON line
+ *
+ * monitor_progress:
+ *   Periodic tasks of the progress, see its definition
  */
 static void init_progress (Progress *prog);
 static void tick_progress (Progress *prog);
 static inline size_t update_req_rate (Progress *prog);
 static inline size_t rt_req_rate (Progress *prog);
+static inline void lat_record (struct lat_hist_t *h, uint us);
+static uint lat_quantile (const struct lat_hist_t *h,
+                          const struct lat_hist_t *prev,
+                          size_t n, double q);
+static void dump_stats (FILE *stream, const Progress *prog);
+static inline void monitor_progress (size_t *avg_rate);
+
+/**
+ *  Adaptive controller functions
+ *
+ * aimd_update:
+ *   Adjusts the setpoints of @c, at the end of each period
+ * rate_limit, window_limit:
+ *   The current request rate and concurrency limits
+ */
+static void aimd_update (struct aimd_t *c, Progress *prog);
+static inline uint rate_limit (void);
+static inline size_t window_limit (void);
+
+/**
+ *  Distributed mode functions
+ *  The protocol is line based, nodes send:
+ *    `HELLO <sign>`  ->  `OK` or `BAD`  (see fuzz_sign)
+ *    `NEXT`  ->  `LEASE <start> <end>`, `WAIT` or `DONE`
+ *    `FIN <start> <end> <errors>`:  all requests of a lease are done
+ *    `R <len>` + @len bytes:  the passed results, as printed
+ *    `PING`:  keep alive, when idle more than NODE_PING_MS
+ *
+ * node_take_chunk:
+ *   Takes the next chunk of worker @w, from the leases
+ *   an empty chunk means waiting, unless @w->eofuzz is set
+ * node_complete:
+ *   Counts the request of fuzz index @idx, sends FIN
+ *   when the lease of it is finished
+ * run_coordinator:
+ *   Leases fuzz indexes to nodes until the end of fuzz
+ */
+static void node_take_chunk (struct worker_t *w);
+static void node_complete (size_t idx, bool err);
+static int run_coordinator (void);
 
 static void __update_progress_bar (const Progress *prog);
 #define update_progress_bar(prog) \
@@ -613,6 +1060,8 @@ static void __update_progress_bar (const Progress *prog);
  * interact:
  *   This function reads user input, from another thread,
  *   and prints appropriate response.
+ *   Keys:  Enter: progress,  a: toggle the adaptive controller,
+ *   +/-: double/halve the window,  >/<: double/halve the rate
  */
 void goto_raw_mode (struct termios *original);
 #define disable_raw_mode(original) \
@@ -740,15 +1189,64 @@ struct Opt
   char *verb; /* HTTP verb */
   FILE *streamout;
   char *proxy;
+  bool keepalive; /* Keep-alive mode, to reuse contexts and connections */
+  bool http2; /* HTTP/2 multiplexing (implies keep-alive) */
+  bool early_abort; /* Abort transfer of discarded responses */
+  struct aimd_t aimd; /* Adaptive rate controller */
+  FILE *stats_stream; /* JSON lines stats (see dump_stats) */
+  struct
+  {
+    char *addr; /* [HOST:]PORT to listen on, coordinator mode */
+    struct lease_t *leases; /* Dynamic array, leases of nodes */
+    struct lease_t *pool; /* Dynamic array, leases of dropped nodes */
+    size_t next; /* The next fuzz index to lease */
+  } coord;
+  struct
+  {
+    char *addr; /* HOST:PORT of the coordinator */
+    int fd;
+    FILE *in; /* Replies of the coordinator */
+    pthread_mutex_t lock; /* Of the socket and the fields below */
+    struct lease_t *leases; /* Dynamic array, leases in progress */
+    size_t next, end; /* Remaining fuzz indexes of the latest lease */
+    long retry_at; /* After WAIT (ms) */
+    long sent_at; /* The latest message (ms) */
+    bool done; /* No more leases */
+  } node;
   FuzzTemplate fuzz_template;
   struct res_filter_t *filters; /* Dynamic array */
 
   /* Internals */
   int fuzz_flag;
+  size_t stats_t0_us;
   CURLM *multi_handle;
+  CompiledTemplate *tmpls; /* Static array; URL, body, headers... */
+  int tmpls_len;
+  int headers_len; /* Number of HTTP header templates */
+  CURLSH *share; /* Shared DNS and TLS session cache (keep-alive mode) */
+  pthread_mutex_t share_locks[CURL_LOCK_DATA_LAST];
   struct progress_t progress;
   pthread_t interact_th; /* interactive mode thread */
 
+  Worker *workers; /* Static array */
+  int workers_len; /* Length of @workers, 1 means no worker thread */
+  int workers_running;
+  size_t fuzz_next; /* The next fuzz index, for workers */
+  struct
+  {
+    char *path;
+    bool resume; /* Restore the state of @path */
+    struct ckpt_t *state; /* mmap'd @path */
+    size_t map_len;
+    struct ckpt_range_t *chunks; /* Of workers, within @state */
+    uint64_t *slots;
+    struct ckpt_range_t *pending;
+    uint32_t pending_next; /* The next pending range to redo (atomic) */
+    bool frozen; /* At exit, workers must not update @state anymore */
+    size_t t0_us;
+  } ckpt;
+  pthread_mutex_t print_lock; /* To print results and progress-bar */
+
   Fword **words; /* Dynamic array */
   int words_len; /* Length of @words */
 
@@ -771,6 +1269,11 @@ struct Opt
   void (*load_next_fuzz) (RequestContext *ctx);
   bool eofuzz; /* End of load_next_fuzz */
 };
+/* End of fuzz, of worker @w */
+#define worker_eofuzz(w) (opt.eofuzz || (w)->eofuzz)
+/* Workers should only update the checkpoint when this is true */
+#define ckpt_active() \
+  (opt.ckpt.state && !__atomic_load_n (&opt.ckpt.frozen, __ATOMIC_ACQUIRE))
 struct Opt opt;
 
 enum http_color_code
@@ -798,7 +1301,21 @@ const char *HttpPallet[] =
 static inline const char *http_pallet_of (int resp_code);
 #define colorof_ctx(ctx) http_pallet_of ((ctx)->stat.code)
 
-/** @optr: The corresponding request context, passed by libcurl **/
+/**
+ *  Early abort filter
+ *  For incomplete responses, returns true when @filters
+ *  will discard the response regardless of the rest of it;
+ *  @final_size is the size of the entire response if it is
+ *  known (Content-Length header), otherwise -1
+ */
+static inline bool
+filter_discards (const struct req_stat_t *stat,
+                 const struct res_filter_t *filters, curl_off_t final_size);
+
+/**
+ *  @optr: The corresponding request context, passed by libcurl
+ *  Stats are counted chunk by chunk, so the body is never stored
+ */
 size_t
 curl_fwrite (void *ptr, size_t size, size_t nmemb, void *optr)
 {
@@ -816,9 +1333,46 @@ curl_fwrite (void *ptr, size_t size, size_t nmemb, void *optr)
       else if (c < ' ')
         ctx->stat.lcount++;
     }
+
+  if (opt.early_abort && 0 != ctx->stat.code &&
+      filter_discards (&ctx->stat, opt.filters, -1))
+    {
+      FLG_SET (ctx->flag, CTX_ABORTED);
+      return 0; /* Aborts the transfer */
+    }
   return len; 
 }
 
+/**
+ *  Header callback of the early abort mode
+ *  At the end of headers, when the response code and
+ *  Content-Length are known, checks the filters
+ */
+size_t
+curl_fheader (char *ptr, size_t size, size_t nmemb, void *optr)
+{
+  size_t len = (size_t)(size * nmemb);
+  RequestContext *ctx = (RequestContext *) optr;
+  long code = 0;
+  curl_off_t final_size = -1;
+
+  if (len > 2 || ('\r' != *ptr && '\n' != *ptr))
+    return len;
+  curl_easy_getinfo (ctx->easy_handle, CURLINFO_RESPONSE_CODE, &code);
+  if (code < 200)
+    return len; /* Informational response, the real one comes next */
+
+  ctx->stat.code = (int) code;
+  curl_easy_getinfo (ctx->easy_handle,
+                     CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &final_size);
+  if (filter_discards (&ctx->stat, opt.filters, final_size))
+    {
+      FLG_SET (ctx->flag, CTX_ABORTED);
+      return 0;
+    }
+  return len;
+}
+
 //-- Strline and StrlineNull functions --//
 static inline char *
 Strline (const char *cstr)
@@ -852,13 +1406,18 @@ fw_init (Fword *fw, char *cstr, size_t cstr_len)
   fw->str = cstr;
   fw->len = (uint) (StrlineNull (cstr) - cstr);
   fw->__str_bytes = cstr_len;
+  fw->__lines = da_new (size_t);
+  fw->__shared = false;
 
   /* Calculating count of words within the wordlist */
   for (char *p = cstr;; fw->total_count++, p++)
     {
-      p = Strline (p);
-      if (!p)
+      char *end = Strline (p);
+      if (!end)
         break;
+      if (0 == fw->total_count % FW_INDEX_STRIDE)
+        da_appd (fw->__lines, (size_t) (p - cstr));
+      p = end;
     }
 }
 
@@ -884,17 +1443,146 @@ fw_map (Fword *dst, int fd)
   return 0;
 }
 
+/**
+ *  (Re)starts the generator of @fw from the word @index
+ *  (permugen --skip) and reads it
+ */
+static int
+fw_gen_start (Fword *fw, uint index)
+{
+  char *cmd = NULL;
+  if (fw->__gen)
+    pclose (fw->__gen);
+  fw->index = index;
+  fw->len = 0;
+  if (-1 == asprintf (&cmd, "%s --skip %u %s",
+                      PERMUGEN_CMD, index, fw->__gen_args))
+    return 1;
+  fw->__gen = popen (cmd, "r");
+  safe_free (cmd);
+  if (! fw->__gen)
+    return 1;
+
+  ssize_t n = getline (&fw->str, &fw->__str_bytes, fw->__gen);
+  if (n <= 0)
+    {
+      if (0 == index)
+        return 1;
+      /* the estimation was wrong */
+      fw->total_count = index;
+      return fw_gen_start (fw, 0);
+    }
+  fw->len = (uint) (StrlineNull (fw->str) - fw->str);
+  return 0;
+}
+
+#define fw_gen_rewind(fw) fw_gen_start (fw, 0)
+
 Fword *
 fw_dup (const Fword *src)
 {
   Fword *tmp = ffuc_malloc (sizeof (Fword));
   fw_cpy (tmp, src);
+  /* Generators cannot be shared, run a new one */
+  if (src->__gen_args)
+    {
+      tmp->__gen_args = strdup (src->__gen_args);
+      tmp->__gen = NULL;
+      tmp->str = NULL;
+      tmp->__str_bytes = 0;
+      if (0 != fw_gen_rewind (tmp))
+        {
+          fw_gen_close (tmp);
+          safe_free (tmp);
+          return NULL;
+        }
+    }
+  else
+    tmp->__shared = true;
   return tmp;
 }
 
+int
+fw_gen (Fword *dst, const char *args)
+{
+  FILE *est;
+  size_t count = 0;
+  char *cmd = NULL, *line = NULL;
+  size_t line_len = 0;
+
+  *dst = (Fword){0};
+  if (-1 == asprintf (&cmd, "%s --estimate %s", PERMUGEN_CMD, args))
+    return 1;
+  /* The count of words, from the first line: `lines:  N` */
+  if ((est = popen (cmd, "r")))
+    {
+      if (-1 != getline (&line, &line_len, est))
+        {
+          if (0 == sscanf (line, "lines: %zu", &count) &&
+              1 == sscanf (line, "lines: at least %zu", &count))
+            count = SIZE_MAX;
+        }
+      pclose (est);
+    }
+  safe_free (line);
+  safe_free (cmd);
+  if (0 == count)
+    return 1;
+  if (count > UINT_MAX)
+    {
+      warnln ("generated word-list is too large, using %u words.",
+              UINT_MAX);
+      count = UINT_MAX;
+    }
+
+  dst->__gen_args = strdup (args);
+  dst->total_count = (uint) count;
+  if (0 != fw_gen_rewind (dst))
+    {
+      fw_gen_close (dst);
+      return 1;
+    }
+  return 0;
+}
+
+void
+fw_gen_close (Fword *fw)
+{
+  if (fw->__gen)
+    pclose (fw->__gen);
+  safe_free (fw->__gen_args);
+  safe_free (fw->str);
+  fw->__gen = NULL;
+}
+
+/* fw_next of generated word-lists */
+static char *
+fw_gen_next (Fword *fw)
+{
+  if (fw->index + 1 >= fw->total_count || !fw->__gen)
+    {
+      fw_gen_rewind (fw);
+      return fw->str;
+    }
+
+  ssize_t n = getline (&fw->str, &fw->__str_bytes, fw->__gen);
+  if (n <= 0) /* the estimation was wrong */
+    {
+      fw->total_count = fw->index + 1;
+      fw_gen_rewind (fw);
+      return fw->str;
+    }
+  fw->len = (uint) (StrlineNull (fw->str) - fw->str);
+  fw->index++;
+  return fw->str;
+}
+
 char *
 fw_next (Fword *fw)
 {
+  if (fw->__gen_args)
+    return fw_gen_next (fw);
+
   char *p = fw_get (fw) + fw->len + 1;
   char *next = Strline (p);
   if (NULL == next || '\0' == *next)
@@ -914,6 +1602,45 @@ fw_next (Fword *fw)
   return p;
 }
 
+static void
+fw_rewind (Fword *fw)
+{
+  if (fw->__gen_args)
+    {
+      fw_gen_rewind (fw);
+      return;
+    }
+  fw->index = 0;
+  fw->__offset = 0;
+  fw->len = (uint) (StrlineNull (fw->str) - fw->str);
+}
+
+static void
+fw_seek (Fword *fw, uint index)
+{
+  if (0 == fw->total_count)
+    return;
+  index %= fw->total_count;
+  if (fw->__gen_args &&
+      (index < fw->index || index - fw->index > FW_GEN_SEEK_MAX))
+    {
+      fw_gen_start (fw, index);
+      return;
+    }
+  if (fw->__lines && (index < fw->index ||
+                     index - fw->index >= FW_INDEX_STRIDE))
+    {
+      /* The nearest indexed word, before @index */
+      fw->index = index - index % FW_INDEX_STRIDE;
+      fw->__offset = fw->__lines[index / FW_INDEX_STRIDE];
+      fw->len = (uint) (StrlineNull (fw_get (fw)) - fw_get (fw));
+    }
+  else if (index < fw->index)
+    fw_rewind (fw);
+  while (fw->index != index && index < fw->total_count)
+    fw_next (fw);
+}
+
 //-- Logger functions --//
 void
 log_filter (const struct res_filter_t *fl)
@@ -943,6 +1670,8 @@ log_current_config (void)
     if (opt.max_rate != MAX_REQ_RATE)
       fprintf (stderr, "- Request rate: %d req/sec\n", opt.max_rate);
     fprintf (stderr, "- Concurrency: %ld req\n", opt.Rqueue.len);
+    if (opt.workers_len > 1)
+      fprintf (stderr, "- Workers: %d threads\n", opt.workers_len);
     if (opt.Rqueue.delay_us[0])
       {
         fprintf (stderr, "- Delay: ");
@@ -1139,35 +1868,126 @@ __next_fuzz_clusterbomb (RequestContext *ctx)
     opt.eofuzz = true;
 }
 
-//-- RequestContext functions --//
-RequestContext *
-lookup_handle (CURL *needle,
-               RequestContext *haystack, size_t len)
+/* Takes the next chunk of fuzz indexes, for worker @w */
+static inline void
+fuzz_take_chunk (Worker *w)
 {
-  for (size_t i=0; i < len; ++i)
+  size_t total = opt.progress.req_total;
+  struct ckpt_range_t *rec = NULL;
+
+  if (opt.node.addr)
     {
-      if (haystack[i].easy_handle == needle)
-        return &haystack[i];
+      node_take_chunk (w);
+      return;
     }
-  return NULL;
+  if (ckpt_active ())
+    {
+      /* Requests left from the resumed run come first */
+      rec = &opt.ckpt.chunks[w->id];
+      uint32_t len = opt.ckpt.state->pending_len, p;
+      if (__atomic_load_n (&opt.ckpt.pending_next, __ATOMIC_RELAXED) < len
+          && (p = __atomic_fetch_add (&opt.ckpt.pending_next, 1,
+                                      __ATOMIC_RELAXED)) < len)
+        {
+          struct ckpt_range_t *r = &opt.ckpt.pending[p];
+          w->next = r->start, w->end = r->end;
+          *rec = *r;
+          r->start = r->end; /* It is in the chunk of @w now */
+          return;
+        }
+    }
+
+  w->next = __atomic_fetch_add (&opt.fuzz_next, FUZZ_CHUNK,
+                                __ATOMIC_RELAXED);
+  w->end = MIN (w->next + FUZZ_CHUNK, total);
+  if (w->next >= total)
+    w->eofuzz = true;
+  if (rec)
+    *rec = (struct ckpt_range_t){w->next, w->end};
 }
 
-RequestContext *
-lookup_free_handle (RequestContext *ctxs, size_t len)
+/**
+ *  Loads the FUZZ of the fuzz index of @ctx->worker, in the same
+ *  order as the other __next_fuzz_xxx functions; used by workers
+ */
+static void
+__next_fuzz_index (RequestContext *ctx)
 {
-  for (size_t i=0; i < len; ++i)
+  Worker *w = ctx->worker;
+  size_t k = w->next++;
+  size_t N = opt.words_len;
+  Fword *fw;
+
+  ctx->fuzz_index = k;
+  if (ckpt_active ())
     {
-      if (ctxs[i].flag == CTX_FREE)
-        return &ctxs[i];
+      /* In flight, before leaving the chunk */
+      opt.ckpt.slots[ctx - opt.Rqueue.ctxs] = k + 1;
+      opt.ckpt.chunks[w->id].start = w->next;
     }
-  return NULL;
-}
+
+  switch (opt.mode)
+    {
+    case MODE_SINGULAR:
+      fw = w->words[0];
+      fw_seek (fw, k);
+      snprintf (tmp, TMP_CAP, FW_FORMAT, FW_ARG (fw));
+      Estrrealloc (ctx->FUZZ[0], tmp);
+      for (size_t i=1; i < N; ++i)
+        ctx->FUZZ[i] = ctx->FUZZ[0];
+      ctx->FUZZ[N] = NULL;
+      break;
+
+    case MODE_PITCHFORK:
+    case MODE_CLUSTERBOMB:
+      for (size_t i=0; i < N; ++i)
+        {
+          fw = w->words[i];
+          uint n = MAX (fw->total_count, 1);
+          fw_seek (fw, k % n);
+          if (MODE_CLUSTERBOMB == opt.mode)
+            k /= n;
+          snprintf (tmp, TMP_CAP, FW_FORMAT, FW_ARG (fw));
+          Estrrealloc (ctx->FUZZ[i], tmp);
+        }
+      break;
+    }
+  fprintd ("worker #%d:  [%zu]\n", w->id, w->next - 1);
+
+  if (w->next >= w->end)
+    fuzz_take_chunk (w);
+}
+
+//-- RequestContext functions --//
+static inline RequestContext *
+lookup_handle (CURL *handle)
+{
+  RequestContext *ctx = NULL;
+  curl_easy_getinfo (handle, CURLINFO_PRIVATE, (char **) &ctx);
+  return ctx;
+}
+
+static inline RequestContext *
+lookup_free_handle (Worker *w)
+{
+  RequestContext *ctx = w->free_ctxs;
+  if (ctx)
+    w->free_ctxs = ctx->next_free;
+  return ctx;
+}
+
+static inline void
+release_handle (Worker *w, RequestContext *ctx)
+{
+  ctx->next_free = w->free_ctxs;
+  w->free_ctxs = ctx;
+}
 
 void
 context_reset (RequestContext *ctx)
 {
-  ctx->flag = CTX_FREE;
-  curl_multi_remove_handle (opt.multi_handle, ctx->easy_handle);
+  FLG_UNSET (ctx->flag, CTX_INUSE | CTX_ABORTED);
+  curl_multi_remove_handle (ctx->multi_handle, ctx->easy_handle);
   STAT_RESET (&ctx->stat);
 }
 
@@ -1219,89 +2039,167 @@ filter_pass (struct req_stat_t *stat, struct res_filter_t *filters)
 #undef RANGE
 }
 
+static inline bool
+filter_discards (const struct req_stat_t *stat,
+                 const struct res_filter_t *filters, curl_off_t final_size)
+{
+#define RANGE(x, rng) ((rng).start <= (x) && (x) <= (rng).end)
+  curl_off_t size = stat->size_bytes;
+  da_foreach (filters, i)
+    {
+      const struct res_filter_t *filter = &filters[i];
+      switch (filter->type)
+        {
+        case FILTER_CODE:
+          if (RANGE (stat->code, filter->range))
+            return true;
+          break;
+        case MATCH_CODE:
+          if (! RANGE (stat->code, filter->range))
+            return true;
+          break;
+
+        case FILTER_SIZE:
+          if (final_size >= 0 && RANGE (final_size, filter->range))
+            return true;
+          break;
+        case MATCH_SIZE:
+          if (final_size >= 0 && ! RANGE (final_size, filter->range))
+            return true;
+          if (size > filter->range.end)
+            return true;
+          break;
+
+          /* Counters only grow, so they can only exceed matchers */
+        case MATCH_WCOUNT:
+          if ((int) stat->wcount > filter->range.end)
+            return true;
+          break;
+        case MATCH_LCOUNT:
+          if ((int) stat->lcount > filter->range.end)
+            return true;
+          break;
+
+        default:
+          break;
+        }
+    }
+  return false;
+#undef RANGE
+}
+
 static void
 handle_response_context (RequestContext *ctx)
 {
   long result = 0;
-  double duration;
+  curl_off_t t[5] = {0};
   struct req_stat_t *stat = &ctx->stat;
   struct progress_t *prog = &opt.progress;
+  bool aborted = HAS_FLAG (ctx->flag, CTX_ABORTED);
 
-  if (CURLE_OK == ctx->stat.ccode)
+  if (CURLE_OK == ctx->stat.ccode || aborted)
     {
       curl_easy_getinfo (ctx->easy_handle, CURLINFO_HTTP_CODE, &result);
       stat->code = (int) result;
     }
   else
-    prog->err_count++;
-
-  curl_easy_getinfo (ctx->easy_handle, CURLINFO_TOTAL_TIME, &duration);
-  stat->duration = (uint) (duration * 1000.f);
+    __atomic_add_fetch (&prog->err_count, 1, __ATOMIC_RELAXED);
+
+  curl_easy_getinfo (ctx->easy_handle, CURLINFO_NAMELOOKUP_TIME_T, &t[0]);
+  curl_easy_getinfo (ctx->easy_handle, CURLINFO_CONNECT_TIME_T, &t[1]);
+  curl_easy_getinfo (ctx->easy_handle, CURLINFO_APPCONNECT_TIME_T, &t[2]);
+  curl_easy_getinfo (ctx->easy_handle, CURLINFO_STARTTRANSFER_TIME_T, &t[3]);
+  curl_easy_getinfo (ctx->easy_handle, CURLINFO_TOTAL_TIME_T, &t[4]);
+  stat->duration = (uint) (t[4] / 1000);
+
+  /* Timings of curl are from the start, some phases may be skipped */
+  if (t[0] > 0)
+    lat_record (&prog->lat[LAT_DNS], t[0]);
+  if (t[1] > t[0])
+    lat_record (&prog->lat[LAT_CONNECT], t[1] - t[0]);
+  if (t[2] > t[1])
+    lat_record (&prog->lat[LAT_TLS], t[2] - t[1]);
+  if (t[3] > 0)
+    lat_record (&prog->lat[LAT_TTFB], t[3]);
+  lat_record (&prog->lat[LAT_TOTAL], t[4]);
+  if (stat->code > 0 && stat->code < HTTP_STATUS_MAX)
+    __atomic_add_fetch (&prog->status[stat->code], 1, __ATOMIC_RELAXED);
 
   /* Print stats and progress-bar if necessary */
-  if (CURLE_OK != ctx->stat.ccode || filter_pass (stat, opt.filters))
+  pthread_mutex_lock (&opt.print_lock);
+  if (aborted)
+    {
+      /* Discarded by early abort, not an error */
+      if (PROG_LOAD (prog->req_sent) % prog->progbar_refrate == 0)
+        update_progress_bar (prog);
+    }
+  else if (CURLE_OK != ctx->stat.ccode || filter_pass (stat, opt.filters))
     {
       print_stats_context (ctx);
+      if (opt.node.addr)
+        fflush (opt.streamout); /* One R message of whole results */
       update_progress_bar (prog);
     }
-  else if (prog->req_sent % prog->progbar_refrate == 0)
+  else if (PROG_LOAD (prog->req_sent) % prog->progbar_refrate == 0)
     update_progress_bar (prog);
+  pthread_mutex_unlock (&opt.print_lock);
 }
 
 static inline void
 __register_context (RequestContext *dst)
 {
   char **FUZZ = dst->FUZZ;
-  FuzzTemplate template = opt.fuzz_template;
   struct request_t *req = &dst->request;
+  size_t lens[opt.words_len], n = 0;
 
-  /**
-   *  Generating URL
-   *  based on opt.fuzz_template.URL
-   */
-  if (opt.fuzz_flag & URL_HASFUZZ)
+  for (int i=0; i < opt.words_len; ++i)
+    lens[i] = Strlen (FUZZ[i]);
+  for (int i=0; i < opt.tmpls_len; ++i)
     {
-      FUZZ += fuzz_snprintf (tmp, TMP_CAP, template.URL, FUZZ);
-      Strrealloc (req->URL, tmp);
+      CompiledTemplate *t = &opt.tmpls[i];
+      n += t->lit_bytes + 1;
+      da_foreach (t->segs, j)
+        {
+          if (! t->segs[j].str)
+            n += lens[t->segs[j].slot];
+        }
+    }
+  if (n > req->arena_cap)
+    {
+      req->arena_cap = MAX (n, 2 * req->arena_cap);
+      req->arena = realloc (req->arena, req->arena_cap);
     }
-  else if (! dst->request.URL)
-    Strrealloc (req->URL, template.URL);
-  curl_setopt (dst->easy_handle, CURLOPT_URL, req->URL);
 
   /**
-   *  Generating POST body
-   *  based on opt.fuzz_template.body
+   *  Assembling the request into @req->arena
+   *  URL, POST body, and HTTP headers respectively
    */
-  if (template.body)
+  char *p = req->arena;
+  CompiledTemplate *t = opt.tmpls;
+
+  req->URL = p;
+  p = tmpl_assemble (p, t++, FUZZ, lens);
+  *(p++) = '\0';
+  curl_setopt (dst->easy_handle, CURLOPT_URL, req->URL);
+
+  if (opt.fuzz_template.body)
     {
-      if (opt.fuzz_flag & BODY_HASFUZZ)
-        {
-          FUZZ += fuzz_snprintf (tmp, TMP_CAP, template.body, FUZZ);
-          Strrealloc (req->body, tmp);
-        }
-      else if (! req->body)
-        Strrealloc (req->body, template.body);
+      req->body = p;
+      p = tmpl_assemble (p, t++, FUZZ, lens);
+      *(p++) = '\0';
       curl_setopt (dst->easy_handle, CURLOPT_POSTFIELDS, req->body);
     }
 
-  /**
-   *  Generating HTTP headers
-   *  based on opt.fuzz_template.headers
-   */
-  if (template.headers)
+  if (opt.headers_len)
     {
-      if (opt.fuzz_flag & HEADER_HASFUZZ)
+      /* Patching the header list in place */
+      for (int i=0; i < opt.headers_len; ++i)
         {
-          curl_slist_safe_free (req->headers);
-          curl_slist_foreach (template.headers, h)
-            {
-              FUZZ += fuzz_snprintf (tmp, TMP_CAP, h->data, FUZZ);
-              curl_slist_appd (req->headers, tmp);
-            }
-          curl_setopt (dst->easy_handle, CURLOPT_HTTPHEADER, req->headers);
+          req->headers[i].data = p;
+          p = tmpl_assemble (p, t++, FUZZ, lens);
+          *(p++) = '\0';
         }
-      else
-        curl_setopt (dst->easy_handle, CURLOPT_HTTPHEADER, template.headers);
+      curl_setopt (dst->easy_handle, CURLOPT_HTTPHEADER, req->headers);
     }
 }
 
@@ -1309,9 +2207,15 @@ int
 register_context (RequestContext *ctx, bool sync)
 {
   CURL *curl = ctx->easy_handle;
-  curl_easy_reset (ctx->easy_handle);
+  FLG_SET (ctx->flag, CTX_INUSE);
+  /**
+   *  In keep-alive mode, static options are only set once, and
+   *  they are kept along with the connection of the handle
+   */
+  if (!opt.keepalive || !HAS_FLAG (ctx->flag, CTX_READY))
   {
-    FLG_SET (ctx->flag, CTX_INUSE);
+    curl_easy_reset (ctx->easy_handle);
+    FLG_SET (ctx->flag, CTX_READY);
     /* HTTP verb */
     if (opt.verb)
       curl_setopt (curl, CURLOPT_CUSTOMREQUEST, opt.verb);
@@ -1320,20 +2224,38 @@ register_context (RequestContext *ctx, bool sync)
     curl_setopt (curl, CURLOPT_SSL_VERIFYHOST, 0L);
     /* Deliver @ctx to curl_fwrite (custom fwrite function) */
     curl_setopt (curl, CURLOPT_WRITEDATA, ctx);
+    curl_setopt (curl, CURLOPT_PRIVATE, ctx);
     curl_setopt (curl, CURLOPT_WRITEFUNCTION, curl_fwrite);
+    if (opt.early_abort)
+      {
+        curl_setopt (curl, CURLOPT_HEADERDATA, ctx);
+        curl_setopt (curl, CURLOPT_HEADERFUNCTION, curl_fheader);
+      }
     /* Timeout */
     curl_setopt (curl, CURLOPT_TIMEOUT_MS, (size_t) opt.ttl);
     curl_setopt (curl, CURLOPT_CONNECTTIMEOUT_MS, CONN_TTL_MS);
     /* Proxy */
     if (opt.proxy)
       curl_setopt (curl, CURLOPT_PROXY, opt.proxy);
+    /* Persistent connections */
+    if (opt.keepalive)
+      {
+        curl_setopt (curl, CURLOPT_SHARE, opt.share);
+        curl_setopt (curl, CURLOPT_TCP_KEEPALIVE, 1L);
+      }
+    if (opt.http2)
+      {
+        curl_setopt (curl, CURLOPT_HTTP_VERSION, (long) CURL_HTTP_VERSION_2TLS);
+        /* Prefer waiting for a multiplexed connection */
+        curl_setopt (curl, CURLOPT_PIPEWAIT, 1L);
+      }
   }
   __register_context (ctx);
 
   if (sync) /* blocking */
       return curl_easy_perform (curl);
   else /* none blocking */
-    curl_multi_add_handle (opt.multi_handle, curl);
+    curl_multi_add_handle (ctx->multi_handle, curl);
   return 0;
 }
 
@@ -1341,18 +2263,21 @@ register_context (RequestContext *ctx, bool sync)
 static inline size_t
 update_req_rate (Progress *prog)
 {
+  /* dt_us and __req_dt are only written by this thread */
   if (prog->dt_us < MIN_DT_US)
     return prog->rate;
-  size_t rate = REQ_RATE (prog);
-  return prog->rate = rate;
+  size_t rate = REQ_RATE (prog->__req_dt, prog->dt_us);
+  PROG_STORE (prog->rate, rate);
+  return rate;
 }
 
 static inline size_t
 rt_req_rate (Progress *prog)
 {
-  if (prog->dt_us < MIN_DT_US)
-    return prog->rate;
-  return RT_REQ_RATE (prog);
+  size_t dt = PROG_LOAD (prog->dt_us);
+  if (dt < MIN_DT_US)
+    return PROG_LOAD (prog->rate);
+  return REQ_RATE (PROG_LOAD (prog->req_dt), dt);
 }
 
 static void
@@ -1361,16 +2286,24 @@ __update_progress_bar (const Progress *prog)
   fprintf (stderr, CLEAN_LINE ("\
 ::.   Progress: %d%% [%d/%d]  ::  %-3d req/sec  ::   Errors: %d   .::"),
            REQ_PERC (prog),
-           prog->req_sent, prog->req_total,
-           prog->rate,
-           prog->err_count
+           PROG_LOAD (prog->req_sent), prog->req_total,
+           PROG_LOAD (prog->rate),
+           PROG_LOAD (prog->err_count)
   );
+  if (opt.aimd.enabled)
+    fprintf (stderr, "  [window: %u, rate: %u, p50: %ums, p99: %ums]",
+             PROG_LOAD (opt.aimd.window), PROG_LOAD (opt.aimd.rate),
+             PROG_LOAD (opt.aimd.p50), PROG_LOAD (opt.aimd.p99));
 }
 
 static void
 init_progress (Progress *prog)
 {
   prog->req_sent = 0;
+  prog->start_us = now_us ();
+  /* Discovery requests (the auto filter mode) are not counted */
+  memset (prog->lat, 0, sizeof (prog->lat));
+  memset (prog->status, 0, sizeof (prog->status));
   /* This makes progress-bar refresh at every 1% of progress */
   prog->progbar_refrate = MAX(1, prog->req_total / 100);
   update_progress_bar (prog);
@@ -1388,15 +2321,183 @@ tick_progress (Progress *prog)
 
   if (dt > MIN_DT_US)
     {
-      prog->__req_dt = prog->req_dt; /* stable req_dt */
-      prog->req_dt = 0;
-      prog->dt_us = dt; /* update delta time */
+      /* stable req_dt */
+      prog->__req_dt = __atomic_exchange_n (&prog->req_dt, 0,
+                                            __ATOMIC_RELAXED);
+      PROG_STORE (prog->dt_us, dt); /* update delta time */
       t0 = t;
     }
   else
     usleep (MIN_DT_US);
 }
 
+static inline uint
+lat_bucket (uint us)
+{
+  if (us < LAT_SUB)
+    return us;
+  uint e = 31 - __builtin_clz (us); /* e >= LAT_SUB_BITS */
+  if (e >= LAT_MAX_BITS)
+    return LAT_HIST_LEN - 1;
+  uint sub = (us >> (e - LAT_SUB_BITS)) & (LAT_SUB - 1);
+  return (e - LAT_SUB_BITS + 1) * LAT_SUB + sub;
+}
+
+/* The upper bound of values of bucket @idx */
+static inline uint
+lat_bucket_max (uint idx)
+{
+  if (idx < LAT_SUB)
+    return idx;
+  uint e = idx / LAT_SUB + LAT_SUB_BITS - 1;
+  uint sub = idx % LAT_SUB;
+  return ((LAT_SUB + sub + 1) << (e - LAT_SUB_BITS)) - 1;
+}
+
+static inline void
+lat_record (struct lat_hist_t *h, uint us)
+{
+  __atomic_add_fetch (&h->buckets[lat_bucket (us)], 1, __ATOMIC_RELAXED);
+}
+
+static uint
+lat_quantile (const struct lat_hist_t *h, const struct lat_hist_t *prev,
+              size_t n, double q)
+{
+  size_t rank = (size_t) (q * n + 0.5), seen = 0;
+  for (uint i=0; i < LAT_HIST_LEN; ++i)
+    {
+      seen += h->buckets[i] - (prev ? prev->buckets[i] : 0);
+      if (seen >= MAX (rank, 1))
+        return lat_bucket_max (i);
+    }
+  return 0;
+}
+
+static void
+dump_stats (FILE *stream, const Progress *prog)
+{
+  size_t dt = now_us () - prog->start_us;
+
+  uint sent = PROG_LOAD (prog->req_sent);
+
+  fprintf (stream, "{\"time_ms\": %zu, \"sent\": %u, \"total\": %u, "
+           "\"errors\": %u, \"rate\": %u, \"avg_rate\": %zu, "
+           "\"in_flight\": %zu, \"status\": {",
+           dt / 1000, sent, prog->req_total, PROG_LOAD (prog->err_count),
+           PROG_LOAD (prog->rate), dt ? sent * 1000000UL / dt : 0,
+           PROG_LOAD (opt.Rqueue.waiting));
+  const char *sep = "";
+  for (int i=0; i < HTTP_STATUS_MAX; ++i)
+    {
+      uint count = PROG_LOAD (prog->status[i]);
+      if (count)
+        {
+          fprintf (stream, "%s\"%d\": %u", sep, i, count);
+          sep = ", ";
+        }
+    }
+
+  fprintf (stream, "}, \"latency_us\": {");
+  for (int p=0; p < LAT_PHASES; ++p)
+    {
+      /* A snapshot, workers keep recording */
+      static struct lat_hist_t snap;
+      const struct lat_hist_t *h = &snap;
+      size_t n = 0;
+      uint max = 0;
+      for (uint i=0; i < LAT_HIST_LEN; ++i)
+        {
+          snap.buckets[i] = PROG_LOAD (prog->lat[p].buckets[i]);
+          n += snap.buckets[i];
+          if (snap.buckets[i])
+            max = lat_bucket_max (i);
+        }
+      fprintf (stream, "%s\"%s\": {\"n\": %zu", p ? ", " : "",
+               lat_phase_name[p], n);
+      if (n)
+        fprintf (stream, ", \"p50\": %u, \"p90\": %u, \"p99\": %u, "
+                 "\"p999\": %u, \"max\": %u",
+                 lat_quantile (h, NULL, n, 0.50),
+                 lat_quantile (h, NULL, n, 0.90),
+                 lat_quantile (h, NULL, n, 0.99),
+                 lat_quantile (h, NULL, n, 0.999), max);
+      fprintf (stream, "}");
+    }
+  fprintf (stream, "}}\n");
+  fflush (stream);
+}
+
+//-- Adaptive controller functions --//
+static inline uint
+rate_limit (void)
+{
+  if (opt.aimd.enabled)
+    return __atomic_load_n (&opt.aimd.rate, __ATOMIC_RELAXED);
+  return opt.max_rate;
+}
+
+static inline size_t
+window_limit (void)
+{
+  if (opt.aimd.enabled)
+    return __atomic_load_n (&opt.aimd.window, __ATOMIC_RELAXED);
+  return opt.Rqueue.len;
+}
+
+static void
+aimd_update (struct aimd_t *c, Progress *prog)
+{
+  struct lat_hist_t now;
+  size_t n = 0;
+
+  size_t t = now_us ();
+  if (t - c->t0_us < AIMD_PERIOD_MS * 1000)
+    return;
+  c->t0_us = t;
+
+  for (uint i=0; i < LAT_HIST_LEN; ++i)
+    {
+      now.buckets[i] = __atomic_load_n (&prog->lat[LAT_TOTAL].buckets[i],
+                                        __ATOMIC_RELAXED);
+      n += now.buckets[i] - c->__prev.buckets[i];
+    }
+  uint errs = __atomic_load_n (&prog->err_count, __ATOMIC_RELAXED);
+  uint err_dt = errs - c->__err_count;
+  c->__err_count = errs;
+  if (n == 0)
+    return; /* Nothing completed in this period */
+
+  /* p50 and p99 are also read by the progress bar (workers) */
+  uint p50 = lat_quantile (&now, &c->__prev, n, 0.50) / 1000;
+  uint p99 = lat_quantile (&now, &c->__prev, n, 0.99) / 1000;
+  __atomic_store_n (&c->p50, p50, __ATOMIC_RELAXED);
+  __atomic_store_n (&c->p99, p99, __ATOMIC_RELAXED);
+  c->__prev = now;
+  if (c->best_p50 == 0 || p50 < c->best_p50)
+    c->best_p50 = MAX (p50, 1);
+
+  uint target = c->target_ms;
+  if (0 == target)
+    target = MAX (AIMD_AUTO_FACTOR * c->best_p50, AIMD_MIN_TARGET_MS);
+
+  uint window = c->window, rate = c->rate;
+  if (p99 > target || err_dt * 100 > n * AIMD_ERR_PERC)
+    {
+      /* Multiplicative decrease */
+      window = MAX (window / 2, 1);
+      rate = MAX (MIN (rate, prog->rate) / 2, 1);
+    }
+  else
+    {
+      /* Additive increase (rate recovers geometrically) */
+      window = MIN (window + AIMD_INC_WINDOW, opt.Rqueue.len);
+      rate = MIN (rate + rate / 4 + 1, opt.max_rate);
+    }
+  __atomic_store_n (&c->window, window, __ATOMIC_RELAXED);
+  __atomic_store_n (&c->rate, rate, __ATOMIC_RELAXED);
+}
+
 //-- Utility functions --//
 void
 goto_raw_mode (struct termios *original)
@@ -1423,39 +2524,80 @@ strrealloc (void *malloced, const char *src)
   return memcpy (res, src, n+1);
 }
 
-int
-fuzz_snprintf (char *restrict dst, size_t dst_cap,
-              const char *restrict format, char **FUZZ)
+void
+compile_template (CompiledTemplate *dst, const char *format, int *slot)
 {
-  int fuzz_used = 0;
-  const char *start = format;
+  const char *start = format, *end;
+  struct tmpl_seg_t seg;
+
+  dst->segs = da_new (struct tmpl_seg_t);
+  dst->lit_bytes = 0;
+#define Appd_lit(s, n) do {                                   \
+    seg = (struct tmpl_seg_t){.str=s, .len=n, .slot=-1};      \
+    da_appd (dst->segs, seg);                                 \
+    dst->lit_bytes += n;                                      \
+  } while (0)
 
-  for (const char *end = start, *__dst = dst;
-       NULL != end && (size_t)(dst - __dst) < dst_cap; )
+  while ((end = strstr (start, "FUZZ")))
     {
-      if ((end = strstr (start, "FUZZ")))
-        {
-          if (end != start)
-            dst = mempcpy (dst, start, (size_t)(end - start));
-          start = end + 4;
+      if (end != start)
+        Appd_lit (start, (size_t)(end - start));
+      start = end + 4;
 
-          if (opt.mode == MODE_SINGULAR)
-            dst = stpcpy (dst, *FUZZ); // replacing all FUZZs with FUZZ[0]
-          else if (*FUZZ)
-            {
-              dst = stpcpy (dst, *FUZZ);
-              FUZZ++, fuzz_used++;
-            }
-          else
-            dst = stpcpy (dst, "FUZZ");
+      if (opt.mode == MODE_SINGULAR)
+        seg = (struct tmpl_seg_t){.slot=0}; // all FUZZs use FUZZ[0]
+      else if (*slot < opt.words_len)
+        seg = (struct tmpl_seg_t){.slot=(*slot)++};
+      else
+        {
+          Appd_lit (end, 4); /* No word-list, keep the keyword */
+          continue;
         }
+      da_appd (dst->segs, seg);
     }
-
   if ('\0' != *start)
-    strcpy (dst, start);
-  else
-    *dst = '\0';
-  return fuzz_used;
+    Appd_lit (start, strlen (start));
+#undef Appd_lit
+}
+
+static inline char *
+tmpl_assemble (char *restrict dst, const CompiledTemplate *t,
+               char **FUZZ, const size_t *lens)
+{
+  da_foreach (t->segs, i)
+    {
+      const struct tmpl_seg_t *seg = &t->segs[i];
+      if (seg->str)
+        dst = mempcpy (dst, seg->str, seg->len);
+      else
+        dst = mempcpy (dst, FUZZ[seg->slot], lens[seg->slot]);
+    }
+  return dst;
+}
+
+/* Compiles opt.fuzz_template, after finishing it */
+static void
+init_templates (void)
+{
+  FuzzTemplate *ft = &opt.fuzz_template;
+  int slot = 0;
+
+  opt.headers_len = 0;
+  curl_slist_foreach (ft->headers, h)
+    {
+      opt.headers_len++;
+    }
+  opt.tmpls_len = 1 + (NULL != ft->body) + opt.headers_len;
+  opt.tmpls = ffuc_calloc (opt.tmpls_len, sizeof (CompiledTemplate));
+
+  CompiledTemplate *t = opt.tmpls;
+  compile_template (t++, ft->URL, &slot);
+  if (ft->body)
+    compile_template (t++, ft->body, &slot);
+  curl_slist_foreach (ft->headers, h)
+    {
+      compile_template (t++, h->data, &slot);
+    }
 }
 
 int
@@ -1522,94 +2664,816 @@ range_usleep (useconds_t range[2])
     }
 }
 
-size_t
-fuzz_count (const char *s)
+size_t
+fuzz_count (const char *s)
+{
+  size_t n = 0;
+  if (!s)
+    return 0;
+  while ((s = strstr (s, "FUZZ")))
+    n++, s += 4;
+  return n;
+}
+
+static inline void
+opt_filter (int type, int start, int end)
+{
+  struct res_filter_t fl = {
+    .type  = type,
+    .range = {start, end},
+  };
+  da_appd (opt.filters, fl);
+}
+
+static inline void
+opt_append_filter (int type, const char *range)
+{
+  struct res_filter_t fl;
+  const char *p = range;
+
+  fl.type = type;
+  fl.range.start = atoi (p);
+  p = strchr (p, '-');
+  if (p)
+    fl.range.end = atoi (p + 1);
+  else
+    fl.range.end = fl.range.start;
+
+  da_appd (opt.filters, fl);
+}
+
+static Fword *
+make_fw_from_path (const char *path)
+{
+  int fd;
+  Fword tmp = {0};
+  if (! path)
+    return NULL;
+
+  if (0 == strncmp (path, FW_GEN_PREFIX, strlen (FW_GEN_PREFIX)))
+    {
+      if (0 == fw_gen (&tmp, path + strlen (FW_GEN_PREFIX)))
+        {
+          Fword *fw = ffuc_malloc (sizeof (Fword));
+          fw_cpy (fw, &tmp);
+          return fw;
+        }
+      warnln ("could not run the generator (%s).", path);
+      return NULL;
+    }
+
+  fd = open (path, O_RDONLY);
+  if (fd < 0)
+    {
+      warnln ("could not open file (%s) -- %s.", path, strerror (errno));
+      return NULL;
+    }
+
+  if (0 == fw_map (&tmp, fd))
+    {
+      Fword *fw = ffuc_malloc (sizeof (Fword));
+      fw_cpy (fw, &tmp);
+      return fw;
+    }
+  else
+    {
+      warnln ("could not mmap file (%s).", path);
+      close (fd);
+      return NULL;
+    }
+
+  return NULL;
+}
+
+/* In interactive mode, this runs in a separate thread */
+void *
+interact (void *__ptr)
+{
+  int c;
+  struct Opt *opt = (struct Opt *)__ptr;
+  while ((c = getchar ()))
+    {
+      switch (c)
+        {
+        case '\n':
+          if (opt->Rqueue.waiting)
+            update_progress_bar (&opt->progress);
+          break;
+
+          /* Adaptive controller setpoints */
+        case 'a':
+          opt->aimd.enabled = !opt->aimd.enabled;
+          update_progress_bar (&opt->progress);
+          break;
+        case '+':
+        case '-':
+          {
+            uint w = opt->aimd.window;
+            w = ('+' == c) ? MIN (w * 2, opt->Rqueue.len) : MAX (w / 2, 1);
+            __atomic_store_n (&opt->aimd.window, w, __ATOMIC_RELAXED);
+            update_progress_bar (&opt->progress);
+          }
+          break;
+        case '>':
+        case '<':
+          {
+            uint r = opt->aimd.rate;
+            r = ('>' == c) ? MIN (r * 2, opt->max_rate) : MAX (r / 2, 1);
+            __atomic_store_n (&opt->aimd.rate, r, __ATOMIC_RELAXED);
+            update_progress_bar (&opt->progress);
+          }
+          break;
+
+        case EOF:
+        case CEOT:
+          goto end_of_interactive;
+        }
+    }
+ end_of_interactive:
+  disable_raw_mode (&opt->orig_termios);
+  return NULL;
+}
+
+static void
+curl_share_lock (CURL *handle, curl_lock_data data,
+                 curl_lock_access access, void *userp)
+{
+  UNUSED (handle), UNUSED (access), UNUSED (userp);
+  pthread_mutex_lock (&opt.share_locks[data]);
+}
+
+static void
+curl_share_unlock (CURL *handle, curl_lock_data data, void *userp)
+{
+  UNUSED (handle), UNUSED (userp);
+  pthread_mutex_unlock (&opt.share_locks[data]);
+}
+
+/* Shares DNS and TLS sessions between all easy handles */
+static void
+init_share (void)
+{
+  for (int i=0; i < CURL_LOCK_DATA_LAST; ++i)
+    pthread_mutex_init (&opt.share_locks[i], NULL);
+  opt.share = curl_share_init ();
+  curl_share_setopt (opt.share, CURLSHOPT_LOCKFUNC, curl_share_lock);
+  curl_share_setopt (opt.share, CURLSHOPT_UNLOCKFUNC, curl_share_unlock);
+  curl_share_setopt (opt.share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+  curl_share_setopt (opt.share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+}
+
+/* Sets up persistent connections of multi handle @multi */
+static inline void
+init_multi_keepalive (CURLM *multi)
+{
+  if (opt.http2)
+    curl_multi_setopt (multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+  /* Connections of all contexts must stay in the cache */
+  curl_multi_setopt (multi, CURLMOPT_MAXCONNECTS, (long) opt.Rqueue.len);
+}
+
+/**
+ *  Splits request contexts between workers, and gives
+ *  each of them a multi handle and copies of word-lists
+ */
+static inline uint64_t
+fnv1a (uint64_t h, const void *data, size_t len)
+{
+  const unsigned char *p = data;
+  for (size_t i=0; i < len; ++i)
+    h = (h ^ p[i]) * 0x100000001b3ULL;
+  return h;
+}
+
+/**
+ *  Signature of the fuzz configuration; the mode, templates
+ *  and the size of word-lists, so a checkpoint won't be
+ *  resumed for another campaign, and nodes of a coordinator
+ *  run the same one
+ */
+static uint64_t
+fuzz_sign (void)
+{
+  FuzzTemplate *ft = &opt.fuzz_template;
+  uint64_t h = 0xcbf29ce484222325ULL;
+
+  h = fnv1a (h, &opt.mode, sizeof (opt.mode));
+  h = fnv1a (h, ft->URL, Strlen (ft->URL) + 1);
+  if (ft->body)
+    h = fnv1a (h, ft->body, Strlen (ft->body) + 1);
+  curl_slist_foreach (ft->headers, hd)
+    {
+      h = fnv1a (h, hd->data, Strlen (hd->data) + 1);
+    }
+  for (int i=0; i < opt.words_len; ++i)
+    h = fnv1a (h, &opt.words[i]->total_count, sizeof (uint));
+  return h;
+}
+
+/* Sets the pointers of opt.ckpt, to the sections of @st */
+static inline void
+ckpt_layout (struct ckpt_t *st)
+{
+  opt.ckpt.chunks = (struct ckpt_range_t *) (st + 1);
+  opt.ckpt.slots = (uint64_t *) (opt.ckpt.chunks + st->workers_len);
+  opt.ckpt.pending = (struct ckpt_range_t *) (opt.ckpt.slots
+                                              + st->slots_len);
+}
+
+static int
+ckpt_range_cmp (const void *a, const void *b)
+{
+  const struct ckpt_range_t *x = a, *y = b;
+  return (x->start > y->start) - (x->start < y->start);
+}
+
+/**
+ *  Collects the unfinished ranges of the checkpoint
+ *  file @path into @pending (dynamic array), sorted
+ *  and merged, so word-lists are seeked forward
+ * Return:
+ *  The header of the checkpoint, magic is zero on failure
+ */
+static struct ckpt_t
+ckpt_load (const char *path, struct ckpt_range_t **pending)
+{
+  struct ckpt_t hdr = {0}, *st;
+  struct stat sb;
+  int fd = open (path, O_RDONLY);
+
+  if (fd < 0 || fstat (fd, &sb) < 0 ||
+      (size_t) sb.st_size < sizeof (struct ckpt_t))
+    goto end;
+  st = ffuc_mmap (NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (MAP_FAILED == st)
+    goto end;
+  if (memcmp (st->magic, CKPT_MAGIC, 8) || (size_t) sb.st_size <
+      ckpt_size (st->workers_len, st->slots_len, st->pending_len))
+    goto unmap;
+
+  hdr = *st;
+  ckpt_layout (st);
+  for (uint32_t i=0; i < st->workers_len; ++i)
+    {
+      struct ckpt_range_t r = opt.ckpt.chunks[i];
+      if (r.start < r.end)
+        da_appd (*pending, r);
+      hdr.fuzz_next = MAX (hdr.fuzz_next, r.end);
+    }
+  for (uint32_t i=0; i < st->slots_len; ++i)
+    {
+      uint64_t n = opt.ckpt.slots[i];
+      if (n)
+        da_appd (*pending, ((struct ckpt_range_t){n - 1, n}));
+    }
+  for (uint32_t i=0; i < st->pending_len; ++i)
+    {
+      struct ckpt_range_t r = opt.ckpt.pending[i];
+      if (r.start < r.end)
+        da_appd (*pending, r);
+    }
+
+  da_sort (*pending, ckpt_range_cmp);
+  da_idx n = 0;
+  da_foreach (*pending, i)
+    {
+      struct ckpt_range_t r = (*pending)[i];
+      if (n > 0 && r.start <= (*pending)[n - 1].end)
+        (*pending)[n - 1].end = MAX ((*pending)[n - 1].end, r.end);
+      else
+        (*pending)[n++] = r;
+    }
+  da_popn (*pending, da_sizeof (*pending) - n);
+
+ unmap:
+  munmap (st, sb.st_size);
+ end:
+  if (fd >= 0)
+    close (fd);
+  return hdr;
+}
+
+/**
+ *  Creates and maps the checkpoint file opt.ckpt.path
+ *  In resume mode, restores the state of it first, the new
+ *  file replaces the old one atomically (rename)
+ */
+static int
+init_ckpt (void)
+{
+  struct ckpt_t hdr = {0}, *st;
+  struct ckpt_range_t *pending = NULL;
+  uint64_t sign = fuzz_sign ();
+
+  if (opt.ckpt.resume)
+    {
+      hdr = ckpt_load (opt.ckpt.path, &pending);
+      if (memcmp (hdr.magic, CKPT_MAGIC, 8) || hdr.sign != sign)
+        {
+          warnln ("checkpoint '%s' does not match this campaign.",
+                  opt.ckpt.path);
+          da_free (pending);
+          return EXIT_FAILURE;
+        }
+      hdr.fuzz_next = MIN (hdr.fuzz_next, opt.progress.req_total);
+      warnln ("resuming from %zu/%u (%zu ranges to redo).",
+              (size_t) hdr.fuzz_next, opt.progress.req_total,
+              (size_t) da_sizeof (pending));
+    }
+  memcpy (hdr.magic, CKPT_MAGIC, 8);
+  hdr.sign = sign;
+  hdr.req_total = opt.progress.req_total;
+  hdr.workers_len = opt.workers_len;
+  hdr.slots_len = opt.Rqueue.len;
+  hdr.pending_len = da_sizeof (pending);
+  opt.ckpt.map_len = ckpt_size (hdr.workers_len, hdr.slots_len,
+                                hdr.pending_len);
+
+  snprintf (tmp, TMP_CAP, "%s.tmp", opt.ckpt.path);
+  int fd = open (tmp, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0 || ftruncate (fd, opt.ckpt.map_len) < 0)
+    goto error;
+  st = ffuc_mmap (NULL, opt.ckpt.map_len,
+                  PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (MAP_FAILED == st)
+    goto error;
+  close (fd);
+
+  *st = hdr;
+  ckpt_layout (st);
+  if (hdr.pending_len)
+    memcpy (opt.ckpt.pending, pending,
+            hdr.pending_len * sizeof (struct ckpt_range_t));
+  da_free (pending);
+  if (rename (tmp, opt.ckpt.path) < 0)
+    {
+      munmap (st, opt.ckpt.map_len);
+      goto error;
+    }
+
+  opt.ckpt.state = st;
+  opt.fuzz_next = hdr.fuzz_next;
+  return EXIT_SUCCESS;
+
+ error:
+  warnln ("checkpoint '%s' failed -- %s", opt.ckpt.path, strerror (errno));
+  if (fd >= 0)
+    close (fd);
+  da_free (pending);
+  return EXIT_FAILURE;
+}
+
+/**
+ *  Updates the header of the checkpoint, every
+ *  CKPT_PERIOD_MS or immediately when @force is true
+ */
+static void
+ckpt_update (bool force)
+{
+  struct ckpt_t *st = opt.ckpt.state;
+
+  size_t t = now_us ();
+  if (!force && t - opt.ckpt.t0_us < CKPT_PERIOD_MS * 1000)
+    return;
+  opt.ckpt.t0_us = t;
+
+  size_t next = __atomic_load_n (&opt.fuzz_next, __ATOMIC_RELAXED);
+  st->fuzz_next = MIN (next, (size_t) opt.progress.req_total);
+  st->req_sent = PROG_LOAD (opt.progress.req_sent);
+  st->err_count = PROG_LOAD (opt.progress.err_count);
+}
+
+//-- Distributed mode functions --//
+/* Sends the whole @buf to @fd, returns -1 on failure */
+static int
+send_all (int fd, const char *buf, size_t len)
+{
+  while (len > 0)
+    {
+      ssize_t n = send (fd, buf, len, MSG_NOSIGNAL);
+      if (n < 0 && EINTR == errno)
+        continue;
+      if (n <= 0)
+        return -1;
+      buf += n, len -= n;
+    }
+  return 0;
+}
+
+/* Sends a message to the coordinator, opt.node.lock must be held */
+static int __attribute__((format (printf, 1, 2)))
+node_printf (const char *fmt, ...)
+{
+  char buf[128];
+  va_list ap;
+
+  va_start (ap, fmt);
+  int n = vsnprintf (buf, sizeof (buf), fmt, ap);
+  va_end (ap);
+  __atomic_store_n (&opt.node.sent_at, now_ms (), __ATOMIC_RELAXED);
+  return send_all (opt.node.fd, buf, n);
+}
+
+/* Cookie write function of opt.streamout, in the node mode */
+static ssize_t
+node_stream_write (void *cookie, const char *buf, size_t size)
+{
+  UNUSED (cookie);
+  pthread_mutex_lock (&opt.node.lock);
+  if (0 == node_printf ("R %zu\n", size))
+    send_all (opt.node.fd, buf, size);
+  pthread_mutex_unlock (&opt.node.lock);
+  return size;
+}
+
+/**
+ *  Connects to the coordinator opt.node.addr (HOST:PORT)
+ *  returns the socket, or -1 on failure
+ */
+static int
+dial (char *addr)
+{
+  struct addrinfo hints = {0}, *res, *ai;
+  int fd = -1;
+  char *port = strrchr (addr, ':');
+
+  if (! port)
+    return -1;
+  *(port++) = '\0';
+  hints.ai_socktype = SOCK_STREAM;
+  if (0 == getaddrinfo (addr, port, &hints, &res))
+    {
+      for (ai = res; ai && fd < 0; ai = ai->ai_next)
+        {
+          if ((fd = socket (ai->ai_family, ai->ai_socktype, 0)) < 0)
+            continue;
+          if (connect (fd, ai->ai_addr, ai->ai_addrlen) < 0)
+            close (fd), fd = -1;
+        }
+      freeaddrinfo (res);
+    }
+  *(--port) = ':';
+  return fd;
+}
+
+/**
+ *  Joins the coordinator, results will be sent to it
+ *  through opt.streamout
+ */
+static int
+init_node (void)
+{
+  char *line = NULL;
+  size_t cap = 0;
+
+  if ((opt.node.fd = dial (opt.node.addr)) < 0)
+    {
+      warnln ("could not connect to '%s' -- %s",
+              opt.node.addr, strerror (errno));
+      return EXIT_FAILURE;
+    }
+  opt.node.in = fdopen (dup (opt.node.fd), "r");
+  pthread_mutex_init (&opt.node.lock, NULL);
+
+  node_printf ("HELLO %" PRIx64 "\n", fuzz_sign ());
+  if (getline (&line, &cap, opt.node.in) < 0 || strncmp (line, "OK", 2))
+    {
+      warnln ("coordinator '%s' runs another campaign.", opt.node.addr);
+      free (line);
+      return EXIT_FAILURE;
+    }
+  free (line);
+
+  cookie_io_functions_t io = {.write = node_stream_write};
+  opt.streamout = fopencookie (NULL, "w", io);
+  setvbuf (opt.streamout, NULL, _IOFBF, NODE_BUF_CAP);
+  return EXIT_SUCCESS;
+}
+
+/* Asks for the next lease, opt.node.lock must be held */
+static void
+node_lease (void)
+{
+  static char *line = NULL;
+  static size_t cap = 0;
+  size_t start, end;
+
+  if (0 != node_printf ("NEXT\n") ||
+      getline (&line, &cap, opt.node.in) < 0)
+    {
+      warnln ("lost the coordinator.");
+      opt.node.done = true;
+    }
+  else if (2 == sscanf (line, "LEASE %zu %zu", &start, &end) && start < end)
+    {
+      struct lease_t l = {.start = start, .end = end};
+      da_appd (opt.node.leases, l);
+      opt.node.next = start, opt.node.end = end;
+    }
+  else if (0 == strncmp (line, "WAIT", 4))
+    opt.node.retry_at = now_ms () + NODE_RETRY_MS;
+  else
+    opt.node.done = true;
+}
+
+static void
+node_take_chunk (Worker *w)
+{
+  pthread_mutex_lock (&opt.node.lock);
+  if (opt.node.next >= opt.node.end && !opt.node.done &&
+      now_ms () >= opt.node.retry_at)
+    node_lease ();
+
+  w->next = opt.node.next;
+  w->end = MIN (w->next + FUZZ_CHUNK, opt.node.end);
+  opt.node.next = w->end;
+  if (w->next >= w->end && opt.node.done)
+    w->eofuzz = true;
+  pthread_mutex_unlock (&opt.node.lock);
+}
+
+static void
+node_complete (size_t idx, bool err)
+{
+  pthread_mutex_lock (&opt.node.lock);
+  da_foreach (opt.node.leases, i)
+    {
+      struct lease_t *l = &opt.node.leases[i];
+      if (idx < l->start || idx >= l->end)
+        continue;
+      l->errors += err;
+      if (++l->done == l->end - l->start)
+        {
+          node_printf ("FIN %zu %zu %u\n", l->start, l->end, l->errors);
+          da_unordered_delete (opt.node.leases, i);
+        }
+      break;
+    }
+  pthread_mutex_unlock (&opt.node.lock);
+}
+
+/* Connection of a node, in the coordinator */
+struct node_t
+{
+  int fd;
+  char *buf; /* Received bytes, not handled yet */
+  size_t len, cap;
+  long seen_at; /* The latest message (ms) */
+  bool joined; /* After a valid HELLO */
+};
+
+/* Opens the listening socket of opt.coord.addr ([HOST:]PORT) */
+static int
+listen_on (char *addr)
+{
+  struct addrinfo hints = {0}, *res, *ai;
+  int fd = -1, yes = 1;
+  char *port = strrchr (addr, ':'), *host = NULL;
+
+  if (port)
+    *port = '\0', host = addr, port++;
+  else
+    port = addr;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+  if (0 == getaddrinfo (host, port, &hints, &res))
+    {
+      for (ai = res; ai && fd < 0; ai = ai->ai_next)
+        {
+          if ((fd = socket (ai->ai_family, ai->ai_socktype, 0)) < 0)
+            continue;
+          setsockopt (fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof (yes));
+          if (bind (fd, ai->ai_addr, ai->ai_addrlen) < 0 ||
+              listen (fd, NODES_MAX) < 0)
+            close (fd), fd = -1;
+        }
+      freeaddrinfo (res);
+    }
+  if (host)
+    *(--port) = ':';
+  return fd;
+}
+
+/**
+ *  Handles the buffered messages of node @nd (#@id, the owner
+ *  of its leases); returns -1 when the node should be dropped
+ */
+static int
+coordinator_handle (struct node_t *nd, int id)
+{
+  char reply[64], *p = nd->buf, *end = nd->buf + nd->len, *nl;
+  size_t total = opt.progress.req_total, start, stop, n;
+  uint errors;
+  uint64_t sign;
+
+  while ((nl = memchr (p, '\n', end - p)))
+    {
+      *reply = '\0';
+      if (1 == sscanf (p, "R %zu", &n))
+        {
+          if ((size_t) (end - nl - 1) < n)
+            break; /* Wait for the whole payload */
+          pthread_mutex_lock (&opt.print_lock);
+          if (opt.Printf.lineclear)
+            fprintf (opt.streamout, CLEAN_LINE ());
+          fwrite (nl + 1, 1, n, opt.streamout);
+          update_progress_bar (&opt.progress);
+          pthread_mutex_unlock (&opt.print_lock);
+          nl += n;
+        }
+      else if (1 == sscanf (p, "HELLO %" SCNx64, &sign))
+        {
+          nd->joined = (sign == fuzz_sign ());
+          snprintf (reply, sizeof (reply), nd->joined ? "OK\n" : "BAD\n");
+        }
+      else if (! nd->joined)
+        return -1;
+      else if (0 == strncmp (p, "NEXT", 4))
+        {
+          struct lease_t l = {0};
+          da_idx pool_len = da_sizeof (opt.coord.pool);
+          if (pool_len)
+            {
+              /* Leases of dropped nodes come first */
+              l = opt.coord.pool[pool_len - 1];
+              da_pop1 (opt.coord.pool);
+            }
+          else if (opt.coord.next < total)
+            {
+              l.start = opt.coord.next;
+              l.end = opt.coord.next = MIN (l.start + LEASE_LEN, total);
+            }
+          l.owner = id;
+          if (l.start < l.end)
+            {
+              da_appd (opt.coord.leases, l);
+              snprintf (reply, sizeof (reply), "LEASE %zu %zu\n",
+                        l.start, l.end);
+            }
+          else
+            snprintf (reply, sizeof (reply),
+                      da_sizeof (opt.coord.leases) ? "WAIT\n" : "DONE\n");
+        }
+      else if (3 == sscanf (p, "FIN %zu %zu %u", &start, &stop, &errors))
+        {
+          da_foreach (opt.coord.leases, i)
+            {
+              struct lease_t *l = &opt.coord.leases[i];
+              if (l->owner != id || l->start != start || l->end != stop)
+                continue;
+              opt.progress.req_sent += stop - start;
+              opt.progress.req_dt += stop - start;
+              opt.progress.err_count += errors;
+              da_unordered_delete (opt.coord.leases, i);
+              break;
+            }
+        }
+      else if (strncmp (p, "PING", 4))
+        return -1;
+
+      if (*reply && send_all (nd->fd, reply, strlen (reply)) < 0)
+        return -1;
+      p = nl + 1;
+    }
+  /* Keep the incomplete message */
+  nd->len = end - p;
+  memmove (nd->buf, p, nd->len);
+  return 0;
+}
+
+/**
+ *  Drops node #@id of @nodes, its leases go back to the pool
+ *  and the last node takes its place
+ */
+static void
+coordinator_drop (struct node_t *nodes, int id, int *nodes_len)
 {
-  size_t n = 0;
-  if (!s)
-    return 0;
-  while ((s = strstr (s, "FUZZ")))
-    n++, s += 4;
-  return n;
-}
+  int last = *nodes_len - 1;
+  for (da_idx i = da_sizeof (opt.coord.leases) - 1; i >= 0; --i)
+    {
+      struct lease_t *l = &opt.coord.leases[i];
+      if (l->owner == id)
+        {
+          da_appd (opt.coord.pool, *l);
+          da_unordered_delete (opt.coord.leases, i);
+        }
+      else if (l->owner == last)
+        l->owner = id;
+    }
+  if (opt.verbose)
+    warnln ("node #%d left, %ld leases to reassign.",
+            id, (long) da_sizeof (opt.coord.pool));
 
-static inline void
-opt_filter (int type, int start, int end)
-{
-  struct res_filter_t fl = {
-    .type  = type,
-    .range = {start, end},
-  };
-  da_appd (opt.filters, fl);
+  close (nodes[id].fd);
+  safe_free (nodes[id].buf);
+  nodes[id] = nodes[last];
+  *nodes_len = last;
 }
 
-static inline void
-opt_append_filter (int type, const char *range)
+static int
+run_coordinator (void)
 {
-  struct res_filter_t fl;
-  const char *p = range;
+  struct node_t nodes[NODES_MAX];
+  struct pollfd pfds[NODES_MAX + 1];
+  int nodes_len = 0, lfd;
+  size_t total = opt.progress.req_total, avg_rate = 0;
 
-  fl.type = type;
-  fl.range.start = atoi (p);
-  p = strchr (p, '-');
-  if (p)
-    fl.range.end = atoi (p + 1);
-  else
-    fl.range.end = fl.range.start;
+  if ((lfd = listen_on (opt.coord.addr)) < 0)
+    {
+      warnln ("could not listen on '%s' -- %s",
+              opt.coord.addr, strerror (errno));
+      return EXIT_FAILURE;
+    }
+  opt.coord.leases = da_new (struct lease_t);
+  opt.coord.pool = da_new (struct lease_t);
+  init_progress (&opt.progress);
 
-  da_appd (opt.filters, fl);
-}
+  while (opt.coord.next < total ||
+         da_sizeof (opt.coord.leases) || da_sizeof (opt.coord.pool))
+    {
+      pfds[0] = (struct pollfd){.fd = lfd, .events = POLLIN};
+      for (int i=0; i < nodes_len; ++i)
+        pfds[i + 1] = (struct pollfd){.fd = nodes[i].fd, .events = POLLIN};
 
-static Fword *
-make_fw_from_path (const char *path)
-{
-  int fd;
-  Fword tmp = {0};
-  if (! path)
-    return NULL;
+      if (poll (pfds, nodes_len + 1, POLL_TTL_MS) < 0 && EINTR != errno)
+        break;
+      long t = now_ms ();
+      /* Backward, as dropping moves the last node */
+      for (int i = nodes_len - 1; i >= 0; --i)
+        {
+          struct node_t *nd = &nodes[i];
+          if (pfds[i + 1].revents)
+            {
+              if (nd->cap - nd->len < BUFSIZ)
+                nd->buf = realloc (nd->buf, nd->cap = 2 * nd->cap + BUFSIZ);
+              ssize_t n = recv (nd->fd, nd->buf + nd->len,
+                                nd->cap - nd->len, 0);
+              nd->len += MAX (n, 0), nd->seen_at = t;
+              if (n <= 0 || coordinator_handle (nd, i) < 0)
+                {
+                  coordinator_drop (nodes, i, &nodes_len);
+                  continue;
+                }
+            }
+          if (t - nd->seen_at > NODE_TTL_MS)
+            coordinator_drop (nodes, i, &nodes_len);
+        }
+      if ((pfds[0].revents & POLLIN) && nodes_len < NODES_MAX)
+        {
+          int fd = accept (lfd, NULL, NULL);
+          if (fd >= 0)
+            nodes[nodes_len++] = (struct node_t){.fd = fd, .seen_at = t};
+        }
+      monitor_progress (&avg_rate);
+    }
 
-  fd = open (path, O_RDONLY);
-  if (fd < 0)
+  end_progress_bar (&opt.progress);
+  for (int i=0; i < nodes_len; ++i)
     {
-      warnln ("could not open file (%s) -- %s.", path, strerror (errno));
-      return NULL;
+      send_all (nodes[i].fd, "DONE\n", 5);
+      close (nodes[i].fd);
+      safe_free (nodes[i].buf);
     }
-
-  if (0 == fw_map (&tmp, fd))
-    return fw_dup (&tmp);
-  else
+  close (lfd);
+  if (opt.verbose)
     {
-      warnln ("could not mmap file (%s).", path);
-      close (fd);
-      return NULL;
+      warnln ("Total requests: %d, Errors: %d, at ~%zu req/sec.",
+              opt.progress.req_total, opt.progress.err_count, avg_rate);
     }
-
-  return NULL;
+  return EXIT_SUCCESS;
 }
 
-/* In interactive mode, this runs in a separate thread */
-void *
-interact (void *__ptr)
+static void
+init_workers (void)
 {
-  int c;
-  struct Opt *opt = (struct Opt *)__ptr;
-  while ((c = getchar ()))
+  int n = opt.workers_len = MIN ((size_t) opt.workers_len, opt.Rqueue.len);
+  opt.workers = ffuc_calloc (n, sizeof (Worker));
+  opt.load_next_fuzz = __next_fuzz_index;
+
+  size_t offset = 0;
+  for (int i=0; i < n; ++i)
     {
-      switch (c)
+      Worker *w = &opt.workers[i];
+      w->id = i;
+      w->multi_handle = curl_multi_init ();
+      if (opt.keepalive)
+        init_multi_keepalive (w->multi_handle);
+      w->ctxs = opt.Rqueue.ctxs + offset;
+      w->len = opt.Rqueue.len / n + ((size_t) i < opt.Rqueue.len % n);
+      offset += w->len;
+      for (size_t j=0; j < w->len; ++j)
         {
-        case '\n':
-          if (opt->Rqueue.waiting)
-            update_progress_bar (&opt->progress);
-          break;
+          w->ctxs[j].worker = w;
+          w->ctxs[j].multi_handle = w->multi_handle;
+        }
 
-        case EOF:
-        case CEOT:
-          goto end_of_interactive;
+      w->words = ffuc_malloc (opt.words_len * sizeof (Fword *));
+      for (int j=0; j < opt.words_len; ++j)
+        {
+          if (! (w->words[j] = fw_dup (opt.words[j])))
+            w->words[j] = fw_dup (&dummy_fword);
         }
     }
- end_of_interactive:
-  disable_raw_mode (&opt->orig_termios);
-  return NULL;
 }
 
 /* Initializes the global Opt, after parsing user options */
@@ -1632,16 +3496,40 @@ init_opt ()
   if (opt.Rqueue.len > opt.max_rate) /* prevent exceeding max rate */
     opt.Rqueue.len = MAX (opt.max_rate, 1);
   opt.Rqueue.ctxs = ffuc_calloc (opt.Rqueue.len, sizeof (RequestContext));
+  init_templates ();
   for (size_t i = 0; i < opt.Rqueue.len; i++)
     {
-      opt.Rqueue.ctxs[i].easy_handle = curl_easy_init();
+      RequestContext *ctx = &opt.Rqueue.ctxs[i];
+      ctx->easy_handle = curl_easy_init();
       int cap_bytes = (n + 1) * sizeof (char *);
-      opt.Rqueue.ctxs[i].FUZZ = ffuc_malloc (cap_bytes);
-      Memzero (opt.Rqueue.ctxs[i].FUZZ, cap_bytes);
+      ctx->FUZZ = ffuc_malloc (cap_bytes);
+      Memzero (ctx->FUZZ, cap_bytes);
+      if (opt.headers_len)
+        {
+          struct curl_slist *hs;
+          hs = ffuc_calloc (opt.headers_len, sizeof (struct curl_slist));
+          for (int j=1; j < opt.headers_len; ++j)
+            hs[j - 1].next = &hs[j];
+          ctx->request.headers = hs;
+        }
     }
   /* Initialize libcurl & context of requests */
   curl_global_init (CURL_GLOBAL_DEFAULT);
   opt.multi_handle = curl_multi_init ();
+  for (size_t i = 0; i < opt.Rqueue.len; i++)
+    opt.Rqueue.ctxs[i].multi_handle = opt.multi_handle;
+  if (opt.http2)
+    opt.keepalive = true;
+  /* Setpoints of the adaptive controller (also used by `interact`) */
+  opt.aimd.window = MIN (AIMD_INIT_WINDOW, opt.Rqueue.len);
+  opt.aimd.rate = opt.max_rate;
+  if (! opt.aimd.enabled)
+    opt.aimd.window = opt.Rqueue.len;
+  if (opt.keepalive)
+    {
+      init_share ();
+      init_multi_keepalive (opt.multi_handle);
+    }
 
   /* Set the default filters if not disabled */
   if (NO_FILTER == opt.filters)
@@ -1682,9 +3570,11 @@ init_opt ()
       break;
     }
 
+  if (opt.node.addr && init_node ())
+    return EXIT_FAILURE;
   if (! isatty (fileno (stderr)))
     opt.progress.progbar_enabled = false;
-  if (! isatty (fileno (opt.streamout)))
+  if (opt.node.addr || ! isatty (fileno (opt.streamout)))
     {
       opt.Printf.color = false;
       opt.Printf.lineclear = false;
@@ -1697,6 +3587,24 @@ init_opt ()
     }
   if (! isatty (STDIN_FILENO))
     opt.interactive = false;
+
+  if ((opt.coord.addr || opt.node.addr) && opt.ckpt.path)
+    {
+      warnln ("checkpoints are not supported in distributed mode.");
+      opt.ckpt.path = NULL;
+    }
+  /* Checkpoints and leases need fuzz indexes, so workers */
+  if (!opt.coord.addr &&
+      (opt.workers_len > 1 || opt.ckpt.path || opt.node.addr))
+    init_workers ();
+  if (opt.ckpt.path && init_ckpt ())
+    return EXIT_FAILURE;
+  /**
+   *  Requests are done in the checkpoint right after their
+   *  results are printed, so results must not be buffered
+   */
+  if (opt.ckpt.path)
+    setvbuf (opt.streamout, NULL, _IOLBF, 0);
   return EXIT_SUCCESS;
 }
 
@@ -1858,6 +3766,17 @@ cleanup (int c, void *p)
         }
     }
 
+  if (opt.ckpt.state)
+    {
+      /**
+       *  On SIGINT, workers are still running, so requests failing
+       *  from now on must stay in the checkpoint; it is not unmapped
+       *  for the same reason, the kernel writes it back at exit
+       */
+      __atomic_store_n (&opt.ckpt.frozen, true, __ATOMIC_RELEASE);
+      ckpt_update (true);
+    }
+
 #ifndef SKIP_FREE
   /* Libcurl cleanup */
   if (NULL != opt.Rqueue.ctxs)
@@ -1866,11 +3785,30 @@ cleanup (int c, void *p)
         {
           RequestContext *ctx = &opt.Rqueue.ctxs[i];
           curl_easy_cleanup (ctx->easy_handle);
-          safe_free (ctx->request.body);
-          curl_slist_free_all (ctx->request.headers);
+          safe_free (ctx->request.arena);
+          safe_free (ctx->request.headers);
         }
     }
+  for (int i=0; i < opt.tmpls_len; ++i)
+    da_free (opt.tmpls[i].segs);
+  safe_free (opt.tmpls);
   curl_multi_cleanup (opt.multi_handle);
+  for (int i=0; i < opt.workers_len && opt.workers; ++i)
+    {
+      Worker *w = &opt.workers[i];
+      curl_multi_cleanup (w->multi_handle);
+      for (int j=0; j < opt.words_len; ++j)
+        {
+          /* mapped files are shared with opt.words */
+          if (w->words[j]->__gen_args)
+            fw_gen_close (w->words[j]);
+          safe_free (w->words[j]);
+        }
+      safe_free (w->words);
+    }
+  safe_free (opt.workers);
+  if (opt.share)
+    curl_share_cleanup (opt.share);
   curl_global_cleanup ();
   /* Opt cleanup */
   safe_free (opt.Rqueue.ctxs);
@@ -1881,6 +3819,18 @@ cleanup (int c, void *p)
     }
   /* Template cleanup */
   da_free (opt.fuzz_template.wlists);
+  if (opt.stats_stream && stderr != opt.stats_stream)
+    fclose (opt.stats_stream);
+  da_free (opt.coord.leases);
+  da_free (opt.coord.pool);
+  if (opt.node.in)
+    {
+      /* Flushes the remaining results to the coordinator */
+      fclose (opt.streamout);
+      fclose (opt.node.in);
+      close (opt.node.fd);
+      da_free (opt.node.leases);
+    }
 #endif /* SKIP_FREE */
 }
 
@@ -1897,9 +3847,13 @@ HTTP_OPTIONS:\n\
   -H, --header      HTTP header\n\
   -w, --wordlist    path to word-list(s)\n\
                     if the previous HTTP component has FUZZ keyword\n\
+  -W, --generator   generated word-list, 'permugen:ARGS' uses the output\n\
+                    of `permugen ARGS` as the word-list (without any file)\n\
 \n\
 OPTIONS:\n\
     -R, --rate      maximum request rate (req/second)\n\
+    -j, --workers   count of worker threads, to send requests and\n\
+                    handle their responses (default is 1)\n\
   --auto-filter     apply filters automatically\n\
                     it's recommended to use this instead of default settings\n\
   --fc, --mc        filter and match HTTP response code\n\
@@ -1910,6 +3864,22 @@ OPTIONS:\n\
     -p, --delay     add delay between requests (in seconds)\n\
                       e.g.  [-p 1]  or  [-p 100-500ms] (random range)\n\
     -T, --timeout   requests timeout\n\
+    -k, --keep-alive  reuse request contexts and connections, with\n\
+                    shared DNS and TLS session cache\n\
+  --http2           HTTP/2 multiplexing (implies --keep-alive)\n\
+    -E, --early-abort  abort the transfer of responses, as soon as\n\
+                    filters discard them (e.g. by code, or --ms)\n\
+  --adaptive[=MS]   adapt concurrency and rate to the target, keeping\n\
+                    p99 latency below MS (automatic by default), and\n\
+                    errors rare; -R and -t are the upper bounds\n\
+  --checkpoint FILE save the progress to FILE, periodically\n\
+  --resume FILE     continue the campaign of checkpoint FILE\n\
+  --stats FILE      append stats to FILE ('-' for stderr) as JSON lines,\n\
+                    periodically, on SIGUSR1, and at the end\n\
+  --coordinator [HOST:]PORT  lease fuzz indexes to nodes, and print\n\
+                    their results instead of sending requests\n\
+  --node HOST:PORT  send requests of leases of the coordinator\n\
+                    (the same options and word-lists are needed)\n\
     -c, --color     toggle output color\n\
     -v, --verbose   verbose\n\
 \n\
@@ -2022,7 +3992,15 @@ parse_args (int argc, char **argv)
         case 'X':
           opt.verb = optarg;
           break;
+        case 'j':
+          if ((opt.workers_len = atoi (optarg)) <= 0)
+            {
+              opt.workers_len = 1;
+              warnln ("invalid number of workers was ignored.");
+            }
+          break;
         case 'w':
+        case 'W':
           last_wlist = optarg;
           set_template (&opt.fuzz_template, WLIST_TEMPLATE, optarg);
           break;
@@ -2064,6 +4042,41 @@ parse_args (int argc, char **argv)
         case 'i':
           opt.interactive = true;
           break;
+        case 'k':
+          opt.keepalive = true;
+          break;
+        case '@':
+          opt.http2 = true;
+          break;
+        case 'E':
+          opt.early_abort = true;
+          break;
+        case '^':
+          if (0 == strcmp (optarg, "-"))
+            opt.stats_stream = stderr;
+          else if (! (opt.stats_stream = fopen (optarg, "a")))
+            {
+              warnln ("could not open '%s' -- %s", optarg, strerror (errno));
+              return EXIT_FAILURE;
+            }
+          break;
+        case '}':
+          opt.ckpt.resume = true;
+          /* fall through */
+        case '{':
+          opt.ckpt.path = optarg;
+          break;
+        case '<':
+          opt.coord.addr = optarg;
+          break;
+        case '>':
+          opt.node.addr = optarg;
+          break;
+        case '%':
+          opt.aimd.enabled = true;
+          if (optarg)
+            opt.aimd.target_ms = atoi (optarg);
+          break;
         case 'A':
           if (opt.filters && NO_FILTER != opt.filters)
             warnln ("disable filters along with filter options.");
@@ -2148,12 +4161,13 @@ do_filter_discovery (void)
 }
 
 static inline RequestContext *
-handle_response_curl (const CURLMsg *msg)
+handle_response_curl (Worker *w, const CURLMsg *msg)
 {
   RequestContext *ctx;
   CURL *curl = msg->easy_handle;
 
-  ctx = lookup_handle (curl, opt.Rqueue.ctxs, opt.Rqueue.len);
+  UNUSED (w);
+  ctx = lookup_handle (curl);
   assert (NULL != ctx && "Broken Logic!!  -  \
 Completed easy_handle doesn't have request context.\n");
 
@@ -2165,13 +4179,267 @@ Completed easy_handle doesn't have request context.\n");
   return ctx;
 }
 
+/* Set by SIGUSR1, to dump stats on the next monitor_progress */
+static volatile sig_atomic_t stats_requested = 0;
+
+void
+on_sigusr1 (int signo)
+{
+  UNUSED (signo);
+  stats_requested = 1;
+}
+
+/* Updates the progress and average request rate @avg_rate */
+static inline void
+monitor_progress (size_t *avg_rate)
+{
+  tick_progress (&opt.progress);
+  update_req_rate (&opt.progress);
+  if (opt.aimd.enabled)
+    aimd_update (&opt.aimd, &opt.progress);
+  if (opt.ckpt.state)
+    ckpt_update (false);
+  if (opt.node.addr && now_ms () - __atomic_load_n (&opt.node.sent_at,
+                                                    __ATOMIC_RELAXED)
+      >= NODE_PING_MS)
+    {
+      pthread_mutex_lock (&opt.node.lock);
+      node_printf ("PING\n");
+      pthread_mutex_unlock (&opt.node.lock);
+    }
+  if (opt.stats_stream)
+    {
+      size_t t = now_us ();
+      if (stats_requested || t - opt.stats_t0_us >= STATS_PERIOD_MS * 1000)
+        {
+          stats_requested = 0;
+          opt.stats_t0_us = t;
+          dump_stats (opt.stats_stream, &opt.progress);
+        }
+    }
+  if (opt.verbose)
+    { /* update average request rate, since the start */
+      size_t dt = now_us () - opt.progress.start_us;
+      if (dt)
+        *avg_rate = PROG_LOAD (opt.progress.req_sent) * 1000000UL / dt;
+    }
+}
+
+/* libcurl socket callback, keeps the epoll set of @userp in sync */
+static int
+curl_socket_cb (CURL *easy, curl_socket_t sock, int what,
+                void *userp, void *socketp)
+{
+  Worker *w = (Worker *) userp;
+  struct epoll_event ev = {0};
+  UNUSED (easy);
+
+  if (CURL_POLL_REMOVE == what)
+    {
+      epoll_ctl (w->epfd, EPOLL_CTL_DEL, sock, NULL);
+      curl_multi_assign (w->multi_handle, sock, NULL);
+      return 0;
+    }
+
+  if (what & CURL_POLL_IN)
+    ev.events |= EPOLLIN;
+  if (what & CURL_POLL_OUT)
+    ev.events |= EPOLLOUT;
+  ev.data.fd = sock;
+  if (socketp) /* already in the epoll set */
+    epoll_ctl (w->epfd, EPOLL_CTL_MOD, sock, &ev);
+  else
+    {
+      epoll_ctl (w->epfd, EPOLL_CTL_ADD, sock, &ev);
+      curl_multi_assign (w->multi_handle, sock, w);
+    }
+  return 0;
+}
+
+/* libcurl timer callback */
+static int
+curl_timer_cb (CURLM *multi, long timeout_ms, void *userp)
+{
+  Worker *w = (Worker *) userp;
+  UNUSED (multi);
+  w->timeout_at = (timeout_ms < 0) ? -1 : now_ms () + timeout_ms;
+  return 0;
+}
+
+/* Sets up the free list and the event driver of @w */
+static int
+init_fuzz_loop (Worker *w)
+{
+  w->free_ctxs = NULL;
+  for (size_t i = w->len; i > 0; --i)
+    release_handle (w, &w->ctxs[i - 1]);
+
+  w->timeout_at = -1;
+  if (-1 == (w->epfd = epoll_create1 (EPOLL_CLOEXEC)))
+    return 1;
+  curl_multi_setopt (w->multi_handle, CURLMOPT_SOCKETFUNCTION, curl_socket_cb);
+  curl_multi_setopt (w->multi_handle, CURLMOPT_SOCKETDATA, w);
+  curl_multi_setopt (w->multi_handle, CURLMOPT_TIMERFUNCTION, curl_timer_cb);
+  curl_multi_setopt (w->multi_handle, CURLMOPT_TIMERDATA, w);
+  return 0;
+}
+
+/**
+ *  The main loop of worker @w, to send requests and handle responses
+ *  until the end of fuzz; @avg_rate is only given to the one that
+ *  updates the progress (not workers), see monitor_progress
+ *
+ *  It's driven by curl_multi_socket_action and epoll, so it only
+ *  wakes up on socket events, curl timeouts, or when the rate limit
+ *  allows sending more requests
+ */
+static void
+fuzz_loop (Worker *w, size_t *avg_rate)
+{
+  CURLMsg *msg;
+  RequestContext *ctx = NULL;
+  struct epoll_event events[EPOLL_EVENTS_MAX];
+  int res, still_running = 0;
+
+  if (0 != init_fuzz_loop (w))
+    {
+      warnln ("epoll failed -- %s", strerror (errno));
+      return;
+    }
+  do {
+    /* Take free contexts (If there is any) and register them */
+    bool limited = false, starved = false;
+    while (!worker_eofuzz (w) && (ctx = lookup_free_handle (w)))
+      {
+        if (opt.node.addr && w->next >= w->end)
+          {
+            /* Waiting for a lease */
+            fuzz_take_chunk (w);
+            if (w->next >= w->end)
+              {
+                release_handle (w, ctx);
+                starved = true;
+                break;
+              }
+          }
+        if (rate_limit () <= rt_req_rate (&opt.progress) ||
+            window_limit () <= __atomic_load_n (&opt.Rqueue.waiting,
+                                                __ATOMIC_RELAXED))
+          {
+            release_handle (w, ctx);
+            limited = true;
+            break;
+          }
+        /* Registering the context */
+        opt.load_next_fuzz (ctx);
+        register_context (ctx, false); /* none blocking */
+        w->waiting++;
+        __atomic_add_fetch (&opt.Rqueue.waiting, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch (&opt.progress.req_dt, 1, __ATOMIC_RELAXED);
+      }
+
+    range_usleep (opt.Rqueue.delay_us);
+    /* Wait until a socket event or the curl timer */
+    long timeout = POLL_TTL_MS;
+    if (limited)
+      timeout = 1;
+    if (starved)
+      timeout = MIN (timeout, NODE_RETRY_MS);
+    if (w->timeout_at >= 0)
+      timeout = MIN (timeout, MAX (w->timeout_at - now_ms (), 0));
+
+    int n = epoll_wait (w->epfd, events, EPOLL_EVENTS_MAX, (int) timeout);
+    for (int i=0; i < n; ++i)
+      {
+        int flags = 0;
+        if (events[i].events & EPOLLIN)
+          flags |= CURL_CSELECT_IN;
+        if (events[i].events & EPOLLOUT)
+          flags |= CURL_CSELECT_OUT;
+        if (events[i].events & (EPOLLERR | EPOLLHUP))
+          flags |= CURL_CSELECT_ERR;
+        curl_multi_socket_action (w->multi_handle, events[i].data.fd,
+                                  flags, &still_running);
+      }
+    if (w->timeout_at >= 0 && now_ms () >= w->timeout_at)
+      {
+        w->timeout_at = -1;
+        curl_multi_socket_action (w->multi_handle, CURL_SOCKET_TIMEOUT,
+                                  0, &still_running);
+      }
+
+    while ((msg = curl_multi_info_read (w->multi_handle, &res)))
+      {
+        RequestContext *completed = handle_response_curl (w, msg);
+        if (opt.node.addr)
+          node_complete (completed->fuzz_index,
+                         CURLE_OK != completed->stat.ccode);
+        context_reset (completed);
+        release_handle (w, completed);
+        if (ckpt_active ())
+          opt.ckpt.slots[completed - opt.Rqueue.ctxs] = 0;
+        __atomic_add_fetch (&opt.progress.req_sent, 1, __ATOMIC_RELAXED);
+        __atomic_sub_fetch (&opt.Rqueue.waiting, 1, __ATOMIC_RELAXED);
+        w->waiting--;
+      }
+
+    if (avg_rate)
+      monitor_progress (avg_rate);
+  }
+  while (w->waiting > 0 || still_running > 0 || !worker_eofuzz (w));
+  close (w->epfd);
+}
+
+static void *
+worker_main (void *arg)
+{
+  Worker *w = (Worker *) arg;
+  fuzz_take_chunk (w);
+  fuzz_loop (w, NULL);
+  __atomic_sub_fetch (&opt.workers_running, 1, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+/* Runs workers and updates the progress until they all finish */
+static void
+run_workers (size_t *avg_rate)
+{
+  opt.workers_running = opt.workers_len;
+  for (int i=0; i < opt.workers_len; ++i)
+    {
+      Worker *w = &opt.workers[i];
+      if (0 != pthread_create (&w->th, NULL, worker_main, w))
+        {
+          /* run it on this thread afterwards */
+          w->th = pthread_self ();
+        }
+    }
+  for (int i=0; i < opt.workers_len; ++i)
+    {
+      if (pthread_equal (opt.workers[i].th, pthread_self ()))
+        worker_main (&opt.workers[i]);
+    }
+
+  while (__atomic_load_n (&opt.workers_running, __ATOMIC_ACQUIRE) > 0)
+    {
+      monitor_progress (avg_rate);
+      usleep (MIN_DT_US);
+    }
+  for (int i=0; i < opt.workers_len; ++i)
+    {
+      if (! pthread_equal (opt.workers[i].th, pthread_self ()))
+        pthread_join (opt.workers[i].th, NULL);
+    }
+}
+
 void
 on_sigint (int signo)
 {
-  if (SIGINT != signo)
+  if (SIGINT != signo && SIGTERM != signo)
     return;
   /* This will trigger cleanup function
-     It's important to disable terminal raw mode */
+     It's important to disable terminal raw mode,
+     and to freeze the checkpoint */
   exit (0);
 }
 
@@ -2192,6 +4460,8 @@ main (int argc, char **argv)
     .max_rate = MAX_REQ_RATE,
     .streamout = stdout,
     .words = da_new (Fword *),
+    .workers_len = 1,
+    .print_lock = PTHREAD_MUTEX_INITIALIZER,
     .progress.progbar_enabled = true,
 #ifndef NO_DEFAULT_COLOR
     .color_enabled = true,
@@ -2217,54 +4487,48 @@ main (int argc, char **argv)
       pthread_create (&opt.interact_th, NULL, interact, &opt);
       signal (SIGINT, on_sigint); /* to disable raw mode on SIGINT */
     }
+  if (opt.ckpt.state)
+    {
+      signal (SIGINT, on_sigint);
+      signal (SIGTERM, on_sigint);
+    }
   log_current_config ();
+  if (opt.coord.addr)
+    return run_coordinator ();
   init_progress (&opt.progress);
+  if (opt.stats_stream)
+    {
+      opt.stats_t0_us = opt.progress.start_us;
+      signal (SIGUSR1, on_sigusr1);
+    }
+  if (opt.ckpt.resume)
+    {
+      opt.progress.req_sent = opt.ckpt.state->req_sent;
+      opt.progress.err_count = opt.ckpt.state->err_count;
+    }
 
   /**
    *  The main Loop
    */
-  CURLMsg *msg;
   size_t avg_rate=0;
-  RequestContext *ctx = NULL;
-  int numfds, res, still_running;
-  do {
-    /* Find a free context (If there is any) and register it */
-    while (!opt.eofuzz && opt.Rqueue.waiting < opt.Rqueue.len)
-      {
-        if (opt.max_rate <= rt_req_rate (&opt.progress))
-          break;
-
-        if ((ctx = lookup_free_handle (opt.Rqueue.ctxs, opt.Rqueue.len)))
-          { /* Registering the context */
-            opt.load_next_fuzz (ctx);
-            register_context (ctx, false); /* none blocking */
-            opt.Rqueue.waiting++;
-            opt.progress.req_dt++;
-          }
-      }
-
-    range_usleep (opt.Rqueue.delay_us);
-    curl_multi_perform (opt.multi_handle, &still_running);
-    curl_multi_wait (opt.multi_handle, NULL, 0, POLL_TTL_MS, &numfds);
-    while ((msg = curl_multi_info_read (opt.multi_handle, &res)))
-      {
-        RequestContext *completed = handle_response_curl (msg);
-        context_reset (completed);
-        opt.progress.req_sent++;
-        opt.Rqueue.waiting--;
-      }
-
-    tick_progress (&opt.progress);
-    update_req_rate (&opt.progress);
-    if (opt.verbose)
-      { /* update average request rate */
-        avg_rate += opt.progress.rate;
-        avg_rate /= 2;
-      }
-  }
-  while (still_running > 0 || !opt.eofuzz);
+  if (opt.workers)
+    run_workers (&avg_rate);
+  else
+    {
+      Worker w = {
+        .multi_handle = opt.multi_handle,
+        .ctxs = opt.Rqueue.ctxs,
+        .len = opt.Rqueue.len,
+        .words = opt.words,
+      };
+      fuzz_loop (&w, &avg_rate);
+    }
 
   end_progress_bar (&opt.progress);
+  if (opt.ckpt.state)
+    ckpt_update (true);
+  if (opt.stats_stream)
+    dump_stats (opt.stats_stream, &opt.progress);
   if (opt.verbose)
     {
       warnln ("Total requests: %d, Errors: %d, at ~%zu req/sec.",
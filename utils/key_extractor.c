@@ -9,18 +9,32 @@
       see help for details: `kextractor -h`
 
     Compilation:
-      cc -ggdb -O3 -Wall -Wextra -Werror -I../libs \
-        key_extractor.c -o kextractor
+      cc -ggdb -O3 -Wall -Wextra -Werror -I../libs -I../DS \
+        key_extractor.c -o kextractor -lpthread
 
     Options:
       Output buffer capacity in bytes:
         `-D_BMAX="(1 * 1024)"`
+      Size of input chunks of parallel mode (-j), in bytes
+      (rounded down to a multiple of 512):
+        `-D KE_CHUNK_SIZE="(4 << 20)"`
+      Size of blocks of the key store of unique mode, in bytes:
+        `-D KE_STORE_BLOCK="(1 << 20)"`
+
+    Dependencies:
+      In `../libs`:  clistd.h, dyna.h, mini-lexer.h
+      In `../DS`:    hashtab.h, arena.h  (unique mode)
  **/
+#undef _GNU_SOURCE
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <getopt.h>
 #include <ctype.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define Version "2"
 #define PROGRAM_NAME "key_extractor"
@@ -33,6 +47,12 @@
 # ifndef _BMAX
 #  define _BMAX (4 * 1024) // 4Kb = 1 disk sector
 # endif
+# ifndef KE_CHUNK_SIZE
+#  define KE_CHUNK_SIZE (4 << 20) // 4Mb
+# endif
+# ifndef KE_STORE_BLOCK
+#  define KE_STORE_BLOCK (1 << 20) // 1Mb
+# endif
 
 
 static struct option const long_options[] =
@@ -58,6 +78,12 @@ static struct option const long_options[] =
   {"format",    required_argument, NULL, 'o'},
   /* extra supports */
   {"js",        no_argument,       NULL, '2'},
+  /* parallel mode */
+  {"jobs",      required_argument, NULL, 'j'},
+  /* unique and frequency modes */
+  {"unique",    no_argument,       NULL, 'u'},
+  {"top",       required_argument, NULL, 't'},
+  {"approx",    required_argument, NULL, 'A'},
   /* do not delete me */
   {NULL,        0,                 NULL,  0 },
 };
@@ -65,6 +91,15 @@ static struct option const long_options[] =
 #define DYNA_IMPLEMENTATION
 #include "dyna.h"
 
+#ifndef HT_HASHER
+#  define HT_HASHER hash_wy
+#endif
+#define HASHTAB_IMPLEMENTATION
+#include "hashtab.h"
+
+#define ARENA_IMPLEMENTATION
+#include "arena.h"
+
 #define TOKEN_MAX_BUF_LEN (512) // 0.5Kb
 #define ML_IMPLEMENTATION
 #include "mini-lexer.h"
@@ -136,6 +171,7 @@ enum ke_flag_t
     C_EXT_DELIMS    = FLG (16),
     C_OVERW_DELIMS  = FLG (17),
     C_JAVASCRIPT    = FLG (18),
+    C_UNIQUE        = FLG (19),
     C_PROVIDED      = FLG (31), // bound
   };
 
@@ -152,8 +188,15 @@ char *out_buff = NULL; // out_stream buffer
 int in_buff_len = TOKEN_MAX_BUF_LEN;
 char *in_buff = NULL; // milexer token buffer
 
-#define Outstr(str) fprintf (out_stream, "%s", str)
-#define Outln() Outstr ("\n")
+/* count of threads, parallel mode */
+int jobs = 1;
+
+/* frequency mode: count of keys to print, and approximate mode memory */
+size_t top_k = 0;
+size_t approx_mem = 0;
+
+#define Outstr(out, str) fprintf (out, "%s", str)
+#define Outln(out) Outstr (out, "\n")
 
 void
 usage (int c)
@@ -183,6 +226,13 @@ OPTIONS:\n\
                            z:  treat strings as normal tokens\n\
                            n:  include numbers\n\
                        Example: '-o Str:key:num'\n\
+     -j, --jobs        to tokenize the input file on N threads\n\
+                       (memory mapped), the output keeps the input order\n\
+     -u, --unique      to only print the first occurrence of each key\n\
+     -t, --top         to only print the K most frequent keys, with counts\n\
+     -A, --approx      approximate mode of -u and -t with N megabytes\n\
+                       of memory (Bloom filter and count-min sketch)\n\
+                       for when the distinct keys don't fit in memory\n\
 ");
 }
 
@@ -218,7 +268,7 @@ int
 parse_args (int argc, char **argv)
 {
   int c;
-  const char *params = "+o:a:d:Dvh";
+  const char *params = "+o:a:d:Dj:ut:A:vh";
   while (1)
     {
       c = getopt_long (argc, argv, params, long_options, NULL);
@@ -258,6 +308,36 @@ parse_args (int argc, char **argv)
           kflags |= C_JAVASCRIPT;
           break;
 
+        case 'j':
+          if ((jobs = atoi (optarg)) < 1)
+            {
+              warnln ("invalid number of jobs -- (%s)", optarg);
+              return 1;
+            }
+          break;
+
+        case 'u':
+          kflags |= C_UNIQUE;
+          break;
+
+        case 't':
+          if (atoi (optarg) < 1)
+            {
+              warnln ("invalid count of top keys -- (%s)", optarg);
+              return 1;
+            }
+          top_k = atoi (optarg);
+          break;
+
+        case 'A':
+          if (atoi (optarg) < 1)
+            {
+              warnln ("invalid memory size -- (%s)", optarg);
+              return 1;
+            }
+          approx_mem = (size_t) atoi (optarg) << 20;
+          break;
+
         case 'a':
           if (safe_open (optarg, "a", &out_stream))
             return 1;
@@ -301,11 +381,12 @@ parse_args (int argc, char **argv)
 }
 
 static inline int
-cstr_isanumber (const char *s)
+str_isanumber (const char *s, size_t len)
 {
-  if (*s != '0')
+  const char *end = s + len;
+  if (len == 0 || *s != '0')
     {
-      for (; *s != '\0'; ++s)
+      for (; s < end; ++s)
         {
           if (!isdigit (*s))
             return 0;
@@ -313,11 +394,11 @@ cstr_isanumber (const char *s)
       return 1;
     }
 
-  switch (*(++s))
+  switch ((len > 1) ? *(++s) : '\0')
     {
     case 'x': /* Hexadecimal value 0x??? */
       {
-        for (++s; *s != '\0'; ++s)
+        for (++s; s < end; ++s)
           {
             if (!isxdigit (*s))
               return 0;
@@ -327,7 +408,7 @@ cstr_isanumber (const char *s)
 
     case 'b': /* Binary number 0b??? */
       {
-        for (++s; *s != '\0'; ++s)
+        for (++s; s < end; ++s)
           {
             if (!isbdigit (*s))
               return 0;
@@ -341,9 +422,17 @@ cstr_isanumber (const char *s)
   return 0;
 }
 
+/**
+ *  tokens are copied into tk->cstr; PFLAG_VIEW does not pay off
+ *  for the short tokens of source files
+ */
+#define Outtoken(out, tk, n) fwrite ((tk)->cstr, 1, n, out)
+
 static inline int
-token_out (const Milexer_Token *tk)
+token_out (FILE *out, const Milexer_Token *tk)
 {
+  size_t n = strlen (tk->cstr);
+
   if (tk->type == TK_EXPRESSION)
     {
       /* string */
@@ -355,17 +444,17 @@ token_out (const Milexer_Token *tk)
             {
               return 0;
             }
-          Outstr (tk->cstr);
+          Outtoken (out, tk, n);
           return 1;
         }
     }
   else if (tk->type == TK_KEYWORD)
     {
-      if (cstr_isanumber (tk->cstr))
+      if (str_isanumber (tk->cstr, n))
         {
           if (HAS_FLG (kflags, O_ALLOW_NUM))
             {
-              Outstr (tk->cstr);
+              Outtoken (out, tk, n);
               return 1;
             }
         }
@@ -373,7 +462,7 @@ token_out (const Milexer_Token *tk)
         {
           if (HAS_FLG (kflags, O_ALLOW_KEY))
             {
-              Outstr (tk->cstr);
+              Outtoken (out, tk, n);
               return 1;
             }
         }
@@ -387,6 +476,356 @@ token_out (const Milexer_Token *tk)
     malloc_ptr = NULL;                          \
   }} while (0)
 
+/**
+ *  Unique mode (-u) and frequency mode (-t)
+ *  The output stream is filtered line by line, like `sort -u`
+ *  does, but keys keep the order of their first occurrence
+ *  The filter only sees complete keys, so it also works with
+ *  tokens longer than the lexer buffer, and with parallel mode
+ *
+ *  Exact mode:  keys are copied into an arena, and are indexed
+ *               by a growable hash table of their indices
+ *  Approximate mode (-A):  only a Bloom filter (unique mode) or
+ *               a count-min sketch and a heap of the top K keys
+ *               are kept, using bounded memory; it might drop new
+ *               keys (false positives) and overestimate the counts
+ */
+struct ukey_t
+{
+  struct keytab_t k;
+  size_t count;
+};
+
+/* Count-min sketch depth and Bloom filter hash count */
+#define KE_CMS_D 4
+#define KE_BLOOM_K 4
+
+struct
+{
+  FILE *out; /* the actual output stream */
+  char *line; /* incomplete line (dynamic array) */
+
+  /* exact mode, @keys is a dynamic array */
+  GHashTable ht;
+  struct ukey_t *keys;
+  Arena store;
+  char *mem; /* free space of the current block of @store */
+  size_t left;
+
+  /* approximate mode */
+  uint8_t *bloom;
+  uint32_t *cms;
+  size_t width; /* in bits (bloom) or counters (cms) */
+  struct ukey_t *heap; /* min-heap of length @top_k */
+  size_t heap_len;
+} Uniq;
+
+/* 64-bit FNV-1a, for the approximate mode */
+static inline uint64_t
+ukey_hash (const char *s, size_t len)
+{
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (; len > 0; --len, ++s)
+    h = (h ^ (unsigned char) *s) * 0x100000001b3ULL;
+  return h;
+}
+
+/* The @i'th hash, from @h (double hashing) */
+#define UKEY_HASH_I(h, i) \
+  ((uint32_t)(h) + (i) * ((uint32_t)((h) >> 32) | 1))
+
+static int
+ukey_isequal (const DATA_T *restrict k1, idx_t l1,
+              const DATA_T *restrict k2, idx_t l2)
+{
+  return l1 == l2 && 0 == memcmp (k1, k2, l1);
+}
+
+/* Copies @s into the key store */
+static char *
+ustore (const char *s, size_t len)
+{
+  char *res;
+  if (len > Uniq.left)
+    {
+      Uniq.left = (len > KE_STORE_BLOCK) ? len : KE_STORE_BLOCK;
+      Uniq.mem = arena_alloc (&Uniq.store, Uniq.left, AUSE_MALLOC);
+      if (!Uniq.mem)
+        {
+          warnln ("could not allocate memory for keys");
+          exit (EXIT_FAILURE);
+        }
+    }
+  res = Uniq.mem;
+  memcpy (res, s, len);
+  Uniq.mem += len;
+  Uniq.left -= len;
+  return res;
+}
+
+/* Exact mode: counts the key @s, returns its count */
+static size_t
+uniq_exact (const char *s, size_t len)
+{
+  idx_t idx;
+  if (HT_FOUND == ght_idxof (&Uniq.ht, s, len, &idx))
+    return ++Uniq.keys[idx].count;
+
+  struct ukey_t k = {NEW_KEY (ustore (s, len), len), 1};
+  da_appd (Uniq.keys, k);
+  Uniq.ht.head = (DATA_T *) Uniq.keys; /* might be reallocated */
+  if (0 > ght_insert (&Uniq.ht, da_sizeof (Uniq.keys) - 1))
+    {
+      warnln ("could not allocate the hash table");
+      exit (EXIT_FAILURE);
+    }
+  return 1;
+}
+
+/* Approximate unique mode: returns 1 for new keys, 2 otherwise */
+static size_t
+uniq_bloom (const char *s, size_t len)
+{
+  uint64_t h = ukey_hash (s, len);
+  size_t ret = 2;
+  for (uint32_t i = 0; i < KE_BLOOM_K; ++i)
+    {
+      size_t bit = UKEY_HASH_I (h, i) % Uniq.width;
+      if (! (Uniq.bloom[bit >> 3] & (1 << (bit & 7))))
+        {
+          Uniq.bloom[bit >> 3] |= 1 << (bit & 7);
+          ret = 1;
+        }
+    }
+  return ret;
+}
+
+/* Min-heap of the top K keys, by count */
+static void
+heap_down (size_t i)
+{
+  struct ukey_t *H = Uniq.heap, tmp;
+  for (size_t c; (c = 2 * i + 1) < Uniq.heap_len; i = c)
+    {
+      if (c + 1 < Uniq.heap_len && H[c + 1].count < H[c].count)
+        ++c;
+      if (H[i].count <= H[c].count)
+        break;
+      tmp = H[i], H[i] = H[c], H[c] = tmp;
+    }
+}
+
+static void
+heap_up (size_t i)
+{
+  struct ukey_t *H = Uniq.heap, tmp;
+  for (size_t p; i > 0 && H[p = (i - 1) / 2].count > H[i].count; i = p)
+    tmp = H[i], H[i] = H[p], H[p] = tmp;
+}
+
+/**
+ *  Approximate frequency mode: counts the key @s
+ *  using the count-min sketch (conservative update)
+ *  and keeps it in the heap, if it's frequent enough
+ */
+static size_t
+uniq_cms (const char *s, size_t len)
+{
+  uint64_t h = ukey_hash (s, len);
+  uint32_t *cell[KE_CMS_D];
+  uint32_t est = UINT32_MAX;
+
+  for (uint32_t i = 0; i < KE_CMS_D; ++i)
+    {
+      cell[i] = Uniq.cms + i * Uniq.width + UKEY_HASH_I (h, i) % Uniq.width;
+      if (*cell[i] < est)
+        est = *cell[i];
+    }
+  if (est < UINT32_MAX)
+    ++est;
+  for (uint32_t i = 0; i < KE_CMS_D; ++i)
+    {
+      if (*cell[i] < est)
+        *cell[i] = est;
+    }
+
+  if (Uniq.heap_len == top_k && est <= Uniq.heap[0].count)
+    return est;
+  for (size_t i = 0; i < Uniq.heap_len; ++i)
+    {
+      if (ukey_isequal (Uniq.heap[i].k.key, Uniq.heap[i].k.len, s, len))
+        {
+          Uniq.heap[i].count = est;
+          heap_down (i);
+          return est;
+        }
+    }
+
+  char *key = malloc (len);
+  memcpy (key, s, len);
+  if (Uniq.heap_len < top_k)
+    {
+      Uniq.heap[Uniq.heap_len] = (struct ukey_t){NEW_KEY (key, len), est};
+      heap_up (Uniq.heap_len++);
+    }
+  else
+    {
+      free (Uniq.heap[0].k.key);
+      Uniq.heap[0] = (struct ukey_t){NEW_KEY (key, len), est};
+      heap_down (0);
+    }
+  return est;
+}
+
+/**
+ *  Filters the line @s (including the line break, if any)
+ *  Returns -1 on write error
+ */
+static int
+uniq_line (const char *s, size_t len)
+{
+  size_t keylen = (len > 0 && s[len - 1] == '\n') ? len - 1 : len;
+  size_t n;
+
+  if (approx_mem == 0)
+    n = uniq_exact (s, keylen);
+  else if (top_k > 0)
+    n = uniq_cms (s, keylen);
+  else
+    n = uniq_bloom (s, keylen);
+
+  if (top_k == 0 && n == 1 && fwrite (s, 1, len, Uniq.out) != len)
+    return -1;
+  return 0;
+}
+
+/* Write function of the filtered output stream (fopencookie) */
+static ssize_t
+uniq_write (void *cookie, const char *buf, size_t size)
+{
+  UNUSED (cookie);
+  const char *p = buf, *end = buf + size, *nl;
+
+  while ((nl = memchr (p, '\n', end - p)))
+    {
+      int ret;
+      ++nl;
+      if (da_sizeof (Uniq.line) > 0)
+        {
+          da_appd_arr (Uniq.line, p, nl - p);
+          ret = uniq_line (Uniq.line, da_sizeof (Uniq.line));
+          da_drop (Uniq.line);
+        }
+      else
+        ret = uniq_line (p, nl - p);
+      if (ret < 0)
+        return -1;
+      p = nl;
+    }
+  if (p < end)
+    da_appd_arr (Uniq.line, p, end - p);
+  return size;
+}
+
+static int
+top_cmp (const void *a, const void *b)
+{
+  const struct ukey_t *k1 = a, *k2 = b;
+  if (k1->count != k2->count)
+    return (k1->count < k2->count) ? 1 : -1;
+  /* the first occurrence comes first (exact mode) */
+  return (k1->k.key < k2->k.key) ? -1 : (k1->k.key > k2->k.key);
+}
+
+/* Prints the top keys, like `sort | uniq -c | sort -rn | head` */
+static void
+top_dump (void)
+{
+  struct ukey_t *top = Uniq.heap;
+  size_t n = Uniq.heap_len;
+
+  if (approx_mem == 0)
+    {
+      top = Uniq.keys;
+      n = da_sizeof (Uniq.keys);
+    }
+  qsort (top, n, sizeof (struct ukey_t), top_cmp);
+  for (size_t i = 0; i < n && i < top_k; ++i)
+    {
+      fprintf (Uniq.out, "%7zu ", top[i].count);
+      fwrite (top[i].k.key, 1, top[i].k.len, Uniq.out);
+      Outln (Uniq.out);
+    }
+}
+
+/* Close function of the filtered output stream (fopencookie) */
+static int
+uniq_close (void *cookie)
+{
+  UNUSED (cookie);
+  /* the last line, without line break */
+  if (da_sizeof (Uniq.line) > 0)
+    uniq_line (Uniq.line, da_sizeof (Uniq.line));
+  if (top_k > 0)
+    top_dump ();
+
+  if (approx_mem)
+    {
+      for (size_t i = 0; i < Uniq.heap_len; ++i)
+        free (Uniq.heap[i].k.key);
+    }
+  safe_free (Uniq.heap);
+  safe_free (Uniq.bloom);
+  safe_free (Uniq.cms);
+  ght_free (&Uniq.ht);
+  arena_free (&Uniq.store);
+  da_free (Uniq.keys);
+  da_free (Uniq.line);
+  return fclose (Uniq.out);
+}
+
+/**
+ *  Replaces @out_stream with the filtered stream
+ *  of unique and frequency modes
+ */
+static int
+uniq_init (void)
+{
+  cookie_io_functions_t io = {.write = uniq_write, .close = uniq_close};
+
+  Uniq.line = da_new (char);
+  if (approx_mem == 0)
+    {
+      Uniq.keys = da_new (struct ukey_t);
+      Uniq.ht = new_ghashtab_t (1024, Uniq.keys, struct ukey_t, k);
+      ht_set_funs (&Uniq.ht, NULL, ukey_isequal);
+      if (0 != ght_init (&Uniq.ht))
+        return 1;
+    }
+  else if (top_k > 0)
+    {
+      Uniq.width = approx_mem / (KE_CMS_D * sizeof (uint32_t));
+      Uniq.cms = calloc (KE_CMS_D * Uniq.width, sizeof (uint32_t));
+      Uniq.heap = calloc (top_k, sizeof (struct ukey_t));
+      if (!Uniq.cms || !Uniq.heap)
+        return 1;
+    }
+  else
+    {
+      Uniq.width = approx_mem * 8;
+      if (!(Uniq.bloom = calloc (approx_mem, 1)))
+        return 1;
+    }
+
+  Uniq.out = out_stream;
+  if (!(out_stream = fopencookie (NULL, "w", io)))
+    {
+      out_stream = Uniq.out;
+      return 1;
+    }
+  return 0;
+}
+
 void
 cleanup (int code, void *ptr)
 {
@@ -414,7 +853,7 @@ kinit (void)
   /* Default output configuration */
   if (! HAS_FLG (kflags, O_PROVIDED))
     {
-      kflags = O_ALLOW_KEY | O_ALLOW_STR;
+      kflags |= O_ALLOW_KEY | O_ALLOW_STR;
     }
 
   /* Check empty output */
@@ -468,6 +907,231 @@ kinit (void)
   return 0;
 }
 
+/**
+ *  Extracts tokens of the current slice of @src into @out
+ *  Returns NEXT_NEED_LOAD at the end of the slice, or NEXT_END
+ */
+static int
+extract (Milexer_Slice *src, Milexer_Token *tk, FILE *out)
+{
+  int ret;
+  for (ret = 0; !NEXT_SHOULD_END (ret); )
+    {
+      ret = ml_next (&ML, src, tk, parse_flg);
+      switch (ret)
+        {
+        case NEXT_NEED_LOAD:
+          return ret;
+
+        case NEXT_CHUNK:
+          token_out (out, tk);
+          break;
+        case NEXT_MATCH:
+        case NEXT_ZTERM:
+          if (token_out (out, tk))
+            Outln (out);
+          break;
+
+        default:
+          break;
+        }
+    }
+  return ret;
+}
+
+/**
+ *  Tokenizes @buf of length @len, in slices of `in_buff_len` bytes,
+ *  the same slices that the serial mode reads from the input file
+ */
+static void
+extract_slices (Milexer_Slice *src, Milexer_Token *tk,
+                const char *buf, size_t len, FILE *out)
+{
+  for (size_t n; len > 0; buf += n, len -= n)
+    {
+      n = (len < (size_t) in_buff_len) ? len : (size_t) in_buff_len;
+      SET_ML_SLICE (src, buf, n);
+      extract (src, tk, out);
+    }
+}
+
+/**
+ *  Parallel mode
+ *  The input file is split into chunks (at multiples of `in_buff_len`),
+ *  and each chunk is tokenized from the initial state of the lexer
+ *  This is only correct when the previous chunk ends in that state
+ *  (not in middle of strings, comments, ...); otherwise, the chunk
+ *  is tokenized again, after the previous one, by the main thread
+ */
+struct chunk_t
+{
+  const char *buf;
+  size_t len;
+
+  /* output of the chunk */
+  char *out;
+  size_t out_len;
+
+  /* the state of the lexer at the end of the chunk */
+  Milexer_Slice src;
+  Milexer_Token tk;
+  bool done;
+};
+
+struct
+{
+  struct chunk_t *chunks;
+  size_t len;
+  /* the next chunk to tokenize, and the next one to write */
+  size_t next, written;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+} Par = {
+  .lock = PTHREAD_MUTEX_INITIALIZER,
+  .cond = PTHREAD_COND_INITIALIZER,
+};
+
+/* At most this many chunks may wait to be written */
+#define PAR_WINDOW (2 * jobs)
+
+/* The lexer is in its initial state (no pending token) */
+#define ML_IS_CLEAN(src, tk) \
+  ((src)->state == SYN_DUMMY && (tk)->__idx == 0)
+
+static void *
+par_worker (void *arg)
+{
+  UNUSED (arg);
+  for (;;)
+    {
+      pthread_mutex_lock (&Par.lock);
+      while (Par.next < Par.len && Par.next >= Par.written + PAR_WINDOW)
+        pthread_cond_wait (&Par.cond, &Par.lock);
+      if (Par.next >= Par.len)
+        {
+          pthread_mutex_unlock (&Par.lock);
+          return NULL;
+        }
+      struct chunk_t *c = &Par.chunks[Par.next++];
+      pthread_mutex_unlock (&Par.lock);
+
+      FILE *out = open_memstream (&c->out, &c->out_len);
+      if (!out)
+        {
+          warnln ("open_memstream failed");
+          exit (EXIT_FAILURE);
+        }
+      c->src = (Milexer_Slice){.lazy = true};
+      c->tk = TOKEN_ALLOC (TOKEN_MAX_BUF_LEN);
+      extract_slices (&c->src, &c->tk, c->buf, c->len, out);
+      fclose (out);
+
+      pthread_mutex_lock (&Par.lock);
+      c->done = true;
+      pthread_cond_broadcast (&Par.cond);
+      pthread_mutex_unlock (&Par.lock);
+    }
+}
+
+/**
+ *  Splits @buf into chunks of about KE_CHUNK_SIZE bytes
+ *  Chunks end at slice boundaries, so slices of the serial mode
+ *  are never split between two chunks
+ */
+static void
+par_split (const char *buf, size_t len)
+{
+  size_t chunk = KE_CHUNK_SIZE - KE_CHUNK_SIZE % in_buff_len;
+  if (chunk == 0)
+    chunk = in_buff_len;
+
+  Par.chunks = calloc (len / chunk + 1, sizeof (struct chunk_t));
+  for (size_t off = 0; off < len; off += chunk, ++Par.len)
+    {
+      Par.chunks[Par.len].buf = buf + off;
+      Par.chunks[Par.len].len = (len - off < chunk) ? len - off : chunk;
+    }
+}
+
+/**
+ *  Tokenizes @buf of length @len on @jobs threads
+ *  The output is the same as the serial mode (also -j 1)
+ */
+static int
+par_extract (const char *buf, size_t len)
+{
+  pthread_t *threads = calloc (jobs, sizeof (pthread_t));
+  Milexer_Slice src = {.lazy = true};
+  Milexer_Token tk = TOKEN_ALLOC (TOKEN_MAX_BUF_LEN);
+
+  par_split (buf, len);
+  /* Threads only read @ML after this */
+  ml_compile (&ML);
+  for (int i=0; i < jobs; ++i)
+    pthread_create (&threads[i], NULL, par_worker, NULL);
+
+  /* Write outputs in order */
+  for (size_t i=0; i < Par.len; ++i)
+    {
+      struct chunk_t *c = &Par.chunks[i];
+      pthread_mutex_lock (&Par.lock);
+      while (!c->done)
+        pthread_cond_wait (&Par.cond, &Par.lock);
+      pthread_mutex_unlock (&Par.lock);
+
+      if (ML_IS_CLEAN (&src, &tk))
+        {
+          /* the chunk has started from the right state */
+          fwrite (c->out, 1, c->out_len, out_stream);
+          TOKEN_FREE (&tk);
+          src = c->src;
+          tk = c->tk;
+        }
+      else
+        {
+          /* continue the previous chunk */
+          TOKEN_FREE (&c->tk);
+          extract_slices (&src, &tk, c->buf, c->len, out_stream);
+        }
+      free (c->out);
+
+      pthread_mutex_lock (&Par.lock);
+      Par.written = i + 1;
+      pthread_cond_broadcast (&Par.cond);
+      pthread_mutex_unlock (&Par.lock);
+    }
+  /* The pending token, when the input has no trailing delimiter */
+  END_ML_SLICE (&src);
+  extract (&src, &tk, out_stream);
+
+  for (int i=0; i < jobs; ++i)
+    pthread_join (threads[i], NULL);
+  TOKEN_FREE (&tk);
+  safe_free (Par.chunks);
+  free (threads);
+  return 0;
+}
+
+/**
+ *  Memory maps the input file, for parallel mode
+ *  Returns NULL if it's not a regular file
+ */
+static const char *
+map_input (size_t *len)
+{
+  struct stat st;
+  void *p;
+  int fd = fileno (in_stream);
+  if (fstat (fd, &st) < 0 || !S_ISREG (st.st_mode) || st.st_size == 0)
+    return NULL;
+  p = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (p == MAP_FAILED)
+    return NULL;
+  madvise (p, st.st_size, MADV_SEQUENTIAL);
+  *len = st.st_size;
+  return p;
+}
+
 int
 main (int argc, char **argv)
 {
@@ -507,39 +1171,42 @@ main (int argc, char **argv)
       warnln ("reading from stdin until EOF");
     }
 
+  if ((HAS_FLG (kflags, C_UNIQUE) || top_k > 0 || approx_mem > 0)
+      && uniq_init ())
+    {
+      warnln ("could not initialize the unique mode");
+      return EXIT_FAILURE;
+    }
+
   /* Update the length of delimiter ranges */
   ML.delim_ranges.len = da_sizeof (Extra_Delims);
 
-  int len;
-  for (int ret = 0; !NEXT_SHOULD_END (ret); )
+  if (jobs > 1)
     {
-      ret = ml_next (&ML, &src, &tk, parse_flg);
-      switch (ret)
+      size_t map_len;
+      const char *map = map_input (&map_len);
+      if (map)
         {
-        case NEXT_NEED_LOAD:
-          len = read (fileno (in_stream),
-                      in_buff,
-                      in_buff_len);
-          if (len > 0)
-            SET_ML_SLICE (&src, in_buff, in_buff_len);
-          else
-            END_ML_SLICE (&src);
-          break; 
- 
-        case NEXT_CHUNK:
-          token_out (&tk);
-          break;
-        case NEXT_MATCH:
-        case NEXT_ZTERM:
-          if (token_out (&tk))
-            Outln ();
-          break;
-
-        default:
-          break;
+          ret = par_extract (map, map_len);
+          munmap ((void *) map, map_len);
+          TOKEN_FREE (&tk);
+          return ret;
         }
+      warnln ("input is not a regular file, ignoring -j");
     }
-  
+
+  int len;
+  while (extract (&src, &tk, out_stream) == NEXT_NEED_LOAD)
+    {
+      len = read (fileno (in_stream),
+                  in_buff,
+                  in_buff_len);
+      if (len > 0)
+        SET_ML_SLICE (&src, in_buff, len);
+      else
+        END_ML_SLICE (&src);
+    }
+
   TOKEN_FREE (&tk);
   return 0;
 }
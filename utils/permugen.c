@@ -58,6 +58,21 @@
       - Global suffix and prefix
       $ permugen --pref "www." --suff ".com"
 
+    * To get size of the output and the expected runtime:
+      $ permugen -s "\l \d" -D7 --estimate
+
+    * Range of output (also works in regular mode):
+      $ permugen -s "\l" -d4 --skip 1000 --count 500
+      - To split the output to 3 equal parts, and generate the 2nd part
+      $ permugen -s "\l" -D4 --shard 2/3
+
+    * Multi-threaded generation:
+      $ permugen -s "\l \d" -d6 --threads 8      # unordered output
+      $ permugen -s "\l \d" -d6 --threads 8 --ordered
+      - To write each shard in a separate file (out.0, out.1, ...)
+        concatenation of these files gives the ordered output
+      $ permugen -s "\l \d" -d6 --threads 8 --shard-output out
+
 
   Regular Mode:
     $ permugen [OPTIONS] -r [SEED_CONFIG]...
@@ -130,12 +145,16 @@
 
 
   Compilation:
-    cc -ggdb -O3 -Wall -Wextra -Werror -I../libs \
-       -o permugen permugen.c
+    cc -ggdb -O3 -Wall -Wextra -Werror -I../libs -I../DS \
+       -o permugen permugen.c -lpthread
 
   Options:
     - To skip uniqueness of word seeds
       define `_SKIP_UNIQUE`
+    - Probe length of the word seeds hash table (see DS/hashtab.h)
+      define `WSEED_HT_DL` (default is 8)
+    - Maximum count of words in a seed
+      define `WSEED_MAXCNT` (default is 0, no limit)
     - To skip freeing allocated memory before quitting
       define `_CLEANUP_NO_FREE`
     - To enable printing of debug information
@@ -143,6 +162,12 @@
     - To use buffered IO library (deprecated)
       define `_USE_BIO`
       define `_BMAX="(1024 * 1)"` (=1024 bytes)
+      the multi-threaded mode is not available with this option
+    - Output stream buffer size of each worker thread
+      define `_THREAD_BMAX` (default is 64 KiB)
+    - Output block size of fixed-length lines (see __perm_fixed)
+      define `_FIXED_BMAX` (default is 256 KiB)
+      to disable this method, define `_NO_FIXED_PERM`
  **/
 #undef _GNU_SOURCE
 #define _GNU_SOURCE
@@ -153,6 +178,11 @@
 #include <getopt.h>
 #include <limits.h>
 #include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define PROGRAM_NAME "permugen"
 #define Version "2.25"
@@ -173,11 +203,39 @@
 # define _BMAX 4096
 #endif
 
-/* Maximum count of words in a seed */
+/* Output stream buffer size of each worker thread */
+#ifndef _FIXED_BMAX
+# define _FIXED_BMAX (1 << 18)
+#endif
+
+#ifndef _THREAD_BMAX
+# define _THREAD_BMAX (1 << 16)
+#endif
+
+/* Minimum count of work units per thread (multi-threaded mode) */
+#ifndef THREAD_UNITS
+# define THREAD_UNITS 8
+#endif
+
+/* Count of lines of calibration burst of the estimate mode */
+#ifndef CALIBRATION_LINES
+# define CALIBRATION_LINES (1 << 20)
+#endif
+
+/* Word seeds hash table, initial capacity and delta_l */
+#ifndef WSEED_HT_CAP
+# define WSEED_HT_CAP 64
+#endif
+#ifndef WSEED_HT_DL
+# define WSEED_HT_DL 8
+#endif
+
+/**
+ *  Maximum count of words in a seed, 0 for no limit
+ *  Words beyond it are dropped (with a warning)
+ */
 #ifndef WSEED_MAXCNT
-/* As our dynamic array grows by a factor of 2,
-   it's more efficient for the max count to be a power of 2 */
-# define WSEED_MAXCNT 8192
+# define WSEED_MAXCNT 0
 #endif
 
 #ifndef IS_LINE_COMMENT
@@ -206,6 +264,9 @@ const int sp_padding_len = 32;
  **   - unescape.h:     Handles backslash interpretation
  **   - dyna.h:         Dynamic array implementation
  **   - mini-lexer.h:   Lexer (used for regex parsing)
+ **
+ **  And in `../DS`:
+ **   - hashtab.h:      Hash table (for uniqueness of word seeds)
  **/
 #ifdef _USE_BIO
 #  define BIO_IMPLEMENTATION
@@ -218,6 +279,14 @@ const int sp_padding_len = 32;
 #define DYNA_IMPLEMENTATION
 #include "dyna.h"
 
+#ifndef _SKIP_UNIQUE
+#  ifndef HT_HASHER
+#    define HT_HASHER hash_wy
+#  endif
+#  define HASHTAB_IMPLEMENTATION
+#  include "hashtab.h"
+#endif
+
 #define ML_FLEX
 #define YY_TOKEN_CAP 512  /* lexer token capacity */
 #define ML_IMPLEMENTATION
@@ -318,6 +387,17 @@ const struct option lopts[] =
     {"suffix",           required_argument, NULL, '4'},
     /* Regular mode */
     {"regular",          no_argument,       NULL, 'r'},
+    /* Estimate mode */
+    {"estimate",         no_argument,       NULL, 'Z'},
+    {"dry-run",          no_argument,       NULL, 'Z'},
+    /* Range */
+    {"skip",             required_argument, NULL, 'K'},
+    {"count",            required_argument, NULL, 'M'},
+    {"shard",            required_argument, NULL, 'I'},
+    /* Multi-threaded mode */
+    {"threads",          required_argument, NULL, 'T'},
+    {"ordered",          no_argument,       NULL, 'O'},
+    {"shard-output",     required_argument, NULL, 'P'},
     /* CLI */
     {"format-getline",   no_argument,       NULL, '9'},
     {"fgetline",         no_argument,       NULL, '9'},
@@ -342,10 +422,35 @@ struct Seed
   int cseed_len;
   /* Word seeds, (Dynamic array) */
   char **wseed;
+#ifndef _SKIP_UNIQUE
+  struct wseed_index *windex; /* hash table of @wseed */
+#endif
+  /* Memory mapped word lists (dynamic array)
+     Words of @wseed may point to them */
+  struct wseed_map *maps;
 
   char *pref, *suff;
 };
 
+struct wseed_map
+{
+  char *mem;
+  size_t len;
+};
+
+#ifndef _SKIP_UNIQUE
+/**
+ *  Hash table of word seeds, to check uniqueness in O(1)
+ *  @keys[i] is the key of @wseed[i]  (dynamic array)
+ *  The table grows (rehashes) when there is no empty slot
+ */
+struct wseed_index
+{
+  HashTable ht;
+  struct keytab_t *keys;
+};
+#endif /* _SKIP_UNIQUE */
+
 /* To allocate and free seed and seed array */
 static inline void mk_seed (struct Seed *dst, int c_len, int w_len);
 #define mk_seed_arr(n) da_newn (struct Seed, n)
@@ -409,6 +514,7 @@ struct Opt
   int mode;
   int escape_disabled; /* to disable backslash interpretation */
   int getline_flags;
+  int estimate; /* estimate mode, to only print size of the output */
   struct {
     int min, max;
   } depth;
@@ -424,6 +530,22 @@ struct Opt
   char **seps; /* component separator(s) (dynamic array) */
   char *prefix, *suffix; /* by malloc */
 
+  /* Range of permutations to generate (by rank) */
+  struct {
+    size_t skip;
+    size_t count; /* SIZE_MAX means until the end */
+  } range;
+  struct {
+    size_t idx, n; /* shard number @idx of @n, starting from 1 */
+  } shard;
+
+  /* Multi-threaded mode (only in normal mode) */
+  struct {
+    int count; /* count of worker threads */
+    int ordered; /* to preserve the output order */
+    const char *shard_path; /* path prefix of per-shard files */
+  } threads;
+
   /* Output stream buffer */
 #ifdef _USE_BIO
   BIO_t *bio;
@@ -587,9 +709,15 @@ int cseed_uniappd (struct Seed *dst, const char *src, int len);
  */
 int wseed_uniappd (const struct Opt *opt,
                    struct Seed *dst, const char *str_word);
+/**
+ *  Similar to wseed_uniappd, but appends @word itself (not a copy)
+ *  @word will not be freed by free_seed, if it belongs to @dst->maps
+ */
+static int __wseed_uniappd (struct Seed *dst, char *word);
 /**
  *  Using wseed_uniappd function, appends words from @stream
  *  to the seed @dst, line by line, and ignores commented lines by `#`
+ *  Regular files are memory mapped (see wseed_map_uniappd)
  */
 void wseed_file_uniappd (const struct Opt *opt,
                          struct Seed *dst, FILE *stream);
@@ -697,6 +825,13 @@ OPTIONS:\n\
       -f, --format            output format\n\
           --no-comment        ignore commented lines  while reading from file\n\
           --format-getline    separate words by space while reading from file\n\
+          --estimate          print count of lines and bytes of the output\n\
+                              and the expected runtime, without generating\n\
+          --skip              skip the first K permutations\n\
+          --count             generate at most M permutations\n\
+          --shard             only generate the i'th part of n equal parts\n\
+                              'i/n' where i in [1 to n], after it, skip and\n\
+                              count options apply within that part\n\
       -h, --help              print help and exit\n\
       -v, --version           print version and exit\n\
 \n\
@@ -709,6 +844,10 @@ OPTIONS:\n\
           --max-depth         maximum depth\n\
 \n\
   Only in normal mode:\n\
+          --threads           count of worker threads\n\
+          --ordered           to preserve the output order of threads\n\
+          --shard-output      to write output of each thread to PATH.N\n\
+                              where N is index of the thread from 0\n\
       -S, --seed-path         word seed path\n\
                               pass - to read from stdin\n\
       -s, --seed              to configure global seeds (see ARGUMENTS)\n\
@@ -837,133 +976,962 @@ __fputc (char c, struct Opt *opt, const struct print_info *info)
     }, opt);
 }
 
+/**
+ **  Rank and unrank of permutations
+ **
+ **  Permutations of each block (in normal mode: depth and separator,
+ **  in regular mode: format, window, offset and separator) are
+ **  numbered from 0, as a mixed radix number where the last
+ **  component changes the fastest; The global rank of a permutation
+ **  is it's index in the whole output, including previous blocks.
+ **
+ **  Counts are saturated at SIZE_MAX (instead of overflow)
+ **/
+static inline size_t
+perm_mul (size_t a, size_t b)
+{
+  size_t res;
+  if (__builtin_mul_overflow (a, b, &res))
+    return SIZE_MAX;
+  return res;
+}
+
+static inline size_t
+perm_add (size_t a, size_t b)
+{
+  size_t res;
+  if (__builtin_add_overflow (a, b, &res))
+    return SIZE_MAX;
+  return res;
+}
+
+/* Normal mode, count of permutations of a block: @base ^ @depth */
+static inline size_t
+perm_count (size_t base, int depth)
+{
+  size_t res = 1;
+  for (int i=0; i < depth; ++i)
+    res = perm_mul (res, base);
+  return res;
+}
+
+/**
+ *  Normal mode, converts @idxs[@depth] to rank (and vice versa)
+ *  @base: total count of seeds (characters and words)
+ */
+static inline size_t
+perm_rank (const int *idxs, int base, int depth)
+{
+  size_t rank = 0;
+  for (int i=0; i < depth; ++i)
+    rank = perm_add (perm_mul (rank, base), idxs[i]);
+  return rank;
+}
+
+static inline void
+perm_unrank (size_t rank, int base, int *idxs, int depth)
+{
+  for (int i = depth - 1; i >= 0; --i, rank /= base)
+    idxs[i] = rank % base;
+}
+
+/**
+ *  Regular mode, similar to the normal mode functions
+ *  @lens[i] + 1  is the radix of the i'th component
+ *  (see the @lens parameter of __regular_perm)
+ */
+static inline size_t
+regular_perm_count (const int *lens, int size)
+{
+  size_t res = 1;
+  for (int i=0; i < size; ++i)
+    res = perm_mul (res, lens[i] + 1);
+  return res;
+}
+
+static inline void
+regular_perm_unrank (size_t rank, const int *lens, int *idxs, int size)
+{
+  for (int i = size - 1; i >= 0; --i)
+    {
+      idxs[i] = rank % (lens[i] + 1);
+      rank /= lens[i] + 1;
+    }
+}
+
+/**
+ **  Output size estimator
+ **
+ **  Each component of output lines, only depends on a single index
+ **  of the permutation (the index itself, or the referenced one by
+ **  a shallow seed in regular mode), so the total bytes of the first
+ **  @r permutations of a block are calculated by counting how many
+ **  times each index value occurs, without generating them.
+ **/
+struct perm_estimate
+{
+  size_t skip, count; /* the range to estimate (by rank) */
+  size_t lines, bytes; /* results (saturated at SIZE_MAX) */
+};
+
+struct est_comp
+{
+  int src; /* the index which determines this component */
+  const int *lens; /* length of the component, for each value of @src */
+};
+
+struct est_block
+{
+  int size; /* count of components and indexes */
+  const int *radix; /* radix of each index, (lens[i] + 1 in regular mode) */
+  size_t line; /* constant bytes of each line */
+  const struct est_comp *comps;
+};
+
+/* Total bytes of the first @r permutations of block @blk */
+static size_t
+est_bytes (const struct est_block *blk, size_t r)
+{
+  size_t bytes = perm_mul (r, blk->line);
+  for (int i=0; i < blk->size; ++i)
+    {
+      const struct est_comp *c = &blk->comps[i];
+      size_t radix = blk->radix[c->src];
+      /* Each value of @src repeats @period times, in cycles */
+      size_t period = 1;
+      for (int j = c->src + 1; j < blk->size; ++j)
+        period = perm_mul (period, blk->radix[j]);
+      size_t cycle = perm_mul (period, radix);
+      size_t full = r / cycle, rem = r % cycle;
+      size_t q = rem / period;
+
+      size_t sum = 0;
+      for (size_t v=0; v < radix; ++v)
+        sum = perm_add (sum, c->lens[v]);
+      bytes = perm_add (bytes, perm_mul (perm_mul (full, period), sum));
+      for (size_t v=0; v < q; ++v)
+        bytes = perm_add (bytes, perm_mul (period, c->lens[v]));
+      if (q < radix)
+        bytes = perm_add (bytes, perm_mul (rem % period, c->lens[q]));
+    }
+  return bytes;
+}
+
+/**
+ *  Adds the intersection of @est->range and a block to @est
+ *  @rank: global rank of the first permutation of the block
+ *  @count: count of permutations of the block
+ */
+static void
+est_add_block (struct perm_estimate *est, const struct est_block *blk,
+               size_t rank, size_t count)
+{
+  size_t from = MAX (rank, est->skip);
+  size_t to = MIN (perm_add (rank, count), perm_add (est->skip, est->count));
+  if (from >= to)
+    return;
+  est->lines = perm_add (est->lines, to - from);
+  est->bytes = perm_add (est->bytes,
+                         est_bytes (blk, to - rank) -
+                         est_bytes (blk, from - rank));
+}
+
+/**
+ **  Component table of normal mode
+ **
+ **  All components of the output lines are measured once before
+ **  generation, and stored in a flat buffer (@mem) as:
+ **    mid[i]:   the i'th seed followed by the separator
+ **    last[i]:  the i'th seed followed by the suffixes and newline
+ **    head:     prefix of the lines (global prefix and seed prefix)
+ **
+ **  Thus, each output line is:  head, mid[...] x (depth-1), last[.]
+ **  and only the changed components of the previous line need to be
+ **  updated, which for the most of lines is only the last component
+ **/
+struct perm_comp
+{
+  const char *str;
+  int len;
+};
+
+struct perm_table
+{
+  int base; /* count of seeds (character and word seeds) */
+  struct perm_comp head;
+  struct perm_comp *mid, *last; /* arrays of length @base */
+  int mid_max, last_max; /* maximum length of @mid and @last */
+  /* All the seeds have the same length, so lines have fixed length */
+  bool fixed;
+  char *mem;
+};
+
+static inline int
+safe_strlen (const char *_Nullable str)
+{
+  return (str) ? (int) strlen (str) : 0;
+}
+
+static inline char *
+perm_table_put (char *dst, const char *_Nullable src, int len)
+{
+  if (len > 0)
+    memcpy (dst, src, len);
+  return dst + len;
+}
+
+/* Builds @tab for the separator @sep (nullable) */
+static void
+perm_table_build (struct perm_table *tab, const struct Opt *opt,
+                  const char *_Nullable sep)
+{
+  const struct Seed *s = opt->seeds;
+  int wlen = (int) da_sizeof (s->wseed);
+  int sep_len = safe_strlen (sep);
+  int pref_len = safe_strlen (opt->prefix);
+  int spref_len = safe_strlen (s->pref);
+  int ssuff_len = safe_strlen (s->suff);
+  int suff_len = safe_strlen (opt->suffix);
+  int tail_len = ssuff_len + suff_len + 1; /* suffixes and newline */
+
+  tab->base = s->cseed_len + wlen;
+  tab->mid = malloc (2 * tab->base * sizeof (struct perm_comp));
+  tab->last = tab->mid + tab->base;
+
+  /* Measuring seeds, the @last array is used as temporary buffer */
+  size_t total = pref_len + spref_len;
+  for (int i=0; i < tab->base; ++i)
+    {
+      if (i < s->cseed_len)
+        tab->last[i] = (struct perm_comp){ .str = &s->cseed[i], .len = 1 };
+      else
+        {
+          const char *w = s->wseed[i - s->cseed_len];
+          tab->last[i] = (struct perm_comp){ .str = w, .len = strlen (w) };
+        }
+      total += 2 * tab->last[i].len + sep_len + tail_len;
+    }
+
+  char *p = tab->mem = malloc (total);
+  tab->head.str = p;
+  p = perm_table_put (p, opt->prefix, pref_len);
+  p = perm_table_put (p, s->pref, spref_len);
+  tab->head.len = p - tab->head.str;
+
+  tab->mid_max = tab->last_max = 0;
+  tab->fixed = true;
+  int seed_len = (tab->base > 0) ? tab->last[0].len : 0;
+  for (int i=0; i < tab->base; ++i)
+    {
+      struct perm_comp seed = tab->last[i];
+      if (seed.len != seed_len)
+        tab->fixed = false;
+      struct perm_comp *c = &tab->mid[i];
+      c->str = p;
+      p = perm_table_put (p, seed.str, seed.len);
+      p = perm_table_put (p, sep, sep_len);
+      c->len = p - c->str;
+      tab->mid_max = MAX (tab->mid_max, c->len);
+
+      c = &tab->last[i];
+      c->str = p;
+      p = perm_table_put (p, seed.str, seed.len);
+      p = perm_table_put (p, s->suff, ssuff_len);
+      p = perm_table_put (p, opt->suffix, suff_len);
+      *(p++) = '\n';
+      c->len = p - c->str;
+      tab->last_max = MAX (tab->last_max, c->len);
+    }
+}
+
+static inline void
+perm_table_free (struct perm_table *tab)
+{
+  safe_free (tab->mid);
+  safe_free (tab->mem);
+}
+
+/* Builds tables of all separators of @opt, (array of length seps) */
+static struct perm_table *
+perm_tables_new (const struct Opt *opt)
+{
+  ssize_t seps_len = da_sizeof (opt->seps);
+  struct perm_table *tabs = malloc (seps_len * sizeof (struct perm_table));
+  for (ssize_t i=0; i < seps_len; ++i)
+    perm_table_build (&tabs[i], opt, opt->seps[i]);
+  return tabs;
+}
+
+static inline void
+perm_tables_free (const struct Opt *opt, struct perm_table *tabs)
+{
+  for (ssize_t i=0; i < da_sizeof (opt->seps); ++i)
+    perm_table_free (&tabs[i]);
+  safe_free (tabs);
+}
+
+#ifndef _NO_FIXED_PERM
+/**
+ *  Normal mode, for fixed-length lines (@tab->fixed)
+ *  Lines are laid out with a fixed stride, in blocks of cycles of
+ *  the last component; the last components of the block are written
+ *  once, and  in each cycle, only the bytes of the components that
+ *  have changed since the previous block, are patched
+ *  So it's almost one store per line, plus one write per block
+ *
+ *  It only generates full cycles; @idxs[depth-1] must be zero
+ *  and @count is decremented by the count of generated lines
+ * Return:
+ *   1 when the end of permutations is reached, otherwise 0
+ */
+static int
+__perm_fixed (const struct Opt *opt, const struct perm_table *tab,
+              int *idxs, int depth, size_t *count)
+{
+  int end = 0;
+  const int base = tab->base;
+  const int mid_len = tab->mid[0].len, last_len = tab->last[0].len;
+  /* length of lines, and the offset of the last component */
+  const int pref_len = tab->head.len + (depth - 1) * mid_len;
+  const size_t line_len = pref_len + last_len;
+  const size_t cycle_len = base * line_len;
+
+  size_t cycles = *count / base;
+  if (0 == cycles)
+    return 0;
+  /**
+   *  Count of cycles in @block, a multiple of base^m, so from one
+   *  block to the next, the lower m components of each cycle slot
+   *  remain unchanged, and usually only one component changes
+   */
+  size_t slots = MAX (1, _FIXED_BMAX / cycle_len), unit = 1;
+  while (base > 1 && unit <= slots / base)
+    unit *= base;
+  slots = MIN (slots - slots % unit, cycles);
+
+  char *block = malloc (slots * cycle_len);
+  char *pref = malloc (pref_len + 1);
+  /* The idxs of the each cycle slot of @block, -1 means empty */
+  int *stored = malloc (slots * depth * sizeof (int));
+  memset (stored, 0xFF, slots * depth * sizeof (int));
+
+  for (size_t j=0; j < slots * base; ++j)
+    memcpy (block + j * line_len + pref_len,
+            tab->last[j % base].str, last_len);
+
+  while (cycles > 0)
+    {
+      size_t n = MIN (slots, cycles);
+      for (size_t r=0; r < n; ++r)
+        {
+          char *cycle = block + r * cycle_len;
+          int *st = stored + r * depth;
+
+          int pos = 0;
+          while (pos < depth - 1 && st[pos] == idxs[pos])
+            ++pos;
+          int off = (st[0] < 0) ? 0 : tab->head.len + pos * mid_len;
+          if (off < pref_len)
+            {
+              memcpy (pref, tab->head.str, tab->head.len);
+              for (int i = pos; i < depth - 1; ++i)
+                memcpy (pref + tab->head.len + i * mid_len,
+                        tab->mid[idxs[i]].str, mid_len);
+              /* Column by column, to avoid a memcpy call per line */
+              for (int k = off; k < pref_len; ++k)
+                {
+                  char *col = cycle + k;
+                  for (int i=0; i < base; ++i, col += line_len)
+                    *col = pref[k];
+                }
+            }
+          memcpy (st, idxs, depth * sizeof (int));
+
+          /* The next cycle, idxs[depth-1] stays zero */
+          for (pos = depth - 2; pos >= 0 && idxs[pos] == base - 1; pos--)
+            idxs[pos] = 0;
+          if (pos < 0)
+            {
+              end = 1;
+              n = r + 1;
+              break;
+            }
+          idxs[pos]++;
+        }
+
+      Fwrite (block, n * cycle_len, opt);
+      cycles -= n;
+      *count -= n * base;
+      if (end)
+        break;
+    }
+
+  safe_free (block);
+  safe_free (pref);
+  safe_free (stored);
+  return end;
+}
+#endif /* _NO_FIXED_PERM */
+
 /**
  *  The main logic of normal mode
  *  It should be called in a loop with @depth in [min_depth, max_depth]
- *  @idxs: a temporary buffer with capacity of @depth
+ *  @tab: component table of the separator (see perm_table_build)
+ *  @idxs: the first permutation to generate, with capacity of @depth
+ *         (all zero, to start from the beginning of permutations)
+ *  @count: maximum count of permutations to generate
  */
 static int
-__perm (const struct Opt *opt, const char *sep,
-        int *idxs, int depth)
+__perm (const struct Opt *opt, const struct perm_table *tab,
+        int *idxs, int depth, size_t count)
 {
-  int _max_depth = opt->seeds->cseed_len - 1 +
-    (int) da_sizeof (opt->seeds->wseed);
-  memset (idxs, 0, depth * sizeof (int));
-
-  int i;
+  int ret = 0;
+  int _max_depth = tab->base - 1;
+  /* @offs[i] is offset of the i'th component in @line */
+  int *offs = malloc (depth * sizeof (int));
+  int line_max = tab->head.len + (depth - 1) * tab->mid_max + tab->last_max;
+  char *line = malloc (line_max);
+  /* Lines are collected in @block, to be written at once */
+  int block_cap = MAX (_BMAX, line_max), block_len = 0;
+  char *block = malloc (block_cap);
+
+  memcpy (line, tab->head.str, tab->head.len);
+  offs[0] = tab->head.len;
+
+  int pos = 0; /* the first changed component */
+  const struct perm_comp *c;
+#ifndef _NO_FIXED_PERM
+  if (tab->fixed && 0 == idxs[depth - 1])
+    goto fixed_perm;
+#endif
  perm_loop: /* O(seeds^depth) */
-  i = 0;
-  if (opt->prefix)
-    Fputs (opt->prefix, opt);
-  if (opt->seeds->pref)
-    Fputs (opt->seeds->pref, opt);
-
-  struct Seed *s = opt->seeds;
- print_loop: /* O(depth) */
+  for (; pos < depth - 1; ++pos) /* O(depth), usually zero times */
+    {
+      c = &tab->mid[idxs[pos]];
+      memcpy (line + offs[pos], c->str, c->len);
+      offs[pos + 1] = offs[pos] + c->len;
+    }
+  c = &tab->last[idxs[depth - 1]];
+  memcpy (line + offs[depth - 1], c->str, c->len);
   {
-    int idx = idxs[i];
-    if (idx < opt->seeds->cseed_len)
-      {
-        /* range of character seeds */
-        Putc (s->cseed[idx], opt);
-      }
-    else
+    int line_len = offs[depth - 1] + c->len;
+    if (__unlikely (block_len + line_len > block_cap))
       {
-        /* range of word seeds */
-        idx -= opt->seeds->cseed_len;
-        Fputs (s->wseed[idx], opt);
+        Fwrite (block, block_len, opt);
+        block_len = 0;
       }
-    i++;
+    memcpy (block + block_len, line, line_len);
+    block_len += line_len;
   }
-  if (__likely (i < depth))
-    {
-      if (sep)
-        Fputs (sep, opt);
-      goto print_loop;
-    }
-
-  /* End of printing of the current permutation */
-  if (opt->seeds->suff)
-    Fputs (opt->seeds->suff, opt);
-  if (opt->suffix)
-    Puts (opt->suffix, opt);
-  else
-    Putln (opt);
 
+  if (__unlikely (--count == 0))
+    goto end_of_perm;
 
-  int pos;
   for (pos = depth - 1; pos >= 0 && idxs[pos] == _max_depth; pos--)
     idxs[pos] = 0;
 
-  if (__unlikely (pos < 0)) /* End of Permutations */
+  if (__likely (pos >= 0))
     {
+      idxs[pos]++;
+#ifndef _NO_FIXED_PERM
+      if (__unlikely (tab->fixed && pos < depth - 1))
+        {
+        fixed_perm:
+          if (count >= (size_t) tab->base)
+            {
+              if (block_len > 0)
+                Fwrite (block, block_len, opt);
+              block_len = 0;
+              if (__perm_fixed (opt, tab, idxs, depth, &count))
+                goto end_of_perm;
+              if (0 == count)
+                goto end_of_perm;
+            }
+          pos = 0;
+        }
+#endif /* _NO_FIXED_PERM */
+      goto perm_loop;
+    }
+
+ end_of_perm: /* End of Permutations */
+  if (block_len > 0)
+    Fwrite (block, block_len, opt);
 #ifdef _USE_BIO
-      if (bio_err (opt->bio)) /* buffered_io write error */
-        return bio_errno (opt->bio);
-      else
-        return 0;
-#else
-      return 0;
+  if (bio_err (opt->bio)) /* buffered_io write error */
+    ret = bio_errno (opt->bio);
 #endif /* _USE_BIO */
+  safe_free (offs);
+  safe_free (line);
+  safe_free (block);
+  return ret;
+}
+
+/* Normal mode, estimates the output within @est->range */
+void
+perm_estimate (const struct Opt *opt, struct perm_estimate *est)
+{
+  ssize_t seps_len = da_sizeof (opt->seps);
+  int depth = opt->depth.max;
+  int *radix = malloc (depth * sizeof (int));
+  struct est_comp *comps = malloc (depth * sizeof (struct est_comp));
+
+  est->lines = est->bytes = 0;
+  for (ssize_t i=0; i < seps_len; ++i)
+    {
+      struct perm_table tab;
+      perm_table_build (&tab, opt, opt->seps[i]);
+      int *lens = malloc (2 * tab.base * sizeof (int));
+      for (int v=0; v < tab.base; ++v)
+        {
+          lens[v] = tab.mid[v].len;
+          lens[tab.base + v] = tab.last[v].len;
+        }
+      for (int j=0; j < depth; ++j)
+        {
+          radix[j] = tab.base;
+          comps[j].src = j;
+          comps[j].lens = lens;
+        }
+
+      /* Blocks of this separator are not contiguous (see `perm`) */
+      size_t sep_rank = 0;
+      for (int dep = opt->depth.min; dep <= opt->depth.max; ++dep)
+        {
+          struct est_block blk = {
+            .size = dep, .radix = radix, .line = tab.head.len,
+            .comps = comps,
+          };
+          comps[dep - 1].lens = lens + tab.base; /* the last component */
+          size_t block = perm_count (tab.base, dep);
+          est_add_block (est, &blk, perm_add (sep_rank,
+                                              perm_mul (i, block)), block);
+          comps[dep - 1].lens = lens;
+          sep_rank = perm_add (sep_rank, perm_mul (seps_len, block));
+        }
+      safe_free (lens);
+      perm_table_free (&tab);
     }
+  safe_free (radix);
+  safe_free (comps);
+}
 
-  idxs[pos]++;
-  goto perm_loop;
+/* Normal mode, total count of permutations */
+size_t
+perm_total (const struct Opt *opt)
+{
+  struct perm_estimate est = { .skip = 0, .count = SIZE_MAX };
+  perm_estimate (opt, &est);
+  return est.lines;
 }
 
 int
 perm (const struct Opt *opt)
 {
+  int ret = 0;
   ssize_t seps_len = da_sizeof (opt->seps);
+  int base = opt->seeds->cseed_len + (int) da_sizeof (opt->seeds->wseed);
   int *tmp = (int *) calloc (opt->depth.max, sizeof (int));
+  size_t skip = opt->range.skip, count = opt->range.count;
+  struct perm_table *tabs = perm_tables_new (opt);
 
   for (int dep = opt->depth.min; dep <= opt->depth.max; ++dep)
     {
-      for (ssize_t i=0; i < seps_len; ++i)
+      size_t block = perm_count (base, dep);
+      for (ssize_t i=0; i < seps_len && count > 0; ++i)
         {
-          int ret = __perm (opt, opt->seps[i], tmp, dep);
+          if (skip >= block)
+            {
+              skip -= block;
+              continue;
+            }
+          size_t n = MIN (block - skip, count);
+          perm_unrank (skip, base, tmp, dep);
+          skip = 0;
+
+          ret = __perm (opt, &tabs[i], tmp, dep, n);
           if (__unlikely (0 != ret))
-            return ret;
+            goto perm_return;
+          count -= n;
         }
     }
+
+ perm_return:
+  perm_tables_free (opt, tabs);
   safe_free (tmp);
-  return 0;
+  return ret;
 }
 
+#ifndef _USE_BIO
 /**
- *  The main logic of regular mode
- *  It should be called by the `regular_perm` function
- *
- *  @size and @offset are used for handling depth
- *  @lens and @idxs both have size @size
- *  @idxs: temporary buffer for internal use of this function
- *  @lens: total length of ea                ch regular seed:
- *         lens[i] = len(s[i]->cssed) + len(s[i]->wseed)
- */
-int
-__regular_perm (struct Opt *opt,
-                const int *lens, int *idxs,
-                int size, int offset, const char *sep)
+ **  Multi-threaded mode of normal mode
+ **
+ **  Permutations of each (depth, separator) pair are split into
+ **  units, by the leading components of them (their first @fixed
+ **  components); units of all pairs are numbered globally in the
+ **  same order that the `perm` function generates them.
+ **
+ **  Worker threads generate units into their own output stream
+ **  (a stdio stream with a _THREAD_BMAX bytes buffer), thus the only
+ **  shared states are: the unit dispenser and the output lock.
+ **
+ **  Unordered:  workers take the next unit from the dispenser and
+ **              write complete lines to the output, in any order
+ **  Ordered:    the same, but writing of unit N waits until
+ **              unit N-1 is completely written
+ **  Sharded:    each worker takes a contiguous range of units, and
+ **              writes them to its own file (`--shard-output`)
+ **/
+struct perm_job
 {
-  int ret;
-  /* permutation indexes */
-  memset (idxs, 0, size * sizeof (typeof (*idxs)));
-  /* Offset of @depths also must apply to seeds */
-  lens += offset;
-  struct Seed *reg_seeds = &opt->seeds[offset];
+  int depth;
+  int fixed; /* count of components fixed by the unit index */
+  const struct perm_table *tab;
+  size_t units; /* count of units = base^fixed */
+  size_t unit_size; /* count of permutations of each unit */
+  size_t first; /* global index of the first unit */
+  size_t rank; /* global rank of the first permutation */
+};
 
-  /**
-   *  O(S_m * ... * S_n)
-   *  where: S_i = @lens[i], for i in [m to n], and
-   *         m = @offset  and  n = @size + @offset
-   */
-  int i;
- reg_perm_loop:
-  i = 0;
-  struct Fmt *current_fmt;
-  struct Seed *current_seed;
-  if (opt->prefix)
-    Fputs (opt->prefix, opt);
+struct perm_pool
+{
+  const struct Opt *opt;
+  struct perm_job *jobs; /* dynamic array */
+  size_t total; /* total count of units */
+
+  size_t next; /* the unit dispenser (atomic) */
+  size_t turn; /* ordered mode: the unit allowed to write */
+  int outfd;
+  int err; /* the first write error (errno) */
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+};
+
+struct perm_worker
+{
+  int id;
+  pthread_t th;
+  struct perm_pool *pool;
+  struct Opt opt; /* a copy of the main opt with private @outf */
+  size_t unit; /* the current unit */
+  char *carry; /* unordered mode: the last incomplete line (dyna) */
+  char *buff; /* @opt.outf buffer */
+};
+
+static int
+write_all (int fd, const char *buf, size_t len)
+{
+  while (len > 0)
+    {
+      ssize_t w = write (fd, buf, len);
+      if (w < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          return errno;
+        }
+      buf += w;
+      len -= w;
+    }
+  return 0;
+}
+
+static inline void
+pool_set_error (struct perm_pool *pool, int err)
+{
+  pthread_mutex_lock (&pool->lock);
+  if (0 == pool->err)
+    pool->err = err;
+  pthread_mutex_unlock (&pool->lock);
+}
+
+/**
+ *  Write function of the output stream of workers
+ *  (fopencookie, see the perm_worker_stream function)
+ */
+static ssize_t
+perm_worker_write (void *cookie, const char *buf, size_t size)
+{
+  struct perm_worker *w = (struct perm_worker *) cookie;
+  struct perm_pool *pool = w->pool;
+  int ret = 0;
+
+  if (w->pool->opt->threads.ordered)
+    {
+      pthread_mutex_lock (&pool->lock);
+      while (pool->turn != w->unit && 0 == pool->err)
+        pthread_cond_wait (&pool->cond, &pool->lock);
+      pthread_mutex_unlock (&pool->lock);
+      /* Only the owner of the turn writes, holding the lock is not needed */
+      ret = write_all (pool->outfd, buf, size);
+    }
+  else
+    {
+      /* Only complete lines must be written, keep the last line */
+      const char *nl = memrchr (buf, '\n', size);
+      if (NULL == nl)
+        {
+          da_appd_arr (w->carry, buf, size);
+          return size;
+        }
+      size_t n = nl - buf + 1;
+
+      pthread_mutex_lock (&pool->lock);
+      if (da_sizeof (w->carry) > 0)
+        ret = write_all (pool->outfd, w->carry, da_sizeof (w->carry));
+      if (0 == ret)
+        ret = write_all (pool->outfd, buf, n);
+      pthread_mutex_unlock (&pool->lock);
+
+      da_drop (w->carry);
+      if (n < size)
+        da_appd_arr (w->carry, nl + 1, size - n);
+    }
+
+  if (ret != 0)
+    {
+      pool_set_error (pool, ret);
+      return -1;
+    }
+  return size;
+}
+
+static FILE *
+perm_worker_stream (struct perm_worker *w)
+{
+  const struct Opt *opt = w->pool->opt;
+  FILE *stream;
+  if (opt->threads.shard_path)
+    {
+      snprintf (w->buff, _THREAD_BMAX, "%s.%d",
+                opt->threads.shard_path, w->id);
+      stream = safe_fopen (w->buff, "w");
+    }
+  else
+    {
+      cookie_io_functions_t io = { .write = perm_worker_write };
+      stream = fopencookie (w, "w", io);
+    }
+
+  if (stream && !!setvbuf (stream, w->buff, _IOFBF, _THREAD_BMAX))
+    warnln ("failed to set buffer for thread #%d", w->id);
+  return stream;
+}
+
+/* Ordered mode: waits for the turn of @w->unit and passes it */
+static void
+perm_worker_pass_turn (struct perm_worker *w)
+{
+  struct perm_pool *pool = w->pool;
+  fflush (w->opt.outf);
+
+  pthread_mutex_lock (&pool->lock);
+  while (pool->turn != w->unit && 0 == pool->err)
+    pthread_cond_wait (&pool->cond, &pool->lock);
+  pool->turn++;
+  pthread_cond_broadcast (&pool->cond);
+  pthread_mutex_unlock (&pool->lock);
+}
+
+/**
+ *  Generates unit @u of the pool
+ *  @idxs: a temporary buffer with capacity of the maximum depth
+ */
+static int
+perm_worker_unit (struct perm_worker *w, int *idxs, size_t u)
+{
+  struct perm_pool *pool = w->pool;
+  const struct perm_job *job = pool->jobs;
+  int base = pool->opt->seeds->cseed_len +
+    (int) da_sizeof (pool->opt->seeds->wseed);
+
+  while (u >= job->first + job->units)
+    job++;
+
+  /* Intersection of the unit and the range option */
+  size_t skip = pool->opt->range.skip;
+  size_t end = perm_add (skip, pool->opt->range.count);
+  size_t from = perm_add (job->rank, perm_mul (u - job->first,
+                                               job->unit_size));
+  size_t to = perm_add (from, job->unit_size);
+  from = MAX (from, skip);
+  to = MIN (to, end);
+  if (from >= to)
+    return 0;
+
+  perm_unrank (from - job->rank, base, idxs, job->depth);
+  return __perm (&w->opt, job->tab, idxs, job->depth, to - from);
+}
+
+static void *
+perm_worker_main (void *arg)
+{
+  struct perm_worker *w = (struct perm_worker *) arg;
+  struct perm_pool *pool = w->pool;
+  const struct Opt *opt = pool->opt;
+  int *idxs = (int *) calloc (opt->depth.max, sizeof (int));
+  size_t u, end;
+
+  if (opt->threads.shard_path)
+    {
+      /* contiguous range of units */
+      u = pool->total * w->id / opt->threads.count;
+      end = pool->total * (w->id + 1) / opt->threads.count;
+    }
+  else
+    {
+      u = __atomic_fetch_add (&pool->next, 1, __ATOMIC_RELAXED);
+      end = pool->total;
+    }
+
+  while (u < end && 0 == __atomic_load_n (&pool->err, __ATOMIC_RELAXED))
+    {
+      w->unit = u;
+      perm_worker_unit (w, idxs, u);
+      if (ferror (w->opt.outf))
+        {
+          pool_set_error (pool, errno ? errno : EIO);
+          break;
+        }
+      if (opt->threads.ordered)
+        perm_worker_pass_turn (w);
+
+      if (opt->threads.shard_path)
+        u++;
+      else
+        u = __atomic_fetch_add (&pool->next, 1, __ATOMIC_RELAXED);
+    }
+
+  if (opt->threads.ordered && 0 != pool->err)
+    {
+      /* Wake up the others, so they can see the error */
+      pthread_mutex_lock (&pool->lock);
+      pthread_cond_broadcast (&pool->cond);
+      pthread_mutex_unlock (&pool->lock);
+    }
+
+  safe_free (idxs);
+  return NULL;
+}
+
+/**
+ *  Multi-threaded version of the `perm` function
+ *  Returns 0 on success, or the errno of the first write error
+ */
+int
+perm_threaded (const struct Opt *opt)
+{
+  int ret = 0, count = opt->threads.count;
+  ssize_t seps_len = da_sizeof (opt->seps);
+  size_t base = opt->seeds->cseed_len + da_sizeof (opt->seeds->wseed);
+  struct perm_table *tabs = perm_tables_new (opt);
+
+  struct perm_pool pool = {
+    .opt = opt,
+    .outfd = fileno (opt->outf),
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+  };
+
+  /* Each job is split into at least THREAD_UNITS units per thread */
+  size_t rank = 0;
+  for (int dep = opt->depth.min; dep <= opt->depth.max; ++dep)
+    {
+      struct perm_job job = { .depth = dep, .units = 1 };
+      while (job.fixed < dep && job.units < (size_t)count * THREAD_UNITS)
+        {
+          job.fixed++;
+          job.units *= base;
+        }
+      job.unit_size = perm_count (base, dep - job.fixed);
+      for (ssize_t i=0; i < seps_len; ++i)
+        {
+          job.tab = &tabs[i];
+          job.first = pool.total;
+          job.rank = rank;
+          pool.total += job.units;
+          rank = perm_add (rank, perm_mul (job.units, job.unit_size));
+          da_appd (pool.jobs, job);
+        }
+    }
+  dprintf ("* threads: %d, units: %lu\n", count, pool.total);
+
+  /* Workers write directly to the output file descriptor */
+  fflush (opt->outf);
+  struct perm_worker *workers = calloc (count, sizeof (struct perm_worker));
+  for (int i=0; i < count; ++i)
+    {
+      struct perm_worker *w = &workers[i];
+      w->id = i;
+      w->pool = &pool;
+      w->opt = *opt;
+      w->buff = malloc (_THREAD_BMAX);
+      if (! (w->opt.outf = perm_worker_stream (w)))
+        {
+          ret = (errno) ? errno : EIO;
+          count = i;
+          break;
+        }
+    }
+
+  if (0 == ret)
+    {
+      for (int i=0; i < count; ++i)
+        pthread_create (&workers[i].th, NULL, perm_worker_main, &workers[i]);
+      for (int i=0; i < count; ++i)
+        pthread_join (workers[i].th, NULL);
+    }
+
+  for (int i=0; i < count; ++i)
+    {
+      safe_fclose (workers[i].opt.outf);
+      safe_free (workers[i].buff);
+      da_free (workers[i].carry);
+    }
+  safe_free (workers);
+  da_free (pool.jobs);
+  perm_tables_free (opt, tabs);
+
+  if (0 == ret)
+    ret = pool.err;
+  if (0 != ret)
+    warnln ("write failed -- %s", strerror (ret));
+  return ret;
+}
+#endif /* _USE_BIO */
+
+/**
+ *  The main logic of regular mode
+ *  It should be called by the `regular_perm` function
+ *
+ *  @size and @offset are used for handling depth
+ *  @lens and @idxs both have size @size
+ *  @idxs: the first permutation to generate (see regular_perm_unrank)
+ *  @lens: total length of each regular seed:
+ *         lens[i] = len(s[i]->cssed) + len(s[i]->wseed)
+ *  @count: maximum count of permutations to generate
+ */
+int
+__regular_perm (struct Opt *opt,
+                const int *lens, int *idxs,
+                int size, int offset, const char *sep, size_t count)
+{
+  int ret;
+  /* Offset of @depths also must apply to seeds */
+  lens += offset;
+  struct Seed *reg_seeds = &opt->seeds[offset];
+
+  /**
+   *  O(S_m * ... * S_n)
+   *  where: S_i = @lens[i], for i in [m to n], and
+   *         m = @offset  and  n = @size + @offset
+   */
+  int i;
+ reg_perm_loop:
+  i = 0;
+  struct Fmt *current_fmt;
+  struct Seed *current_seed;
+  if (opt->prefix)
+    Fputs (opt->prefix, opt);
 
  print_loop: /* O(S_i) */
   {
@@ -1025,12 +1993,16 @@ __regular_perm (struct Opt *opt,
   else
     Putln (opt);
 
+  if (__unlikely (--count == 0))
+    goto end_of_perm;
+
   int pos;
   for (pos = size - 1; pos >= 0 && idxs[pos] == lens[pos]; --pos)
     idxs[pos] = 0;
 
   if (__unlikely (pos < 0)) /* End of Permutations */
     {
+    end_of_perm:
 #ifdef _USE_BIO
       if (bio_err (opt->bio))
         {
@@ -1056,15 +2028,93 @@ __regular_perm (struct Opt *opt,
   return ret;
 }
 
-int
-regular_perm (struct Opt *opt)
+/* Length of the seed @s entry @idx, padded by @padding */
+static inline int
+regular_seed_len (const struct Seed *s, int idx, int padding)
+{
+  int len = 0;
+  if (idx < s->cseed_len)
+    len = 1;
+  else if (idx - s->cseed_len < (int) da_sizeof (s->wseed))
+    len = strlen (s->wseed[idx - s->cseed_len]);
+  return MAX (len, abs (padding));
+}
+
+/**
+ *  Regular mode, estimates the block: @size, @offset, @sep of
+ *  __regular_perm, with formats @fmts (see __regular_perm)
+ */
+static void
+regular_est_block (const struct Opt *opt, struct perm_estimate *est,
+                   const struct Fmt *fmts, const int *lens,
+                   int size, int offset, const char *sep,
+                   size_t rank, size_t count)
+{
+  int sep_len = safe_strlen (sep);
+  int *radix = malloc (size * sizeof (int));
+  struct est_comp *comps = malloc (size * sizeof (struct est_comp));
+  struct est_block blk = {
+    .size = size, .radix = radix, .comps = comps,
+    .line = safe_strlen (opt->prefix) + safe_strlen (opt->suffix) + 1,
+  };
+
+  lens += offset;
+  for (int i=0; i < size; ++i)
+    radix[i] = lens[i] + 1;
+  for (int i=0; i < size; ++i)
+    {
+      const struct Seed *cur = &opt->seeds[offset + i], *s = cur;
+      const struct Fmt *fmt = &fmts[i];
+      int src = i, constant = 0;
+
+      /* Similar to the print loop of __regular_perm */
+      if (cur->seed_type > 0)
+        {
+          s = &opt->seeds[cur->seed_type - 1];
+          if (cur->seed_type - 1 < size)
+            src = cur->seed_type - 1;
+        }
+      if (NULL_REF_SEED != cur->seed_type)
+        constant += safe_strlen (fmt->pref) + safe_strlen (cur->pref);
+      constant += safe_strlen (cur->suff) + safe_strlen (fmt->suff);
+      if (i + 1 < size && (!cur->suff || *cur->suff == '\0'))
+        constant += sep_len;
+
+      int *clens = malloc (radix[src] * sizeof (int));
+      for (int v=0; v < radix[src]; ++v)
+        {
+          clens[v] = constant;
+          if (NULL_REF_SEED != cur->seed_type)
+            clens[v] += regular_seed_len (s, v, fmt->padding);
+        }
+      comps[i] = (struct est_comp){ .src = src, .lens = clens };
+    }
+
+  est_add_block (est, &blk, rank, count);
+  for (int i=0; i < size; ++i)
+    free ((int *) comps[i].lens);
+  safe_free (comps);
+  safe_free (radix);
+}
+
+/**
+ *  Iterates over blocks of regular mode, in the order of output
+ *  (a block is a format, window, offset and separator combination)
+ *
+ *  When @est is not NULL, only estimates the output within
+ *  @est->range, otherwise generates the permutations
+ *  within the @opt->range
+ */
+static int
+__regular_blocks (struct Opt *opt, struct perm_estimate *est)
 {
   int ret = 0;
   struct Seed *seeds = opt->seeds;
   int seeds_len = (int) da_sizeof (seeds);
   int idxs_len_bytes = seeds_len * sizeof (int);
-  int *tmp = malloc (idxs_len_bytes),
+  int *tmp = calloc (1, idxs_len_bytes),
     *lengths = malloc (idxs_len_bytes);
+  size_t skip = opt->range.skip, count = opt->range.count;
 
   /* Initialize @lengths by length of each seed array */
   struct Seed *s = NULL;
@@ -1086,11 +2136,26 @@ regular_perm (struct Opt *opt)
   ssize_t fmt_len = da_sizeof (opt->formats);
   size_t  max_depth = da_sizeof (seeds);
 
+  /* Estimation must not modify the format options */
+  struct Fmt *fmts = opt->fmts;
+  size_t rank = 0;
+  if (est)
+    {
+      est->lines = est->bytes = 0;
+      fmts = mk_fmt_arr (max_depth);
+    }
+
   int fmt_count = start;
   for (char **fmt = opt->formats; fmt_len != 0; ++fmt, --fmt_len)
     {
-      if (*fmt)
-        fmt_count = pparse_format_option (opt, opt->fmts, max_depth, *fmt);
+      if (*fmt && est)
+        {
+          char *fmt_copy = strdup (*fmt);
+          fmt_count = pparse_format_option (opt, fmts, max_depth, fmt_copy);
+          free (fmt_copy);
+        }
+      else if (*fmt)
+        fmt_count = pparse_format_option (opt, fmts, max_depth, *fmt);
       for (int window = start; window <= end; ++window)
         {
           for (int offset = 0; offset + window <= seeds_len; ++offset)
@@ -1100,24 +2165,74 @@ regular_perm (struct Opt *opt)
                   int window_len = MIN (fmt_count, window);
                   if (__unlikely (window_len <= 0))
                     continue;
+                  size_t block =
+                    regular_perm_count (lengths + offset, window_len);
+                  if (est)
+                    {
+                      regular_est_block (opt, est, fmts, lengths,
+                                         window_len, offset, opt->seps[i],
+                                         rank, block);
+                      rank = perm_add (rank, block);
+                      continue;
+                    }
+                  if (skip >= block)
+                    {
+                      skip -= block;
+                      continue;
+                    }
+                  if (__unlikely (count == 0))
+                    goto end_of_format;
+                  size_t n = MIN (block - skip, count);
+                  regular_perm_unrank (skip, lengths + offset,
+                                       tmp, window_len);
+                  skip = 0;
+
                   ret =
                     __regular_perm (opt, lengths, tmp,
-                                    window_len, offset, opt->seps[i]);
-                  if (__unlikely (ret != 0))
-                    break;
+                                    window_len, offset, opt->seps[i], n);
+                  count -= n;
+                  if (__unlikely (ret != 0 || count == 0))
+                    goto end_of_format;
                 }
             }
         }
+    end_of_format:
       /* Free and unset fmts if provided */
       for (int i=0; i<fmt_count; ++i)
-        fmt_free (&opt->fmts[i]);
+        fmt_free (&fmts[i]);
+      if (ret != 0 || count == 0)
+        break;
     }
 
+  if (est)
+    safe_free (fmts);
   safe_free (tmp);
   safe_free (lengths);
   return ret;
 }
 
+int
+regular_perm (struct Opt *opt)
+{
+  return __regular_blocks (opt, NULL);
+}
+
+/* Regular mode, estimates the output within @est->range */
+void
+regular_perm_estimate (struct Opt *opt, struct perm_estimate *est)
+{
+  __regular_blocks (opt, est);
+}
+
+/* Regular mode, total count of permutations */
+size_t
+regular_perm_total (struct Opt *opt)
+{
+  struct perm_estimate est = { .skip = 0, .count = SIZE_MAX };
+  __regular_blocks (opt, &est);
+  return est.lines;
+}
+
 int
 cseed_uniappd (struct Seed *s, const char *src, int len)
 {
@@ -1146,6 +2261,136 @@ cseed_uniappd (struct Seed *s, const char *src, int len)
   return (rw > 0) ? rw - 1 : 0;
 }
 
+#ifndef _SKIP_UNIQUE
+/**
+ *  Makes the hash table of @windex with capacity @cap,
+ *  and inserts the first @n keys of @windex->keys
+ */
+static int
+windex_rehash (struct wseed_index *windex, idx_t cap, idx_t n)
+{
+  safe_free (windex->ht.table);
+  windex->ht = new_hashtab (cap, windex->keys, WSEED_HT_DL);
+  ht_set_funs (&windex->ht, NULL, NULL);
+  if (0 != ht_init (&windex->ht, malloc (ht_sizeof (&windex->ht))))
+    return -1;
+
+  for (idx_t i = 0; i < n; ++i)
+    {
+      if (HT_NO_EMPTYSLOT == ht_insert (&windex->ht, i))
+        return windex_rehash (windex, 2 * cap, n);
+    }
+  return 0;
+}
+
+/**
+ *  Inserts the last key of @windex->keys
+ *  Returns HT_DUPLICATED when the key already exists
+ */
+static int
+windex_insert (struct wseed_index *windex)
+{
+  int ret;
+  idx_t idx = da_sizeof (windex->keys) - 1;
+  windex->ht.head = (DATA_T *) windex->keys; /* might be reallocated */
+
+  /* Keep the load factor below 1/2 */
+  if (2 * (idx + 1) > windex->ht.cap &&
+      0 != windex_rehash (windex, 2 * windex->ht.cap, idx))
+    return -1;
+
+  while (HT_NO_EMPTYSLOT == (ret = ht_insert (&windex->ht, idx)))
+    {
+      if (0 != windex_rehash (windex, 2 * windex->ht.cap, idx))
+        return -1;
+    }
+  return ret;
+}
+#endif /* _SKIP_UNIQUE */
+
+#ifndef _SKIP_UNIQUE
+/**
+ *  Makes the index of the current words of @s, with room
+ *  for @n more words without rehashing
+ */
+static int
+windex_new (struct Seed *s, size_t n)
+{
+  idx_t len = da_sizeof (s->wseed);
+  s->windex = calloc (1, sizeof (struct wseed_index));
+  if (! s->windex)
+    return -1;
+  s->windex->keys = da_newn (struct keytab_t, MAX (WSEED_HT_CAP, len + n));
+  da_foreach (s->wseed, i)
+    {
+      struct keytab_t k = KEYS (s->wseed[i]);
+      da_appd (s->windex->keys, k);
+    }
+  return windex_rehash (s->windex,
+                        MAX (WSEED_HT_CAP, 2 * (len + n) + 1), len);
+}
+#endif /* _SKIP_UNIQUE */
+
+/**
+ *  Reserves room for @n more words in @s, so appending
+ *  them will not reallocate @s->wseed nor rehash its index
+ *  Used with the line count of word-list files
+ */
+static void
+wseed_reserve (struct Seed *s, size_t n)
+{
+#if WSEED_MAXCNT > 0
+  n = MIN (n, (size_t) WSEED_MAXCNT);
+#endif
+  if (n > INT_MAX / 2)
+    return;
+  da_reserve (s->wseed, n);
+#ifndef _SKIP_UNIQUE
+  idx_t len = da_sizeof (s->wseed);
+  if (! s->windex)
+    windex_new (s, n);
+  else if (2 * (len + n) > s->windex->ht.cap)
+    {
+      da_reserve (s->windex->keys, n);
+      windex_rehash (s->windex, 2 * (len + n) + 1, len);
+    }
+#endif
+}
+
+static int
+__wseed_uniappd (struct Seed *s, char *word)
+{
+  if (!s->wseed || !word)
+    return -1;
+#if WSEED_MAXCNT > 0
+  if (da_sizeof (s->wseed) >= WSEED_MAXCNT)
+    {
+      static bool warned = false;
+      if (! warned)
+        warnln ("more than %d words in a seed, the rest are ignored "
+                "(see WSEED_MAXCNT)", WSEED_MAXCNT);
+      warned = true;
+      return -1;
+    }
+#endif
+
+#ifndef _SKIP_UNIQUE
+  if (! s->windex && 0 != windex_new (s, 1))
+    return -1;
+  struct keytab_t k = KEYS (word);
+  da_appd (s->windex->keys, k);
+  int ret = windex_insert (s->windex);
+  if (HT_FOUND != ret)
+    {
+      da_pop1 (s->windex->keys);
+      return (HT_DUPLICATED == ret) ? 1 : -1;
+    }
+#endif /* _SKIP_UNIQUE */
+
+  da_appd (s->wseed, word);
+  return 0;
+}
+
 int
 wseed_uniappd (const struct Opt *opt,
                struct Seed *s, const char *str_word)
@@ -1157,20 +2402,82 @@ wseed_uniappd (const struct Opt *opt,
   if (!opt->escape_disabled)
     UNESCAPE (word);
 
-  size_t len = da_sizeof (s->wseed);
-  if (len >= WSEED_MAXCNT)
+  int ret = __wseed_uniappd (s, word);
+  if (0 != ret)
+    safe_free (word);
+  return ret;
+}
+
+/**
+ *  Memory mapped version of wseed_file_uniappd, for regular files
+ *  The file is mapped privately (copy on write), and words are
+ *  terminated and unescaped in place, so @dst->wseed points to
+ *  the mapping instead of copies; lines longer than WSEED_MAXLEN
+ *  are ignored.  Returns -1 if @fd could not be mapped
+ */
+static int
+wseed_map_uniappd (const struct Opt *opt, struct Seed *dst, int fd)
+{
+  struct stat sb;
+  if (-1 == fstat (fd, &sb) || !S_ISREG (sb.st_mode) || 0 == sb.st_size)
     return -1;
-#ifndef _SKIP_UNIQUE
-  for (size_t i=0; i < len; ++i)
+
+  char *mem = mmap (NULL, sb.st_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE, fd, 0);
+  if (MAP_FAILED == mem)
+    return -1;
+  madvise (mem, sb.st_size, MADV_SEQUENTIAL);
+
+  struct wseed_map map = { .mem = mem, .len = sb.st_size };
+  da_appd (dst->maps, map);
+
+  /* Words are separated by newline, or by any space in GETLINE_FMT */
+  bool fmt = HAS_FLAG (opt->getline_flags, GETLINE_FMT);
+  char *end = mem + sb.st_size;
+
+  /* Size the seed by the line count, to not grow it while loading */
+  size_t lines = 1;
+  for (char *p = mem; (p = memchr (p, '\n', end - p)); ++p)
+    ++lines;
+  wseed_reserve (dst, lines);
+  for (char *p = mem, *next; p < end; p = next)
     {
-      if (Strcmp (s->wseed[i], word))
+      char *w = p;
+      if (fmt)
+        while (p < end && *p > ' ')
+          ++p;
+      else
+        while (p < end && *p != '\n')
+          ++p;
+      next = p + 1;
+
+      if (p == end) /* the last line without newline */
         {
-          safe_free (word);
-          return 1;
+          if (p - w > WSEED_MAXLEN)
+            break;
+          w = strndup (w, p - w);
         }
+      else if (p - w > WSEED_MAXLEN)
+        continue;
+      else
+        *p = '\0';
+
+      char *cr = strchr (w, '\r');
+      if (cr)
+        *cr = '\0';
+
+      int ret = 1;
+      if (getline_isvalid (w, opt->getline_flags))
+        {
+          if (!opt->escape_disabled)
+            UNESCAPE (w);
+          ret = __wseed_uniappd (dst, w);
+        }
+      if (0 != ret && p == end)
+        safe_free (w);
+      if (ret < 0)
+        break;
     }
-#endif /* _SKIP_UNIQUE */
-  da_appd (s->wseed, word);
   return 0;
 }
 
@@ -1236,9 +2543,10 @@ wseed_getline (char *buff, int len, FILE *stream, int flags)
       if (! fgets (buff, len, stream))
         return 1;
       char *p = strpbrk (buff, "\r\n");
-      if (! p)
-        return 1; /* invalid */
-      *p = '\0';
+      if (p)
+        *p = '\0';
+      else if (! feof (stream))
+        return 1; /* invalid, too long */
     }
   if (! getline_isvalid (buff, flags))
     return 1;
@@ -1282,6 +2590,9 @@ wseed_file_uniappd (const struct Opt *opt,
         }
     }
 
+  if (0 == wseed_map_uniappd (opt, dst, fileno (stream)))
+    return;
+
   const int line_cap = WSEED_MAXLEN + 1;
   char *line = malloc (line_cap);
   while (1)
@@ -1346,6 +2657,25 @@ opt_regular_getopt (int argc, char **argv, struct Opt *opt)
   return 0;
 }
 
+/**
+ *  Parses a non-negative integer @str into @dst
+ *  Returns -1 on failure, and 0 on success
+ */
+static int
+parse_size (const char *str, size_t *dst)
+{
+  char *end;
+  unsigned long long n;
+  if ('-' == *str)
+    return -1;
+  errno = 0;
+  n = strtoull (str, &end, 10);
+  if (0 != errno || end == str || '\0' != *end)
+    return -1;
+  *dst = (size_t) n;
+  return 0;
+}
+
 #define CHECK(cond, action) if (cond) {action}
 #define CHECK_AND_BREAK(cond, action) CHECK (cond, {action; break;})
 
@@ -1474,6 +2804,44 @@ opt_getopt (int argc, char **argv, struct Opt *opt)
           }
           break;
 
+        case 'Z': /* estimate */
+          opt->estimate = true;
+          break;
+
+          /* Range of output */
+        case 'K': /* skip */
+          if (parse_size (optarg, &opt->range.skip) < 0)
+            warnln ("invalid skip value (%s) was ignored", optarg);
+          break;
+        case 'M': /* count */
+          if (parse_size (optarg, &opt->range.count) < 0)
+            warnln ("invalid count value (%s) was ignored", optarg);
+          break;
+        case 'I': /* shard i/n */
+          {
+            size_t i, n;
+            if (2 != sscanf (optarg, "%zu/%zu", &i, &n) ||
+                i < 1 || i > n)
+              {
+                warnln ("invalid shard (%s) was ignored", optarg);
+                break;
+              }
+            opt->shard.idx = i;
+            opt->shard.n = n;
+          }
+          break;
+
+          /* Multi-threaded mode */
+        case 'T': NORMAL_MODE_ONLY
+          opt->threads.count = atoi (optarg);
+          break;
+        case 'O': NORMAL_MODE_ONLY
+          opt->threads.ordered = true;
+          break;
+        case 'P': NORMAL_MODE_ONLY
+          opt->threads.shard_path = optarg;
+          break;
+
         case '9':
           opt->getline_flags |= GETLINE_FMT;
           break;
@@ -1544,6 +2912,16 @@ opt_init (struct Opt *opt)
           /* Invalid min and max depths, set them equal */
           opt->depth.max = opt->depth.min;
         }
+
+#ifdef _USE_BIO
+      if (opt->threads.count > 1)
+        warnln ("multi-threaded mode is not supported with _USE_BIO");
+      opt->threads.count = 0;
+#endif
+      if (opt->threads.count <= 1 && opt->threads.shard_path)
+        opt->threads.count = 1; /* a single shard */
+      if (opt->threads.ordered && opt->threads.shard_path)
+        opt->threads.ordered = false; /* shards are always ordered */
       break;
     }
 
@@ -1572,6 +2950,43 @@ opt_init (struct Opt *opt)
   *opt->bio = bio_new (_BMAX, malloc (_BMAX), fileno (opt->outf));
   dprintf ("* buffer length of buffered_io: %d bytes\n", _BMAX);
 # endif /* _USE_BIO */
+
+  /**
+   *  The shard option, turns to a range of permutations,
+   *  then skip and count options apply within it
+   */
+  if (opt->shard.n > 0)
+    {
+      size_t total = (opt->mode == REGULAR_MODE) ?
+        regular_perm_total (opt) : perm_total (opt);
+      size_t from = (unsigned __int128) total * (opt->shard.idx - 1)
+        / opt->shard.n;
+      size_t to = (unsigned __int128) total * opt->shard.idx
+        / opt->shard.n;
+
+      from = perm_add (from, opt->range.skip);
+      opt->range.skip = from;
+      opt->range.count = (from < to) ? MIN (opt->range.count, to - from) : 0;
+      dprintf ("* shard %lu/%lu: skip=%lu, count=%lu\n",
+               opt->shard.idx, opt->shard.n,
+               opt->range.skip, opt->range.count);
+    }
+}
+
+/* Checks if @word belongs to one of the mapped files of @s */
+static inline bool
+wseed_is_mapped (const struct Seed *s, const char *word)
+{
+  if (s->maps)
+    {
+      da_foreach (s->maps, i)
+        {
+          const char *mem = s->maps[i].mem;
+          if (word >= mem && word < mem + s->maps[i].len)
+            return true;
+        }
+    }
+  return false;
 }
 
 static inline void
@@ -1586,10 +3001,27 @@ free_seed (struct Seed *s)
     {
       da_foreach (s->wseed, i)
         {
-          safe_free (s->wseed[i]);
+          if (! wseed_is_mapped (s, s->wseed[i]))
+            safe_free (s->wseed[i]);
         }
       da_free (s->wseed);
     }
+#ifndef _SKIP_UNIQUE
+  if (s->windex)
+    {
+      safe_free (s->windex->ht.table);
+      da_free (s->windex->keys);
+      safe_free (s->windex);
+    }
+#endif
+  if (s->maps)
+    {
+      da_foreach (s->maps, i)
+        {
+          munmap (s->maps[i].mem, s->maps[i].len);
+        }
+      da_free (s->maps);
+    }
 }
 
 static inline void
@@ -1613,11 +3045,105 @@ mk_opt (void)
 
   opt.outf = stdout;
   opt.mode = NORMAL_MODE;
+  opt.range.count = SIZE_MAX;
   opt.escape_disabled = false;
 
   return &opt;
 }
 
+/* Generates permutations, based on the mode of @opt */
+static int
+generate (struct Opt *opt)
+{
+  switch (opt->mode)
+    {
+    case REGULAR_MODE:
+      return regular_perm (opt);
+
+    case NORMAL_MODE:
+#ifndef _USE_BIO
+      if (opt->threads.count > 1 || opt->threads.shard_path)
+        return perm_threaded (opt);
+#endif
+      return perm (opt);
+    }
+  return 0;
+}
+
+static inline const char *
+human_size (double bytes, char *buff, int len)
+{
+  const char *units[] = {"B", "KiB", "MiB", "GiB", "TiB", "PiB", "EiB"};
+  int i = 0;
+  for (; bytes >= 1024 && i < 6; ++i)
+    bytes /= 1024;
+  snprintf (buff, len, "%.2f %s", bytes, units[i]);
+  return buff;
+}
+
+/**
+ *  The estimate mode (--estimate)
+ *  Prints count of lines and bytes of the output without generating it,
+ *  and the expected runtime, based on the rate of a short calibration
+ *  burst (at most CALIBRATION_LINES lines into /dev/null)
+ */
+static int
+estimate (struct Opt *opt)
+{
+  char tmp[32];
+  struct timespec t0, t1;
+  struct perm_estimate est = {
+    .skip = opt->range.skip, .count = opt->range.count,
+  };
+  struct perm_estimate burst = {
+    .skip = opt->range.skip,
+    .count = MIN (opt->range.count, CALIBRATION_LINES),
+  };
+  void (*est_fun) (struct Opt *, struct perm_estimate *) =
+    (opt->mode == REGULAR_MODE) ? regular_perm_estimate :
+    (void (*) (struct Opt *, struct perm_estimate *)) perm_estimate;
+
+  /* It must be called before generation, see __regular_blocks */
+  est_fun (opt, &est);
+  est_fun (opt, &burst);
+
+  FILE *outf = opt->outf, *devnull = safe_fopen ("/dev/null", "w");
+  if (! devnull)
+    return EXIT_FAILURE;
+  opt->outf = devnull;
+  opt->range.count = burst.lines;
+#ifdef _USE_BIO
+  bio_fout (opt->bio, devnull);
+#endif
+
+  clock_gettime (CLOCK_MONOTONIC, &t0);
+  generate (opt);
+#ifdef _USE_BIO
+  bio_flush (opt->bio);
+  bio_fout (opt->bio, outf);
+#endif
+  fflush (devnull);
+  clock_gettime (CLOCK_MONOTONIC, &t1);
+  opt->outf = outf;
+  safe_fclose (devnull);
+
+  double dt = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+  const char *at_least = (est.lines == SIZE_MAX || est.bytes == SIZE_MAX)
+    ? "at least " : "";
+
+  printf ("lines:  %s%zu\n", at_least, est.lines);
+  printf ("bytes:  %s%zu (%s)\n", at_least, est.bytes,
+          human_size (est.bytes, tmp, sizeof (tmp)));
+  if (dt > 0 && burst.bytes > 0)
+    {
+      double rate = burst.bytes / dt;
+      printf ("rate:   %s/s (calibration: %zu lines)\n",
+              human_size (rate, tmp, sizeof (tmp)), burst.lines);
+      printf ("time:   %s%.2f seconds\n", at_least, est.bytes / rate);
+    }
+  return 0;
+}
+
 int
 main (int argc, char **argv)
 {
@@ -1708,18 +3234,12 @@ main (int argc, char **argv)
 #endif /* _DEBUG */
 
 
-  /* Generating permutations */
-  switch (opt->mode)
-    {
-    case REGULAR_MODE:
-      regular_perm (opt);
-      break;
-
-    case NORMAL_MODE:
-      perm (opt);
-      break;
-    }
+  if (opt->estimate)
+    return estimate (opt);
 
+  /* Generating permutations */
+  if (0 != generate (opt))
+    return EXIT_FAILURE;
   return 0;
 }
 
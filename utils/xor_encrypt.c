@@ -4,26 +4,52 @@
  *
  *    usage:
  *      ./enc [input file] [output file] [KEY]      
- *      KEY is in range 0x00 to 0xFF
+ *      KEY is in range 0x00 to 0xFF, or a longer
+ *      hex string (up to MAX_KEY bytes) for a
+ *      repeating multi-byte key, e.g. 0xdeadbeef
  *
  *
  *    compilation:
- *      cc -o enc -Wall -Wextra -DDEBUG xor_encrypt.c
+ *      cc -O2 -o enc -Wall -Wextra -DDEBUG xor_encrypt.c -lpthread
  *
  *    use -D ESCAPE_HEAD
  *          if you don't want the magic byte of
  *          your files to be affected
+ *    use -D NO_MMAP
+ *          to always use the stdio path, by default
+ *          regular files are mapped and XORed in
+ *          parallel (THREADS, default: number of CPUs)
  *
  */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
+
+#ifndef NO_MMAP
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
-#define BUFF_SIZE 512
+#define BUFF_SIZE (64 * 1024)
 #define HEAD_LEN 10
+#define MAX_KEY 64
 
+/* minimum bytes per thread of the mmap path */
+#define MIN_CHUNK (4 << 20)
+/* XOR pattern length, multiple of the key and 64 bytes */
+#define PAT_LEN(klen) ((klen) * 64)
 
-#define xor_alg(j, x) buff[j] ^= x
 
 #ifdef DEBUG
 #define logf(format, ...) \
@@ -44,11 +70,199 @@
 
 
 
-int enc(FILE *in, FILE *out, char xor)
+typedef struct {
+  unsigned char k[MAX_KEY];
+  size_t len;
+} xor_key;
+
+
+/**
+ *  builds the XOR pattern of @key starting at key
+ *  offset @phase, PAT_LEN(key->len) bytes of @pat
+ */
+static void mkpat(unsigned char *pat, const xor_key *key, size_t phase)
+{
+  size_t i;
+  for(i=0; i<PAT_LEN(key->len); ++i)
+    pat[i] = key->k[(phase + i) % key->len];
+}
+
+/**
+ *  dst[i] = src[i] ^ key, where the key starts at
+ *  offset @phase of the repeating key
+ *  the pattern period is a multiple of 64, so the main
+ *  loop XORs whole 16-byte words (dst may equal src)
+ */
+static void xor_block(unsigned char *dst, const unsigned char *src,
+                      size_t n, const xor_key *key, size_t phase)
+{
+  unsigned char pat[PAT_LEN(MAX_KEY)];
+  size_t plen = PAT_LEN(key->len), i, j;
+
+  mkpat(pat, key, phase);
+
+  for(i=0; i + plen <= n; i += plen)
+    {
+      for(j=0; j<plen; j += 64)
+        {
+#ifdef __SSE2__
+          const __m128i *s = (const __m128i *)(src + i + j);
+          __m128i *d = (__m128i *)(dst + i + j);
+          const __m128i *p = (const __m128i *)(pat + j);
+          __m128i a = _mm_loadu_si128(s + 0);
+          __m128i b = _mm_loadu_si128(s + 1);
+          __m128i c = _mm_loadu_si128(s + 2);
+          __m128i e = _mm_loadu_si128(s + 3);
+          _mm_storeu_si128(d + 0, _mm_xor_si128(a, _mm_loadu_si128(p + 0)));
+          _mm_storeu_si128(d + 1, _mm_xor_si128(b, _mm_loadu_si128(p + 1)));
+          _mm_storeu_si128(d + 2, _mm_xor_si128(c, _mm_loadu_si128(p + 2)));
+          _mm_storeu_si128(d + 3, _mm_xor_si128(e, _mm_loadu_si128(p + 3)));
+#else
+          size_t k;
+          for(k=0; k<64; k += 8)
+            {
+              unsigned long long w, x;
+              memcpy(&w, src + i + j + k, 8);
+              memcpy(&x, pat + j + k, 8);
+              w ^= x;
+              memcpy(dst + i + j + k, &w, 8);
+            }
+#endif
+        }
+    }
+  /* tail, pattern continues from the start */
+  for(j=0; i<n; ++i, ++j)
+    dst[i] = src[i] ^ pat[j];
+}
+
+
+#ifndef NO_MMAP
+struct xor_job {
+  unsigned char *dst;
+  const unsigned char *src;
+  size_t n;
+  size_t phase;
+  const xor_key *key;
+  pthread_t th;
+  int spawned;
+};
+
+static void *xor_worker(void *arg)
+{
+  struct xor_job *job = arg;
+  xor_block(job->dst, job->src, job->n, job->key, job->phase);
+  return NULL;
+}
+
+/**
+ *  the mmap path: maps the input and output files
+ *  and splits XOR of them across threads
+ *  returns -1 when not applicable (input is not a regular
+ *  file or the output cannot be mapped), otherwise the
+ *  number of bytes written, or -2 on failure
+ */
+long long enc_mmap(const char *in_path, const char *out_path,
+                   const xor_key *key)
+{
+  struct stat st;
+  int in_fd, out_fd;
+  unsigned char *src, *dst;
+  size_t size, head = 0, nth, chunk, i;
+  long long ret = -1;
+
+  if ((in_fd = open(in_path, O_RDONLY)) < 0)
+    return -1;
+  if (fstat(in_fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+    {
+      close(in_fd);
+      return -1;
+    }
+  size = st.st_size;
+
+  if ((out_fd = open(out_path, O_RDWR|O_CREAT|O_TRUNC, 0644)) < 0)
+    {
+      close(in_fd);
+      return -1;
+    }
+  if (fstat(out_fd, &st) < 0 || !S_ISREG(st.st_mode) ||
+      ftruncate(out_fd, size) < 0)
+    goto Close;
+
+  src = mmap(NULL, size, PROT_READ, MAP_SHARED, in_fd, 0);
+  if (src == MAP_FAILED)
+    goto Close;
+  dst = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, out_fd, 0);
+  if (dst == MAP_FAILED)
+    {
+      munmap(src, size);
+      goto Close;
+    }
+  madvise(src, size, MADV_SEQUENTIAL);
+
+#ifdef ESCAPE_HEAD
+  // copy first HEAD_LEN bytes of the input file
+  head = size < HEAD_LEN ? size : HEAD_LEN;
+  memcpy(dst, src, head);
+#endif
+
+#ifdef THREADS
+  nth = THREADS;
+#else
+  nth = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  if (nth > (size - head) / MIN_CHUNK)
+    nth = (size - head) / MIN_CHUNK;
+  if (nth < 1)
+    nth = 1;
+  logf("mmap mode: %zu thread(s)\n", nth);
+
+  {
+    struct xor_job jobs[nth];
+    /* page aligned chunks, phase follows the key offset */
+    chunk = ((size - head) / nth + 4095) & ~(size_t)4095;
+    for(i=0; i<nth; ++i)
+      {
+        size_t off = i * chunk;
+        size_t n = off >= size - head ? 0 :
+          (size - head - off < chunk ? size - head - off : chunk);
+        jobs[i] = (struct xor_job){
+          .dst = dst + head + off, .src = src + head + off,
+          .n = n, .phase = off % key->len, .key = key
+        };
+        // the first chunk is done by this thread, after the others
+        if (i > 0)
+          jobs[i].spawned = (pthread_create(&jobs[i].th, NULL,
+                                            xor_worker, jobs + i) == 0);
+        if (i > 0 && !jobs[i].spawned)
+          xor_worker(jobs + i);
+      }
+    xor_worker(jobs);
+    for(i=1; i<nth; ++i)
+      if (jobs[i].spawned)
+        pthread_join(jobs[i].th, NULL);
+  }
+
+  logf("%zu records in\n", size);
+  munmap(src, size);
+  if (munmap(dst, size) < 0)
+    ret = -2;
+  else
+    ret = size;
+
+ Close:
+  close(in_fd);
+  if (close(out_fd) < 0)
+    ret = -2;
+  return ret;
+}
+#endif
+
+
+size_t enc(FILE *in, FILE *out, const xor_key *key)
 {
-  char buff[BUFF_SIZE];
-  size_t i, j;
-  int write_l = 0, read_l = 0;
+  static unsigned char buff[BUFF_SIZE];
+  size_t i, phase = 0;
+  size_t write_l = 0, read_l = 0;
 
 
 #ifdef ESCAPE_HEAD
@@ -62,28 +276,58 @@ int enc(FILE *in, FILE *out, char xor)
   // copy and XOR
   while ((i = fread(buff, 1, BUFF_SIZE, in)) > 0)
     {
-      for(j=0; j<i; ++j)
-        xor_alg(j, xor);
+      xor_block(buff, buff, i, key, phase);
+      phase = (phase + i) % key->len;
 
       read_l += i;
       write_l += fwrite(buff, 1, i, out);
     }
 
-  logf("%d records in\n", read_l);
+  logf("%zu records in\n", read_l);
   return write_l;
 }
 
 
+/**
+ *  parses the hex key, one byte per two digits
+ *  0x prefix is optional, returns the key length,
+ *  0 on invalid input
+ */
+static size_t parse_key(const char *s, xor_key *key)
+{
+  size_t n, i;
+  if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X'))
+    s += 2;
+  n = strlen(s);
+  if (n == 0 || (n + 1) / 2 > MAX_KEY)
+    return 0;
+
+  key->len = 0;
+  for(i=0; i<n; ++i)
+    if (!isxdigit((unsigned char)s[i]))
+      return 0;
+  // odd number of digits, the first byte has only one
+  if (n % 2)
+    {
+      sscanf(s, "%1hhx", &key->k[key->len++]);
+      s++;
+    }
+  for(; *s; s += 2)
+    sscanf(s, "%2hhx", &key->k[key->len++]);
+  return key->len;
+}
+
+
 int main(int argc, char **argv)
 {
-  unsigned int xor;
+  xor_key key;
   FILE *file_in, *file_out;
 
   
   if(argc<4)
     {
       fprintf(stderr, "Not Enough Input Arguments\n");
-      fprintf(stderr, "Usage: ./enc [input file] [output file] 0x[00 to ff]\n");
+      fprintf(stderr, "Usage: ./enc [input file] [output file] 0x[00 to ff]...\n");
       return 1;
     }
 
@@ -93,11 +337,32 @@ int main(int argc, char **argv)
       return 1;
     }
 
-  // read xor byte
-  sscanf(argv[3], "%x", &xor);
-  logf("config: in=%s, out=%s, XOR byte=0x%x\n",
-         argv[1], argv[2], xor);
+  // read xor key
+  if (parse_key(argv[3], &key) == 0)
+    {
+      fprintf(stderr, "invalid key, expected up to %d hex bytes.\n",
+              MAX_KEY);
+      return 1;
+    }
+  logf("config: in=%s, out=%s, XOR key length=%zu\n",
+         argv[1], argv[2], key.len);
 
+#ifndef NO_MMAP
+  {
+    long long _len = enc_mmap(argv[1], argv[2], &key);
+    if (_len == -2)
+      {
+        perror("enc");
+        return 1;
+      }
+    if (_len >= 0)
+      {
+        printf("%lld bytes (%.1f %s) copied.\n",
+               _len, HR_size(_len), HR_format(_len));
+        return 0;
+      }
+  }
+#endif
 
   
   // open files
@@ -119,9 +384,9 @@ int main(int argc, char **argv)
     }
   else
     {
-      int _len = enc(file_in, file_out, (char)xor);
+      size_t _len = enc(file_in, file_out, &key);
 
-      printf("%d bytes (%.1f %s) copied.\n",
+      printf("%zu bytes (%.1f %s) copied.\n",
              _len, HR_size(_len), HR_format(_len));
 
       fclose(file_in);